@@ -25,8 +25,21 @@
 #define ICET_USE_MPI_IN_PLACE
 #endif
 
+#if MPI_VERSION >= 3
+#define ICET_USE_MPI_REDUCE_SCATTER
+#endif
+
 #define ICET_MPI_REQUEST_MAGIC_NUMBER ((IceTEnum)0xD7168B00)
 
+/* Requests are allocated this many at a time and then reused. */
+#define ICET_MPI_REQUEST_BLOCK_SIZE     64
+
+/* The most persistent requests a communicator keeps at once. */
+#define ICET_MPI_PERSISTENT_CACHE_SIZE  128
+
+/* The most group communicators kept for ReduceScatterBlock. */
+#define ICET_MPI_GROUP_CACHE_SIZE       16
+
 #define ICET_MPI_TEMP_BUFFER_0  (ICET_COMMUNICATION_LAYER_START | (IceTEnum)0x00)
 
 static IceTCommunicator MPIDuplicate(IceTCommunicator self);
@@ -37,66 +50,98 @@ static void MPIDestroy(IceTCommunicator self);
 static void MPIBarrier(IceTCommunicator self);
 static void MPISend(IceTCommunicator self,
                     const void *buf,
-                    int count,
+                    IceTSizeType count,
                     IceTEnum datatype,
                     int dest,
                     int tag);
 static void MPIRecv(IceTCommunicator self,
                     void *buf,
-                    int count,
+                    IceTSizeType count,
                     IceTEnum datatype,
                     int src,
                     int tag);
 static void MPISendrecv(IceTCommunicator self,
                         const void *sendbuf,
-                        int sendcount,
+                        IceTSizeType sendcount,
                         IceTEnum sendtype,
                         int dest,
                         int sendtag,
                         void *recvbuf,
-                        int recvcount,
+                        IceTSizeType recvcount,
                         IceTEnum recvtype,
                         int src,
                         int recvtag);
 static void MPIGather(IceTCommunicator self,
                       const void *sendbuf,
-                      int sendcount,
+                      IceTSizeType sendcount,
                       IceTEnum datatype,
                       void *recvbuf,
                       int root);
 static void MPIGatherv(IceTCommunicator self,
                        const void *sendbuf,
-                       int sendcount,
+                       IceTSizeType sendcount,
                        IceTEnum datatype,
                        void *recvbuf,
-                       const int *recvcounts,
-                       const int *recvoffsets,
+                       const IceTSizeType *recvcounts,
+                       const IceTSizeType *recvoffsets,
                        int root);
 static void MPIAllgather(IceTCommunicator self,
                          const void *sendbuf,
-                         int sendcount,
+                         IceTSizeType sendcount,
                          IceTEnum datatype,
                          void *recvbuf);
 static void MPIAlltoall(IceTCommunicator self,
                         const void *sendbuf,
-                        int sendcount,
+                        IceTSizeType sendcount,
                         IceTEnum datatype,
                         void *recvbuf);
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+static void MPIReduceScatterBlock(IceTCommunicator self,
+                                  int group_size,
+                                  const IceTInt32 *group,
+                                  const void *sendbuf,
+                                  void *recvbuf,
+                                  IceTSizeType recvcount,
+                                  IceTSizeType element_size,
+                                  IceTCommReduceFunction reduce,
+                                  void *reduce_data);
+#endif
 static IceTCommRequest MPIIsend(IceTCommunicator self,
                                 const void *buf,
-                                int count,
+                                IceTSizeType count,
                                 IceTEnum datatype,
                                 int dest,
                                 int tag);
 static IceTCommRequest MPIIrecv(IceTCommunicator self,
                                 void *buf,
-                                int count,
+                                IceTSizeType count,
                                 IceTEnum datatype,
                                 int src,
                                 int tag);
+static IceTCommRequest MPIPersistentIsend(IceTCommunicator self,
+                                          const void *buf,
+                                          IceTSizeType count,
+                                          IceTEnum datatype,
+                                          int dest,
+                                          int tag);
+static IceTCommRequest MPIPersistentIrecv(IceTCommunicator self,
+                                          void *buf,
+                                          IceTSizeType count,
+                                          IceTEnum datatype,
+                                          int src,
+                                          int tag);
 static void MPIWaitone(IceTCommunicator self, IceTCommRequest *request);
 static int  MPIWaitany(IceTCommunicator self,
                        int count, IceTCommRequest *array_of_requests);
+static int  MPIWaitsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices);
+static int  MPITestsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices);
+static int  MPITest(IceTCommunicator self, IceTCommRequest *request);
 static int MPIComm_size(IceTCommunicator self);
 static int MPIComm_rank(IceTCommunicator self);
 
@@ -104,6 +149,72 @@ typedef struct IceTMPICommRequestInternalsStruct {
     MPI_Request request;
 } *IceTMPICommRequestInternals;
 
+struct IceTMPIPersistentRequestStruct;
+
+/* A request handed out by the communicator together with its internals.
+   Unused requests are kept in a free list linked through next_free.  The
+   slot of a persistent request is part of its cache entry instead, which
+   persistent points back to. */
+typedef struct IceTMPIRequestSlotStruct {
+    struct IceTCommRequestStruct request;
+    struct IceTMPICommRequestInternalsStruct internals;
+    struct IceTMPIRequestSlotStruct *next_free;
+    struct IceTMPIPersistentRequestStruct *persistent;
+} IceTMPIRequestSlot;
+
+/* A persistent MPI request made with MPI_Send_init or MPI_Recv_init and
+   remembered by what it exchanges.  The MPI request stays in the slot
+   between uses and is only freed when the entry is replaced or the
+   communicator is destroyed. */
+typedef struct IceTMPIPersistentRequestStruct {
+    IceTMPIRequestSlot slot;
+    const void *buf;
+    IceTSizeType count;
+    IceTEnum datatype;
+    int rank;
+    int tag;
+    IceTBoolean is_send;
+    IceTBoolean active;
+    unsigned long last_used;
+} IceTMPIPersistentRequest;
+
+/* Requests are allocated in blocks, which are linked so that they can be
+   freed with the communicator. */
+typedef struct IceTMPIRequestBlockStruct {
+    IceTMPIRequestSlot slots[ICET_MPI_REQUEST_BLOCK_SIZE];
+    struct IceTMPIRequestBlockStruct *next;
+} IceTMPIRequestBlock;
+
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+/* A communicator made for the processes of a ReduceScatterBlock group. */
+typedef struct IceTMPIGroupCommStruct {
+    int size;
+    IceTInt32 *ranks;
+    MPI_Comm comm;
+} IceTMPIGroupComm;
+#endif
+
+typedef struct IceTMPICommDataStruct {
+    MPI_Comm comm;
+    IceTMPIRequestSlot *free_requests;
+    IceTMPIRequestBlock *request_blocks;
+    /* Scratch array of MPI requests for Waitany, Waitsome and Testsome,
+       grown as needed. */
+    MPI_Request *wait_requests;
+    int wait_size;
+    /* Persistent requests, allocated on first use. */
+    IceTMPIPersistentRequest *persistent_requests;
+    int num_persistent_requests;
+    unsigned long persistent_clock;
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+    IceTMPIGroupComm group_comms[ICET_MPI_GROUP_CACHE_SIZE];
+    int num_group_comms;
+#endif
+} *IceTMPICommData;
+
+#define MPI_DATA        ((IceTMPICommData)self->data)
+#define MPI_COMM        (MPI_DATA->comm)
+
 static MPI_Request getMPIRequest(IceTCommRequest icet_request)
 {
     if (icet_request == ICET_COMM_REQUEST_NULL) {
@@ -137,42 +248,65 @@ static void setMPIRequest(IceTCommRequest icet_request, MPI_Request mpi_request)
         = mpi_request;
 }
 
-static IceTCommRequest create_request(void)
+/* Takes a request from the free list of the communicator, which only needs
+   to allocate memory when more requests are outstanding than ever before. */
+static IceTCommRequest create_request(IceTCommunicator self)
 {
-    IceTCommRequest request;
-
-    request = (IceTCommRequest)malloc(sizeof(struct IceTCommRequestStruct));
-    if (request == NULL) {
-        icetRaiseError("Could not allocate memory for IceTCommRequest",
-                       ICET_OUT_OF_MEMORY);
-        return NULL;
+    IceTMPIRequestSlot *slot;
+
+    if (MPI_DATA->free_requests == NULL) {
+        IceTMPIRequestBlock *block;
+        int i;
+
+        block = malloc(sizeof(IceTMPIRequestBlock));
+        if (block == NULL) {
+            icetRaiseError("Could not allocate memory for IceTCommRequest",
+                           ICET_OUT_OF_MEMORY);
+            return NULL;
+        }
+        for (i = 0; i < ICET_MPI_REQUEST_BLOCK_SIZE; i++) {
+            block->slots[i].request.magic_number
+                = ICET_MPI_REQUEST_MAGIC_NUMBER;
+            block->slots[i].request.internals = &block->slots[i].internals;
+            block->slots[i].next_free = &block->slots[i+1];
+            block->slots[i].persistent = NULL;
+        }
+        block->slots[ICET_MPI_REQUEST_BLOCK_SIZE-1].next_free = NULL;
+        block->next = MPI_DATA->request_blocks;
+        MPI_DATA->request_blocks = block;
+        MPI_DATA->free_requests = &block->slots[0];
     }
 
-    request->magic_number = ICET_MPI_REQUEST_MAGIC_NUMBER;
-    request->internals=malloc(sizeof(struct IceTMPICommRequestInternalsStruct));
-    if (request->internals == NULL) {
-        free(request);
-        icetRaiseError("Could not allocate memory for IceTCommRequest",
-                       ICET_OUT_OF_MEMORY);
-        return NULL;
-    }
+    slot = MPI_DATA->free_requests;
+    MPI_DATA->free_requests = slot->next_free;
 
-    setMPIRequest(request, MPI_REQUEST_NULL);
+    setMPIRequest(&slot->request, MPI_REQUEST_NULL);
 
-    return request;
+    return &slot->request;
 }
 
-static void destroy_request(IceTCommRequest request)
+/* Puts a request back on the free list of the communicator.  The request
+   is the first member of its slot, so the slot has the same address.  A
+   persistent request is instead left in the cache to be started again. */
+static void destroy_request(IceTCommunicator self, IceTCommRequest request)
 {
-    MPI_Request mpi_request = getMPIRequest(request);
+    IceTMPIRequestSlot *slot = (IceTMPIRequestSlot *)request;
+    MPI_Request mpi_request;
+
+    if (slot->persistent != NULL) {
+        slot->persistent->active = ICET_FALSE;
+        return;
+    }
+
+    mpi_request = getMPIRequest(request);
     if (mpi_request != MPI_REQUEST_NULL) {
         icetRaiseError("Destroying MPI request that is not NULL."
                        " Probably leaking MPI requests.",
                        ICET_SANITY_CHECK_FAIL);
     }
 
-    free(request->internals);
-    free(request);
+    slot->next_free = MPI_DATA->free_requests;
+    MPI_DATA->free_requests = slot;
 }
 
 #ifdef BREAK_ON_MPI_ERROR
@@ -193,6 +327,7 @@ static void ErrorHandler(MPI_Comm *comm, int *errorno, ...)
 IceTCommunicator icetCreateMPICommunicator(MPI_Comm mpi_comm)
 {
     IceTCommunicator comm;
+    IceTMPICommData data;
 #ifdef BREAK_ON_MPI_ERROR
     MPI_Errhandler eh;
 #endif
@@ -219,30 +354,51 @@ IceTCommunicator icetCreateMPICommunicator(MPI_Comm mpi_comm)
     comm->Gatherv = MPIGatherv;
     comm->Allgather = MPIAllgather;
     comm->Alltoall = MPIAlltoall;
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+    comm->ReduceScatterBlock = MPIReduceScatterBlock;
+#else
+    comm->ReduceScatterBlock = NULL;
+#endif
     comm->Isend = MPIIsend;
     comm->Irecv = MPIIrecv;
+    comm->PersistentIsend = MPIPersistentIsend;
+    comm->PersistentIrecv = MPIPersistentIrecv;
     comm->Wait = MPIWaitone;
     comm->Waitany = MPIWaitany;
+    comm->Waitsome = MPIWaitsome;
+    comm->Testsome = MPITestsome;
+    comm->Test = MPITest;
     comm->Comm_size = MPIComm_size;
     comm->Comm_rank = MPIComm_rank;
 
-    comm->data = malloc(sizeof(MPI_Comm));
-    if (comm->data == NULL) {
+    data = malloc(sizeof(struct IceTMPICommDataStruct));
+    if (data == NULL) {
         free(comm);
         icetRaiseError("Could not allocate memory for IceTCommunicator.",
                        ICET_OUT_OF_MEMORY);
         return NULL;
     }
-    MPI_Comm_dup(mpi_comm, (MPI_Comm *)comm->data);
+    MPI_Comm_dup(mpi_comm, &data->comm);
+    data->free_requests = NULL;
+    data->request_blocks = NULL;
+    data->wait_requests = NULL;
+    data->wait_size = 0;
+    data->persistent_requests = NULL;
+    data->num_persistent_requests = 0;
+    data->persistent_clock = 0;
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+    data->num_group_comms = 0;
+#endif
+    comm->data = data;
 
 #ifdef BREAK_ON_MPI_ERROR
 #if MPI_VERSION < 2
     MPI_Errhandler_create(ErrorHandler, &eh);
-    MPI_Errhandler_set(*((MPI_Comm *)comm->data), eh);
+    MPI_Errhandler_set(data->comm, eh);
     MPI_Errhandler_free(&eh);
 #else /* MPI_VERSION >= 2 */
     MPI_Comm_create_errhandler(ErrorHandler, &eh);
-    MPI_Comm_set_errhandler(*((MPI_Comm *)comm->data), eh);
+    MPI_Comm_set_errhandler(data->comm, eh);
     MPI_Errhandler_free(&eh);
 #endif /* MPI_VERSION >= 2 */
 #endif
@@ -258,8 +414,6 @@ void icetDestroyMPICommunicator(IceTCommunicator comm)
 }
 
 
-#define MPI_COMM        (*((MPI_Comm *)self->data))
-
 static IceTCommunicator MPIDuplicate(IceTCommunicator self)
 {
     if (self != ICET_COMM_NULL) {
@@ -296,7 +450,30 @@ static IceTCommunicator MPISubset(IceTCommunicator self,
 
 static void MPIDestroy(IceTCommunicator self)
 {
-    MPI_Comm_free((MPI_Comm *)self->data);
+    int i;
+
+    for (i = 0; i < MPI_DATA->num_persistent_requests; i++) {
+        IceTMPIPersistentRequest *entry = &MPI_DATA->persistent_requests[i];
+        if (entry->active) {
+            icetRaiseError("Destroying communicator with active requests.",
+                           ICET_SANITY_CHECK_FAIL);
+        }
+        MPI_Request_free(&entry->slot.internals.request);
+    }
+    free(MPI_DATA->persistent_requests);
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+    for (i = 0; i < MPI_DATA->num_group_comms; i++) {
+        MPI_Comm_free(&MPI_DATA->group_comms[i].comm);
+        free(MPI_DATA->group_comms[i].ranks);
+    }
+#endif
+    while (MPI_DATA->request_blocks != NULL) {
+        IceTMPIRequestBlock *block = MPI_DATA->request_blocks;
+        MPI_DATA->request_blocks = block->next;
+        free(block);
+    }
+    free(MPI_DATA->wait_requests);
+    MPI_Comm_free(&MPI_COMM);
     free(self->data);
     free(self);
 }
@@ -314,6 +491,7 @@ static void MPIBarrier(IceTCommunicator self)
       case ICET_INT:    mpi_type = MPI_INT;     break;                       \
       case ICET_FLOAT:  mpi_type = MPI_FLOAT;   break;                       \
       case ICET_DOUBLE: mpi_type = MPI_DOUBLE;  break;                       \
+      case ICET_INT64:  mpi_type = MPI_LONG_LONG_INT; break;                 \
       default:                                                               \
           icetRaiseError("MPI Communicator received bad data type.",         \
                          ICET_INVALID_ENUM);                                 \
@@ -321,60 +499,147 @@ static void MPIBarrier(IceTCommunicator self)
           break;                                                             \
     }
 
+#ifdef ICET_USE_64BIT_SIZE
+#if MPI_VERSION < 2
+#error "64-bit sizes (ICET_USE_64BIT_SIZE) require MPI 2 or later."
+#endif
+
+/* MPI takes counts as int.  A count of elements that does not fit is sent
+   as one element of a derived type made of chunks of ICET_MPI_COUNT_CHUNK
+   elements followed by the remainder.  The extent of the derived type is
+   that of all count elements, so the same type works for gathers. */
+#define ICET_MPI_COUNT_CHUNK    ((IceTSizeType)1 << 30)
+
+#define ICET_MPI_GATHERV_TAG    32000
+#define ICET_MPI_TEMP_BUFFER_1  (ICET_COMMUNICATION_LAYER_START | (IceTEnum)0x01)
+
+/* Returns the MPI count to use with the type placed in count_type for count
+   elements of base_type.  Release count_type with MPIFreeCountType once the
+   operation has been started.  (MPI keeps a freed type alive until the
+   operations that use it complete.) */
+static int MPICount(IceTSizeType count,
+                    MPI_Datatype base_type,
+                    MPI_Datatype *count_type)
+{
+    MPI_Datatype chunk_type;
+    MPI_Datatype types[2];
+    int block_lengths[2];
+    MPI_Aint displacements[2];
+    MPI_Aint lower_bound;
+    MPI_Aint extent;
+    IceTSizeType num_chunks;
+
+    if (count <= ICET_MPI_COUNT_CHUNK) {
+        *count_type = base_type;
+        return (int)count;
+    }
+
+    num_chunks = count/ICET_MPI_COUNT_CHUNK;
+    MPI_Type_get_extent(base_type, &lower_bound, &extent);
+    MPI_Type_contiguous((int)ICET_MPI_COUNT_CHUNK, base_type, &chunk_type);
+
+    types[0] = chunk_type;
+    block_lengths[0] = (int)num_chunks;
+    displacements[0] = 0;
+    types[1] = base_type;
+    block_lengths[1] = (int)(count%ICET_MPI_COUNT_CHUNK);
+    displacements[1] = (MPI_Aint)(num_chunks*ICET_MPI_COUNT_CHUNK)*extent;
+
+    MPI_Type_create_struct(2, block_lengths, displacements, types, count_type);
+    MPI_Type_commit(count_type);
+    MPI_Type_free(&chunk_type);
+
+    return 1;
+}
+
+static void MPIFreeCountType(MPI_Datatype base_type, MPI_Datatype *count_type)
+{
+    if (*count_type != base_type) {
+        MPI_Type_free(count_type);
+    }
+}
+#else /* ICET_USE_64BIT_SIZE */
+#define MPICount(count, base_type, count_type) \
+    (*(count_type) = (base_type), (int)(count))
+#define MPIFreeCountType(base_type, count_type)
+#endif /* ICET_USE_64BIT_SIZE */
+
 static void MPISend(IceTCommunicator self,
                     const void *buf,
-                    int count,
+                    IceTSizeType count,
                     IceTEnum datatype,
                     int dest,
                     int tag)
 {
     MPI_Datatype mpidatatype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
     CONVERT_DATATYPE(datatype, mpidatatype);
-    MPI_Send((void *)buf, count, mpidatatype, dest, tag, MPI_COMM);
+    mpicount = MPICount(count, mpidatatype, &mpicounttype);
+    MPI_Send((void *)buf, mpicount, mpicounttype, dest, tag, MPI_COMM);
+    MPIFreeCountType(mpidatatype, &mpicounttype);
 }
 
 static void MPIRecv(IceTCommunicator self,
                     void *buf,
-                    int count,
+                    IceTSizeType count,
                     IceTEnum datatype,
                     int src,
                     int tag)
 {
     MPI_Datatype mpidatatype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
     CONVERT_DATATYPE(datatype, mpidatatype);
-    MPI_Recv(buf, count, mpidatatype, src, tag, MPI_COMM, MPI_STATUS_IGNORE);
+    mpicount = MPICount(count, mpidatatype, &mpicounttype);
+    MPI_Recv(buf, mpicount, mpicounttype, src, tag, MPI_COMM,
+             MPI_STATUS_IGNORE);
+    MPIFreeCountType(mpidatatype, &mpicounttype);
 }
 
 static void MPISendrecv(IceTCommunicator self,
                         const void *sendbuf,
-                        int sendcount,
+                        IceTSizeType sendcount,
                         IceTEnum sendtype,
                         int dest,
                         int sendtag,
                         void *recvbuf,
-                        int recvcount,
+                        IceTSizeType recvcount,
                         IceTEnum recvtype,
                         int src,
                         int recvtag)
 {
     MPI_Datatype mpisendtype;
     MPI_Datatype mpirecvtype;
+    MPI_Datatype mpisendcounttype;
+    MPI_Datatype mpirecvcounttype;
+    int mpisendcount;
+    int mpirecvcount;
     CONVERT_DATATYPE(sendtype, mpisendtype);
     CONVERT_DATATYPE(recvtype, mpirecvtype);
+    mpisendcount = MPICount(sendcount, mpisendtype, &mpisendcounttype);
+    mpirecvcount = MPICount(recvcount, mpirecvtype, &mpirecvcounttype);
+
+    MPI_Sendrecv((void *)sendbuf, mpisendcount, mpisendcounttype,
+                 dest, sendtag,
+                 recvbuf, mpirecvcount, mpirecvcounttype,
+                 src, recvtag,
+                 MPI_COMM, MPI_STATUS_IGNORE);
 
-    MPI_Sendrecv((void *)sendbuf, sendcount, mpisendtype, dest, sendtag,
-                 recvbuf, recvcount, mpirecvtype, src, recvtag, MPI_COMM,
-                 MPI_STATUS_IGNORE);
+    MPIFreeCountType(mpisendtype, &mpisendcounttype);
+    MPIFreeCountType(mpirecvtype, &mpirecvcounttype);
 }
 
 static void MPIGather(IceTCommunicator self,
                       const void *sendbuf,
-                      int sendcount,
+                      IceTSizeType sendcount,
                       IceTEnum datatype,
                       void *recvbuf,
                       int root)
 {
     MPI_Datatype mpitype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
     CONVERT_DATATYPE(datatype, mpitype);
 
     if (sendbuf == ICET_IN_PLACE_COLLECT) {
@@ -391,18 +656,78 @@ static void MPIGather(IceTCommunicator self,
 #endif
     }
 
-    MPI_Gather((void *)sendbuf, sendcount, mpitype,
-               recvbuf, sendcount, mpitype, root,
+    mpicount = MPICount(sendcount, mpitype, &mpicounttype);
+    MPI_Gather((void *)sendbuf, mpicount, mpicounttype,
+               recvbuf, mpicount, mpicounttype, root,
                MPI_COMM);
+    MPIFreeCountType(mpitype, &mpicounttype);
 }
 
+#ifdef ICET_USE_64BIT_SIZE
+/* MPI_Gatherv takes counts and offsets as int, which may not hold the sizes
+   of the pieces of a large image.  Because the other processes cannot tell
+   whether the root can use MPI_Gatherv, the gather is always done with
+   messages to the root. */
+static void MPIGatherv(IceTCommunicator self,
+                       const void *sendbuf,
+                       IceTSizeType sendcount,
+                       IceTEnum datatype,
+                       void *recvbuf,
+                       const IceTSizeType *recvcounts,
+                       const IceTSizeType *recvoffsets,
+                       int root)
+{
+    MPI_Datatype mpitype;
+    int rank;
+    CONVERT_DATATYPE(datatype, mpitype);
+
+    MPI_Comm_rank(MPI_COMM, &rank);
+
+    if (rank == root) {
+        IceTSizeType type_width = icetTypeWidth(datatype);
+        MPI_Request *requests;
+        int numproc;
+        int proc;
+
+        MPI_Comm_size(MPI_COMM, &numproc);
+        requests = icetGetStateBuffer(ICET_MPI_TEMP_BUFFER_1,
+                                      numproc*sizeof(MPI_Request));
+        for (proc = 0; proc < numproc; proc++) {
+            MPI_Datatype mpicounttype;
+            int mpicount;
+            if ((proc == rank) || (recvcounts[proc] < 1)) {
+                requests[proc] = MPI_REQUEST_NULL;
+                continue;
+            }
+            mpicount = MPICount(recvcounts[proc], mpitype, &mpicounttype);
+            MPI_Irecv((IceTByte *)recvbuf + recvoffsets[proc]*type_width,
+                      mpicount, mpicounttype, proc, ICET_MPI_GATHERV_TAG,
+                      MPI_COMM, requests + proc);
+            MPIFreeCountType(mpitype, &mpicounttype);
+        }
+        if ((sendbuf != ICET_IN_PLACE_COLLECT) && (recvcounts[rank] > 0)) {
+            memcpy((IceTByte *)recvbuf + recvoffsets[rank]*type_width,
+                   sendbuf,
+                   recvcounts[rank]*type_width);
+        }
+        MPI_Waitall(numproc, requests, MPI_STATUSES_IGNORE);
+    } else if (sendcount > 0) {
+        MPI_Datatype mpicounttype;
+        int mpicount;
+        mpicount = MPICount(sendcount, mpitype, &mpicounttype);
+        MPI_Send((void *)sendbuf, mpicount, mpicounttype,
+                 root, ICET_MPI_GATHERV_TAG, MPI_COMM);
+        MPIFreeCountType(mpitype, &mpicounttype);
+    }
+}
+#else /* ICET_USE_64BIT_SIZE */
 static void MPIGatherv(IceTCommunicator self,
                        const void *sendbuf,
-                       int sendcount,
+                       IceTSizeType sendcount,
                        IceTEnum datatype,
                        void *recvbuf,
-                       const int *recvcounts,
-                       const int *recvoffsets,
+                       const IceTSizeType *recvcounts,
+                       const IceTSizeType *recvoffsets,
                        int root)
 {
     MPI_Datatype mpitype;
@@ -427,14 +752,17 @@ static void MPIGatherv(IceTCommunicator self,
                 recvbuf, (int *)recvcounts, (int *)recvoffsets, mpitype,
                 root, MPI_COMM);
 }
+#endif /* ICET_USE_64BIT_SIZE */
 
 static void MPIAllgather(IceTCommunicator self,
                          const void *sendbuf,
-                         int sendcount,
+                         IceTSizeType sendcount,
                          IceTEnum datatype,
                          void *recvbuf)
 {
     MPI_Datatype mpitype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
     CONVERT_DATATYPE(datatype, mpitype);
 
     if (sendbuf == ICET_IN_PLACE_COLLECT) {
@@ -451,28 +779,216 @@ static void MPIAllgather(IceTCommunicator self,
 #endif
     }
 
-    MPI_Allgather((void *)sendbuf, sendcount, mpitype,
-                  recvbuf, sendcount, mpitype,
+    mpicount = MPICount(sendcount, mpitype, &mpicounttype);
+    MPI_Allgather((void *)sendbuf, mpicount, mpicounttype,
+                  recvbuf, mpicount, mpicounttype,
                   MPI_COMM);
+    MPIFreeCountType(mpitype, &mpicounttype);
 }
 
 static void MPIAlltoall(IceTCommunicator self,
                         const void *sendbuf,
-                        int sendcount,
+                        IceTSizeType sendcount,
                         IceTEnum datatype,
                         void *recvbuf)
 {
     MPI_Datatype mpitype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
     CONVERT_DATATYPE(datatype, mpitype);
 
-    MPI_Alltoall((void *)sendbuf, sendcount, mpitype,
-                 recvbuf, sendcount, mpitype,
+    mpicount = MPICount(sendcount, mpitype, &mpicounttype);
+    MPI_Alltoall((void *)sendbuf, mpicount, mpicounttype,
+                 recvbuf, mpicount, mpicounttype,
                  MPI_COMM);
+    MPIFreeCountType(mpitype, &mpicounttype);
 }
 
+#ifdef ICET_USE_MPI_REDUCE_SCATTER
+#define ICET_MPI_REDUCE_SCATTER_TAG     32001
+
+/* The reduce function of the ReduceScatterBlock in progress.  MPI gives
+   the operation no user data, so it is passed here.  Each thread keeps its
+   own so that threads acting as IceT processes do not share it. */
+ICET_THREAD_LOCAL IceTCommReduceFunction g_reduce_function = NULL;
+ICET_THREAD_LOCAL void *g_reduce_data = NULL;
+
+static void MPIReduceOperation(void *invec,
+                               void *inoutvec,
+                               int *len,
+                               MPI_Datatype *datatype)
+{
+    /* To remove warning */
+    (void)datatype;
+
+    g_reduce_function(invec, inoutvec, *len, g_reduce_data);
+}
+
+#ifdef ICET_USE_64BIT_SIZE
+/* Reduce-scatters blocks with too many elements for an int count in rounds.
+   Each round packs the same slice of every block together in a temporary
+   buffer of at most ICET_MPI_COUNT_CHUNK bytes. */
+static void MPIReduceScatterBlockRounds(const void *sendbuf,
+                                        void *recvbuf,
+                                        IceTSizeType recvcount,
+                                        IceTSizeType element_size,
+                                        MPI_Datatype element_type,
+                                        MPI_Op op,
+                                        MPI_Comm group_comm,
+                                        int group_size)
+{
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *send_bytes = (const IceTByte *)sendbuf;
+    IceTByte *recv_bytes = (IceTByte *)recvbuf;
+    IceTByte *round_buffer;
+    IceTSizeType round_count;
+    IceTSizeType start;
+
+    round_count = ICET_MPI_COUNT_CHUNK/(group_size*element_size);
+    if (round_count < 1) round_count = 1;
+    round_buffer = icetGetStateBuffer(ICET_MPI_TEMP_BUFFER_1,
+                                      group_size*round_count*element_size);
+
+    for (start = 0; start < recvcount; start += round_count) {
+        IceTSizeType count = recvcount - start;
+        int block;
+        if (count > round_count) count = round_count;
+        for (block = 0; block < group_size; block++) {
+            memcpy(round_buffer + block*count*element_size,
+                   send_bytes + (block*recvcount + start)*element_size,
+                   count*element_size);
+        }
+        MPI_Reduce_scatter_block(round_buffer,
+                                 recv_bytes + start*element_size,
+                                 (int)count,
+                                 element_type,
+                                 op,
+                                 group_comm);
+    }
+}
+#endif /* ICET_USE_64BIT_SIZE */
+
+/* Returns a communicator for the processes of group in that order.  The
+   communicator itself is used if the group is all of it in order.  Otherwise
+   one is made with MPI_Comm_create_group, which (unlike MPI_Comm_create) only
+   involves the processes in the group, and kept for the next time the group
+   is used.  Every process in the group must agree on whether it is kept
+   (otherwise one would later create it alone), so the group decides that
+   together when it is made, and kept communicators are never dropped before
+   the communicator is destroyed.  If the group is not kept, *free_comm is
+   set to true and the caller frees the result. */
+static MPI_Comm MPIGetGroupComm(IceTCommunicator self,
+                                int group_size,
+                                const IceTInt32 *group,
+                                IceTBoolean *free_comm)
+{
+    IceTMPIGroupComm *entry;
+    MPI_Group original_group;
+    MPI_Group subset_group;
+    MPI_Comm group_comm;
+    IceTInt32 *ranks;
+    int comm_size;
+    int keep;
+    int i;
+
+    *free_comm = ICET_FALSE;
+
+    MPI_Comm_size(MPI_COMM, &comm_size);
+    if (group_size == comm_size) {
+        for (i = 0; i < group_size; i++) {
+            if (group[i] != i) break;
+        }
+        if (i == group_size) return MPI_COMM;
+    }
+
+    for (i = 0; i < MPI_DATA->num_group_comms; i++) {
+        entry = &MPI_DATA->group_comms[i];
+        if (   (entry->size == group_size)
+            && (memcmp(entry->ranks, group, group_size*sizeof(IceTInt32))
+                == 0) ) {
+            return entry->comm;
+        }
+    }
+
+    MPI_Comm_group(MPI_COMM, &original_group);
+    MPI_Group_incl(original_group, group_size, (IceTInt32 *)group,
+                   &subset_group);
+    MPI_Comm_create_group(MPI_COMM, subset_group,
+                          ICET_MPI_REDUCE_SCATTER_TAG, &group_comm);
+    MPI_Group_free(&subset_group);
+    MPI_Group_free(&original_group);
+
+    /* A process votes to keep the communicator only if it has room and
+       memory for it. */
+    ranks = NULL;
+    if (MPI_DATA->num_group_comms < ICET_MPI_GROUP_CACHE_SIZE) {
+        ranks = malloc(group_size*sizeof(IceTInt32));
+    }
+    keep = (ranks != NULL);
+    MPI_Allreduce(MPI_IN_PLACE, &keep, 1, MPI_INT, MPI_MIN, group_comm);
+    if (keep) {
+        entry = &MPI_DATA->group_comms[MPI_DATA->num_group_comms++];
+        memcpy(ranks, group, group_size*sizeof(IceTInt32));
+        entry->size = group_size;
+        entry->ranks = ranks;
+        entry->comm = group_comm;
+        return group_comm;
+    }
+    free(ranks);
+
+    *free_comm = ICET_TRUE;
+    return group_comm;
+}
+
+static void MPIReduceScatterBlock(IceTCommunicator self,
+                                  int group_size,
+                                  const IceTInt32 *group,
+                                  const void *sendbuf,
+                                  void *recvbuf,
+                                  IceTSizeType recvcount,
+                                  IceTSizeType element_size,
+                                  IceTCommReduceFunction reduce,
+                                  void *reduce_data)
+{
+    MPI_Comm group_comm;
+    IceTBoolean free_group_comm;
+    MPI_Datatype element_type;
+    MPI_Op op;
+
+    group_comm = MPIGetGroupComm(self, group_size, group, &free_group_comm);
+
+    /* Elements are never split, so the reduce function always gets whole
+       ones. */
+    MPI_Type_contiguous((int)element_size, MPI_BYTE, &element_type);
+    MPI_Type_commit(&element_type);
+    MPI_Op_create(MPIReduceOperation, 1, &op);
+    g_reduce_function = reduce;
+    g_reduce_data = reduce_data;
+
+#ifdef ICET_USE_64BIT_SIZE
+    if (recvcount > ICET_MPI_COUNT_CHUNK) {
+        MPIReduceScatterBlockRounds(sendbuf, recvbuf, recvcount, element_size,
+                                    element_type, op, group_comm, group_size);
+    } else
+#endif
+    {
+        MPI_Reduce_scatter_block((void *)sendbuf, recvbuf, (int)recvcount,
+                                 element_type, op, group_comm);
+    }
+
+    g_reduce_function = NULL;
+    g_reduce_data = NULL;
+    MPI_Op_free(&op);
+    MPI_Type_free(&element_type);
+    if (free_group_comm) {
+        MPI_Comm_free(&group_comm);
+    }
+}
+#endif /* ICET_USE_MPI_REDUCE_SCATTER */
+
 static IceTCommRequest MPIIsend(IceTCommunicator self,
                                 const void *buf,
-                                int count,
+                                IceTSizeType count,
                                 IceTEnum datatype,
                                 int dest,
                                 int tag)
@@ -480,12 +996,16 @@ static IceTCommRequest MPIIsend(IceTCommunicator self,
     IceTCommRequest icet_request;
     MPI_Request mpi_request;
     MPI_Datatype mpidatatype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
 
     CONVERT_DATATYPE(datatype, mpidatatype);
-    MPI_Isend((void *)buf, count, mpidatatype, dest, tag, MPI_COMM,
+    mpicount = MPICount(count, mpidatatype, &mpicounttype);
+    MPI_Isend((void *)buf, mpicount, mpicounttype, dest, tag, MPI_COMM,
               &mpi_request);
+    MPIFreeCountType(mpidatatype, &mpicounttype);
 
-    icet_request = create_request();
+    icet_request = create_request(self);
     setMPIRequest(icet_request, mpi_request);
 
     return icet_request;
@@ -493,7 +1013,7 @@ static IceTCommRequest MPIIsend(IceTCommunicator self,
 
 static IceTCommRequest MPIIrecv(IceTCommunicator self,
                                 void *buf,
-                                int count,
+                                IceTSizeType count,
                                 IceTEnum datatype,
                                 int src,
                                 int tag)
@@ -501,23 +1021,157 @@ static IceTCommRequest MPIIrecv(IceTCommunicator self,
     IceTCommRequest icet_request;
     MPI_Request mpi_request;
     MPI_Datatype mpidatatype;
+    MPI_Datatype mpicounttype;
+    int mpicount;
 
     CONVERT_DATATYPE(datatype, mpidatatype);
-    MPI_Irecv(buf, count, mpidatatype, src, tag, MPI_COMM,
+    mpicount = MPICount(count, mpidatatype, &mpicounttype);
+    MPI_Irecv(buf, mpicount, mpicounttype, src, tag, MPI_COMM,
               &mpi_request);
+    MPIFreeCountType(mpidatatype, &mpicounttype);
 
-    icet_request = create_request();
+    icet_request = create_request(self);
     setMPIRequest(icet_request, mpi_request);
 
     return icet_request;
 }
 
-static void MPIWaitone(IceTCommunicator self, IceTCommRequest *icet_request)
+/* Finds the cached persistent request for the given exchange or makes one,
+   replacing the least recently used entry that is not in progress if the
+   cache is full.  Returns NULL if the exchange cannot use a persistent
+   request, which happens when the matching entry is already in progress or
+   every entry is. */
+static IceTMPIPersistentRequest *MPIFindPersistent(IceTCommunicator self,
+                                                   const void *buf,
+                                                   IceTSizeType count,
+                                                   IceTEnum datatype,
+                                                   int rank,
+                                                   int tag,
+                                                   IceTBoolean is_send)
 {
+    IceTMPIPersistentRequest *entries;
+    IceTMPIPersistentRequest *entry;
+    IceTMPIPersistentRequest *oldest;
+    MPI_Datatype mpidatatype;
+    MPI_Datatype mpicounttype;
     MPI_Request mpi_request;
+    int mpicount;
+    int i;
+
+    if (MPI_DATA->persistent_requests == NULL) {
+        entries = malloc(ICET_MPI_PERSISTENT_CACHE_SIZE
+                         * sizeof(IceTMPIPersistentRequest));
+        if (entries == NULL) return NULL;
+        MPI_DATA->persistent_requests = entries;
+    }
+    entries = MPI_DATA->persistent_requests;
+
+    entry = NULL;
+    oldest = NULL;
+    for (i = 0; i < MPI_DATA->num_persistent_requests; i++) {
+        if (   (entries[i].buf == buf)
+            && (entries[i].rank == rank)
+            && (entries[i].tag == tag)
+            && (entries[i].is_send == is_send) ) {
+            entry = &entries[i];
+            break;
+        }
+        if (   !entries[i].active
+            && ((oldest == NULL)
+                || (entries[i].last_used < oldest->last_used)) ) {
+            oldest = &entries[i];
+        }
+    }
 
-    /* To remove warning */
-    (void)self;
+    if (entry != NULL) {
+        if (entry->active) return NULL;
+        if ((entry->count == count) && (entry->datatype == datatype)) {
+            entry->last_used = ++MPI_DATA->persistent_clock;
+            return entry;
+        }
+        /* Same exchange with a different size.  Make the request again. */
+        MPI_Request_free(&entry->slot.internals.request);
+    } else if (MPI_DATA->num_persistent_requests
+               < ICET_MPI_PERSISTENT_CACHE_SIZE) {
+        entry = &entries[MPI_DATA->num_persistent_requests++];
+    } else if (oldest != NULL) {
+        entry = oldest;
+        MPI_Request_free(&entry->slot.internals.request);
+    } else {
+        return NULL;
+    }
+
+    CONVERT_DATATYPE(datatype, mpidatatype);
+    mpicount = MPICount(count, mpidatatype, &mpicounttype);
+    if (is_send) {
+        MPI_Send_init((void *)buf, mpicount, mpicounttype, rank, tag, MPI_COMM,
+                      &mpi_request);
+    } else {
+        MPI_Recv_init((void *)buf, mpicount, mpicounttype, rank, tag, MPI_COMM,
+                      &mpi_request);
+    }
+    MPIFreeCountType(mpidatatype, &mpicounttype);
+
+    entry->slot.request.magic_number = ICET_MPI_REQUEST_MAGIC_NUMBER;
+    entry->slot.request.internals = &entry->slot.internals;
+    entry->slot.internals.request = mpi_request;
+    entry->slot.next_free = NULL;
+    entry->slot.persistent = entry;
+    entry->buf = buf;
+    entry->count = count;
+    entry->datatype = datatype;
+    entry->rank = rank;
+    entry->tag = tag;
+    entry->is_send = is_send;
+    entry->active = ICET_FALSE;
+    entry->last_used = ++MPI_DATA->persistent_clock;
+
+    return entry;
+}
+
+static IceTCommRequest MPIPersistentIsend(IceTCommunicator self,
+                                          const void *buf,
+                                          IceTSizeType count,
+                                          IceTEnum datatype,
+                                          int dest,
+                                          int tag)
+{
+    IceTMPIPersistentRequest *entry;
+
+    entry = MPIFindPersistent(self, buf, count, datatype, dest, tag,
+                              ICET_TRUE);
+    if (entry == NULL) {
+        return MPIIsend(self, buf, count, datatype, dest, tag);
+    }
+
+    MPI_Start(&entry->slot.internals.request);
+    entry->active = ICET_TRUE;
+    return &entry->slot.request;
+}
+
+static IceTCommRequest MPIPersistentIrecv(IceTCommunicator self,
+                                          void *buf,
+                                          IceTSizeType count,
+                                          IceTEnum datatype,
+                                          int src,
+                                          int tag)
+{
+    IceTMPIPersistentRequest *entry;
+
+    entry = MPIFindPersistent(self, buf, count, datatype, src, tag,
+                              ICET_FALSE);
+    if (entry == NULL) {
+        return MPIIrecv(self, buf, count, datatype, src, tag);
+    }
+
+    MPI_Start(&entry->slot.internals.request);
+    entry->active = ICET_TRUE;
+    return &entry->slot.request;
+}
+
+static void MPIWaitone(IceTCommunicator self, IceTCommRequest *icet_request)
+{
+    MPI_Request mpi_request;
 
     if (*icet_request == ICET_COMM_REQUEST_NULL) return;
 
@@ -525,41 +1179,132 @@ static void MPIWaitone(IceTCommunicator self, IceTCommRequest *icet_request)
     MPI_Wait(&mpi_request, MPI_STATUS_IGNORE);
     setMPIRequest(*icet_request, mpi_request);
 
-    destroy_request(*icet_request);
+    destroy_request(self, *icet_request);
     *icet_request = ICET_COMM_REQUEST_NULL;
 }
 
-static int  MPIWaitany(IceTCommunicator self,
-                       int count, IceTCommRequest *array_of_requests)
+/* Copies the MPI requests of array_of_requests into the scratch array of
+   the communicator, which is returned (or NULL if it could not grow). */
+static MPI_Request *MPIGetRequests(IceTCommunicator self,
+                                   int count,
+                                   IceTCommRequest *array_of_requests)
 {
     MPI_Request *mpi_requests;
     int idx;
 
-    /* To remove warning */
-    (void)self;
-
-    mpi_requests = malloc(sizeof(MPI_Request)*count);
-    if (mpi_requests == NULL) {
-        icetRaiseError("Could not allocate array for MPI requests.",
-                       ICET_OUT_OF_MEMORY);
-        return -1;
+    if (MPI_DATA->wait_size < count) {
+        mpi_requests = malloc(sizeof(MPI_Request)*count);
+        if (mpi_requests == NULL) {
+            icetRaiseError("Could not allocate array for MPI requests.",
+                           ICET_OUT_OF_MEMORY);
+            return NULL;
+        }
+        free(MPI_DATA->wait_requests);
+        MPI_DATA->wait_requests = mpi_requests;
+        MPI_DATA->wait_size = count;
     }
+    mpi_requests = MPI_DATA->wait_requests;
 
     for (idx = 0; idx < count; idx++) {
         mpi_requests[idx] = getMPIRequest(array_of_requests[idx]);
     }
 
+    return mpi_requests;
+}
+
+/* Releases the requests that MPI_Waitsome or MPI_Testsome finished. */
+static int MPIFinishSome(IceTCommunicator self,
+                         int outcount,
+                         IceTCommRequest *array_of_requests,
+                         const int *array_of_indices,
+                         const MPI_Request *mpi_requests)
+{
+    int i;
+
+    if (outcount == MPI_UNDEFINED) return 0;
+
+    for (i = 0; i < outcount; i++) {
+        int idx = array_of_indices[i];
+        setMPIRequest(array_of_requests[idx], mpi_requests[idx]);
+        destroy_request(self, array_of_requests[idx]);
+        array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+    }
+
+    return outcount;
+}
+
+static int  MPIWaitany(IceTCommunicator self,
+                       int count, IceTCommRequest *array_of_requests)
+{
+    MPI_Request *mpi_requests;
+    int idx;
+
+    mpi_requests = MPIGetRequests(self, count, array_of_requests);
+    if (mpi_requests == NULL) return -1;
+
     MPI_Waitany(count, mpi_requests, &idx, MPI_STATUS_IGNORE);
 
     setMPIRequest(array_of_requests[idx], mpi_requests[idx]);
-    destroy_request(array_of_requests[idx]);
+    destroy_request(self, array_of_requests[idx]);
     array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
 
-    free(mpi_requests);
-
     return idx;
 }
 
+static int  MPIWaitsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices)
+{
+    MPI_Request *mpi_requests;
+    int outcount;
+
+    mpi_requests = MPIGetRequests(self, count, array_of_requests);
+    if (mpi_requests == NULL) return 0;
+
+    MPI_Waitsome(count, mpi_requests, &outcount, array_of_indices,
+                 MPI_STATUSES_IGNORE);
+
+    return MPIFinishSome(self, outcount, array_of_requests, array_of_indices,
+                         mpi_requests);
+}
+
+static int  MPITestsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices)
+{
+    MPI_Request *mpi_requests;
+    int outcount;
+
+    mpi_requests = MPIGetRequests(self, count, array_of_requests);
+    if (mpi_requests == NULL) return 0;
+
+    MPI_Testsome(count, mpi_requests, &outcount, array_of_indices,
+                 MPI_STATUSES_IGNORE);
+
+    return MPIFinishSome(self, outcount, array_of_requests, array_of_indices,
+                         mpi_requests);
+}
+
+static int  MPITest(IceTCommunicator self, IceTCommRequest *icet_request)
+{
+    MPI_Request mpi_request;
+    int flag;
+
+    if (*icet_request == ICET_COMM_REQUEST_NULL) return 1;
+
+    mpi_request = getMPIRequest(*icet_request);
+    MPI_Test(&mpi_request, &flag, MPI_STATUS_IGNORE);
+    setMPIRequest(*icet_request, mpi_request);
+
+    if (!flag) return 0;
+
+    destroy_request(self, *icet_request);
+    *icet_request = ICET_COMM_REQUEST_NULL;
+    return 1;
+}
+
 static int MPIComm_size(IceTCommunicator self)
 {
     int size;
@@ -0,0 +1,1904 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2010 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* The shared memory communicator passes messages between processes on one
+ * node through a segment made with shm_open and mapped by every process.
+ * The segment holds a header with a process-shared lock, a mailbox for each
+ * process, and a heap of blocks.  A send claims a block, copies its data in
+ * outside of the lock, and then appends the block to the mailbox of the
+ * receiver.  The receiver takes the block out of its mailbox, copies the
+ * data into the receive buffer, and frees the block.  Blocks are referred
+ * to by offset, since each process maps the segment at its own address.
+ *
+ * Only block offsets are handed between processes, but the data itself is
+ * still copied twice, into the segment and out of it again, which is what
+ * MPI does between processes on one node as well.  The buffers belong to
+ * the caller and are not in the segment, so the receiver cannot read them
+ * in place.  What the segment saves is the matching and progress machinery
+ * of MPI, and it works for processes that are not MPI processes at all.
+ *
+ * A message that does not fit in the free space is sent in fragments, so
+ * any message can pass through a segment of any size as long as both
+ * processes keep calling the communicator.  Each process may only hold its
+ * share of the heap, so a process sending a lot cannot keep the others from
+ * sending.  Only the first fragment of a message is sent before the
+ * receiver has posted a matching receive.  The receiver then hands that
+ * block back to the sender, and the rest follows.  Data moves whenever a
+ * process posts a message or waits for one.  A process with nothing to do
+ * sleeps on a process-shared condition variable that is signaled whenever
+ * the segment changes.
+ *
+ * Every process holds a record lock on its own byte of the segment file,
+ * which the system drops when the process exits however it exits.  A
+ * process that has waited a while for a peer checks whether the peer still
+ * holds its lock.  If not, the segment is marked as failed and every
+ * process raises an error and gives up on its messages instead of waiting
+ * forever.  A process that dies while it holds the lock of the segment
+ * header (which is only held to update the lists) still stops the others.
+ *
+ * Messages to processes on other nodes go through a fallback communicator
+ * (typically MPI).  Collective operations are built from point-to-point
+ * messages, so the part of a collective within a node also goes through
+ * the segment. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceTShm.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevPorting.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ICET_SHM_REQUEST_MAGIC_NUMBER   ((IceTEnum)0x5A3EAD00)
+#define ICET_SHM_SEGMENT_MAGIC_NUMBER   0x1CE75E90
+
+/* The heap of a segment has this many bytes for each process on the node,
+   and each process can have at most this many bytes of the heap in blocks
+   it has sent that are not yet received.  Bigger messages are sent in
+   fragments. */
+#define ICET_SHM_BYTES_PER_PROCESS      ((IceTShmOffset)2*1024*1024)
+
+/* At most this many bytes of a message are sent before the receiver has
+   matched it, so that messages nobody receives yet do not take up the
+   share of the sender. */
+#define ICET_SHM_EAGER_BYTES            ((IceTShmOffset)64*1024)
+
+/* When a message does not fit in any free block, a fragment of it is only
+   sent if at least this many bytes fit. */
+#define ICET_SHM_MIN_FRAGMENT           ((IceTShmOffset)4096)
+
+/* Blocks start on cache lines so that processes copying into neighboring
+   blocks do not share lines. */
+#define ICET_SHM_ALIGNMENT              ((IceTShmOffset)64)
+
+/* Processes attaching to a segment check for it every millisecond and give
+   up after a minute.  They wait as long for the others to attach. */
+#define ICET_SHM_ATTACH_TRIES           60000
+
+/* A process that has waited this many milliseconds without the segment
+   changing checks whether the processes it waits for are alive. */
+#define ICET_SHM_CHECK_PEERS_MS         100
+
+/* Tags used by collective operations.  These may go through the fallback
+   communicator, so they have to be valid MPI tags (at most 32767) and not
+   be used by the strategies. */
+#define ICET_SHM_BARRIER_TAG            32100
+#define ICET_SHM_GATHER_TAG             32101
+#define ICET_SHM_ALLGATHER_TAG          32102
+#define ICET_SHM_ALLTOALL_TAG           32103
+#define ICET_SHM_REDUCE_SCATTER_TAG     32104
+#define ICET_SHM_CONTEXT_TAG            32105
+
+typedef IceTPointerArithmetic IceTShmOffset;
+
+/* These structures live in the segment. */
+typedef struct IceTShmHeaderStruct {
+    /* Set last by the process that creates the segment. */
+    int magic_number;
+    int size; /* Number of processes on the node. */
+    int attached; /* Processes that have mapped the segment. */
+    IceTShmOffset heap_start;
+    IceTShmOffset heap_end;
+    /* Counts changes to the segment so that a process can tell whether
+       anything happened since it last looked. */
+    unsigned long changes;
+    /* Set when a process is found dead.  Every process then gives up. */
+    IceTBoolean failed;
+    pthread_mutex_t lock; /* Protects everything in the segment. */
+    pthread_cond_t changed;
+} IceTShmHeader;
+
+/* Fragments waiting for a process to receive them, linked by offset, and
+   what the other processes need to know about the process. */
+typedef struct IceTShmMailboxStruct {
+    IceTShmOffset head;
+    IceTShmOffset tail;
+    /* Bytes of the heap in blocks sent by the process. */
+    IceTShmOffset held;
+    long pid;
+    /* Whether the process holds the record lock on its byte of the file. */
+    IceTBoolean locked;
+} IceTShmMailbox;
+
+typedef struct IceTShmBlockStruct {
+    IceTShmOffset size; /* Bytes in the block, including this header. */
+    IceTBoolean is_free;
+    /* A first fragment that the receiver has matched and handed back to
+       the sender so that it sends the rest. */
+    IceTBoolean is_ack;
+    /* The rest describes the fragment held in a used block. */
+    IceTShmOffset next; /* Next fragment in the mailbox. */
+    int sender; /* Node rank of the sending process. */
+    int message; /* Number of the message among those of the sender. */
+    int context_owner; /* Identifies the communicator. */
+    int context_id;
+    int source; /* Rank of the sender in the communicator. */
+    int tag;
+    IceTShmOffset total_size; /* Bytes in the whole message. */
+    IceTShmOffset position; /* Where the fragment goes in the message. */
+    IceTShmOffset fragment_size;
+} IceTShmBlock;
+
+/* A process attached to a segment.  Shared by all the communicators of the
+   process that use the segment. */
+typedef struct IceTShmNodeStruct {
+    IceTByte *base; /* Where the segment is mapped in this process. */
+    IceTShmOffset bytes;
+    int fd; /* Kept open to hold the record lock. */
+    int rank; /* Rank of this process on the node. */
+    IceTBoolean failed; /* Whether the error for a dead peer was raised. */
+    int references;
+    int next_message;
+    int next_context;
+    /* Messages of this process that are still moving, in posted order. */
+    struct IceTShmMessageStruct *sends;
+    struct IceTShmMessageStruct *receives;
+} *IceTShmNode;
+
+typedef struct IceTShmMessageStruct {
+    /* The request handed out for this message.  Its internals point back
+       to the message. */
+    struct IceTCommRequestStruct request;
+    /* If not ICET_COMM_NULL, the message goes to another node through this
+       communicator and everything below is unused. */
+    IceTCommunicator fallback;
+    IceTCommRequest fallback_request;
+    IceTShmNode node;
+    IceTBoolean is_send;
+    IceTByte *buffer;
+    IceTShmOffset size; /* In bytes. */
+    int peer; /* Node rank of the other process. */
+    int context_owner;
+    int context_id;
+    int source; /* Communicator rank of the sender. */
+    int tag;
+    /* Sender and number of the message.  For a receive, these are -1 until
+       its first fragment is found. */
+    int sender;
+    int number;
+    IceTShmOffset total_size; /* Bytes in the whole message. */
+    IceTShmOffset done; /* Bytes moved so far. */
+    /* For a send, whether the receiver has matched the first fragment. */
+    IceTBoolean matched;
+    /* The fragment being copied in this pass, or 0. */
+    IceTShmOffset fragment;
+    IceTShmOffset fragment_size;
+    IceTBoolean complete;
+    struct IceTShmMessageStruct *next;
+} IceTShmMessage;
+
+typedef struct IceTShmCommDataStruct {
+    IceTShmNode node;
+    IceTCommunicator fallback; /* For other nodes, or ICET_COMM_NULL. */
+    int size;
+    int rank;
+    int world_rank; /* Rank in the communicator that made the first one. */
+    int *node_ranks; /* Node rank of each rank, or -1 if on another node. */
+    int context_owner;
+    int context_id;
+} *IceTShmCommData;
+
+static IceTCommunicator ShmDuplicate(IceTCommunicator self);
+static IceTCommunicator ShmSubset(IceTCommunicator self,
+                                  int count,
+                                  const IceTInt32 *ranks);
+static void ShmDestroy(IceTCommunicator self);
+static void ShmBarrier(IceTCommunicator self);
+static void ShmSend(IceTCommunicator self,
+                    const void *buf,
+                    IceTSizeType count,
+                    IceTEnum datatype,
+                    int dest,
+                    int tag);
+static void ShmRecv(IceTCommunicator self,
+                    void *buf,
+                    IceTSizeType count,
+                    IceTEnum datatype,
+                    int src,
+                    int tag);
+static void ShmSendrecv(IceTCommunicator self,
+                        const void *sendbuf,
+                        IceTSizeType sendcount,
+                        IceTEnum sendtype,
+                        int dest,
+                        int sendtag,
+                        void *recvbuf,
+                        IceTSizeType recvcount,
+                        IceTEnum recvtype,
+                        int src,
+                        int recvtag);
+static void ShmGather(IceTCommunicator self,
+                      const void *sendbuf,
+                      IceTSizeType sendcount,
+                      IceTEnum datatype,
+                      void *recvbuf,
+                      int root);
+static void ShmGatherv(IceTCommunicator self,
+                       const void *sendbuf,
+                       IceTSizeType sendcount,
+                       IceTEnum datatype,
+                       void *recvbuf,
+                       const IceTSizeType *recvcounts,
+                       const IceTSizeType *recvoffsets,
+                       int root);
+static void ShmAllgather(IceTCommunicator self,
+                         const void *sendbuf,
+                         IceTSizeType sendcount,
+                         IceTEnum datatype,
+                         void *recvbuf);
+static void ShmAlltoall(IceTCommunicator self,
+                        const void *sendbuf,
+                        IceTSizeType sendcount,
+                        IceTEnum datatype,
+                        void *recvbuf);
+static void ShmReduceScatterBlock(IceTCommunicator self,
+                                  int group_size,
+                                  const IceTInt32 *group,
+                                  const void *sendbuf,
+                                  void *recvbuf,
+                                  IceTSizeType recvcount,
+                                  IceTSizeType element_size,
+                                  IceTCommReduceFunction reduce,
+                                  void *reduce_data);
+static IceTCommRequest ShmIsend(IceTCommunicator self,
+                                const void *buf,
+                                IceTSizeType count,
+                                IceTEnum datatype,
+                                int dest,
+                                int tag);
+static IceTCommRequest ShmIrecv(IceTCommunicator self,
+                                void *buf,
+                                IceTSizeType count,
+                                IceTEnum datatype,
+                                int src,
+                                int tag);
+static void ShmWaitone(IceTCommunicator self, IceTCommRequest *request);
+static int  ShmWaitany(IceTCommunicator self,
+                       int count, IceTCommRequest *array_of_requests);
+static int  ShmWaitsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices);
+static int  ShmTestsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices);
+static int  ShmTest(IceTCommunicator self, IceTCommRequest *request);
+static int ShmComm_size(IceTCommunicator self);
+static int ShmComm_rank(IceTCommunicator self);
+
+#define SHM_DATA        ((IceTShmCommData)self->data)
+#define SHM_NODE        (SHM_DATA->node)
+#define SHM_SIZE        (SHM_DATA->size)
+#define SHM_RANK        (SHM_DATA->rank)
+
+#define SHM_ALIGN(bytes)                                                \
+    ((((bytes) + ICET_SHM_ALIGNMENT - 1)/ICET_SHM_ALIGNMENT)*ICET_SHM_ALIGNMENT)
+
+#define SHM_HEADER_BYTES        SHM_ALIGN((IceTShmOffset)sizeof(IceTShmHeader))
+#define SHM_BLOCK_HEADER_BYTES  SHM_ALIGN((IceTShmOffset)sizeof(IceTShmBlock))
+
+#define SHM_HEADER(node)        ((IceTShmHeader *)(node)->base)
+#define SHM_MAILBOXES(node)                                             \
+    ((IceTShmMailbox *)((node)->base + SHM_HEADER_BYTES))
+#define SHM_BLOCK(node, offset) ((IceTShmBlock *)((node)->base + (offset)))
+#define SHM_PAYLOAD(node, offset)                                       \
+    ((node)->base + (offset) + SHM_BLOCK_HEADER_BYTES)
+
+static IceTShmOffset shmSegmentBytes(int node_size)
+{
+    return (  SHM_HEADER_BYTES
+            + SHM_ALIGN((IceTShmOffset)(node_size*sizeof(IceTShmMailbox)))
+            + node_size*ICET_SHM_BYTES_PER_PROCESS );
+}
+
+static void shmSleep(void)
+{
+    struct timespec delay;
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000000;
+    nanosleep(&delay, NULL);
+}
+
+/* Sets deadline to the given number of milliseconds from now, in the clock
+   used by pthread_cond_timedwait. */
+static void shmDeadline(struct timespec *deadline, long milliseconds)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += milliseconds/1000;
+    deadline->tv_nsec += (milliseconds%1000)*1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/* Each process takes a write lock on the byte of the segment file at its
+   node rank and keeps it until it detaches. */
+static IceTBoolean shmLockRank(int fd, int node_rank)
+{
+    struct flock lock;
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = (off_t)node_rank;
+    lock.l_len = 1;
+    return (fcntl(fd, F_SETLK, &lock) == 0);
+}
+
+static void shmInitSegment(IceTByte *base, IceTShmOffset bytes, int node_size)
+{
+    IceTShmHeader *header = (IceTShmHeader *)base;
+    IceTShmMailbox *mailboxes = (IceTShmMailbox *)(base + SHM_HEADER_BYTES);
+    IceTShmBlock *first_block;
+    pthread_mutexattr_t mutex_attributes;
+    pthread_condattr_t cond_attributes;
+    int rank;
+
+    pthread_mutexattr_init(&mutex_attributes);
+    pthread_mutexattr_setpshared(&mutex_attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&header->lock, &mutex_attributes);
+    pthread_mutexattr_destroy(&mutex_attributes);
+
+    pthread_condattr_init(&cond_attributes);
+    pthread_condattr_setpshared(&cond_attributes, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->changed, &cond_attributes);
+    pthread_condattr_destroy(&cond_attributes);
+
+    pthread_mutex_lock(&header->lock);
+
+    header->size = node_size;
+    header->attached = 0;
+    header->heap_start
+        = (  SHM_HEADER_BYTES
+           + SHM_ALIGN((IceTShmOffset)(node_size*sizeof(IceTShmMailbox))) );
+    header->heap_end = bytes;
+    header->changes = 0;
+    header->failed = ICET_FALSE;
+
+    for (rank = 0; rank < node_size; rank++) {
+        mailboxes[rank].head = 0;
+        mailboxes[rank].tail = 0;
+        mailboxes[rank].held = 0;
+        mailboxes[rank].pid = 0;
+        mailboxes[rank].locked = ICET_FALSE;
+    }
+
+    first_block = (IceTShmBlock *)(base + header->heap_start);
+    first_block->size = header->heap_end - header->heap_start;
+    first_block->is_free = ICET_TRUE;
+
+    /* The other processes wait for this before they look at anything else.
+       They then take the lock, so they see everything written here. */
+    header->magic_number = ICET_SHM_SEGMENT_MAGIC_NUMBER;
+
+    pthread_mutex_unlock(&header->lock);
+}
+
+/* Maps the segment with the given name, creating it on node rank 0.
+   Returns once all the processes of the node have mapped it, at which point
+   the name is removed. */
+static IceTShmNode shmAttach(const char *name, int node_size, int node_rank)
+{
+    IceTShmOffset bytes = shmSegmentBytes(node_size);
+    IceTShmHeader *header;
+    IceTShmMailbox *mailbox;
+    IceTShmNode node;
+    struct timespec deadline;
+    IceTBoolean locked;
+    void *base;
+    int fd = -1;
+    int tries;
+
+    if (node_rank == 0) {
+        /* Remove any segment left behind by a run that crashed. */
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if ((fd >= 0) && (ftruncate(fd, (off_t)bytes) != 0)) {
+            close(fd);
+            shm_unlink(name);
+            fd = -1;
+        }
+    } else {
+        for (tries = 0; tries < ICET_SHM_ATTACH_TRIES; tries++) {
+            struct stat status;
+            fd = shm_open(name, O_RDWR, 0);
+            if (fd >= 0) {
+                if (   (fstat(fd, &status) == 0)
+                    && (status.st_size >= (off_t)bytes) ) {
+                    break;
+                }
+                close(fd);
+                fd = -1;
+            }
+            shmSleep();
+        }
+    }
+    if (fd < 0) {
+        icetRaiseError("Could not open shared memory segment.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    base = mmap(NULL, (size_t)bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        if (node_rank == 0) shm_unlink(name);
+        icetRaiseError("Could not map shared memory segment.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+    header = (IceTShmHeader *)base;
+
+    if (node_rank == 0) {
+        shmInitSegment((IceTByte *)base, bytes, node_size);
+    } else {
+        for (tries = 0; tries < ICET_SHM_ATTACH_TRIES; tries++) {
+            if (   ((volatile IceTShmHeader *)header)->magic_number
+                == ICET_SHM_SEGMENT_MAGIC_NUMBER ) {
+                break;
+            }
+            shmSleep();
+        }
+        if (tries == ICET_SHM_ATTACH_TRIES) {
+            munmap(base, (size_t)bytes);
+            close(fd);
+            icetRaiseError("Shared memory segment was never set up.",
+                           ICET_INVALID_OPERATION);
+            return NULL;
+        }
+    }
+
+    node = malloc(sizeof(struct IceTShmNodeStruct));
+    if (node == NULL) {
+        munmap(base, (size_t)bytes);
+        close(fd);
+        icetRaiseError("Could not allocate memory for shared memory node.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    node->base = (IceTByte *)base;
+    node->bytes = bytes;
+    node->fd = fd;
+    node->rank = node_rank;
+    node->failed = ICET_FALSE;
+    node->references = 0;
+    node->next_message = 0;
+    node->next_context = 0;
+    node->sends = NULL;
+    node->receives = NULL;
+
+    /* Without the lock (for example, if the file system does not support
+       record locks) the others just cannot tell if this process dies. */
+    locked = shmLockRank(fd, node_rank);
+
+    pthread_mutex_lock(&header->lock);
+    if (header->size != node_size) {
+        pthread_mutex_unlock(&header->lock);
+        munmap(base, (size_t)bytes);
+        close(fd);
+        free(node);
+        icetRaiseError("Processes disagree on the number on the node.",
+                       ICET_INVALID_VALUE);
+        return NULL;
+    }
+    mailbox = SHM_MAILBOXES(node) + node_rank;
+    mailbox->pid = (long)getpid();
+    mailbox->locked = locked;
+    header->attached++;
+    header->changes++;
+    pthread_cond_broadcast(&header->changed);
+    shmDeadline(&deadline, ICET_SHM_ATTACH_TRIES);
+    while (header->attached < header->size) {
+        if (   pthread_cond_timedwait(&header->changed, &header->lock,
+                                      &deadline)
+            == ETIMEDOUT ) {
+            break;
+        }
+    }
+    if (header->attached < header->size) {
+        header->attached--;
+        pthread_mutex_unlock(&header->lock);
+        munmap(base, (size_t)bytes);
+        close(fd);
+        free(node);
+        if (node_rank == 0) shm_unlink(name);
+        icetRaiseError("Not every process attached to the shared memory"
+                       " segment.", ICET_INVALID_OPERATION);
+        return NULL;
+    }
+    pthread_mutex_unlock(&header->lock);
+
+    if (node_rank == 0) {
+        shm_unlink(name);
+    }
+
+    return node;
+}
+
+static void shmReleaseNode(IceTShmNode node)
+{
+    node->references--;
+    if (node->references < 1) {
+        munmap(node->base, (size_t)node->bytes);
+        close(node->fd);
+        free(node);
+    }
+}
+
+/* Finds room for the next fragment of a message with the given number of
+   bytes left.  Free blocks next to each other are merged as they are
+   passed.  Takes the first free block that holds the rest of the message
+   or, if there is none, the largest one if it holds at least
+   ICET_SHM_MIN_FRAGMENT bytes.  Neither may take more than is left of the
+   share of this process.  Returns the offset of the block (with the bytes
+   it holds in payload) or 0 if there is no room.  Must be called with the
+   lock held. */
+static IceTShmOffset shmAllocate(IceTShmNode node,
+                                 IceTShmOffset wanted,
+                                 IceTShmOffset *payload)
+{
+    const IceTShmHeader *header = SHM_HEADER(node);
+    IceTShmMailbox *mailbox = SHM_MAILBOXES(node) + node->rank;
+    IceTShmOffset share_left = ICET_SHM_BYTES_PER_PROCESS - mailbox->held;
+    IceTShmOffset wanted_size = SHM_BLOCK_HEADER_BYTES + SHM_ALIGN(wanted);
+    IceTShmOffset found = 0;
+    IceTShmOffset found_size = 0;
+    IceTBoolean found_all = ICET_FALSE;
+    IceTShmOffset offset;
+    IceTShmBlock *block;
+
+    if (wanted_size > share_left) {
+        if (share_left < SHM_BLOCK_HEADER_BYTES + ICET_SHM_MIN_FRAGMENT) {
+            return 0;
+        }
+        wanted = (  (share_left - SHM_BLOCK_HEADER_BYTES)
+                  / ICET_SHM_ALIGNMENT*ICET_SHM_ALIGNMENT );
+        wanted_size = SHM_BLOCK_HEADER_BYTES + wanted;
+    }
+
+    offset = header->heap_start;
+    while (offset < header->heap_end) {
+        block = SHM_BLOCK(node, offset);
+        if (block->is_free) {
+            while (   (offset + block->size < header->heap_end)
+                   && SHM_BLOCK(node, offset + block->size)->is_free ) {
+                block->size += SHM_BLOCK(node, offset + block->size)->size;
+            }
+            if (block->size >= wanted_size) {
+                found = offset;
+                found_size = wanted_size;
+                found_all = ICET_TRUE;
+                break;
+            }
+            if (block->size > found_size) {
+                found = offset;
+                found_size = block->size;
+            }
+        }
+        offset += block->size;
+    }
+
+    if (found == 0) {
+        return 0;
+    }
+    if (   !found_all
+        && (found_size < SHM_BLOCK_HEADER_BYTES + ICET_SHM_MIN_FRAGMENT) ) {
+        return 0;
+    }
+
+    block = SHM_BLOCK(node, found);
+    if (block->size - found_size >= SHM_BLOCK_HEADER_BYTES+ICET_SHM_ALIGNMENT) {
+        IceTShmBlock *rest = SHM_BLOCK(node, found + found_size);
+        rest->size = block->size - found_size;
+        rest->is_free = ICET_TRUE;
+        block->size = found_size;
+    }
+    block->is_free = ICET_FALSE;
+    block->is_ack = ICET_FALSE;
+    mailbox->held += block->size;
+
+    *payload = block->size - SHM_BLOCK_HEADER_BYTES;
+    if (*payload > wanted) {
+        *payload = wanted;
+    }
+    return found;
+}
+
+/* Frees a block and takes it off the share of the process that sent it.
+   Must be called with the lock held. */
+static void shmFree(IceTShmNode node, IceTShmOffset offset)
+{
+    IceTShmBlock *block = SHM_BLOCK(node, offset);
+    SHM_MAILBOXES(node)[block->sender].held -= block->size;
+    block->is_free = ICET_TRUE;
+}
+
+/* Takes a block out of the mailbox of this process given the block before
+   it (or 0 if it is first).  Must be called with the lock held. */
+static void shmUnlinkFromMailbox(IceTShmNode node,
+                                 IceTShmOffset previous,
+                                 IceTShmOffset offset)
+{
+    IceTShmMailbox *mailbox = SHM_MAILBOXES(node) + node->rank;
+    IceTShmBlock *block = SHM_BLOCK(node, offset);
+
+    if (previous == 0) {
+        mailbox->head = block->next;
+    } else {
+        SHM_BLOCK(node, previous)->next = block->next;
+    }
+    if (mailbox->tail == offset) {
+        mailbox->tail = previous;
+    }
+}
+
+/* Claims a block for the next fragment of a send, of at most limit bytes,
+   and fills in its description.  Must be called with the lock held. */
+static IceTBoolean shmStartSendFragment(IceTShmNode node,
+                                        IceTShmMessage *message,
+                                        IceTShmOffset limit)
+{
+    IceTShmOffset wanted = message->size - message->done;
+    IceTShmOffset payload;
+    IceTShmOffset offset;
+    IceTShmBlock *block;
+
+    if (wanted > limit) {
+        wanted = limit;
+    }
+    offset = shmAllocate(node, wanted, &payload);
+    if (offset == 0) {
+        return ICET_FALSE;
+    }
+
+    block = SHM_BLOCK(node, offset);
+    block->next = 0;
+    block->sender = node->rank;
+    block->message = message->number;
+    block->context_owner = message->context_owner;
+    block->context_id = message->context_id;
+    block->source = message->source;
+    block->tag = message->tag;
+    block->total_size = message->size;
+    block->position = message->done;
+    block->fragment_size = payload;
+
+    message->fragment = offset;
+    message->fragment_size = payload;
+    return ICET_TRUE;
+}
+
+/* Takes the next fragment of a receive out of the mailbox of this process,
+   if it is there.  The first fragment of a message is matched by
+   communicator, source, and tag.  Fragments are appended in order, so the
+   first match in the mailbox is always the right one.  Must be called with
+   the lock held. */
+static void shmStartReceiveFragment(IceTShmNode node, IceTShmMessage *message)
+{
+    IceTShmMailbox *mailbox = SHM_MAILBOXES(node) + node->rank;
+    IceTShmOffset previous = 0;
+    IceTShmOffset offset = mailbox->head;
+
+    while (offset != 0) {
+        IceTShmBlock *block = SHM_BLOCK(node, offset);
+        IceTBoolean match;
+        if (block->is_ack) {
+            match = ICET_FALSE;
+        } else if (message->sender < 0) {
+            match = (   (block->position == 0)
+                     && (block->context_owner == message->context_owner)
+                     && (block->context_id == message->context_id)
+                     && (block->source == message->source)
+                     && (block->tag == message->tag) );
+        } else {
+            match = (   (block->sender == message->sender)
+                     && (block->message == message->number) );
+        }
+        if (match) {
+            shmUnlinkFromMailbox(node, previous, offset);
+            if (message->sender < 0) {
+                message->sender = block->sender;
+                message->number = block->message;
+                message->total_size = block->total_size;
+            }
+            message->fragment = offset;
+            message->fragment_size = block->fragment_size;
+            return;
+        }
+        previous = offset;
+        offset = block->next;
+    }
+}
+
+static void shmAppendToMailbox(IceTShmNode node,
+                               int dest,
+                               IceTShmOffset offset)
+{
+    IceTShmMailbox *mailbox = SHM_MAILBOXES(node) + dest;
+
+    SHM_BLOCK(node, offset)->next = 0;
+    if (mailbox->tail == 0) {
+        mailbox->head = offset;
+    } else {
+        SHM_BLOCK(node, mailbox->tail)->next = offset;
+    }
+    mailbox->tail = offset;
+}
+
+/* Takes the first fragments that receivers have handed back out of the
+   mailbox of this process, marks their messages as matched, and frees
+   them.  Must be called with the lock held. */
+static void shmTakeAcks(IceTShmNode node)
+{
+    IceTShmOffset previous = 0;
+    IceTShmOffset offset = SHM_MAILBOXES(node)[node->rank].head;
+
+    while (offset != 0) {
+        IceTShmBlock *block = SHM_BLOCK(node, offset);
+        IceTShmOffset next = block->next;
+        if (block->is_ack) {
+            IceTShmMessage *message;
+            for (message = node->sends; message != NULL;
+                 message = message->next) {
+                if (message->number == block->message) {
+                    message->matched = ICET_TRUE;
+                    break;
+                }
+            }
+            shmUnlinkFromMailbox(node, previous, offset);
+            shmFree(node, offset);
+        } else {
+            previous = offset;
+        }
+        offset = next;
+    }
+}
+
+/* Whether an earlier send to the same process has not sent its first
+   fragment.  First fragments go in the order the messages were posted,
+   since a receive matches the first fragment in the mailbox. */
+static IceTBoolean shmSendIsBehind(IceTShmNode node, IceTShmMessage *message)
+{
+    IceTShmMessage *earlier;
+    for (earlier = node->sends; earlier != message; earlier = earlier->next) {
+        if (   (earlier->peer == message->peer)
+            && (earlier->done == 0)
+            && (earlier->fragment == 0) ) {
+            return ICET_TRUE;
+        }
+    }
+    return ICET_FALSE;
+}
+
+/* Whether every process that this one has a message with is alive, that
+   is, still holds the record lock on its byte of the segment file.  Must be
+   called with the lock held. */
+static IceTBoolean shmPeersAlive(IceTShmNode node)
+{
+    IceTShmMessage *lists[2];
+    IceTShmMessage *message;
+    int i;
+
+    lists[0] = node->sends;
+    lists[1] = node->receives;
+    for (i = 0; i < 2; i++) {
+        for (message = lists[i]; message != NULL; message = message->next) {
+            const IceTShmMailbox *peer = SHM_MAILBOXES(node) + message->peer;
+            struct flock lock;
+            if (!peer->locked || (peer->pid == (long)getpid())) continue;
+            lock.l_type = F_WRLCK;
+            lock.l_whence = SEEK_SET;
+            lock.l_start = (off_t)message->peer;
+            lock.l_len = 1;
+            if (   (fcntl(node->fd, F_GETLK, &lock) == 0)
+                && (lock.l_type == F_UNLCK) ) {
+                return ICET_FALSE;
+            }
+        }
+    }
+    return ICET_TRUE;
+}
+
+/* Finishes every message of this process once a peer is found dead.  The
+   data is not moved, but nothing waits for it anymore. */
+static void shmAbandon(IceTShmNode node)
+{
+    IceTShmMessage *message;
+
+    if (!node->failed) {
+        node->failed = ICET_TRUE;
+        icetRaiseError("A process sharing the memory segment has died.",
+                       ICET_INVALID_OPERATION);
+    }
+    for (message = node->sends; message != NULL; message = message->next) {
+        message->complete = ICET_TRUE;
+    }
+    for (message = node->receives; message != NULL; message = message->next){
+        message->complete = ICET_TRUE;
+    }
+    node->sends = NULL;
+    node->receives = NULL;
+}
+
+static void shmRemoveComplete(IceTShmMessage **list)
+{
+    while (*list != NULL) {
+        if ((*list)->complete) {
+            *list = (*list)->next;
+        } else {
+            list = &(*list)->next;
+        }
+    }
+}
+
+/* Moves the next fragment of every message of this process that can move.
+   Blocks are claimed and released under the lock, but the data is copied
+   outside of it.  Returns whether any fragment moved.  If changes is not
+   NULL, it is set to the change count of the segment before anything
+   happened. */
+static IceTBoolean shmProgress(IceTShmNode node, unsigned long *changes)
+{
+    IceTShmHeader *header = SHM_HEADER(node);
+    IceTShmMessage *message;
+    IceTBoolean progressed = ICET_FALSE;
+
+    pthread_mutex_lock(&header->lock);
+    if (changes != NULL) {
+        *changes = header->changes;
+    }
+    if (header->failed) {
+        pthread_mutex_unlock(&header->lock);
+        shmAbandon(node);
+        return ICET_TRUE;
+    }
+    shmTakeAcks(node);
+    /* Until the receiver matches a message, only its first fragment (of at
+       most ICET_SHM_EAGER_BYTES) goes. */
+    for (message = node->sends; message != NULL; message = message->next) {
+        if (message->done == 0) {
+            if (!shmSendIsBehind(node, message)) {
+                shmStartSendFragment(node, message, ICET_SHM_EAGER_BYTES);
+            }
+        } else if (message->matched) {
+            shmStartSendFragment(node, message, message->size);
+        }
+    }
+    for (message = node->receives; message != NULL; message = message->next){
+        shmStartReceiveFragment(node, message);
+    }
+    pthread_mutex_unlock(&header->lock);
+
+    for (message = node->sends; message != NULL; message = message->next) {
+        if ((message->fragment != 0) && (message->fragment_size > 0)) {
+            memcpy(SHM_PAYLOAD(node, message->fragment),
+                   message->buffer + message->done,
+                   message->fragment_size);
+        }
+    }
+    for (message = node->receives; message != NULL; message = message->next){
+        IceTShmOffset copy_size;
+        if (message->fragment == 0) continue;
+        if ((message->done == 0) && (message->total_size > message->size)) {
+            icetRaiseError("Message is larger than the receive buffer.",
+                           ICET_INVALID_VALUE);
+        }
+        copy_size = message->fragment_size;
+        if (message->done + copy_size > message->size) {
+            copy_size = message->size - message->done;
+        }
+        if (copy_size > 0) {
+            memcpy(message->buffer + message->done,
+                   SHM_PAYLOAD(node, message->fragment),
+                   copy_size);
+        }
+    }
+
+    pthread_mutex_lock(&header->lock);
+    for (message = node->sends; message != NULL; message = message->next) {
+        if (message->fragment == 0) continue;
+        shmAppendToMailbox(node, message->peer, message->fragment);
+        message->done += message->fragment_size;
+        message->fragment = 0;
+        message->complete = (message->done == message->size);
+        progressed = ICET_TRUE;
+    }
+    for (message = node->receives; message != NULL; message = message->next){
+        IceTShmBlock *block;
+        if (message->fragment == 0) continue;
+        block = SHM_BLOCK(node, message->fragment);
+        if (   (block->position == 0)
+            && (block->fragment_size < block->total_size) ) {
+            /* The sender waits for this to send the rest. */
+            block->is_ack = ICET_TRUE;
+            shmAppendToMailbox(node, block->sender, message->fragment);
+        } else {
+            shmFree(node, message->fragment);
+        }
+        message->done += message->fragment_size;
+        message->fragment = 0;
+        message->complete = (message->done == message->total_size);
+        progressed = ICET_TRUE;
+    }
+    if (progressed) {
+        header->changes++;
+        pthread_cond_broadcast(&header->changed);
+    }
+    pthread_mutex_unlock(&header->lock);
+
+    shmRemoveComplete(&node->sends);
+    shmRemoveComplete(&node->receives);
+
+    return progressed;
+}
+
+/* Moves what it can and, if nothing could move, sleeps until another
+   process changes the segment. */
+static void shmBlock(IceTShmNode node)
+{
+    IceTShmHeader *header = SHM_HEADER(node);
+    unsigned long changes;
+    struct timespec deadline;
+
+    if (shmProgress(node, &changes)) return;
+
+    pthread_mutex_lock(&header->lock);
+    shmDeadline(&deadline, ICET_SHM_CHECK_PEERS_MS);
+    while ((header->changes == changes) && !header->failed) {
+        if (   pthread_cond_timedwait(&header->changed, &header->lock,
+                                      &deadline)
+            != ETIMEDOUT ) {
+            continue;
+        }
+        if (!shmPeersAlive(node)) {
+            header->failed = ICET_TRUE;
+            header->changes++;
+            pthread_cond_broadcast(&header->changed);
+        }
+        shmDeadline(&deadline, ICET_SHM_CHECK_PEERS_MS);
+    }
+    pthread_mutex_unlock(&header->lock);
+}
+
+static void shmAppendMessage(IceTShmMessage **list, IceTShmMessage *message)
+{
+    while (*list != NULL) {
+        list = &(*list)->next;
+    }
+    message->next = NULL;
+    *list = message;
+}
+
+static IceTShmMessage *shmStart(IceTCommunicator self,
+                                IceTBoolean is_send,
+                                const void *buffer,
+                                IceTSizeType size,
+                                int peer,
+                                int tag)
+{
+    IceTShmMessage *message;
+    IceTShmNode node = SHM_NODE;
+
+    if ((peer < 0) || (peer >= SHM_SIZE)) {
+        icetRaiseError("Rank is not in the shared memory communicator.",
+                       ICET_INVALID_VALUE);
+        return NULL;
+    }
+
+    message = malloc(sizeof(IceTShmMessage));
+    if (message == NULL) {
+        icetRaiseError("Could not allocate memory for IceTCommRequest",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    message->request.magic_number = ICET_SHM_REQUEST_MAGIC_NUMBER;
+    message->request.internals = message;
+    message->fallback = ICET_COMM_NULL;
+    message->fallback_request = ICET_COMM_REQUEST_NULL;
+    message->node = node;
+    message->is_send = is_send;
+    message->buffer = (IceTByte *)buffer;
+    message->size = size;
+    message->complete = ICET_FALSE;
+    message->next = NULL;
+
+    if (SHM_DATA->node_ranks[peer] < 0) {
+        IceTCommunicator fallback = SHM_DATA->fallback;
+        message->fallback = fallback;
+        if (is_send) {
+            message->fallback_request = fallback->Isend(fallback,
+                                                        buffer, size,
+                                                        ICET_BYTE,
+                                                        peer, tag);
+        } else {
+            message->fallback_request = fallback->Irecv(fallback,
+                                                        message->buffer,
+                                                        size,
+                                                        ICET_BYTE,
+                                                        peer, tag);
+        }
+        return message;
+    }
+
+    message->peer = SHM_DATA->node_ranks[peer];
+    message->context_owner = SHM_DATA->context_owner;
+    message->context_id = SHM_DATA->context_id;
+    message->source = is_send ? SHM_RANK : peer;
+    message->tag = tag;
+    message->done = 0;
+    message->matched = ICET_FALSE;
+    message->fragment = 0;
+    message->fragment_size = 0;
+    if (is_send) {
+        message->sender = node->rank;
+        message->number = node->next_message++;
+        message->total_size = size;
+        shmAppendMessage(&node->sends, message);
+    } else {
+        message->sender = -1;
+        message->number = -1;
+        message->total_size = -1;
+        shmAppendMessage(&node->receives, message);
+    }
+
+    shmProgress(node, NULL);
+
+    return message;
+}
+
+static void shmWait(IceTShmMessage *message)
+{
+    if (message == NULL) return;
+
+    if (message->fallback != ICET_COMM_NULL) {
+        message->fallback->Wait(message->fallback,
+                                &message->fallback_request);
+    } else {
+        while (!message->complete) {
+            shmBlock(message->node);
+        }
+    }
+
+    free(message);
+}
+
+/* Returns whether the message has finished without moving any data.  A
+   message to another node is checked with the Test method of the fallback
+   communicator, or waited on if it has none. */
+static IceTBoolean shmTest(IceTShmMessage *message)
+{
+    IceTCommunicator fallback = message->fallback;
+
+    if ((fallback != ICET_COMM_NULL) && !message->complete) {
+        if (fallback->Test != NULL) {
+            if (fallback->Test(fallback, &message->fallback_request)) {
+                message->complete = ICET_TRUE;
+            }
+        } else {
+            fallback->Wait(fallback, &message->fallback_request);
+            message->complete = ICET_TRUE;
+        }
+    }
+
+    return message->complete;
+}
+
+static void shmWaitAll(int count, IceTShmMessage **messages)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        shmWait(messages[i]);
+    }
+}
+
+static IceTShmMessage **shmAllocateMessages(int count)
+{
+    IceTShmMessage **messages;
+    int i;
+
+    messages = malloc(count*sizeof(IceTShmMessage *));
+    if (messages == NULL) {
+        icetRaiseError("Could not allocate array for messages.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        messages[i] = NULL;
+    }
+    return messages;
+}
+
+static IceTShmMessage *getShmMessage(IceTCommRequest icet_request)
+{
+    if (icet_request == ICET_COMM_REQUEST_NULL) {
+        return NULL;
+    }
+
+    if (icet_request->magic_number != ICET_SHM_REQUEST_MAGIC_NUMBER) {
+        icetRaiseError("Request object is not from the shared memory"
+                       " communicator.", ICET_INVALID_VALUE);
+        return NULL;
+    }
+
+    return (IceTShmMessage *)icet_request->internals;
+}
+
+/* Makes a communicator on the node.  node_ranks is copied. */
+static IceTCommunicator shmCreateCommunicator(IceTShmNode node,
+                                              IceTCommunicator fallback,
+                                              int size,
+                                              int rank,
+                                              int world_rank,
+                                              const int *node_ranks,
+                                              int context_owner,
+                                              int context_id)
+{
+    IceTCommunicator comm;
+    IceTShmCommData data;
+    int i;
+
+    comm = malloc(sizeof(struct IceTCommunicatorStruct));
+    data = malloc(sizeof(struct IceTShmCommDataStruct));
+    if (data != NULL) {
+        data->node_ranks = malloc(size*sizeof(int));
+    }
+    if ((comm == NULL) || (data == NULL) || (data->node_ranks == NULL)) {
+        if (data != NULL) free(data->node_ranks);
+        free(comm);
+        free(data);
+        if (fallback != ICET_COMM_NULL) fallback->Destroy(fallback);
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+
+    comm->Duplicate = ShmDuplicate;
+    comm->Subset = ShmSubset;
+    comm->Destroy = ShmDestroy;
+    comm->Barrier = ShmBarrier;
+    comm->Send = ShmSend;
+    comm->Recv = ShmRecv;
+    comm->Sendrecv = ShmSendrecv;
+    comm->Gather = ShmGather;
+    comm->Gatherv = ShmGatherv;
+    comm->Allgather = ShmAllgather;
+    comm->Alltoall = ShmAlltoall;
+    comm->ReduceScatterBlock = ShmReduceScatterBlock;
+    comm->Isend = ShmIsend;
+    comm->Irecv = ShmIrecv;
+    comm->PersistentIsend = NULL;
+    comm->PersistentIrecv = NULL;
+    comm->Wait = ShmWaitone;
+    comm->Waitany = ShmWaitany;
+    comm->Waitsome = ShmWaitsome;
+    comm->Testsome = ShmTestsome;
+    comm->Test = ShmTest;
+    comm->Comm_size = ShmComm_size;
+    comm->Comm_rank = ShmComm_rank;
+
+    node->references++;
+    data->node = node;
+    data->fallback = fallback;
+    data->size = size;
+    data->rank = rank;
+    data->world_rank = world_rank;
+    for (i = 0; i < size; i++) {
+        data->node_ranks[i] = node_ranks[i];
+    }
+    data->context_owner = context_owner;
+    data->context_id = context_id;
+    comm->data = data;
+
+    return comm;
+}
+
+IceTCommunicator icetCreateShmCommunicator(const char *name,
+                                           int size,
+                                           int rank)
+{
+    IceTCommunicator comm;
+    IceTShmNode node;
+    int *node_ranks;
+    int i;
+
+    if ((size < 1) || (rank < 0) || (rank >= size)) {
+        icetRaiseError("Bad size or rank for shared memory communicator.",
+                       ICET_INVALID_VALUE);
+        return ICET_COMM_NULL;
+    }
+
+    node_ranks = malloc(size*sizeof(int));
+    if (node_ranks == NULL) {
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+    for (i = 0; i < size; i++) {
+        node_ranks[i] = i;
+    }
+
+    node = shmAttach(name, size, rank);
+    if (node == NULL) {
+        free(node_ranks);
+        return ICET_COMM_NULL;
+    }
+
+    /* Communicators made from this one get contexts numbered from 1. */
+    comm = shmCreateCommunicator(node, ICET_COMM_NULL,
+                                 size, rank, rank, node_ranks, 0, 0);
+    if (comm == ICET_COMM_NULL) {
+        shmReleaseNode(node);
+    }
+
+    free(node_ranks);
+    return comm;
+}
+
+IceTCommunicator icetCreateShmHybridCommunicator(IceTCommunicator world,
+                                                 int node_id,
+                                                 const char *name)
+{
+    IceTCommunicator comm = ICET_COMM_NULL;
+    IceTCommunicator fallback;
+    IceTShmNode node;
+    IceTInt *node_ids;
+    int *node_ranks;
+    char *segment_name;
+    int size;
+    int rank;
+    int node_size;
+    int leader;
+    int i;
+
+    if (world == ICET_COMM_NULL) {
+        return ICET_COMM_NULL;
+    }
+    size = world->Comm_size(world);
+    rank = world->Comm_rank(world);
+
+    node_ids = malloc(size*sizeof(IceTInt));
+    node_ranks = malloc(size*sizeof(int));
+    segment_name = malloc(strlen(name) + 32);
+    if ((node_ids == NULL) || (node_ranks == NULL) || (segment_name == NULL)) {
+        free(node_ids);
+        free(node_ranks);
+        free(segment_name);
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+
+    node_ids[rank] = node_id;
+    world->Allgather(world, ICET_IN_PLACE_COLLECT, 1, ICET_INT, node_ids);
+
+    node_size = 0;
+    leader = -1;
+    for (i = 0; i < size; i++) {
+        if (node_ids[i] == node_id) {
+            if (leader < 0) leader = i;
+            node_ranks[i] = node_size;
+            node_size++;
+        } else {
+            node_ranks[i] = -1;
+        }
+    }
+    sprintf(segment_name, "%s.%d", name, leader);
+
+    fallback = world->Duplicate(world);
+    node = shmAttach(segment_name, node_size, node_ranks[rank]);
+    if (node != NULL) {
+        comm = shmCreateCommunicator(node, fallback,
+                                     size, rank, rank, node_ranks, 0, 0);
+        if (comm == ICET_COMM_NULL) {
+            shmReleaseNode(node);
+        }
+    } else if (fallback != ICET_COMM_NULL) {
+        fallback->Destroy(fallback);
+    }
+
+    free(node_ids);
+    free(node_ranks);
+    free(segment_name);
+    return comm;
+}
+
+void icetDestroyShmCommunicator(IceTCommunicator comm)
+{
+    if (comm != ICET_COMM_NULL) {
+        comm->Destroy(comm);
+    }
+}
+
+static IceTCommunicator ShmDuplicate(IceTCommunicator self)
+{
+    IceTCommunicator result;
+    IceTInt32 *ranks;
+    int i;
+
+    if (self == ICET_COMM_NULL) {
+        return ICET_COMM_NULL;
+    }
+
+    ranks = malloc(SHM_SIZE*sizeof(IceTInt32));
+    if (ranks == NULL) {
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+    for (i = 0; i < SHM_SIZE; i++) {
+        ranks[i] = i;
+    }
+
+    result = ShmSubset(self, SHM_SIZE, ranks);
+
+    free(ranks);
+    return result;
+}
+
+/* The first rank of the subset picks a context for it that no other
+   communicator made from the same first one can have, and sends it to the
+   others. */
+static IceTCommunicator ShmSubset(IceTCommunicator self,
+                                  int count,
+                                  const IceTInt32 *ranks)
+{
+    IceTCommunicator fallback = ICET_COMM_NULL;
+    IceTCommunicator result;
+    IceTInt32 context[2];
+    int *node_ranks;
+    int new_rank;
+    int i;
+
+    if (SHM_DATA->fallback != ICET_COMM_NULL) {
+        fallback = SHM_DATA->fallback->Subset(SHM_DATA->fallback,
+                                              count, ranks);
+    }
+
+    new_rank = icetFindRankInGroup(ranks, count, SHM_RANK);
+    if (new_rank < 0) {
+        if (fallback != ICET_COMM_NULL) fallback->Destroy(fallback);
+        return ICET_COMM_NULL;
+    }
+
+    if (new_rank == 0) {
+        context[0] = SHM_DATA->world_rank;
+        context[1] = ++SHM_NODE->next_context;
+        for (i = 1; i < count; i++) {
+            shmWait(shmStart(self, ICET_TRUE, context, sizeof(context),
+                             ranks[i], ICET_SHM_CONTEXT_TAG));
+        }
+    } else {
+        shmWait(shmStart(self, ICET_FALSE, context, sizeof(context),
+                         ranks[0], ICET_SHM_CONTEXT_TAG));
+    }
+
+    node_ranks = malloc(count*sizeof(int));
+    if (node_ranks == NULL) {
+        if (fallback != ICET_COMM_NULL) fallback->Destroy(fallback);
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+    for (i = 0; i < count; i++) {
+        node_ranks[i] = SHM_DATA->node_ranks[ranks[i]];
+    }
+
+    result = shmCreateCommunicator(SHM_NODE, fallback,
+                                   count, new_rank, SHM_DATA->world_rank,
+                                   node_ranks, context[0], context[1]);
+
+    free(node_ranks);
+    return result;
+}
+
+static void ShmDestroy(IceTCommunicator self)
+{
+    if (SHM_DATA->fallback != ICET_COMM_NULL) {
+        SHM_DATA->fallback->Destroy(SHM_DATA->fallback);
+    }
+    shmReleaseNode(SHM_NODE);
+    free(SHM_DATA->node_ranks);
+    free(self->data);
+    free(self);
+}
+
+/* A dissemination barrier.  In each round every rank signals the rank
+   distance after it and waits for the one distance before it. */
+static void ShmBarrier(IceTCommunicator self)
+{
+    int size = SHM_SIZE;
+    int rank = SHM_RANK;
+    int distance;
+
+    for (distance = 1; distance < size; distance *= 2) {
+        IceTShmMessage *send;
+        IceTShmMessage *receive;
+        send = shmStart(self, ICET_TRUE, NULL, 0,
+                        (rank + distance)%size, ICET_SHM_BARRIER_TAG);
+        receive = shmStart(self, ICET_FALSE, NULL, 0,
+                           (rank - distance + size)%size,
+                           ICET_SHM_BARRIER_TAG);
+        shmWait(receive);
+        shmWait(send);
+    }
+}
+
+static void ShmSend(IceTCommunicator self,
+                    const void *buf,
+                    IceTSizeType count,
+                    IceTEnum datatype,
+                    int dest,
+                    int tag)
+{
+    shmWait(shmStart(self, ICET_TRUE,
+                     buf, count*icetTypeWidth(datatype),
+                     dest, tag));
+}
+
+static void ShmRecv(IceTCommunicator self,
+                    void *buf,
+                    IceTSizeType count,
+                    IceTEnum datatype,
+                    int src,
+                    int tag)
+{
+    shmWait(shmStart(self, ICET_FALSE,
+                     buf, count*icetTypeWidth(datatype),
+                     src, tag));
+}
+
+static void ShmSendrecv(IceTCommunicator self,
+                        const void *sendbuf,
+                        IceTSizeType sendcount,
+                        IceTEnum sendtype,
+                        int dest,
+                        int sendtag,
+                        void *recvbuf,
+                        IceTSizeType recvcount,
+                        IceTEnum recvtype,
+                        int src,
+                        int recvtag)
+{
+    IceTShmMessage *send;
+    IceTShmMessage *receive;
+
+    send = shmStart(self, ICET_TRUE,
+                    sendbuf, sendcount*icetTypeWidth(sendtype),
+                    dest, sendtag);
+    receive = shmStart(self, ICET_FALSE,
+                       recvbuf, recvcount*icetTypeWidth(recvtype),
+                       src, recvtag);
+    shmWait(receive);
+    shmWait(send);
+}
+
+static void ShmGather(IceTCommunicator self,
+                      const void *sendbuf,
+                      IceTSizeType sendcount,
+                      IceTEnum datatype,
+                      void *recvbuf,
+                      int root)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = SHM_SIZE;
+    int rank = SHM_RANK;
+
+    if (rank == root) {
+        IceTShmMessage **messages;
+        int proc;
+
+        messages = shmAllocateMessages(size);
+        if (messages == NULL) return;
+        for (proc = 0; proc < size; proc++) {
+            if (proc == rank) continue;
+            messages[proc] = shmStart(self, ICET_FALSE,
+                                      (IceTByte *)recvbuf + proc*block_size,
+                                      block_size, proc,
+                                      ICET_SHM_GATHER_TAG);
+        }
+        if (sendbuf != ICET_IN_PLACE_COLLECT) {
+            memcpy((IceTByte *)recvbuf + rank*block_size,
+                   sendbuf,
+                   block_size);
+        }
+        shmWaitAll(size, messages);
+        free(messages);
+    } else {
+        shmWait(shmStart(self, ICET_TRUE, sendbuf, block_size, root,
+                         ICET_SHM_GATHER_TAG));
+    }
+}
+
+static void ShmGatherv(IceTCommunicator self,
+                       const void *sendbuf,
+                       IceTSizeType sendcount,
+                       IceTEnum datatype,
+                       void *recvbuf,
+                       const IceTSizeType *recvcounts,
+                       const IceTSizeType *recvoffsets,
+                       int root)
+{
+    IceTSizeType type_width = icetTypeWidth(datatype);
+    int size = SHM_SIZE;
+    int rank = SHM_RANK;
+
+    if (rank == root) {
+        IceTShmMessage **messages;
+        int proc;
+
+        messages = shmAllocateMessages(size);
+        if (messages == NULL) return;
+        for (proc = 0; proc < size; proc++) {
+            if ((proc == rank) || (recvcounts[proc] < 1)) continue;
+            messages[proc] = shmStart(self, ICET_FALSE,
+                                      (IceTByte *)recvbuf
+                                      + recvoffsets[proc]*type_width,
+                                      recvcounts[proc]*type_width,
+                                      proc,
+                                      ICET_SHM_GATHER_TAG);
+        }
+        if ((sendbuf != ICET_IN_PLACE_COLLECT) && (recvcounts[rank] > 0)) {
+            memcpy((IceTByte *)recvbuf + recvoffsets[rank]*type_width,
+                   sendbuf,
+                   recvcounts[rank]*type_width);
+        }
+        shmWaitAll(size, messages);
+        free(messages);
+    } else if (sendcount > 0) {
+        shmWait(shmStart(self, ICET_TRUE, sendbuf, sendcount*type_width,
+                         root, ICET_SHM_GATHER_TAG));
+    }
+}
+
+static void ShmAllgather(IceTCommunicator self,
+                         const void *sendbuf,
+                         IceTSizeType sendcount,
+                         IceTEnum datatype,
+                         void *recvbuf)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = SHM_SIZE;
+    int rank = SHM_RANK;
+    IceTByte *my_block = (IceTByte *)recvbuf + rank*block_size;
+    IceTShmMessage **messages;
+    int proc;
+
+    if (sendbuf != ICET_IN_PLACE_COLLECT) {
+        memcpy(my_block, sendbuf, block_size);
+    }
+
+    messages = shmAllocateMessages(2*size);
+    if (messages == NULL) return;
+    for (proc = 0; proc < size; proc++) {
+        if (proc == rank) continue;
+        messages[2*proc] = shmStart(self, ICET_FALSE,
+                                    (IceTByte *)recvbuf + proc*block_size,
+                                    block_size, proc,
+                                    ICET_SHM_ALLGATHER_TAG);
+        messages[2*proc+1] = shmStart(self, ICET_TRUE,
+                                      my_block, block_size, proc,
+                                      ICET_SHM_ALLGATHER_TAG);
+    }
+    shmWaitAll(2*size, messages);
+    free(messages);
+}
+
+static void ShmAlltoall(IceTCommunicator self,
+                        const void *sendbuf,
+                        IceTSizeType sendcount,
+                        IceTEnum datatype,
+                        void *recvbuf)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = SHM_SIZE;
+    int rank = SHM_RANK;
+    IceTShmMessage **messages;
+    int proc;
+
+    memcpy((IceTByte *)recvbuf + rank*block_size,
+           (const IceTByte *)sendbuf + rank*block_size,
+           block_size);
+
+    messages = shmAllocateMessages(2*size);
+    if (messages == NULL) return;
+    for (proc = 0; proc < size; proc++) {
+        if (proc == rank) continue;
+        messages[2*proc] = shmStart(self, ICET_FALSE,
+                                    (IceTByte *)recvbuf + proc*block_size,
+                                    block_size, proc,
+                                    ICET_SHM_ALLTOALL_TAG);
+        messages[2*proc+1] = shmStart(self, ICET_TRUE,
+                                      (const IceTByte *)sendbuf
+                                      + proc*block_size,
+                                      block_size, proc,
+                                      ICET_SHM_ALLTOALL_TAG);
+    }
+    shmWaitAll(2*size, messages);
+    free(messages);
+}
+
+/* Each process sends block i to group[i] and reduces the blocks it gets in
+   group order, so the result does not depend on arrival order. */
+static void ShmReduceScatterBlock(IceTCommunicator self,
+                                  int group_size,
+                                  const IceTInt32 *group,
+                                  const void *sendbuf,
+                                  void *recvbuf,
+                                  IceTSizeType recvcount,
+                                  IceTSizeType element_size,
+                                  IceTCommReduceFunction reduce,
+                                  void *reduce_data)
+{
+    IceTSizeType block_size = recvcount*element_size;
+    IceTShmMessage **messages;
+    IceTByte *incoming;
+    int group_rank;
+    int i;
+
+    group_rank = icetFindRankInGroup(group, group_size, SHM_RANK);
+    if (group_rank < 0) {
+        icetRaiseError("Local process not in reduce-scatter group.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    messages = shmAllocateMessages(2*group_size);
+    incoming = malloc(group_size*block_size);
+    if ((messages == NULL) || (incoming == NULL)) {
+        free(messages);
+        free(incoming);
+        icetRaiseError("Could not allocate buffer for reduce-scatter.",
+                       ICET_OUT_OF_MEMORY);
+        return;
+    }
+
+    for (i = 0; i < group_size; i++) {
+        if (i == group_rank) continue;
+        messages[2*i] = shmStart(self, ICET_FALSE,
+                                 incoming + i*block_size,
+                                 block_size, group[i],
+                                 ICET_SHM_REDUCE_SCATTER_TAG);
+        messages[2*i+1] = shmStart(self, ICET_TRUE,
+                                   (const IceTByte *)sendbuf + i*block_size,
+                                   block_size, group[i],
+                                   ICET_SHM_REDUCE_SCATTER_TAG);
+    }
+    memcpy(recvbuf,
+           (const IceTByte *)sendbuf + group_rank*block_size,
+           block_size);
+    shmWaitAll(2*group_size, messages);
+
+    for (i = 0; i < group_size; i++) {
+        if (i == group_rank) continue;
+        reduce(incoming + i*block_size, recvbuf, recvcount, reduce_data);
+    }
+
+    free(incoming);
+    free(messages);
+}
+
+static IceTCommRequest ShmIsend(IceTCommunicator self,
+                                const void *buf,
+                                IceTSizeType count,
+                                IceTEnum datatype,
+                                int dest,
+                                int tag)
+{
+    IceTShmMessage *message;
+
+    message = shmStart(self, ICET_TRUE,
+                       buf, count*icetTypeWidth(datatype),
+                       dest, tag);
+    if (message == NULL) {
+        return ICET_COMM_REQUEST_NULL;
+    }
+    return &message->request;
+}
+
+static IceTCommRequest ShmIrecv(IceTCommunicator self,
+                                void *buf,
+                                IceTSizeType count,
+                                IceTEnum datatype,
+                                int src,
+                                int tag)
+{
+    IceTShmMessage *message;
+
+    message = shmStart(self, ICET_FALSE,
+                       buf, count*icetTypeWidth(datatype),
+                       src, tag);
+    if (message == NULL) {
+        return ICET_COMM_REQUEST_NULL;
+    }
+    return &message->request;
+}
+
+static void ShmWaitone(IceTCommunicator self, IceTCommRequest *request)
+{
+    (void)self;
+
+    if (*request == ICET_COMM_REQUEST_NULL) return;
+
+    shmWait(getShmMessage(*request));
+    *request = ICET_COMM_REQUEST_NULL;
+}
+
+/* Requests to other nodes are checked with the Test method of the fallback
+   communicator while data on the node is moved.  Only when every request
+   left goes to another node does this block in the fallback communicator. */
+static int  ShmWaitany(IceTCommunicator self,
+                       int count, IceTCommRequest *array_of_requests)
+{
+    IceTCommRequest *fallback_requests;
+    IceTShmMessage *message;
+    int idx;
+
+    while (ICET_TRUE) {
+        IceTBoolean any_on_node = ICET_FALSE;
+        IceTBoolean any_fallback = ICET_FALSE;
+
+        shmProgress(SHM_NODE, NULL);
+        for (idx = 0; idx < count; idx++) {
+            if (array_of_requests[idx] == ICET_COMM_REQUEST_NULL) continue;
+            message = getShmMessage(array_of_requests[idx]);
+            if (message == NULL) return -1;
+            if (shmTest(message)) {
+                free(message);
+                array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+                return idx;
+            }
+            if (message->fallback == ICET_COMM_NULL) {
+                any_on_node = ICET_TRUE;
+            } else {
+                any_fallback = ICET_TRUE;
+            }
+        }
+        if (!any_on_node && !any_fallback) {
+            icetRaiseError("No active requests to wait for.",
+                           ICET_INVALID_VALUE);
+            return -1;
+        }
+        if (!any_on_node) break;
+        if (!any_fallback) shmBlock(SHM_NODE);
+    }
+
+    fallback_requests = malloc(count*sizeof(IceTCommRequest));
+    if (fallback_requests == NULL) {
+        icetRaiseError("Could not allocate array for requests.",
+                       ICET_OUT_OF_MEMORY);
+        return -1;
+    }
+    for (idx = 0; idx < count; idx++) {
+        message = getShmMessage(array_of_requests[idx]);
+        fallback_requests[idx]
+            = (message != NULL) ? message->fallback_request
+                                : ICET_COMM_REQUEST_NULL;
+    }
+    idx = SHM_DATA->fallback->Waitany(SHM_DATA->fallback,
+                                      count, fallback_requests);
+    free(fallback_requests);
+
+    if ((idx >= 0) && (idx < count)) {
+        free(getShmMessage(array_of_requests[idx]));
+        array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+    }
+    return idx;
+}
+
+/* Finds the finished requests, waiting for at least one if block is true.
+   Returns how many were found.  While requests to other nodes are left,
+   waiting polls them instead of sleeping. */
+static int shmFinishSome(IceTCommunicator self,
+                         int count,
+                         IceTCommRequest *array_of_requests,
+                         int *array_of_indices,
+                         IceTBoolean block)
+{
+    IceTShmMessage *message;
+    int outcount;
+    int idx;
+    int i;
+
+    while (ICET_TRUE) {
+        IceTBoolean any_on_node = ICET_FALSE;
+        IceTBoolean any_fallback = ICET_FALSE;
+
+        shmProgress(SHM_NODE, NULL);
+        outcount = 0;
+        for (idx = 0; idx < count; idx++) {
+            if (array_of_requests[idx] == ICET_COMM_REQUEST_NULL) continue;
+            message = getShmMessage(array_of_requests[idx]);
+            if (message == NULL) return 0;
+            if (shmTest(message)) {
+                array_of_indices[outcount++] = idx;
+            } else if (message->fallback == ICET_COMM_NULL) {
+                any_on_node = ICET_TRUE;
+            } else {
+                any_fallback = ICET_TRUE;
+            }
+        }
+        if ((outcount > 0) || !block) break;
+        if (!any_on_node && !any_fallback) break;
+        if (!any_fallback) shmBlock(SHM_NODE);
+    }
+
+    for (i = 0; i < outcount; i++) {
+        idx = array_of_indices[i];
+        free(getShmMessage(array_of_requests[idx]));
+        array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+    }
+
+    return outcount;
+}
+
+static int  ShmWaitsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices)
+{
+    return shmFinishSome(self, count, array_of_requests, array_of_indices,
+                         ICET_TRUE);
+}
+
+static int  ShmTestsome(IceTCommunicator self,
+                        int count,
+                        IceTCommRequest *array_of_requests,
+                        int *array_of_indices)
+{
+    return shmFinishSome(self, count, array_of_requests, array_of_indices,
+                         ICET_FALSE);
+}
+
+static int  ShmTest(IceTCommunicator self, IceTCommRequest *request)
+{
+    int index;
+    if (*request == ICET_COMM_REQUEST_NULL) return 1;
+    return shmFinishSome(self, 1, request, &index, ICET_FALSE);
+}
+
+static int ShmComm_size(IceTCommunicator self)
+{
+    return SHM_SIZE;
+}
+
+static int ShmComm_rank(IceTCommunicator self)
+{
+    return SHM_RANK;
+}
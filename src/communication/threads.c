@@ -0,0 +1,1202 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2010 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* The threads communicator passes messages between threads of one process.
+ * Every send and receive is a message record placed in queues shared by all
+ * the threads of a group.  Whichever side is posted second finds the other
+ * in the queue and copies the data straight from the send buffer to the
+ * receive buffer, so there are no intermediate copies.  The copy is made
+ * outside of the lock.  Each thread waits on its own condition variable,
+ * which is signaled when one of its messages completes.
+ *
+ * Collective operations are built from the same messages.  Subset and
+ * Duplicate make a new group by having its first rank allocate the shared
+ * queues and send the pointer to the others. */
+
+#include <IceTThreads.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevPorting.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICET_THREADS_REQUEST_MAGIC_NUMBER ((IceTEnum)0x7D4EAD00)
+
+/* A blocking send of at most this many bytes whose receive has not been
+   posted yet is copied and finishes right away (like the eager protocol of
+   MPI).  Larger ones wait for the receive. */
+#define ICET_THREADS_EAGER_LIMIT        ((IceTSizeType)65536)
+
+/* Tags used by collective operations.  Application tags are not negative,
+   so these never match their messages. */
+#define ICET_THREADS_BARRIER_TAG        (-1)
+#define ICET_THREADS_GATHER_TAG         (-2)
+#define ICET_THREADS_ALLGATHER_TAG      (-3)
+#define ICET_THREADS_ALLTOALL_TAG       (-4)
+#define ICET_THREADS_REDUCE_SCATTER_TAG (-5)
+#define ICET_THREADS_GROUP_TAG          (-6)
+
+typedef struct IceTThreadsMessageStruct {
+    /* The request handed out for this message.  Its internals point back
+       to the message. */
+    struct IceTCommRequestStruct request;
+    IceTBoolean is_send;
+    IceTVoid *buffer;
+    IceTSizeType size; /* In bytes. */
+    int source; /* Group ranks of the sender and the receiver. */
+    int dest;
+    int tag;
+    /* World rank of the thread waiting for the message, or -1 for the
+       copy left by an eager send, which the receiver frees. */
+    int waiter;
+    IceTBoolean complete;
+    struct IceTThreadsMessageStruct *next;
+} IceTThreadsMessage;
+
+typedef struct IceTThreadsGroupStruct {
+    IceTThreadsWorld world;
+    int size;
+    int *world_ranks; /* World rank of each rank in the group. */
+    /* Messages that have not been matched, indexed by destination rank. */
+    IceTThreadsMessage **sends;
+    IceTThreadsMessage **receives;
+    int references; /* Communicators using the group. */
+} *IceTThreadsGroup;
+
+struct IceTThreadsWorldStruct {
+    int size;
+    pthread_mutex_t lock; /* Protects all the groups of the world. */
+    pthread_cond_t *wakeup; /* One for each rank. */
+    IceTThreadsGroup group; /* Group of all the ranks. */
+};
+
+typedef struct IceTThreadsCommDataStruct {
+    IceTThreadsGroup group;
+    int rank;
+} *IceTThreadsCommData;
+
+static IceTCommunicator ThreadsDuplicate(IceTCommunicator self);
+static IceTCommunicator ThreadsSubset(IceTCommunicator self,
+                                      int count,
+                                      const IceTInt32 *ranks);
+static void ThreadsDestroy(IceTCommunicator self);
+static void ThreadsBarrier(IceTCommunicator self);
+static void ThreadsSend(IceTCommunicator self,
+                        const void *buf,
+                        IceTSizeType count,
+                        IceTEnum datatype,
+                        int dest,
+                        int tag);
+static void ThreadsRecv(IceTCommunicator self,
+                        void *buf,
+                        IceTSizeType count,
+                        IceTEnum datatype,
+                        int src,
+                        int tag);
+static void ThreadsSendrecv(IceTCommunicator self,
+                            const void *sendbuf,
+                            IceTSizeType sendcount,
+                            IceTEnum sendtype,
+                            int dest,
+                            int sendtag,
+                            void *recvbuf,
+                            IceTSizeType recvcount,
+                            IceTEnum recvtype,
+                            int src,
+                            int recvtag);
+static void ThreadsGather(IceTCommunicator self,
+                          const void *sendbuf,
+                          IceTSizeType sendcount,
+                          IceTEnum datatype,
+                          void *recvbuf,
+                          int root);
+static void ThreadsGatherv(IceTCommunicator self,
+                           const void *sendbuf,
+                           IceTSizeType sendcount,
+                           IceTEnum datatype,
+                           void *recvbuf,
+                           const IceTSizeType *recvcounts,
+                           const IceTSizeType *recvoffsets,
+                           int root);
+static void ThreadsAllgather(IceTCommunicator self,
+                             const void *sendbuf,
+                             IceTSizeType sendcount,
+                             IceTEnum datatype,
+                             void *recvbuf);
+static void ThreadsAlltoall(IceTCommunicator self,
+                            const void *sendbuf,
+                            IceTSizeType sendcount,
+                            IceTEnum datatype,
+                            void *recvbuf);
+static void ThreadsReduceScatterBlock(IceTCommunicator self,
+                                      int group_size,
+                                      const IceTInt32 *group,
+                                      const void *sendbuf,
+                                      void *recvbuf,
+                                      IceTSizeType recvcount,
+                                      IceTSizeType element_size,
+                                      IceTCommReduceFunction reduce,
+                                      void *reduce_data);
+static IceTCommRequest ThreadsIsend(IceTCommunicator self,
+                                    const void *buf,
+                                    IceTSizeType count,
+                                    IceTEnum datatype,
+                                    int dest,
+                                    int tag);
+static IceTCommRequest ThreadsIrecv(IceTCommunicator self,
+                                    void *buf,
+                                    IceTSizeType count,
+                                    IceTEnum datatype,
+                                    int src,
+                                    int tag);
+static void ThreadsWaitone(IceTCommunicator self, IceTCommRequest *request);
+static int  ThreadsWaitany(IceTCommunicator self,
+                           int count, IceTCommRequest *array_of_requests);
+static int  ThreadsWaitsome(IceTCommunicator self,
+                            int count,
+                            IceTCommRequest *array_of_requests,
+                            int *array_of_indices);
+static int  ThreadsTestsome(IceTCommunicator self,
+                            int count,
+                            IceTCommRequest *array_of_requests,
+                            int *array_of_indices);
+static int  ThreadsTest(IceTCommunicator self, IceTCommRequest *request);
+static int ThreadsComm_size(IceTCommunicator self);
+static int ThreadsComm_rank(IceTCommunicator self);
+
+#define THREADS_DATA    ((IceTThreadsCommData)self->data)
+#define THREADS_GROUP   (THREADS_DATA->group)
+#define THREADS_RANK    (THREADS_DATA->rank)
+#define THREADS_WORLD   (THREADS_GROUP->world)
+
+static IceTThreadsGroup threadsCreateGroup(IceTThreadsWorld world, int size)
+{
+    IceTThreadsGroup group;
+    int rank;
+
+    group = malloc(sizeof(struct IceTThreadsGroupStruct));
+    if (group == NULL) {
+        icetRaiseError("Could not allocate memory for threads group.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    group->world_ranks = malloc(size*sizeof(int));
+    group->sends = malloc(size*sizeof(IceTThreadsMessage *));
+    group->receives = malloc(size*sizeof(IceTThreadsMessage *));
+    if (   (group->world_ranks == NULL)
+        || (group->sends == NULL)
+        || (group->receives == NULL) ) {
+        free(group->world_ranks);
+        free(group->sends);
+        free(group->receives);
+        free(group);
+        icetRaiseError("Could not allocate memory for threads group.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    group->world = world;
+    group->size = size;
+    for (rank = 0; rank < size; rank++) {
+        group->world_ranks[rank] = rank;
+        group->sends[rank] = NULL;
+        group->receives[rank] = NULL;
+    }
+    group->references = 0;
+
+    return group;
+}
+
+static void threadsReleaseGroup(IceTThreadsGroup group)
+{
+    IceTThreadsWorld world = group->world;
+    IceTBoolean last_reference;
+
+    pthread_mutex_lock(&world->lock);
+    group->references--;
+    last_reference = (group->references < 1);
+    pthread_mutex_unlock(&world->lock);
+
+    if (last_reference) {
+        free(group->world_ranks);
+        free(group->sends);
+        free(group->receives);
+        free(group);
+    }
+}
+
+/* Makes a communicator for one rank of the group.  The caller has already
+   added the reference to the group for it. */
+static IceTCommunicator threadsCreateCommunicator(IceTThreadsGroup group,
+                                                  int rank)
+{
+    IceTCommunicator comm;
+    IceTThreadsCommData data;
+
+    comm = malloc(sizeof(struct IceTCommunicatorStruct));
+    data = malloc(sizeof(struct IceTThreadsCommDataStruct));
+    if ((comm == NULL) || (data == NULL)) {
+        free(comm);
+        free(data);
+        threadsReleaseGroup(group);
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+
+    comm->Duplicate = ThreadsDuplicate;
+    comm->Subset = ThreadsSubset;
+    comm->Destroy = ThreadsDestroy;
+    comm->Barrier = ThreadsBarrier;
+    comm->Send = ThreadsSend;
+    comm->Recv = ThreadsRecv;
+    comm->Sendrecv = ThreadsSendrecv;
+    comm->Gather = ThreadsGather;
+    comm->Gatherv = ThreadsGatherv;
+    comm->Allgather = ThreadsAllgather;
+    comm->Alltoall = ThreadsAlltoall;
+    comm->ReduceScatterBlock = ThreadsReduceScatterBlock;
+    comm->Isend = ThreadsIsend;
+    comm->Irecv = ThreadsIrecv;
+    comm->PersistentIsend = NULL;
+    comm->PersistentIrecv = NULL;
+    comm->Wait = ThreadsWaitone;
+    comm->Waitany = ThreadsWaitany;
+    comm->Waitsome = ThreadsWaitsome;
+    comm->Testsome = ThreadsTestsome;
+    comm->Test = ThreadsTest;
+    comm->Comm_size = ThreadsComm_size;
+    comm->Comm_rank = ThreadsComm_rank;
+
+    data->group = group;
+    data->rank = rank;
+    comm->data = data;
+
+    return comm;
+}
+
+IceTThreadsWorld icetCreateThreadsWorld(int size)
+{
+    IceTThreadsWorld world;
+    int rank;
+
+    if (size < 1) {
+        icetRaiseError("A threads world needs at least one rank.",
+                       ICET_INVALID_VALUE);
+        return NULL;
+    }
+
+    world = malloc(sizeof(struct IceTThreadsWorldStruct));
+    if (world == NULL) {
+        icetRaiseError("Could not allocate memory for threads world.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    world->wakeup = malloc(size*sizeof(pthread_cond_t));
+    if (world->wakeup == NULL) {
+        free(world);
+        icetRaiseError("Could not allocate memory for threads world.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    world->group = threadsCreateGroup(world, size);
+    if (world->group == NULL) {
+        free(world->wakeup);
+        free(world);
+        return NULL;
+    }
+
+    /* The world holds a reference to its group until it is destroyed. */
+    world->group->references = 1;
+    world->size = size;
+    pthread_mutex_init(&world->lock, NULL);
+    for (rank = 0; rank < size; rank++) {
+        pthread_cond_init(&world->wakeup[rank], NULL);
+    }
+
+    return world;
+}
+
+void icetDestroyThreadsWorld(IceTThreadsWorld world)
+{
+    int rank;
+
+    if (world == NULL) return;
+
+    threadsReleaseGroup(world->group);
+    for (rank = 0; rank < world->size; rank++) {
+        pthread_cond_destroy(&world->wakeup[rank]);
+    }
+    pthread_mutex_destroy(&world->lock);
+    free(world->wakeup);
+    free(world);
+}
+
+IceTCommunicator icetCreateThreadsCommunicator(IceTThreadsWorld world,
+                                               int rank)
+{
+    if (world == NULL) {
+        return ICET_COMM_NULL;
+    }
+    if ((rank < 0) || (rank >= world->size)) {
+        icetRaiseError("Rank is not in the threads world.",
+                       ICET_INVALID_VALUE);
+        return ICET_COMM_NULL;
+    }
+
+    pthread_mutex_lock(&world->lock);
+    world->group->references++;
+    pthread_mutex_unlock(&world->lock);
+
+    return threadsCreateCommunicator(world->group, rank);
+}
+
+void icetDestroyThreadsCommunicator(IceTCommunicator comm)
+{
+    if (comm != ICET_COMM_NULL) {
+        comm->Destroy(comm);
+    }
+}
+
+/* Puts the message in the queues of the group or, if the other side is
+   already there, takes it out and moves the data. */
+static void threadsPost(IceTThreadsGroup group,
+                        IceTThreadsMessage *message,
+                        IceTBoolean eager)
+{
+    IceTThreadsWorld world = group->world;
+    IceTThreadsMessage **match_queue;
+    IceTThreadsMessage **wait_queue;
+    IceTThreadsMessage *match;
+    const IceTThreadsMessage *send;
+    IceTThreadsMessage *receive;
+    IceTSizeType size;
+    IceTBoolean free_match;
+
+    if (message->is_send) {
+        match_queue = &group->receives[message->dest];
+        wait_queue = &group->sends[message->dest];
+    } else {
+        match_queue = &group->sends[message->dest];
+        wait_queue = &group->receives[message->dest];
+    }
+
+    pthread_mutex_lock(&world->lock);
+
+    /* Messages between two ranks with the same tag match in the order they
+       are posted. */
+    while (   (*match_queue != NULL)
+           && (   ((*match_queue)->source != message->source)
+               || ((*match_queue)->tag != message->tag) ) ) {
+        match_queue = &(*match_queue)->next;
+    }
+    match = *match_queue;
+
+    if (match == NULL) {
+        if (eager && (message->size <= ICET_THREADS_EAGER_LIMIT)) {
+            IceTThreadsMessage *copy
+                = malloc(sizeof(IceTThreadsMessage) + message->size);
+            if (copy != NULL) {
+                *copy = *message;
+                copy->buffer = copy + 1;
+                if (message->size > 0) {
+                    memcpy(copy->buffer, message->buffer, message->size);
+                }
+                copy->waiter = -1;
+                message->complete = ICET_TRUE;
+                message = copy;
+            }
+        }
+        while (*wait_queue != NULL) {
+            wait_queue = &(*wait_queue)->next;
+        }
+        message->next = NULL;
+        *wait_queue = message;
+        pthread_mutex_unlock(&world->lock);
+        return;
+    }
+
+    *match_queue = match->next;
+    pthread_mutex_unlock(&world->lock);
+
+    if (message->is_send) {
+        send = message;
+        receive = match;
+    } else {
+        send = match;
+        receive = message;
+    }
+    size = send->size;
+    if (size > receive->size) {
+        icetRaiseError("Message is larger than the receive buffer.",
+                       ICET_INVALID_VALUE);
+        size = receive->size;
+    }
+    if (size > 0) {
+        memcpy(receive->buffer, send->buffer, size);
+    }
+
+    /* Once complete, the match may be freed by its waiter at any time. */
+    free_match = (match->waiter < 0);
+    pthread_mutex_lock(&world->lock);
+    message->complete = ICET_TRUE;
+    match->complete = ICET_TRUE;
+    if (!free_match) {
+        pthread_cond_signal(&world->wakeup[match->waiter]);
+    }
+    pthread_mutex_unlock(&world->lock);
+
+    if (free_match) {
+        free(match);
+    }
+}
+
+static IceTThreadsMessage *threadsStart(IceTCommunicator self,
+                                        IceTBoolean is_send,
+                                        const void *buffer,
+                                        IceTSizeType size,
+                                        int peer,
+                                        int tag,
+                                        IceTBoolean eager)
+{
+    IceTThreadsMessage *message;
+
+    if ((peer < 0) || (peer >= THREADS_GROUP->size)) {
+        icetRaiseError("Rank is not in the threads communicator.",
+                       ICET_INVALID_VALUE);
+        return NULL;
+    }
+
+    message = malloc(sizeof(IceTThreadsMessage));
+    if (message == NULL) {
+        icetRaiseError("Could not allocate memory for IceTCommRequest",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    message->request.magic_number = ICET_THREADS_REQUEST_MAGIC_NUMBER;
+    message->request.internals = message;
+    message->is_send = is_send;
+    message->buffer = (IceTVoid *)buffer;
+    message->size = size;
+    message->source = is_send ? THREADS_RANK : peer;
+    message->dest = is_send ? peer : THREADS_RANK;
+    message->tag = tag;
+    message->waiter = THREADS_GROUP->world_ranks[THREADS_RANK];
+    message->complete = ICET_FALSE;
+    message->next = NULL;
+
+    threadsPost(THREADS_GROUP, message, eager);
+
+    return message;
+}
+
+static void threadsWait(IceTCommunicator self, IceTThreadsMessage *message)
+{
+    if (message == NULL) return;
+
+    pthread_mutex_lock(&THREADS_WORLD->lock);
+    while (!message->complete) {
+        pthread_cond_wait(&THREADS_WORLD->wakeup[message->waiter],
+                          &THREADS_WORLD->lock);
+    }
+    pthread_mutex_unlock(&THREADS_WORLD->lock);
+
+    free(message);
+}
+
+static void threadsWaitAll(IceTCommunicator self,
+                           int count,
+                           IceTThreadsMessage **messages)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        threadsWait(self, messages[i]);
+    }
+}
+
+static IceTThreadsMessage **threadsAllocateMessages(int count)
+{
+    IceTThreadsMessage **messages;
+    int i;
+
+    messages = malloc(count*sizeof(IceTThreadsMessage *));
+    if (messages == NULL) {
+        icetRaiseError("Could not allocate array for messages.",
+                       ICET_OUT_OF_MEMORY);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        messages[i] = NULL;
+    }
+    return messages;
+}
+
+static IceTThreadsMessage *getThreadsMessage(IceTCommRequest icet_request)
+{
+    if (icet_request == ICET_COMM_REQUEST_NULL) {
+        return NULL;
+    }
+
+    if (icet_request->magic_number != ICET_THREADS_REQUEST_MAGIC_NUMBER) {
+        icetRaiseError("Request object is not from the threads communicator.",
+                       ICET_INVALID_VALUE);
+        return NULL;
+    }
+
+    return (IceTThreadsMessage *)icet_request->internals;
+}
+
+static IceTCommunicator threadsSubsetGroup(IceTCommunicator self,
+                                           int count,
+                                           const IceTInt32 *ranks)
+{
+    IceTThreadsGroup new_group = NULL;
+    int new_rank;
+    int i;
+
+    new_rank = icetFindRankInGroup(ranks, count, THREADS_RANK);
+    if (new_rank < 0) {
+        return ICET_COMM_NULL;
+    }
+
+    if (new_rank == 0) {
+        new_group = threadsCreateGroup(THREADS_WORLD, count);
+        if (new_group != NULL) {
+            for (i = 0; i < count; i++) {
+                new_group->world_ranks[i]
+                    = THREADS_GROUP->world_ranks[ranks[i]];
+            }
+            new_group->references = count;
+        }
+        for (i = 1; i < count; i++) {
+            threadsWait(self, threadsStart(self,
+                                           ICET_TRUE,
+                                           &new_group,
+                                           sizeof(IceTThreadsGroup),
+                                           ranks[i],
+                                           ICET_THREADS_GROUP_TAG,
+                                           ICET_TRUE));
+        }
+    } else {
+        threadsWait(self, threadsStart(self,
+                                       ICET_FALSE,
+                                       &new_group,
+                                       sizeof(IceTThreadsGroup),
+                                       ranks[0],
+                                       ICET_THREADS_GROUP_TAG,
+                                       ICET_FALSE));
+    }
+
+    if (new_group == NULL) {
+        return ICET_COMM_NULL;
+    }
+    return threadsCreateCommunicator(new_group, new_rank);
+}
+
+static IceTCommunicator ThreadsDuplicate(IceTCommunicator self)
+{
+    IceTCommunicator result;
+    IceTInt32 *ranks;
+    int i;
+
+    if (self == ICET_COMM_NULL) {
+        return ICET_COMM_NULL;
+    }
+
+    ranks = malloc(THREADS_GROUP->size*sizeof(IceTInt32));
+    if (ranks == NULL) {
+        icetRaiseError("Could not allocate memory for IceTCommunicator.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_COMM_NULL;
+    }
+    for (i = 0; i < THREADS_GROUP->size; i++) {
+        ranks[i] = i;
+    }
+
+    result = threadsSubsetGroup(self, THREADS_GROUP->size, ranks);
+
+    free(ranks);
+    return result;
+}
+
+static IceTCommunicator ThreadsSubset(IceTCommunicator self,
+                                      int count,
+                                      const IceTInt32 *ranks)
+{
+    return threadsSubsetGroup(self, count, ranks);
+}
+
+static void ThreadsDestroy(IceTCommunicator self)
+{
+    threadsReleaseGroup(THREADS_GROUP);
+    free(self->data);
+    free(self);
+}
+
+/* A dissemination barrier.  In each round every rank signals the rank
+   distance after it and waits for the one distance before it. */
+static void ThreadsBarrier(IceTCommunicator self)
+{
+    int size = THREADS_GROUP->size;
+    int rank = THREADS_RANK;
+    int distance;
+
+    for (distance = 1; distance < size; distance *= 2) {
+        IceTThreadsMessage *send;
+        IceTThreadsMessage *receive;
+        send = threadsStart(self, ICET_TRUE, NULL, 0,
+                            (rank + distance)%size,
+                            ICET_THREADS_BARRIER_TAG, ICET_FALSE);
+        receive = threadsStart(self, ICET_FALSE, NULL, 0,
+                               (rank - distance + size)%size,
+                               ICET_THREADS_BARRIER_TAG, ICET_FALSE);
+        threadsWait(self, receive);
+        threadsWait(self, send);
+    }
+}
+
+static void ThreadsSend(IceTCommunicator self,
+                        const void *buf,
+                        IceTSizeType count,
+                        IceTEnum datatype,
+                        int dest,
+                        int tag)
+{
+    threadsWait(self, threadsStart(self,
+                                   ICET_TRUE,
+                                   buf,
+                                   count*icetTypeWidth(datatype),
+                                   dest,
+                                   tag,
+                                   ICET_TRUE));
+}
+
+static void ThreadsRecv(IceTCommunicator self,
+                        void *buf,
+                        IceTSizeType count,
+                        IceTEnum datatype,
+                        int src,
+                        int tag)
+{
+    threadsWait(self, threadsStart(self,
+                                   ICET_FALSE,
+                                   buf,
+                                   count*icetTypeWidth(datatype),
+                                   src,
+                                   tag,
+                                   ICET_FALSE));
+}
+
+static void ThreadsSendrecv(IceTCommunicator self,
+                            const void *sendbuf,
+                            IceTSizeType sendcount,
+                            IceTEnum sendtype,
+                            int dest,
+                            int sendtag,
+                            void *recvbuf,
+                            IceTSizeType recvcount,
+                            IceTEnum recvtype,
+                            int src,
+                            int recvtag)
+{
+    IceTThreadsMessage *send;
+    IceTThreadsMessage *receive;
+
+    send = threadsStart(self, ICET_TRUE,
+                        sendbuf, sendcount*icetTypeWidth(sendtype),
+                        dest, sendtag, ICET_FALSE);
+    receive = threadsStart(self, ICET_FALSE,
+                           recvbuf, recvcount*icetTypeWidth(recvtype),
+                           src, recvtag, ICET_FALSE);
+    threadsWait(self, receive);
+    threadsWait(self, send);
+}
+
+static void ThreadsGather(IceTCommunicator self,
+                          const void *sendbuf,
+                          IceTSizeType sendcount,
+                          IceTEnum datatype,
+                          void *recvbuf,
+                          int root)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = THREADS_GROUP->size;
+    int rank = THREADS_RANK;
+
+    if (rank == root) {
+        IceTThreadsMessage **messages;
+        int proc;
+
+        messages = threadsAllocateMessages(size);
+        if (messages == NULL) return;
+        for (proc = 0; proc < size; proc++) {
+            if (proc == rank) continue;
+            messages[proc] = threadsStart(self, ICET_FALSE,
+                                          (IceTByte *)recvbuf
+                                          + proc*block_size,
+                                          block_size, proc,
+                                          ICET_THREADS_GATHER_TAG,
+                                          ICET_FALSE);
+        }
+        if (sendbuf != ICET_IN_PLACE_COLLECT) {
+            memcpy((IceTByte *)recvbuf + rank*block_size,
+                   sendbuf,
+                   block_size);
+        }
+        threadsWaitAll(self, size, messages);
+        free(messages);
+    } else {
+        threadsWait(self, threadsStart(self, ICET_TRUE,
+                                       sendbuf, block_size, root,
+                                       ICET_THREADS_GATHER_TAG,
+                                       ICET_TRUE));
+    }
+}
+
+static void ThreadsGatherv(IceTCommunicator self,
+                           const void *sendbuf,
+                           IceTSizeType sendcount,
+                           IceTEnum datatype,
+                           void *recvbuf,
+                           const IceTSizeType *recvcounts,
+                           const IceTSizeType *recvoffsets,
+                           int root)
+{
+    IceTSizeType type_width = icetTypeWidth(datatype);
+    int size = THREADS_GROUP->size;
+    int rank = THREADS_RANK;
+
+    if (rank == root) {
+        IceTThreadsMessage **messages;
+        int proc;
+
+        messages = threadsAllocateMessages(size);
+        if (messages == NULL) return;
+        for (proc = 0; proc < size; proc++) {
+            if ((proc == rank) || (recvcounts[proc] < 1)) continue;
+            messages[proc] = threadsStart(self, ICET_FALSE,
+                                          (IceTByte *)recvbuf
+                                          + recvoffsets[proc]*type_width,
+                                          recvcounts[proc]*type_width,
+                                          proc,
+                                          ICET_THREADS_GATHER_TAG,
+                                          ICET_FALSE);
+        }
+        if ((sendbuf != ICET_IN_PLACE_COLLECT) && (recvcounts[rank] > 0)) {
+            memcpy((IceTByte *)recvbuf + recvoffsets[rank]*type_width,
+                   sendbuf,
+                   recvcounts[rank]*type_width);
+        }
+        threadsWaitAll(self, size, messages);
+        free(messages);
+    } else if (sendcount > 0) {
+        threadsWait(self, threadsStart(self, ICET_TRUE,
+                                       sendbuf, sendcount*type_width, root,
+                                       ICET_THREADS_GATHER_TAG,
+                                       ICET_TRUE));
+    }
+}
+
+static void ThreadsAllgather(IceTCommunicator self,
+                             const void *sendbuf,
+                             IceTSizeType sendcount,
+                             IceTEnum datatype,
+                             void *recvbuf)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = THREADS_GROUP->size;
+    int rank = THREADS_RANK;
+    IceTByte *my_block = (IceTByte *)recvbuf + rank*block_size;
+    IceTThreadsMessage **messages;
+    int proc;
+
+    if (sendbuf != ICET_IN_PLACE_COLLECT) {
+        memcpy(my_block, sendbuf, block_size);
+    }
+
+    messages = threadsAllocateMessages(2*size);
+    if (messages == NULL) return;
+    for (proc = 0; proc < size; proc++) {
+        if (proc == rank) continue;
+        messages[2*proc] = threadsStart(self, ICET_FALSE,
+                                        (IceTByte *)recvbuf + proc*block_size,
+                                        block_size, proc,
+                                        ICET_THREADS_ALLGATHER_TAG,
+                                        ICET_FALSE);
+        messages[2*proc+1] = threadsStart(self, ICET_TRUE,
+                                          my_block, block_size, proc,
+                                          ICET_THREADS_ALLGATHER_TAG,
+                                          ICET_FALSE);
+    }
+    threadsWaitAll(self, 2*size, messages);
+    free(messages);
+}
+
+static void ThreadsAlltoall(IceTCommunicator self,
+                            const void *sendbuf,
+                            IceTSizeType sendcount,
+                            IceTEnum datatype,
+                            void *recvbuf)
+{
+    IceTSizeType block_size = sendcount*icetTypeWidth(datatype);
+    int size = THREADS_GROUP->size;
+    int rank = THREADS_RANK;
+    IceTThreadsMessage **messages;
+    int proc;
+
+    memcpy((IceTByte *)recvbuf + rank*block_size,
+           (const IceTByte *)sendbuf + rank*block_size,
+           block_size);
+
+    messages = threadsAllocateMessages(2*size);
+    if (messages == NULL) return;
+    for (proc = 0; proc < size; proc++) {
+        if (proc == rank) continue;
+        messages[2*proc] = threadsStart(self, ICET_FALSE,
+                                        (IceTByte *)recvbuf + proc*block_size,
+                                        block_size, proc,
+                                        ICET_THREADS_ALLTOALL_TAG,
+                                        ICET_FALSE);
+        messages[2*proc+1] = threadsStart(self, ICET_TRUE,
+                                          (const IceTByte *)sendbuf
+                                          + proc*block_size,
+                                          block_size, proc,
+                                          ICET_THREADS_ALLTOALL_TAG,
+                                          ICET_FALSE);
+    }
+    threadsWaitAll(self, 2*size, messages);
+    free(messages);
+}
+
+/* Each process sends block i to group[i] and reduces the blocks it gets in
+   group order, so the result does not depend on arrival order. */
+static void ThreadsReduceScatterBlock(IceTCommunicator self,
+                                      int group_size,
+                                      const IceTInt32 *group,
+                                      const void *sendbuf,
+                                      void *recvbuf,
+                                      IceTSizeType recvcount,
+                                      IceTSizeType element_size,
+                                      IceTCommReduceFunction reduce,
+                                      void *reduce_data)
+{
+    IceTSizeType block_size = recvcount*element_size;
+    IceTThreadsMessage **messages;
+    IceTByte *incoming;
+    int group_rank;
+    int i;
+
+    group_rank = icetFindRankInGroup(group, group_size, THREADS_RANK);
+    if (group_rank < 0) {
+        icetRaiseError("Local process not in reduce-scatter group.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    messages = threadsAllocateMessages(2*group_size);
+    incoming = malloc(group_size*block_size);
+    if ((messages == NULL) || (incoming == NULL)) {
+        free(messages);
+        free(incoming);
+        icetRaiseError("Could not allocate buffer for reduce-scatter.",
+                       ICET_OUT_OF_MEMORY);
+        return;
+    }
+
+    for (i = 0; i < group_size; i++) {
+        if (i == group_rank) continue;
+        messages[2*i] = threadsStart(self, ICET_FALSE,
+                                     incoming + i*block_size,
+                                     block_size, group[i],
+                                     ICET_THREADS_REDUCE_SCATTER_TAG,
+                                     ICET_FALSE);
+        messages[2*i+1] = threadsStart(self, ICET_TRUE,
+                                       (const IceTByte *)sendbuf
+                                       + i*block_size,
+                                       block_size, group[i],
+                                       ICET_THREADS_REDUCE_SCATTER_TAG,
+                                       ICET_FALSE);
+    }
+    memcpy(recvbuf,
+           (const IceTByte *)sendbuf + group_rank*block_size,
+           block_size);
+    threadsWaitAll(self, 2*group_size, messages);
+
+    for (i = 0; i < group_size; i++) {
+        if (i == group_rank) continue;
+        reduce(incoming + i*block_size, recvbuf, recvcount, reduce_data);
+    }
+
+    free(incoming);
+    free(messages);
+}
+
+static IceTCommRequest ThreadsIsend(IceTCommunicator self,
+                                    const void *buf,
+                                    IceTSizeType count,
+                                    IceTEnum datatype,
+                                    int dest,
+                                    int tag)
+{
+    IceTThreadsMessage *message;
+
+    message = threadsStart(self, ICET_TRUE,
+                           buf, count*icetTypeWidth(datatype),
+                           dest, tag, ICET_FALSE);
+    if (message == NULL) {
+        return ICET_COMM_REQUEST_NULL;
+    }
+    return &message->request;
+}
+
+static IceTCommRequest ThreadsIrecv(IceTCommunicator self,
+                                    void *buf,
+                                    IceTSizeType count,
+                                    IceTEnum datatype,
+                                    int src,
+                                    int tag)
+{
+    IceTThreadsMessage *message;
+
+    message = threadsStart(self, ICET_FALSE,
+                           buf, count*icetTypeWidth(datatype),
+                           src, tag, ICET_FALSE);
+    if (message == NULL) {
+        return ICET_COMM_REQUEST_NULL;
+    }
+    return &message->request;
+}
+
+static void ThreadsWaitone(IceTCommunicator self, IceTCommRequest *request)
+{
+    if (*request == ICET_COMM_REQUEST_NULL) return;
+
+    threadsWait(self, getThreadsMessage(*request));
+    *request = ICET_COMM_REQUEST_NULL;
+}
+
+static int  ThreadsWaitany(IceTCommunicator self,
+                           int count, IceTCommRequest *array_of_requests)
+{
+    int my_world_rank = THREADS_GROUP->world_ranks[THREADS_RANK];
+    IceTBoolean any_active = ICET_FALSE;
+    int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        if (array_of_requests[idx] == ICET_COMM_REQUEST_NULL) continue;
+        if (getThreadsMessage(array_of_requests[idx]) == NULL) return -1;
+        any_active = ICET_TRUE;
+    }
+    if (!any_active) {
+        icetRaiseError("No active requests to wait for.", ICET_INVALID_VALUE);
+        return -1;
+    }
+
+    pthread_mutex_lock(&THREADS_WORLD->lock);
+    while (ICET_TRUE) {
+        for (idx = 0; idx < count; idx++) {
+            IceTThreadsMessage *message
+                = getThreadsMessage(array_of_requests[idx]);
+            if ((message != NULL) && message->complete) break;
+        }
+        if (idx < count) break;
+        pthread_cond_wait(&THREADS_WORLD->wakeup[my_world_rank],
+                          &THREADS_WORLD->lock);
+    }
+    pthread_mutex_unlock(&THREADS_WORLD->lock);
+
+    free(getThreadsMessage(array_of_requests[idx]));
+    array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+
+    return idx;
+}
+
+/* Finds the finished requests, waiting for at least one if block is true.
+   Returns how many were found. */
+static int threadsFinishSome(IceTCommunicator self,
+                             int count,
+                             IceTCommRequest *array_of_requests,
+                             int *array_of_indices,
+                             IceTBoolean block)
+{
+    int my_world_rank = THREADS_GROUP->world_ranks[THREADS_RANK];
+    IceTBoolean any_active = ICET_FALSE;
+    int outcount;
+    int idx;
+    int i;
+
+    for (idx = 0; idx < count; idx++) {
+        if (array_of_requests[idx] == ICET_COMM_REQUEST_NULL) continue;
+        if (getThreadsMessage(array_of_requests[idx]) == NULL) return 0;
+        any_active = ICET_TRUE;
+    }
+    if (!any_active) return 0;
+
+    pthread_mutex_lock(&THREADS_WORLD->lock);
+    while (ICET_TRUE) {
+        outcount = 0;
+        for (idx = 0; idx < count; idx++) {
+            IceTThreadsMessage *message
+                = getThreadsMessage(array_of_requests[idx]);
+            if ((message != NULL) && message->complete) {
+                array_of_indices[outcount++] = idx;
+            }
+        }
+        if ((outcount > 0) || !block) break;
+        pthread_cond_wait(&THREADS_WORLD->wakeup[my_world_rank],
+                          &THREADS_WORLD->lock);
+    }
+    pthread_mutex_unlock(&THREADS_WORLD->lock);
+
+    for (i = 0; i < outcount; i++) {
+        idx = array_of_indices[i];
+        free(getThreadsMessage(array_of_requests[idx]));
+        array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+    }
+
+    return outcount;
+}
+
+static int  ThreadsWaitsome(IceTCommunicator self,
+                            int count,
+                            IceTCommRequest *array_of_requests,
+                            int *array_of_indices)
+{
+    return threadsFinishSome(self, count, array_of_requests,
+                             array_of_indices, ICET_TRUE);
+}
+
+static int  ThreadsTestsome(IceTCommunicator self,
+                            int count,
+                            IceTCommRequest *array_of_requests,
+                            int *array_of_indices)
+{
+    return threadsFinishSome(self, count, array_of_requests,
+                             array_of_indices, ICET_FALSE);
+}
+
+static int  ThreadsTest(IceTCommunicator self, IceTCommRequest *request)
+{
+    int index;
+    if (*request == ICET_COMM_REQUEST_NULL) return 1;
+    return threadsFinishSome(self, 1, request, &index, ICET_FALSE);
+}
+
+static int ThreadsComm_size(IceTCommunicator self)
+{
+    return THREADS_GROUP->size;
+}
+
+static int ThreadsComm_rank(IceTCommunicator self)
+{
+    return THREADS_RANK;
+}
+
+#define ICET_THREADS_RUN_STARTING       0
+#define ICET_THREADS_RUN_GO             1
+#define ICET_THREADS_RUN_ABORT          2
+
+typedef struct IceTThreadsRunStruct {
+    IceTThreadsWorld world;
+    IceTThreadsFunction func;
+    IceTVoid *data;
+    int status;
+} IceTThreadsRunInfo;
+
+typedef struct IceTThreadsRunThreadStruct {
+    IceTThreadsRunInfo *info;
+    int rank;
+} IceTThreadsRunThread;
+
+static void *icetThreadsRunMain(void *arg)
+{
+    const IceTThreadsRunThread *thread = (const IceTThreadsRunThread *)arg;
+    IceTThreadsRunInfo *info = thread->info;
+    IceTThreadsWorld world = info->world;
+    IceTCommunicator comm;
+    IceTBoolean go;
+
+    /* No rank may run until they all exist, because they would wait
+       forever on one that could not be started. */
+    pthread_mutex_lock(&world->lock);
+    while (info->status == ICET_THREADS_RUN_STARTING) {
+        pthread_cond_wait(&world->wakeup[thread->rank], &world->lock);
+    }
+    go = (info->status == ICET_THREADS_RUN_GO);
+    pthread_mutex_unlock(&world->lock);
+
+    if (!go) return NULL;
+
+    comm = icetCreateThreadsCommunicator(world, thread->rank);
+    info->func(comm, info->data);
+    icetDestroyThreadsCommunicator(comm);
+
+    return NULL;
+}
+
+IceTBoolean icetThreadsRun(int size, IceTThreadsFunction func, IceTVoid *data)
+{
+    IceTThreadsRunInfo info;
+    IceTThreadsRunThread *threads;
+    pthread_t *thread_ids;
+    int num_started;
+    int rank;
+
+    info.world = icetCreateThreadsWorld(size);
+    if (info.world == NULL) {
+        return ICET_FALSE;
+    }
+    info.func = func;
+    info.data = data;
+    info.status = ICET_THREADS_RUN_STARTING;
+
+    threads = malloc(size*sizeof(IceTThreadsRunThread));
+    thread_ids = malloc(size*sizeof(pthread_t));
+    if ((threads == NULL) || (thread_ids == NULL)) {
+        free(threads);
+        free(thread_ids);
+        icetDestroyThreadsWorld(info.world);
+        icetRaiseError("Could not allocate memory for threads.",
+                       ICET_OUT_OF_MEMORY);
+        return ICET_FALSE;
+    }
+
+    for (num_started = 0; num_started < size; num_started++) {
+        threads[num_started].info = &info;
+        threads[num_started].rank = num_started;
+        if (pthread_create(&thread_ids[num_started],
+                           NULL,
+                           icetThreadsRunMain,
+                           &threads[num_started]) != 0) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&info.world->lock);
+    info.status = ((num_started == size)
+                   ? ICET_THREADS_RUN_GO : ICET_THREADS_RUN_ABORT);
+    for (rank = 0; rank < num_started; rank++) {
+        pthread_cond_signal(&info.world->wakeup[rank]);
+    }
+    pthread_mutex_unlock(&info.world->lock);
+
+    for (rank = 0; rank < num_started; rank++) {
+        pthread_join(thread_ids[rank], NULL);
+    }
+
+    free(threads);
+    free(thread_ids);
+    icetDestroyThreadsWorld(info.world);
+
+    return (num_started == size);
+}
@@ -23,6 +23,16 @@
  *              switched without effect.)
  *      DEST_SPARSE_IMAGE - an IceTSparseImage object to place the result.
  *
+ * The following macros are optional:
+ *      PARTITION - If defined, composite only PARTITION_PIXELS pixels starting
+ *              at a seek point in the inputs given by FRONT_START,
+ *              FRONT_DEPTH_START, FRONT_INACTIVE, FRONT_ACTIVE, BACK_START,
+ *              BACK_DEPTH_START, BACK_INACTIVE, and BACK_ACTIVE.  CORRUPT is
+ *              set to true if the inputs are bad.  The caller is responsible
+ *              for checking that the images agree and for sizing
+ *              DEST_SPARSE_IMAGE.  See CCC_PARTITION in
+ *              cc_composite_template_body.h.
+ *
  * All of the above macros are undefined at the end of this file.
  */
 
@@ -42,6 +52,20 @@
 #error Need ACTIVE_RUN_LENGTH macro.  Is this included in image.c?
 #endif
 
+#ifdef PARTITION
+#define CCC_PARTITION
+#define CCC_PARTITION_PIXELS    PARTITION_PIXELS
+#define CCC_FRONT_START         FRONT_START
+#define CCC_FRONT_DEPTH_START   FRONT_DEPTH_START
+#define CCC_FRONT_INACTIVE      FRONT_INACTIVE
+#define CCC_FRONT_ACTIVE        FRONT_ACTIVE
+#define CCC_BACK_START          BACK_START
+#define CCC_BACK_DEPTH_START    BACK_DEPTH_START
+#define CCC_BACK_INACTIVE       BACK_INACTIVE
+#define CCC_BACK_ACTIVE         BACK_ACTIVE
+#define CCC_CORRUPT             CORRUPT
+#endif
+
 {
     IceTEnum _color_format;
     IceTEnum _depth_format;
@@ -52,6 +76,7 @@
     _color_format = icetSparseImageGetColorFormat(FRONT_SPARSE_IMAGE);
     _depth_format = icetSparseImageGetDepthFormat(FRONT_SPARSE_IMAGE);
 
+#ifndef PARTITION
     if (   (_color_format != icetSparseImageGetColorFormat(BACK_SPARSE_IMAGE))
         || (_color_format != icetSparseImageGetColorFormat(DEST_SPARSE_IMAGE))
         || (_depth_format != icetSparseImageGetDepthFormat(BACK_SPARSE_IMAGE))
@@ -61,138 +86,66 @@
                        " composite.",
                        ICET_SANITY_CHECK_FAIL);
     }
+#endif
 
     if (_composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
-        if (_depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        if (   (_depth_format == ICET_IMAGE_DEPTH_FLOAT)
+            && (   (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                || (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
           /* Use Z buffer for active pixel testing and compositing. */
             if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-#define UNPACK_PIXEL(pointer, color, depth)     \
-    color = (IceTUInt *)pointer;                \
-    pointer += sizeof(IceTUInt);                \
-    depth = (IceTFloat *)pointer;               \
-    pointer += sizeof(IceTFloat);
 #define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
 #define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
 #define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
-#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
-    {                                                                   \
-        const IceTUInt *src1_color;                                     \
-        const IceTFloat *src1_depth;                                    \
-        const IceTUInt *src2_color;                                     \
-        const IceTFloat *src2_depth;                                    \
-        IceTUInt *dest_color;                                           \
-        IceTFloat *dest_depth;                                          \
-        UNPACK_PIXEL(src1_pointer, src1_color, src1_depth);             \
-        UNPACK_PIXEL(src2_pointer, src2_color, src2_depth);             \
-        UNPACK_PIXEL(dest_pointer, dest_color, dest_depth);             \
-        if (src1_depth[0] < src2_depth[0]) {                            \
-            dest_color[0] = src1_color[0];                              \
-            dest_depth[0] = src1_depth[0];                              \
-        } else {                                                        \
-            dest_color[0] = src2_color[0];                              \
-            dest_depth[0] = src2_depth[0];                              \
-        }                                                               \
-    }
-#define CCC_PIXEL_SIZE (sizeof(IceTUInt) + sizeof(IceTFloat))
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    memcpy(dest, back, (count)*sizeof(IceTUInt));                       \
+    memcpy(dest_depth, back_depth, (count)*sizeof(IceTFloat));          \
+    icetSIMDZBufferUByte((const IceTUInt *)(front),                     \
+                         (const IceTFloat *)(front_depth),              \
+                         (IceTUInt *)(dest),                            \
+                         (IceTFloat *)(dest_depth),                     \
+                         count);
+#define CCC_PIXEL_SIZE (sizeof(IceTUInt))
+#define CCC_DEPTH_SIZE (sizeof(IceTFloat))
 #include "cc_composite_template_body.h"
-#undef UNPACK_PIXEL
             } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-#define UNPACK_PIXEL(pointer, color, depth)     \
-    color = (IceTFloat *)pointer;               \
-    pointer += 4*sizeof(IceTUInt);              \
-    depth = (IceTFloat *)pointer;               \
-    pointer += sizeof(IceTFloat);
-#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
-#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
-#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
-
-#if ICET_ADD_FRAMEBUFFERS
-
-#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
-    {                                                                   \
-        const IceTFloat *src1_color;                                    \
-        const IceTFloat *src1_depth;                                    \
-        const IceTFloat *src2_color;                                    \
-        const IceTFloat *src2_depth;                                    \
-        IceTFloat *dest_color;                                          \
-        IceTFloat *dest_depth;                                          \
-        UNPACK_PIXEL(src1_pointer, src1_color, src1_depth);             \
-        UNPACK_PIXEL(src2_pointer, src2_color, src2_depth);             \
-        UNPACK_PIXEL(dest_pointer, dest_color, dest_depth);             \
-				dest_color[0] = src1_color[0] + src2_color[0]; 									\
-				dest_color[1] = src1_color[1] + src2_color[1]; 									\
-				dest_color[2] = src1_color[2] + src2_color[2]; 									\
-				dest_color[3] = src1_color[3] + src2_color[3]; 									\
-				dest_depth[0] = src1_depth[0];                              		\
-    }
-
-#else
-
-#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
-    {                                                                   \
-        const IceTFloat *src1_color;                                    \
-        const IceTFloat *src1_depth;                                    \
-        const IceTFloat *src2_color;                                    \
-        const IceTFloat *src2_depth;                                    \
-        IceTFloat *dest_color;                                          \
-        IceTFloat *dest_depth;                                          \
-        UNPACK_PIXEL(src1_pointer, src1_color, src1_depth);             \
-        UNPACK_PIXEL(src2_pointer, src2_color, src2_depth);             \
-        UNPACK_PIXEL(dest_pointer, dest_color, dest_depth);             \
-        if (src1_depth[0] < src2_depth[0]) {                            \
-            dest_color[0] = src1_color[0];                              \
-            dest_color[1] = src1_color[1];                              \
-            dest_color[2] = src1_color[2];                              \
-            dest_color[3] = src1_color[3];                              \
-            dest_depth[0] = src1_depth[0];                              \
-        } else {                                                        \
-            dest_color[0] = src2_color[0];                              \
-            dest_color[1] = src2_color[1];                              \
-            dest_color[2] = src2_color[2];                              \
-            dest_color[3] = src2_color[3];                              \
-            dest_depth[0] = src2_depth[0];                              \
-        }                                                               \
-    }
-
-#endif
-
-#define CCC_PIXEL_SIZE (5*sizeof(IceTFloat))
-#include "cc_composite_template_body.h"
-#undef UNPACK_PIXEL
-            } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
-#define UNPACK_PIXEL(pointer, depth)            \
-    depth = (IceTFloat *)pointer;               \
-    pointer += sizeof(IceTFloat);
 #define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
 #define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
 #define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
-#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
-    {                                                                   \
-        const IceTFloat *src1_depth;                                    \
-        const IceTFloat *src2_depth;                                    \
-        IceTFloat *dest_depth;                                          \
-        UNPACK_PIXEL(src1_pointer, src1_depth);                         \
-        UNPACK_PIXEL(src2_pointer, src2_depth);                         \
-        UNPACK_PIXEL(dest_pointer, dest_depth);                         \
-        if (src1_depth[0] < src2_depth[0]) {                            \
-            dest_depth[0] = src1_depth[0];                              \
-        } else {                                                        \
-            dest_depth[0] = src2_depth[0];                              \
-        }                                                               \
-    }
-#define CCC_PIXEL_SIZE (sizeof(IceTFloat))
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    memcpy(dest, back, 4*(count)*sizeof(IceTFloat));                    \
+    memcpy(dest_depth, back_depth, (count)*sizeof(IceTFloat));          \
+    icetSIMDZBufferFloat((const IceTFloat *)(front),                    \
+                         (const IceTFloat *)(front_depth),              \
+                         (IceTFloat *)(dest),                           \
+                         (IceTFloat *)(dest_depth),                     \
+                         count);
+#define CCC_PIXEL_SIZE (4*sizeof(IceTFloat))
+#define CCC_DEPTH_SIZE (sizeof(IceTFloat))
 #include "cc_composite_template_body.h"
-#undef UNPACK_PIXEL
-            } else {
-                icetRaiseError("Encountered invalid color format.",
-                               ICET_SANITY_CHECK_FAIL);
             }
         } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
             icetRaiseError("Cannot use Z buffer compositing operation with no"
                            " Z buffer.", ICET_INVALID_OPERATION);
         } else {
-            icetRaiseError("Encountered invalid depth format.",
-                           ICET_SANITY_CHECK_FAIL);
+          /* Any other depth format (or float depth without color).  Pixels are
+             handled as bytes with the helpers in image.c. */
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    memcpy(dest, back, (count)*_color_size);                            \
+    memcpy(dest_depth, back_depth, (count)*_depth_size);                \
+    depthZBufferPixels(_color_format, _depth_format,                    \
+                       front, front_depth, dest, dest_depth, count);
+#define CCC_PIXEL_SIZE _color_size
+#define CCC_DEPTH_SIZE _depth_size
+#include "cc_composite_template_body.h"
         }
     } else if (_composite_mode == ICET_COMPOSITE_MODE_BLEND) {
       /* Use alpha for active pixel and compositing. */
@@ -239,6 +192,29 @@
 #define CCC_PIXEL_SIZE (4*sizeof(IceTFloat))
 #include "cc_composite_template_body.h"
 #undef UNPACK_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+#define UNPACK_PIXEL(pointer, color)            \
+    color = (IceTUShort *)pointer;              \
+    pointer += 4*sizeof(IceTUShort);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(front_pointer, back_pointer, dest_pointer)        \
+    {                                                                   \
+        const IceTUShort *front_color;                                  \
+        const IceTUShort *back_color;                                   \
+        IceTUShort *dest_color;                                         \
+        UNPACK_PIXEL(front_pointer, front_color);                       \
+        UNPACK_PIXEL(back_pointer, back_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        icetSIMDBlendHalf(front_color, back_color, dest_color, 1);  \
+    }
+#define CCC_PIXEL_SIZE (4*sizeof(IceTUShort))
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+            } else if (addOnlyColorFormat(_color_format)) {
+                icetRaiseError("Cannot blend colors without an alpha channel.",
+                               ICET_INVALID_OPERATION);
             } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
                 icetRaiseWarning("Compositing image with no data.",
                                  ICET_INVALID_OPERATION);
@@ -251,6 +227,220 @@
             icetRaiseError("Cannot use blend composite with a depth buffer.",
                            ICET_INVALID_VALUE);
         }
+    } else if (   (_composite_mode == ICET_COMPOSITE_MODE_MAX)
+               || (_composite_mode == ICET_COMPOSITE_MODE_MIN) ) {
+      /* Only pixels active in both images are composited here, so their
+         channels are simply compared.  Pixels are handled as bytes with the
+         helpers in image.c. */
+        IceTSizeType _color_size = colorPixelSize(_color_format);
+        if (_depth_format != ICET_IMAGE_DEPTH_NONE) {
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    memcpy(dest, back, (count)*_color_size);                            \
+    memcpy(dest_depth, back_depth, (count)*_depth_size);                \
+    depthReducePixels(_composite_mode, _color_format, _depth_format,    \
+                      front, front_depth, dest, dest_depth, count);
+#define CCC_PIXEL_SIZE _color_size
+#define CCC_DEPTH_SIZE _depth_size
+#include "cc_composite_template_body.h"
+        } else if (_color_format != ICET_IMAGE_COLOR_NONE) {
+#define UNPACK_PIXEL(pointer, color)            \
+    color = pointer;                            \
+    pointer += _color_size;
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
+    {                                                                   \
+        const IceTVoid *src1_color;                                     \
+        const IceTVoid *src2_color;                                     \
+        IceTVoid *dest_color;                                           \
+        UNPACK_PIXEL(src1_pointer, src1_color);                         \
+        UNPACK_PIXEL(src2_pointer, src2_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        memcpy(dest_color, src2_color, _color_size);                    \
+        colorExtremumValues(_composite_mode, _color_format,             \
+                            src1_color, dest_color, 1);                 \
+    }
+#define CCC_PIXEL_SIZE _color_size
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+        } else {
+            icetRaiseWarning("Compositing image with no data.",
+                             ICET_INVALID_OPERATION);
+            icetClearSparseImage(DEST_SPARSE_IMAGE);
+        }
+    } else if (_composite_mode == ICET_COMPOSITE_MODE_ADD) {
+        if (   (_depth_format == ICET_IMAGE_DEPTH_FLOAT)
+            && (   (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                || (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
+          /* Use Z buffer for active pixel testing.  Sum colors and keep the
+             nearest depth. */
+            if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    {                                                                   \
+        const IceTUByte *src1_color = (const IceTUByte *)(front);       \
+        const IceTFloat *src1_depth = (const IceTFloat *)(front_depth); \
+        const IceTUByte *src2_color = (const IceTUByte *)(back);        \
+        const IceTFloat *src2_depth = (const IceTFloat *)(back_depth);  \
+        IceTUByte *dest_color = (IceTUByte *)(dest);                    \
+        IceTFloat *dest_depth_f = (IceTFloat *)(dest_depth);            \
+        IceTSizeType i;                                                 \
+        for (i = 0; i < (count); i++) {                                 \
+            ICET_ADD_UBYTE(src1_color + 4*i,                            \
+                           src2_color + 4*i,                            \
+                           dest_color + 4*i);                           \
+            dest_depth_f[i] = CCC_MIN(src1_depth[i], src2_depth[i]);    \
+        }                                                               \
+    }
+#define CCC_PIXEL_SIZE (sizeof(IceTUInt))
+#define CCC_DEPTH_SIZE (sizeof(IceTFloat))
+#include "cc_composite_template_body.h"
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    {                                                                   \
+        const IceTFloat *src1_color = (const IceTFloat *)(front);       \
+        const IceTFloat *src1_depth = (const IceTFloat *)(front_depth); \
+        const IceTFloat *src2_color = (const IceTFloat *)(back);        \
+        const IceTFloat *src2_depth = (const IceTFloat *)(back_depth);  \
+        IceTFloat *dest_color = (IceTFloat *)(dest);                    \
+        IceTFloat *dest_depth_f = (IceTFloat *)(dest_depth);            \
+        IceTSizeType i;                                                 \
+        for (i = 0; i < (count); i++) {                                 \
+            ICET_ADD_FLOAT(src1_color + 4*i,                            \
+                           src2_color + 4*i,                            \
+                           dest_color + 4*i);                           \
+            dest_depth_f[i] = CCC_MIN(src1_depth[i], src2_depth[i]);    \
+        }                                                               \
+    }
+#define CCC_PIXEL_SIZE (4*sizeof(IceTFloat))
+#define CCC_DEPTH_SIZE (sizeof(IceTFloat))
+#include "cc_composite_template_body.h"
+            }
+        } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
+          /* Active pixels are those with nonzero color.  Sum colors. */
+            if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+#define UNPACK_PIXEL(pointer, color)            \
+    color = (IceTUInt *)pointer;                \
+    pointer += sizeof(IceTUInt);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
+    {                                                                   \
+        const IceTUInt *src1_color;                                     \
+        const IceTUInt *src2_color;                                     \
+        IceTUInt *dest_color;                                           \
+        UNPACK_PIXEL(src1_pointer, src1_color);                         \
+        UNPACK_PIXEL(src2_pointer, src2_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        ICET_ADD_UBYTE((const IceTUByte *)src1_color,                   \
+                       (const IceTUByte *)src2_color,                   \
+                       (IceTUByte *)dest_color);                        \
+    }
+#define CCC_PIXEL_SIZE (sizeof(IceTUInt))
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+#define UNPACK_PIXEL(pointer, color)            \
+    color = (IceTFloat *)pointer;               \
+    pointer += 4*sizeof(IceTUInt);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
+    {                                                                   \
+        const IceTFloat *src1_color;                                    \
+        const IceTFloat *src2_color;                                    \
+        IceTFloat *dest_color;                                          \
+        UNPACK_PIXEL(src1_pointer, src1_color);                         \
+        UNPACK_PIXEL(src2_pointer, src2_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        ICET_ADD_FLOAT(src1_color, src2_color, dest_color);             \
+    }
+#define CCC_PIXEL_SIZE (4*sizeof(IceTFloat))
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+#define UNPACK_PIXEL(pointer, color)            \
+    color = (IceTUShort *)pointer;              \
+    pointer += 4*sizeof(IceTUShort);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(front_pointer, back_pointer, dest_pointer)        \
+    {                                                                   \
+        const IceTUShort *front_color;                                  \
+        const IceTUShort *back_color;                                   \
+        IceTUShort *dest_color;                                         \
+        UNPACK_PIXEL(front_pointer, front_color);                       \
+        UNPACK_PIXEL(back_pointer, back_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        icetSIMDAddHalf(front_color, back_color, dest_color, 1);    \
+    }
+#define CCC_PIXEL_SIZE (4*sizeof(IceTUShort))
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+            } else if (addOnlyColorFormat(_color_format)) {
+                IceTSizeType _color_size = colorPixelSize(_color_format);
+#define UNPACK_PIXEL(pointer, color)            \
+    color = pointer;                            \
+    pointer += _color_size;
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE(src1_pointer, src2_pointer, dest_pointer)         \
+    {                                                                   \
+        const IceTVoid *src1_color;                                     \
+        const IceTVoid *src2_color;                                     \
+        IceTVoid *dest_color;                                           \
+        UNPACK_PIXEL(src1_pointer, src1_color);                         \
+        UNPACK_PIXEL(src2_pointer, src2_color);                         \
+        UNPACK_PIXEL(dest_pointer, dest_color);                         \
+        colorAddValues(_color_format,                                   \
+                       src1_color, src2_color, dest_color, 1);          \
+    }
+#define CCC_PIXEL_SIZE _color_size
+#include "cc_composite_template_body.h"
+#undef UNPACK_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
+                icetRaiseWarning("Compositing image with no data.",
+                                 ICET_INVALID_OPERATION);
+                icetClearSparseImage(DEST_SPARSE_IMAGE);
+            } else {
+                icetRaiseError("Encountered invalid color format.",
+                               ICET_SANITY_CHECK_FAIL);
+            }
+        } else {
+          /* Any other depth format (or float depth without color).  Both
+             pixels are active, so depthReducePixels sums them. */
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+#define CCC_FRONT_COMPRESSED_IMAGE FRONT_SPARSE_IMAGE
+#define CCC_BACK_COMPRESSED_IMAGE BACK_SPARSE_IMAGE
+#define CCC_DEST_COMPRESSED_IMAGE DEST_SPARSE_IMAGE
+#define CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth,      \
+                             dest, dest_depth, count)                   \
+    memcpy(dest, back, (count)*_color_size);                            \
+    memcpy(dest_depth, back_depth, (count)*_depth_size);                \
+    depthReducePixels(_composite_mode, _color_format, _depth_format,    \
+                      front, front_depth, dest, dest_depth, count);
+#define CCC_PIXEL_SIZE _color_size
+#define CCC_DEPTH_SIZE _depth_size
+#include "cc_composite_template_body.h"
+        }
     } else {
         icetRaiseError("Encountered invalid composite mode.",
                        ICET_SANITY_CHECK_FAIL);
@@ -260,3 +450,28 @@
 #undef FRONT_SPARSE_IMAGE
 #undef BACK_SPARSE_IMAGE
 #undef DEST_SPARSE_IMAGE
+
+#ifdef PARTITION
+#undef PARTITION
+#undef PARTITION_PIXELS
+#undef FRONT_START
+#undef FRONT_DEPTH_START
+#undef FRONT_INACTIVE
+#undef FRONT_ACTIVE
+#undef BACK_START
+#undef BACK_DEPTH_START
+#undef BACK_INACTIVE
+#undef BACK_ACTIVE
+#undef CORRUPT
+#undef CCC_PARTITION
+#undef CCC_PARTITION_PIXELS
+#undef CCC_FRONT_START
+#undef CCC_FRONT_DEPTH_START
+#undef CCC_FRONT_INACTIVE
+#undef CCC_FRONT_ACTIVE
+#undef CCC_BACK_START
+#undef CCC_BACK_DEPTH_START
+#undef CCC_BACK_INACTIVE
+#undef CCC_BACK_ACTIVE
+#undef CCC_CORRUPT
+#endif
@@ -22,9 +22,33 @@
  *              pointers to actual data in the three buffers, perform the
  *              actual compositing operation and increment the pointers.
  *      CCC_PIXEL_SIZE - the number of bytes required to store the data
- *              for one pixel.
+ *              for one pixel in the run data.
  *
- * All of the above macros are undefined at the end of this file.
+ * The following macros are optional:
+ *      CCC_DEPTH_SIZE - If defined, the images keep their depths in a
+ *              separate plane (see icetSparseImageGetDepthPlane) of this many
+ *              bytes per pixel, and spans of active pixels are composited
+ *              with CCC_COMPOSITE_PIXELS instead of CCC_COMPOSITE.
+ *      CCC_COMPOSITE_PIXELS(front, front_depth, back, back_depth, dest,
+ *              dest_depth, count) - composite count pixels given pointers to
+ *              the data and the depths of the three buffers.  The pointers
+ *              are not incremented.
+ *      CCC_PARTITION - If defined, only a range of pixels is composited,
+ *              starting partway through the input images.  The start is a
+ *              seek point in each input as found by icetSparseImageScanPixels:
+ *              CCC_FRONT_START and CCC_BACK_START point into the run length
+ *              data, CCC_FRONT_DEPTH_START and CCC_BACK_DEPTH_START point
+ *              into the depth planes (if CCC_DEPTH_SIZE is defined), and
+ *              CCC_FRONT_INACTIVE, CCC_FRONT_ACTIVE,
+ *              CCC_BACK_INACTIVE, and CCC_BACK_ACTIVE give the pixels left in
+ *              the current run.  CCC_PARTITION_PIXELS is the number of pixels
+ *              to composite and CCC_CORRUPT is a variable that is set to true
+ *              if the input runs do not add up.  The dimensions of the
+ *              destination are not set and no diagnostics are raised, so the
+ *              body may run on a worker thread.
+ *
+ * All of the above macros except the CCC_PARTITION ones are undefined at the
+ * end of this file.
  */
 
 #ifndef ICET_IMAGE_DATA
@@ -52,7 +76,14 @@
     IceTSizeType _back_num_inactive;
     IceTSizeType _back_num_active;
     IceTSizeType _dest_num_active;
+#ifdef CCC_DEPTH_SIZE
+    const IceTByte *_front_depth;
+    const IceTByte *_back_depth;
+    IceTByte *_dest_depth_stage;
+    IceTByte *_dest_depth;
+#endif
 
+#ifndef CCC_PARTITION
     _num_pixels = icetSparseImageGetNumPixels(CCC_FRONT_COMPRESSED_IMAGE);
     if (_num_pixels != icetSparseImageGetNumPixels(CCC_BACK_COMPRESSED_IMAGE)) {
         icetRaiseError("Input buffers do not agree for compressed-compressed"
@@ -66,12 +97,33 @@
 
     _front = ICET_IMAGE_DATA(CCC_FRONT_COMPRESSED_IMAGE);
     _back = ICET_IMAGE_DATA(CCC_BACK_COMPRESSED_IMAGE);
+    _front_num_inactive = _front_num_active = 0;
+    _back_num_inactive = _back_num_active = 0;
+#ifdef CCC_DEPTH_SIZE
+    _front_depth = icetSparseImageGetDepthPlane(CCC_FRONT_COMPRESSED_IMAGE);
+    _back_depth = icetSparseImageGetDepthPlane(CCC_BACK_COMPRESSED_IMAGE);
+#endif
+#else /* CCC_PARTITION */
+    _num_pixels = CCC_PARTITION_PIXELS;
+    _front = CCC_FRONT_START;
+    _back = CCC_BACK_START;
+    _front_num_inactive = CCC_FRONT_INACTIVE;
+    _front_num_active = CCC_FRONT_ACTIVE;
+    _back_num_inactive = CCC_BACK_INACTIVE;
+    _back_num_active = CCC_BACK_ACTIVE;
+#ifdef CCC_DEPTH_SIZE
+    _front_depth = CCC_FRONT_DEPTH_START;
+    _back_depth = CCC_BACK_DEPTH_START;
+#endif
+#endif /* CCC_PARTITION */
     _dest = ICET_IMAGE_DATA(CCC_DEST_COMPRESSED_IMAGE);
     _dest_runlengths = NULL;
+#ifdef CCC_DEPTH_SIZE
+    _dest_depth_stage = icetSparseImageDepthStage(CCC_DEST_COMPRESSED_IMAGE);
+    _dest_depth = _dest_depth_stage;
+#endif
 
     _pixel = 0;
-    _front_num_inactive = _front_num_active = 0;
-    _back_num_inactive = _back_num_active = 0;
     _dest_num_active = 0;
     while (_pixel < _num_pixels) {
         /* When num_active is 0, we have exhausted all active pixels and the
@@ -92,6 +144,11 @@
         {
             IceTSizeType _dest_num_inactive
                 = CCC_MIN(_front_num_inactive, _back_num_inactive);
+#ifdef CCC_PARTITION
+            /* Runs may continue past the end of the partition. */
+            _dest_num_inactive = CCC_MIN(_dest_num_inactive,
+                                         _num_pixels - _pixel);
+#endif
             if (_dest_num_inactive > 0) {
                 /* Record active pixel count.  (Special case on first iteration
                  * where there is no runlength and no place to put it.) */
@@ -122,6 +179,9 @@
         if ((0 < _front_num_inactive) && (0 < _back_num_active)) {
             IceTSizeType _num_to_copy
                 = CCC_MIN(_front_num_inactive, _back_num_active);
+#ifdef CCC_PARTITION
+            _num_to_copy = CCC_MIN(_num_to_copy, _num_pixels - _pixel);
+#endif
             _front_num_inactive -= _num_to_copy;
             _back_num_active -= _num_to_copy;
             _dest_num_active += _num_to_copy;
@@ -129,11 +189,19 @@
             memcpy(_dest, _back, CCC_PIXEL_SIZE*_num_to_copy);
             _dest += CCC_PIXEL_SIZE*_num_to_copy;
             _back += CCC_PIXEL_SIZE*_num_to_copy;
+#ifdef CCC_DEPTH_SIZE
+            memcpy(_dest_depth, _back_depth, CCC_DEPTH_SIZE*_num_to_copy);
+            _dest_depth += CCC_DEPTH_SIZE*_num_to_copy;
+            _back_depth += CCC_DEPTH_SIZE*_num_to_copy;
+#endif
         }
 
         if ((0 < _back_num_inactive) && (0 < _front_num_active)) {
             IceTSizeType _num_to_copy
                 = CCC_MIN(_back_num_inactive, _front_num_active);
+#ifdef CCC_PARTITION
+            _num_to_copy = CCC_MIN(_num_to_copy, _num_pixels - _pixel);
+#endif
             _back_num_inactive -= _num_to_copy;
             _front_num_active -= _num_to_copy;
             _dest_num_active += _num_to_copy;
@@ -141,18 +209,42 @@
             memcpy(_dest, _front, CCC_PIXEL_SIZE*_num_to_copy);
             _dest += CCC_PIXEL_SIZE*_num_to_copy;
             _front += CCC_PIXEL_SIZE*_num_to_copy;
+#ifdef CCC_DEPTH_SIZE
+            memcpy(_dest_depth, _front_depth, CCC_DEPTH_SIZE*_num_to_copy);
+            _dest_depth += CCC_DEPTH_SIZE*_num_to_copy;
+            _front_depth += CCC_DEPTH_SIZE*_num_to_copy;
+#endif
         }
 
         if ((_front_num_inactive == 0) && (_back_num_inactive == 0)) {
             IceTSizeType _num_to_composite
                 = CCC_MIN(_front_num_active, _back_num_active);
+#ifdef CCC_PARTITION
+            _num_to_composite = CCC_MIN(_num_to_composite,
+                                        _num_pixels - _pixel);
+#endif
             _front_num_active -= _num_to_composite;
             _back_num_active -= _num_to_composite;
             _dest_num_active += _num_to_composite;
             _pixel += _num_to_composite;
+#ifdef CCC_DEPTH_SIZE
+            if (0 < _num_to_composite) {
+                CCC_COMPOSITE_PIXELS(_front, _front_depth,
+                                     _back, _back_depth,
+                                     _dest, _dest_depth,
+                                     _num_to_composite);
+                _front += CCC_PIXEL_SIZE*_num_to_composite;
+                _back += CCC_PIXEL_SIZE*_num_to_composite;
+                _dest += CCC_PIXEL_SIZE*_num_to_composite;
+                _front_depth += CCC_DEPTH_SIZE*_num_to_composite;
+                _back_depth += CCC_DEPTH_SIZE*_num_to_composite;
+                _dest_depth += CCC_DEPTH_SIZE*_num_to_composite;
+            }
+#else
             for ( ; 0 < _num_to_composite; _num_to_composite--) {
                 CCC_COMPOSITE(_front, _back, _dest);
             }
+#endif
         }
     }
 
@@ -161,7 +253,11 @@
     }
 
     if (_pixel != _num_pixels) {
+#ifndef CCC_PARTITION
         icetRaiseError("Corrupt compressed image.", ICET_INVALID_VALUE);
+#else
+        CCC_CORRUPT = ICET_TRUE;
+#endif
     }
 
     {
@@ -171,10 +267,19 @@
         IceTPointerArithmetic _buffer_end
             =(IceTPointerArithmetic)_dest;
         IceTPointerArithmetic _compressed_size = _buffer_end - _buffer_begin;
-        ICET_IMAGE_HEADER(CCC_DEST_COMPRESSED_IMAGE)
+        ICET_IMAGE_SIZE_HEADER(CCC_DEST_COMPRESSED_IMAGE)
             [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
-            = (IceTInt)_compressed_size;
+            = (IceTSizeType)_compressed_size;
+        ICET_IMAGE_SIZE_HEADER(CCC_DEST_COMPRESSED_IMAGE)
+            [ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+        ICET_IMAGE_SIZE_HEADER(CCC_DEST_COMPRESSED_IMAGE)
+            [ICET_IMAGE_DEPTH_PLANE_INDEX] = 0;
     }
+#ifdef CCC_DEPTH_SIZE
+    icetSparseImageAppendDepths(CCC_DEST_COMPRESSED_IMAGE,
+                                _dest_depth_stage,
+                                _dest_depth);
+#endif
 }
 
 #undef CCC_FRONT_COMPRESSED_IMAGE
@@ -182,3 +287,7 @@
 #undef CCC_DEST_COMPRESSED_IMAGE
 #undef CCC_COMPOSITE
 #undef CCC_PIXEL_SIZE
+#ifdef CCC_DEPTH_SIZE
+#undef CCC_DEPTH_SIZE
+#undef CCC_COMPOSITE_PIXELS
+#endif
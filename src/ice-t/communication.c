@@ -14,19 +14,35 @@
 #include <IceTDevDiagnostics.h>
 #include <IceTDevPorting.h>
 
-#define icetAddSentBytes(num_sending)                                   \
-    icetStateSetInteger(ICET_BYTES_SENT,                                \
-                        icetUnsafeStateGetInteger(ICET_BYTES_SENT)[0]   \
-                        + (num_sending))
+/* ICET_BYTES_SENT is an integer, so with 64-bit sizes it stops at the
+   largest IceTInt rather than wrapping around. */
+#ifdef ICET_USE_64BIT_SIZE
+#define ICET_MAX_BYTES_SENT     ((IceTSizeType)0x7FFFFFFF)
+#endif
+
+static void icetAddSentBytes(IceTSizeType num_sending)
+{
+    IceTSizeType total
+        = icetUnsafeStateGetInteger(ICET_BYTES_SENT)[0] + num_sending;
+#ifdef ICET_MAX_BYTES_SENT
+    if (total > ICET_MAX_BYTES_SENT) total = ICET_MAX_BYTES_SENT;
+#endif
+    icetStateSetInteger(ICET_BYTES_SENT, (IceTInt)total);
+}
 
 #define icetAddSent(count, datatype)                                    \
-    icetAddSentBytes((IceTInt)count*icetTypeWidth(datatype))
+    icetAddSentBytes((IceTSizeType)(count)*icetTypeWidth(datatype))
 
+#ifdef ICET_USE_64BIT_SIZE
+/* Messages over 2 GB are expected with 64-bit sizes. */
+#define icetCommCheckCount(count)
+#else
 #define icetCommCheckCount(count)                                       \
     if (count > 1073741824) {                                           \
         icetRaiseWarning("Encountered a ridiculously large message.",   \
                          ICET_INVALID_VALUE);                           \
     }
+#endif
 
 IceTCommunicator icetCommDuplicate()
 {
@@ -55,7 +71,7 @@ void icetCommSend(const void *buf,
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(count);
     icetAddSent(count, datatype);
-    comm->Send(comm, buf, (int)count, datatype, dest, tag);
+    comm->Send(comm, buf, count, datatype, dest, tag);
 }
 
 void icetCommRecv(void *buf,
@@ -66,7 +82,7 @@ void icetCommRecv(void *buf,
 {
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(count);
-    comm->Recv(comm, buf, (int)count, datatype, src, tag);
+    comm->Recv(comm, buf, count, datatype, src, tag);
 }
 
 void icetCommSendrecv(const void *sendbuf,
@@ -84,8 +100,8 @@ void icetCommSendrecv(const void *sendbuf,
     icetCommCheckCount(sendcount);
     icetCommCheckCount(recvcount);
     icetAddSent(sendcount, sendtype);
-    comm->Sendrecv(comm, sendbuf, (int)sendcount, sendtype, dest, sendtag,
-                   recvbuf, (int)recvcount, recvtype, src, recvtag);
+    comm->Sendrecv(comm, sendbuf, sendcount, sendtype, dest, sendtag,
+                   recvbuf, recvcount, recvtype, src, recvtag);
 }
 
 void icetCommGather(const void *sendbuf,
@@ -114,31 +130,11 @@ void icetCommGatherv(const void *sendbuf,
                      int root)
 {
     IceTCommunicator comm = icetGetCommunicator();
-    int *int_recvcounts;
-    int *int_recvoffsets;
     icetCommCheckCount(sendcount);
-    if (root == icetCommRank()) {
-        if (sizeof(int) == sizeof(IceTSizeType)) {
-            int_recvcounts = (int *)recvcounts;
-            int_recvoffsets = (int *)recvoffsets;
-        } else {
-            int numproc = icetCommSize();
-            int proc;
-            int_recvcounts = icetGetStateBuffer(ICET_COMM_COUNT_BUF,
-                                                numproc*sizeof(int));
-            int_recvoffsets = icetGetStateBuffer(ICET_COMM_OFFSET_BUF,
-                                                 numproc*sizeof(int));
-            for (proc = 0; proc < numproc; proc++) {
-                icetCommCheckCount(recvcounts[proc]);
-                int_recvcounts[proc] = recvcounts[proc];
-                icetCommCheckCount(recvoffsets[proc]);
-                int_recvoffsets[proc] = recvoffsets[proc];
-            }
-        }
-    } else {
+    if (root != icetCommRank()) {
         icetAddSent(sendcount, datatype);
-        int_recvcounts = NULL;
-        int_recvoffsets = NULL;
+        recvcounts = NULL;
+        recvoffsets = NULL;
     }
 #ifdef DEBUG
     comm->Barrier(comm);
@@ -148,8 +144,8 @@ void icetCommGatherv(const void *sendbuf,
                   sendcount,
                   datatype,
                   recvbuf,
-                  int_recvcounts,
-                  int_recvoffsets,
+                  recvcounts,
+                  recvoffsets,
                   root);
 }
 
@@ -161,7 +157,7 @@ void icetCommAllgather(const void *sendbuf,
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(sendcount);
     icetAddSent(sendcount, datatype);
-    comm->Allgather(comm, sendbuf, (int)sendcount, datatype, recvbuf);
+    comm->Allgather(comm, sendbuf, sendcount, datatype, recvbuf);
 }
 
 void icetCommAlltoall(const void *sendbuf,
@@ -172,7 +168,23 @@ void icetCommAlltoall(const void *sendbuf,
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(sendcount);
     icetAddSent(sendcount, datatype);
-    comm->Alltoall(comm, sendbuf, (int)sendcount, datatype, recvbuf);
+    comm->Alltoall(comm, sendbuf, sendcount, datatype, recvbuf);
+}
+
+void icetCommReduceScatterBlock(int group_size,
+                                const IceTInt32 *group,
+                                const void *sendbuf,
+                                void *recvbuf,
+                                IceTSizeType recvcount,
+                                IceTSizeType element_size,
+                                IceTCommReduceFunction reduce,
+                                void *reduce_data)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    icetCommCheckCount(recvcount*element_size);
+    icetAddSentBytes((IceTSizeType)(group_size - 1)*recvcount*element_size);
+    comm->ReduceScatterBlock(comm, group_size, group, sendbuf, recvbuf,
+                             recvcount, element_size, reduce, reduce_data);
 }
 
 IceTCommRequest icetCommIsend(const void *buf,
@@ -184,7 +196,7 @@ IceTCommRequest icetCommIsend(const void *buf,
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(count);
     icetAddSent(count, datatype);
-    return comm->Isend(comm, buf, (int)count, datatype, dest, tag);
+    return comm->Isend(comm, buf, count, datatype, dest, tag);
 }
 
 IceTCommRequest icetCommIrecv(void *buf,
@@ -195,7 +207,36 @@ IceTCommRequest icetCommIrecv(void *buf,
 {
     IceTCommunicator comm = icetGetCommunicator();
     icetCommCheckCount(count);
-    return comm->Irecv(comm, buf, (int)count, datatype, src, tag);
+    return comm->Irecv(comm, buf, count, datatype, src, tag);
+}
+
+IceTCommRequest icetCommPersistentIsend(const void *buf,
+                                        IceTSizeType count,
+                                        IceTEnum datatype,
+                                        int dest,
+                                        int tag)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    icetCommCheckCount(count);
+    icetAddSent(count, datatype);
+    if (comm->PersistentIsend == NULL) {
+        return comm->Isend(comm, buf, count, datatype, dest, tag);
+    }
+    return comm->PersistentIsend(comm, buf, count, datatype, dest, tag);
+}
+
+IceTCommRequest icetCommPersistentIrecv(void *buf,
+                                        IceTSizeType count,
+                                        IceTEnum datatype,
+                                        int src,
+                                        int tag)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    icetCommCheckCount(count);
+    if (comm->PersistentIrecv == NULL) {
+        return comm->Irecv(comm, buf, count, datatype, src, tag);
+    }
+    return comm->PersistentIrecv(comm, buf, count, datatype, src, tag);
 }
 
 void icetCommWait(IceTCommRequest *request)
@@ -210,6 +251,66 @@ int icetCommWaitany(int count, IceTCommRequest *array_of_requests)
     return comm->Waitany(comm, count, array_of_requests);
 }
 
+int icetCommWaitsome(int count,
+                     IceTCommRequest *array_of_requests,
+                     int *array_of_indices)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    int i;
+
+    if (comm->Waitsome != NULL) {
+        return comm->Waitsome(comm, count, array_of_requests,
+                              array_of_indices);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (array_of_requests[i] != ICET_COMM_REQUEST_NULL) break;
+    }
+    if (i == count) return 0;
+
+    array_of_indices[0] = comm->Waitany(comm, count, array_of_requests);
+    return 1;
+}
+
+int icetCommTestsome(int count,
+                     IceTCommRequest *array_of_requests,
+                     int *array_of_indices)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    int num_done;
+    int i;
+
+    if (comm->Testsome != NULL) {
+        return comm->Testsome(comm, count, array_of_requests,
+                              array_of_indices);
+    }
+
+    /* Without Test there is no way to look at a request without blocking,
+       so report that nothing has finished yet. */
+    if (comm->Test == NULL) return 0;
+
+    num_done = 0;
+    for (i = 0; i < count; i++) {
+        if (   (array_of_requests[i] != ICET_COMM_REQUEST_NULL)
+            && comm->Test(comm, &array_of_requests[i]) ) {
+            array_of_indices[num_done] = i;
+            num_done++;
+        }
+    }
+    return num_done;
+}
+
+IceTBoolean icetCommTest(IceTCommRequest *request)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+
+    if (comm->Test != NULL) {
+        return comm->Test(comm, request) ? ICET_TRUE : ICET_FALSE;
+    }
+
+    return ICET_FALSE;
+}
+
 void icetCommWaitall(int count, IceTCommRequest *array_of_requests)
 {
     int i;
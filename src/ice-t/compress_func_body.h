@@ -36,6 +36,11 @@
  *              pixels in memory.  If defined, then REGION_OFFSET_X,
  *              REGION_OFFSET_Y, REGION_WIDTH, and REGION_HEIGHT must also be
  *              defined.
+ *      WORKER_THREAD - If defined, the body may be run on a thread other than
+ *              the one that owns the IceT context (see icetParallelFor).
+ *              Timing and debug diagnostics, which modify the state, are
+ *              skipped, as are finding the active bounds and building the
+ *              seek table (the caller joins the pieces and does both).
  *
  * All of the above macros are undefined at the end of this file.
  */
@@ -61,6 +66,10 @@
 #endif
 #endif
 
+#ifdef WORKER_THREAD
+#define CT_NO_TIMING
+#endif
+
 {
     IceTEnum _color_format, _depth_format;
     IceTSizeType _pixel_count;
@@ -115,20 +124,28 @@
 #endif /*REGION*/
 #endif /*DEBUG*/
 
-    if (_composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
-        if (_depth_format == ICET_IMAGE_DEPTH_FLOAT) {
-          /* Use Z buffer for active pixel testing. */
+    if (   (_composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER)
+        || (   reductionCompositeMode(_composite_mode)
+            && (_depth_format != ICET_IMAGE_DEPTH_NONE) ) ) {
+        if (   (_depth_format == ICET_IMAGE_DEPTH_FLOAT)
+            && (   (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                || (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
+          /* Use Z buffer for active pixel testing.  Additive compositing
+             uses the same test; pixels never touched by the renderer are
+             left at the far plane. */
             const IceTFloat *_depth = icetImageGetDepthcf(INPUT_IMAGE);
 #ifdef OFFSET
             _depth += OFFSET;
 #endif
             if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
                 const IceTUInt *_color;
-                IceTUInt *_c_out;
-                IceTFloat *_d_out;
+                IceTByte *_d_stage;
+                IceTByte *_d_out;
 #ifdef REGION
                 IceTSizeType _region_count = 0;
 #endif
+                _d_stage = icetSparseImageDepthStage(OUTPUT_SPARSE_IMAGE);
+                _d_out = _d_stage;
                 _color = icetImageGetColorcui(INPUT_IMAGE);
 #ifdef OFFSET
                 _color += OFFSET;
@@ -138,12 +155,6 @@
 #define CT_DEPTH_FORMAT         _depth_format
 #define CT_PIXEL_COUNT          _pixel_count
 #define CT_ACTIVE()             (_depth[0] < 1.0)
-#define CT_WRITE_PIXEL(dest)    _c_out = (IceTUInt *)dest;      \
-                                _c_out[0] = _color[0];          \
-                                dest += sizeof(IceTUInt);       \
-                                _d_out = (IceTFloat *)dest;     \
-                                _d_out[0] = _depth[0];          \
-                                dest += sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color++;  _depth++;                    \
                                 _region_count++;                        \
@@ -155,6 +166,28 @@
 #else
 #define CT_INCREMENT_PIXEL()    _color++;  _depth++;
 #endif
+#define CT_COUNT_RUN(count, active)                                     \
+            icetSIMDCountDepthRun(_depth, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       (count)*sizeof(IceTUInt));       \
+                                dest += (count)*sizeof(IceTUInt);       \
+                                memcpy(_d_out, _depth,                  \
+                                       (count)*sizeof(IceTFloat));      \
+                                _d_out += (count)*sizeof(IceTFloat);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count)                                      \
+                                _color += (count);  _depth += (count);  \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _region_x_skip;           \
+                                    _depth += _region_x_skip;           \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += (count);  _depth += (count);
+#endif
 #ifdef PADDING
 #define CT_PADDING
 #define CT_SPACE_BOTTOM         SPACE_BOTTOM
@@ -165,12 +198,18 @@
 #define CT_FULL_HEIGHT          FULL_HEIGHT
 #endif
 #include "compress_template_body.h"
+                icetSparseImageAppendDepths(OUTPUT_SPARSE_IMAGE,
+                                            _d_stage,
+                                            _d_out);
             } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
                 const IceTFloat *_color;
-                IceTFloat *_out;
+                IceTByte *_d_stage;
+                IceTByte *_d_out;
 #ifdef REGION
                 IceTSizeType _region_count = 0;
 #endif
+                _d_stage = icetSparseImageDepthStage(OUTPUT_SPARSE_IMAGE);
+                _d_out = _d_stage;
                 _color = icetImageGetColorcf(INPUT_IMAGE);
 #ifdef OFFSET
                 _color += 4*(OFFSET);
@@ -180,13 +219,6 @@
 #define CT_DEPTH_FORMAT         _depth_format
 #define CT_PIXEL_COUNT          _pixel_count
 #define CT_ACTIVE()             (_depth[0] < 1.0)
-#define CT_WRITE_PIXEL(dest)    _out = (IceTFloat *)dest;       \
-                                _out[0] = _color[0];            \
-                                _out[1] = _color[1];            \
-                                _out[2] = _color[2];            \
-                                _out[3] = _color[3];            \
-                                _out[4] = _depth[0];            \
-                                dest += 5*sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color += 4;  _depth++;                 \
                                 _region_count++;                        \
@@ -198,6 +230,28 @@
 #else
 #define CT_INCREMENT_PIXEL()    _color += 4;  _depth++;
 #endif
+#define CT_COUNT_RUN(count, active)                                     \
+            icetSIMDCountDepthRun(_depth, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       4*(count)*sizeof(IceTFloat));    \
+                                dest += 4*(count)*sizeof(IceTFloat);    \
+                                memcpy(_d_out, _depth,                  \
+                                       (count)*sizeof(IceTFloat));      \
+                                _d_out += (count)*sizeof(IceTFloat);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count)                                      \
+                                _color += 4*(count);  _depth += (count); \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _depth += _region_x_skip;           \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);  _depth += (count);
+#endif
 #ifdef PADDING
 #define CT_PADDING
 #define CT_SPACE_BOTTOM         SPACE_BOTTOM
@@ -208,28 +262,76 @@
 #define CT_FULL_HEIGHT          FULL_HEIGHT
 #endif
 #include "compress_template_body.h"
-            } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
-                IceTFloat *_out;
+                icetSparseImageAppendDepths(OUTPUT_SPARSE_IMAGE,
+                                            _d_stage,
+                                            _d_out);
+            }
+        } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
+            icetRaiseError("Cannot use Z buffer compression with no"
+                           " Z buffer.", ICET_INVALID_OPERATION);
+        } else {
+          /* Any other depth format (or float depth without color).  Pixels are
+             copied as bytes and depths are tested with the helpers in
+             image.c. */
+            const IceTByte *_color;
+            const IceTByte *_depth;
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+            IceTByte *_d_stage;
+            IceTByte *_d_out;
 #ifdef REGION
-                IceTSizeType _region_count = 0;
+            IceTSizeType _region_count = 0;
+#endif
+            _d_stage = icetSparseImageDepthStage(OUTPUT_SPARSE_IMAGE);
+            _d_out = _d_stage;
+            _color = icetImageGetColorConstVoid(INPUT_IMAGE, NULL);
+            _depth = icetImageGetDepthConstVoid(INPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += _color_size*(OFFSET);
+            _depth += _depth_size*(OFFSET);
 #endif
 #define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
 #define CT_COLOR_FORMAT         _color_format
 #define CT_DEPTH_FORMAT         _depth_format
 #define CT_PIXEL_COUNT          _pixel_count
-#define CT_ACTIVE()             (_depth[0] < 1.0)
-#define CT_WRITE_PIXEL(dest)    _out = (IceTFloat *)dest;       \
-                                _out[0] = _depth[0];            \
-                                dest += 1*sizeof(IceTFloat);
+#define CT_ACTIVE()             depthIsActive(_depth_format, _depth)
 #ifdef REGION
-#define CT_INCREMENT_PIXEL()    _depth++;                               \
+#define CT_INCREMENT_PIXEL()    _color += _color_size;                  \
+                                _depth += _depth_size;                  \
                                 _region_count++;                        \
                                 if (_region_count >= _region_width) {   \
-                                    _depth += _region_x_skip;           \
+                                    _color += _color_size*_region_x_skip; \
+                                    _depth += _depth_size*_region_x_skip; \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color += _color_size;                  \
+                                _depth += _depth_size;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            depthCountRun(_depth_format, _depth, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       (count)*_color_size);            \
+                                dest += (count)*_color_size;            \
+                                memcpy(_d_out, _depth,                  \
+                                       (count)*_depth_size);            \
+                                _d_out += (count)*_depth_size;
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count)                                      \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;          \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _color_size*_region_x_skip; \
+                                    _depth += _depth_size*_region_x_skip; \
                                     _region_count = 0;                  \
                                 }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
 #else
-#define CT_INCREMENT_PIXEL()    _depth++;
+#define CT_INCREMENT_PIXELS(count)                                      \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
 #endif
 #ifdef PADDING
 #define CT_PADDING
@@ -241,19 +343,22 @@
 #define CT_FULL_HEIGHT          FULL_HEIGHT
 #endif
 #include "compress_template_body.h"
-            } else {
-                icetRaiseError("Encountered invalid color format.",
-                               ICET_SANITY_CHECK_FAIL);
+            icetSparseImageAppendDepths(OUTPUT_SPARSE_IMAGE, _d_stage, _d_out);
+        }
+    } else if (_composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+        IceTFloat _alpha_cutoff;
+        IceTUInt _min_alpha_ubyte;
+      /* Use alpha for active pixel testing.  With ICET_BLEND_ALPHA_CUTOFF,
+         pixels too transparent to matter are also treated as inactive. */
+        icetGetFloatv(ICET_BLEND_ALPHA_CUTOFF, &_alpha_cutoff);
+        if (_alpha_cutoff < 1.0f) {
+            _min_alpha_ubyte = (IceTUInt)(_alpha_cutoff*255.0f);
+            if ((IceTFloat)_min_alpha_ubyte < _alpha_cutoff*255.0f) {
+                _min_alpha_ubyte++;
             }
-        } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
-            icetRaiseError("Cannot use Z buffer compression with no"
-                           " Z buffer.", ICET_INVALID_OPERATION);
         } else {
-            icetRaiseError("Encountered invalid depth format.",
-                           ICET_SANITY_CHECK_FAIL);
+            _min_alpha_ubyte = (_alpha_cutoff > 1.0f) ? 256 : 255;
         }
-    } else if (_composite_mode == ICET_COMPOSITE_MODE_BLEND) {
-      /* Use alpha for active pixel testing. */
         if (_depth_format != ICET_IMAGE_DEPTH_NONE) {
             icetRaiseWarning("Z buffer ignored during blend compress"
                              " operation.  Output z buffer meaningless.",
@@ -261,7 +366,6 @@
         }
         if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
             const IceTUInt *_color;
-            IceTUInt *_out;
 #ifdef REGION
             IceTSizeType _region_count = 0;
 #endif
@@ -273,10 +377,10 @@
 #define CT_COLOR_FORMAT         _color_format
 #define CT_DEPTH_FORMAT         _depth_format
 #define CT_PIXEL_COUNT          _pixel_count
-#define CT_ACTIVE()             (((IceTUByte*)_color)[3] != 0x00)
-#define CT_WRITE_PIXEL(dest)    _out = (IceTUInt *)dest;        \
-                                _out[0] = _color[0];            \
-                                dest += sizeof(IceTUInt);
+#define CT_ACTIVE()                                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? (((IceTUByte*)_color)[3] >= _min_alpha_ubyte)            \
+             : (((IceTUByte*)_color)[3] != 0x00) )
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color++;                               \
                                 _region_count++;                        \
@@ -287,6 +391,26 @@
 #else
 #define CT_INCREMENT_PIXEL()    _color++;
 #endif
+#define CT_COUNT_RUN(count, active)                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? icetSIMDCountAlphaCutoffUByteRun(_color, count, active,  \
+                                                _min_alpha_ubyte)       \
+             : icetSIMDCountAlphaUByteRun(_color, count, active) )
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       (count)*sizeof(IceTUInt));       \
+                                dest += (count)*sizeof(IceTUInt);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += (count);                   \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _region_x_skip;           \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += (count);
+#endif
 #ifdef PADDING
 #define CT_PADDING
 #define CT_SPACE_BOTTOM         SPACE_BOTTOM
@@ -299,7 +423,6 @@
 #include "compress_template_body.h"
         } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
             const IceTFloat *_color;
-            IceTFloat *_out;
 #ifdef REGION
             IceTSizeType _region_count = 0;
 #endif
@@ -311,13 +434,68 @@
 #define CT_COLOR_FORMAT         _color_format
 #define CT_DEPTH_FORMAT         _depth_format
 #define CT_PIXEL_COUNT          _pixel_count
-#define CT_ACTIVE()             (_color[3] != 0.0)
-#define CT_WRITE_PIXEL(dest)    _out = (IceTFloat *)dest;       \
-                                _out[0] = _color[0];            \
-                                _out[1] = _color[1];            \
-                                _out[2] = _color[2];            \
-                                _out[3] = _color[3];            \
-                                dest += 4*sizeof(IceTUInt);
+#define CT_ACTIVE()                                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? (_color[3] >= _alpha_cutoff)                             \
+             : (_color[3] != 0.0) )
+#ifdef REGION
+#define CT_INCREMENT_PIXEL()    _color += 4;                            \
+                                _region_count++;                        \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color += 4;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? icetSIMDCountAlphaCutoffFloatRun(_color, count, active,  \
+                                                _alpha_cutoff)          \
+             : icetSIMDCountAlphaFloatRun(_color, count, active) )
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       4*(count)*sizeof(IceTFloat));    \
+                                dest += 4*(count)*sizeof(IceTFloat);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);                 \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);
+#endif
+#ifdef PADDING
+#define CT_PADDING
+#define CT_SPACE_BOTTOM         SPACE_BOTTOM
+#define CT_SPACE_TOP            SPACE_TOP
+#define CT_SPACE_LEFT           SPACE_LEFT
+#define CT_SPACE_RIGHT          SPACE_RIGHT
+#define CT_FULL_WIDTH           FULL_WIDTH
+#define CT_FULL_HEIGHT          FULL_HEIGHT
+#endif
+#include "compress_template_body.h"
+        } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+            const IceTUShort *_color;
+#ifdef REGION
+            IceTSizeType _region_count = 0;
+#endif
+            _color = icetImageGetColorConstVoid(INPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += 4*(OFFSET);
+#endif
+#define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
+#define CT_COLOR_FORMAT         _color_format
+#define CT_DEPTH_FORMAT         _depth_format
+#define CT_PIXEL_COUNT          _pixel_count
+#define CT_ACTIVE()                                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? (icetSIMDCountAlphaCutoffHalfRun(_color, 1, ICET_TRUE,   \
+                                                _alpha_cutoff) == 1)    \
+             : ((_color[3] & 0x7FFF) != 0) )
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color += 4;                            \
                                 _region_count++;                        \
@@ -328,6 +506,26 @@
 #else
 #define CT_INCREMENT_PIXEL()    _color += 4;
 #endif
+#define CT_COUNT_RUN(count, active)                                     \
+            (  (_alpha_cutoff > 0.0f)                                   \
+             ? icetSIMDCountAlphaCutoffHalfRun(_color, count, active,   \
+                                               _alpha_cutoff)           \
+             : icetSIMDCountAlphaHalfRun(_color, count, active) )
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       4*(count)*sizeof(IceTUShort));   \
+                                dest += 4*(count)*sizeof(IceTUShort);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);                 \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);
+#endif
 #ifdef PADDING
 #define CT_PADDING
 #define CT_SPACE_BOTTOM         SPACE_BOTTOM
@@ -338,14 +536,242 @@
 #define CT_FULL_HEIGHT          FULL_HEIGHT
 #endif
 #include "compress_template_body.h"
+        } else if (addOnlyColorFormat(_color_format)) {
+            icetRaiseError("Cannot blend colors without an alpha channel.",
+                           ICET_INVALID_OPERATION);
         } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
-            IceTUInt *_out;
+            IceTByte *_out;
             icetRaiseWarning("Compressing image with no data.",
                              ICET_INVALID_OPERATION);
             _out = ICET_IMAGE_DATA(OUTPUT_SPARSE_IMAGE);
             INACTIVE_RUN_LENGTH(_out) = _pixel_count;
             ACTIVE_RUN_LENGTH(_out) = 0;
-            _out++;
+            _out += RUN_LENGTH_SIZE;
+            icetSparseImageSetActualSize(OUTPUT_SPARSE_IMAGE, _out);
+        } else {
+            icetRaiseError("Encountered invalid color format.",
+                           ICET_SANITY_CHECK_FAIL);
+        }
+    } else if (reductionCompositeMode(_composite_mode)) {
+      /* No depth buffer (otherwise handled with the Z buffer above).  Any
+         pixel with a nonzero color contributes and is active. */
+        if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            const IceTUInt *_color;
+#ifdef REGION
+            IceTSizeType _region_count = 0;
+#endif
+            _color = icetImageGetColorcui(INPUT_IMAGE);
+#ifdef OFFSET
+            _color += OFFSET;
+#endif
+#define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
+#define CT_COLOR_FORMAT         _color_format
+#define CT_DEPTH_FORMAT         _depth_format
+#define CT_PIXEL_COUNT          _pixel_count
+#define CT_ACTIVE()             (_color[0] != 0)
+#ifdef REGION
+#define CT_INCREMENT_PIXEL()    _color++;                               \
+                                _region_count++;                        \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _region_x_skip;           \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color++;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            icetSIMDCountColorUByteRun(_color, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       (count)*sizeof(IceTUInt));       \
+                                dest += (count)*sizeof(IceTUInt);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += (count);                   \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _region_x_skip;           \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += (count);
+#endif
+#ifdef PADDING
+#define CT_PADDING
+#define CT_SPACE_BOTTOM         SPACE_BOTTOM
+#define CT_SPACE_TOP            SPACE_TOP
+#define CT_SPACE_LEFT           SPACE_LEFT
+#define CT_SPACE_RIGHT          SPACE_RIGHT
+#define CT_FULL_WIDTH           FULL_WIDTH
+#define CT_FULL_HEIGHT          FULL_HEIGHT
+#endif
+#include "compress_template_body.h"
+        } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            const IceTFloat *_color;
+#ifdef REGION
+            IceTSizeType _region_count = 0;
+#endif
+            _color = icetImageGetColorcf(INPUT_IMAGE);
+#ifdef OFFSET
+            _color += 4*(OFFSET);
+#endif
+#define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
+#define CT_COLOR_FORMAT         _color_format
+#define CT_DEPTH_FORMAT         _depth_format
+#define CT_PIXEL_COUNT          _pixel_count
+#define CT_ACTIVE()             (   (_color[0] != 0.0) || (_color[1] != 0.0) \
+                                 || (_color[2] != 0.0) || (_color[3] != 0.0))
+#ifdef REGION
+#define CT_INCREMENT_PIXEL()    _color += 4;                            \
+                                _region_count++;                        \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color += 4;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            icetSIMDCountColorFloatRun(_color, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       4*(count)*sizeof(IceTFloat));    \
+                                dest += 4*(count)*sizeof(IceTFloat);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);                 \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);
+#endif
+#ifdef PADDING
+#define CT_PADDING
+#define CT_SPACE_BOTTOM         SPACE_BOTTOM
+#define CT_SPACE_TOP            SPACE_TOP
+#define CT_SPACE_LEFT           SPACE_LEFT
+#define CT_SPACE_RIGHT          SPACE_RIGHT
+#define CT_FULL_WIDTH           FULL_WIDTH
+#define CT_FULL_HEIGHT          FULL_HEIGHT
+#endif
+#include "compress_template_body.h"
+        } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+            const IceTUShort *_color;
+#ifdef REGION
+            IceTSizeType _region_count = 0;
+#endif
+            _color = icetImageGetColorConstVoid(INPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += 4*(OFFSET);
+#endif
+#define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
+#define CT_COLOR_FORMAT         _color_format
+#define CT_DEPTH_FORMAT         _depth_format
+#define CT_PIXEL_COUNT          _pixel_count
+#define CT_ACTIVE()             (((  _color[0] | _color[1]              \
+                                   | _color[2] | _color[3]) & 0x7FFF) != 0)
+#ifdef REGION
+#define CT_INCREMENT_PIXEL()    _color += 4;                            \
+                                _region_count++;                        \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color += 4;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            icetSIMDCountColorHalfRun(_color, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       4*(count)*sizeof(IceTUShort));   \
+                                dest += 4*(count)*sizeof(IceTUShort);
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);                 \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += 4*_region_x_skip;         \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += 4*(count);
+#endif
+#ifdef PADDING
+#define CT_PADDING
+#define CT_SPACE_BOTTOM         SPACE_BOTTOM
+#define CT_SPACE_TOP            SPACE_TOP
+#define CT_SPACE_LEFT           SPACE_LEFT
+#define CT_SPACE_RIGHT          SPACE_RIGHT
+#define CT_FULL_WIDTH           FULL_WIDTH
+#define CT_FULL_HEIGHT          FULL_HEIGHT
+#endif
+#include "compress_template_body.h"
+        } else if (addOnlyColorFormat(_color_format)) {
+            /* Use IceTByte for byte-based pointer arithmetic. */
+            const IceTByte *_color;
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+#ifdef REGION
+            IceTSizeType _region_count = 0;
+#endif
+            _color = icetImageGetColorConstVoid(INPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += _color_size*(OFFSET);
+#endif
+#define CT_COMPRESSED_IMAGE     OUTPUT_SPARSE_IMAGE
+#define CT_COLOR_FORMAT         _color_format
+#define CT_DEPTH_FORMAT         _depth_format
+#define CT_PIXEL_COUNT          _pixel_count
+#define CT_ACTIVE()                                                     \
+            (colorCountValueRun(_color_format, _color, 1, ICET_TRUE) == 1)
+#ifdef REGION
+#define CT_INCREMENT_PIXEL()    _color += _color_size;                  \
+                                _region_count++;                        \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _color_size*_region_x_skip; \
+                                    _region_count = 0;                  \
+                                }
+#else
+#define CT_INCREMENT_PIXEL()    _color += _color_size;
+#endif
+#define CT_COUNT_RUN(count, active)                                     \
+            colorCountValueRun(_color_format, _color, count, active)
+#define CT_WRITE_PIXELS(dest, count)                                    \
+                                memcpy(dest, _color,                    \
+                                       (count)*_color_size);            \
+                                dest += (count)*_color_size;
+#ifdef REGION
+#define CT_INCREMENT_PIXELS(count) _color += _color_size*(count);       \
+                                _region_count += (count);               \
+                                if (_region_count >= _region_width) {   \
+                                    _color += _color_size*_region_x_skip; \
+                                    _region_count = 0;                  \
+                                }
+#define CT_CONTIGUOUS_PIXELS    (_region_width - _region_count)
+#else
+#define CT_INCREMENT_PIXELS(count) _color += _color_size*(count);
+#endif
+#ifdef PADDING
+#define CT_PADDING
+#define CT_SPACE_BOTTOM         SPACE_BOTTOM
+#define CT_SPACE_TOP            SPACE_TOP
+#define CT_SPACE_LEFT           SPACE_LEFT
+#define CT_SPACE_RIGHT          SPACE_RIGHT
+#define CT_FULL_WIDTH           FULL_WIDTH
+#define CT_FULL_HEIGHT          FULL_HEIGHT
+#endif
+#include "compress_template_body.h"
+        } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
+            IceTByte *_out;
+            icetRaiseWarning("Compressing image with no data.",
+                             ICET_INVALID_OPERATION);
+            _out = ICET_IMAGE_DATA(OUTPUT_SPARSE_IMAGE);
+            INACTIVE_RUN_LENGTH(_out) = _pixel_count;
+            ACTIVE_RUN_LENGTH(_out) = 0;
+            _out += RUN_LENGTH_SIZE;
             icetSparseImageSetActualSize(OUTPUT_SPARSE_IMAGE, _out);
         } else {
             icetRaiseError("Encountered invalid color format.",
@@ -356,16 +782,26 @@
                        ICET_SANITY_CHECK_FAIL);
     }
 
+#ifndef WORKER_THREAD
+    icetSparseImageFindActiveBounds(OUTPUT_SPARSE_IMAGE);
+    icetSparseImageBuildSeekTable(OUTPUT_SPARSE_IMAGE);
+
     icetRaiseDebug1("Compression: %f%%\n",
         100.0f - (  100.0f*icetSparseImageGetCompressedBufferSize(OUTPUT_SPARSE_IMAGE)
                   / icetImageBufferSizeType(_color_format, _depth_format,
                                             icetSparseImageGetWidth(OUTPUT_SPARSE_IMAGE),
                                             icetSparseImageGetHeight(OUTPUT_SPARSE_IMAGE)) ));
+#endif
 }
 
 #undef INPUT_IMAGE
 #undef OUTPUT_SPARSE_IMAGE
 
+#ifdef WORKER_THREAD
+#undef WORKER_THREAD
+#undef CT_NO_TIMING
+#endif
+
 #ifdef PADDING
 #undef PADDING
 #undef SPACE_BOTTOM
@@ -24,7 +24,8 @@
  *              variable holding it.
  *      CT_ACTIVE() - provides a true value if the current pixel is active.
  *      CT_WRITE_PIXEL(pointer) - writes the current pixel to the pointer and
- *              increments the pointer.
+ *              increments the pointer.  Not needed if CT_COUNT_RUN is
+ *              defined.
  *      CT_INCREMENT_PIXEL() - Increments to the next input pixel.
  *
  * The following macros are optional:
@@ -32,6 +33,24 @@
  *              around the file.  If defined, then CT_SPACE_BOTTOM,
  *              CT_SPACE_TOP, CT_SPACE_LEFT, CT_SPACE_RIGHT, CT_FULL_WIDTH,
  *              and CT_FULL_HEIGHT must all also be defined.
+ *      CT_COUNT_RUN(count, active) - If defined, returns how many of the
+ *              next count pixels (which are contiguous in memory) are active
+ *              (or inactive if active is false), stopping at the first that
+ *              is not.  This lets whole runs be found with vector
+ *              instructions rather than testing CT_ACTIVE() on each pixel.
+ *              If defined, then CT_WRITE_PIXELS and CT_INCREMENT_PIXELS must
+ *              also be defined.
+ *      CT_WRITE_PIXELS(pointer, count) - writes count pixels to the pointer
+ *              and increments the pointer.  Images with both color and depth
+ *              write only colors here and stage the depths themselves (see
+ *              icetSparseImageAppendDepths).
+ *      CT_INCREMENT_PIXELS(count) - Increments count input pixels.
+ *      CT_NO_TIMING - If defined, compression time is not recorded.  Unlike
+ *              the other macros, this one is left defined.
+ *      CT_CONTIGUOUS_PIXELS - If defined, the number of pixels left before
+ *              CT_INCREMENT_PIXEL() jumps in memory (for example, at the end
+ *              of a row in a region).  Runs passed to CT_COUNT_RUN do not
+ *              cross this point.
  *
  * All of the above macros are undefined at the end of this file.
  */
@@ -66,6 +85,21 @@
 #pragma warning(disable:4127)
 #endif
 
+#ifdef CT_COUNT_RUN
+#ifndef CT_WRITE_PIXELS
+#error Need CT_WRITE_PIXELS macro with CT_COUNT_RUN.
+#endif
+#ifndef CT_INCREMENT_PIXELS
+#error Need CT_INCREMENT_PIXELS macro with CT_COUNT_RUN.
+#endif
+#ifdef CT_CONTIGUOUS_PIXELS
+#define CT_RUN_LIMIT(remaining)                                         \
+    (((remaining) < (CT_CONTIGUOUS_PIXELS)) ? (remaining) : (CT_CONTIGUOUS_PIXELS))
+#else
+#define CT_RUN_LIMIT(remaining) (remaining)
+#endif
+#endif
+
 {
   IceTByte *_dest;  /* Use IceTByte for byte-based pointer arithmetic. */
     IceTSizeType _pixels = CT_PIXEL_COUNT;
@@ -76,7 +110,9 @@
 #endif
     IceTSizeType _compressed_size;
 
+#ifndef CT_NO_TIMING
     icetTimingCompressBegin();
+#endif
 
     _dest = ICET_IMAGE_DATA(CT_COMPRESSED_IMAGE);
 
@@ -94,11 +130,22 @@
             _count += CT_SPACE_LEFT;
             while (ICET_TRUE) {
                 IceTVoid *_runlengths;
+#ifdef CT_COUNT_RUN
+                while (_x < _lastx) {
+                    IceTSizeType _limit = CT_RUN_LIMIT(_lastx - _x);
+                    IceTSizeType _run = CT_COUNT_RUN(_limit, ICET_FALSE);
+                    CT_INCREMENT_PIXELS(_run);
+                    _x += _run;
+                    _count += _run;
+                    if (_run < _limit) break;
+                }
+#else /* CT_COUNT_RUN */
                 while ((_x < _lastx) && (!CT_ACTIVE())) {
                     _x++;
                     _count++;
                     CT_INCREMENT_PIXEL();
                 }
+#endif /* CT_COUNT_RUN */
                 if (_x >= _lastx) break;
                 _runlengths = _dest;
                 _dest += RUN_LENGTH_SIZE;
@@ -107,12 +154,24 @@
                 _totalcount += _count;
 #endif
                 _count = 0;
+#ifdef CT_COUNT_RUN
+                while (_x < _lastx) {
+                    IceTSizeType _limit = CT_RUN_LIMIT(_lastx - _x);
+                    IceTSizeType _run = CT_COUNT_RUN(_limit, ICET_TRUE);
+                    CT_WRITE_PIXELS(_dest, _run);
+                    CT_INCREMENT_PIXELS(_run);
+                    _x += _run;
+                    _count += _run;
+                    if (_run < _limit) break;
+                }
+#else /* CT_COUNT_RUN */
                 while ((_x < _lastx) && CT_ACTIVE()) {
                     CT_WRITE_PIXEL(_dest);
                     CT_INCREMENT_PIXEL();
                     _count++;
                     _x++;
                 }
+#endif /* CT_COUNT_RUN */
                 ACTIVE_RUN_LENGTH(_runlengths) = _count;
 #ifdef DEBUG
                 _totalcount += _count;
@@ -131,11 +190,22 @@
             IceTVoid *_runlengths = _dest;
             _dest += RUN_LENGTH_SIZE;
           /* Count background pixels. */
+#ifdef CT_COUNT_RUN
+            while (_p < _pixels) {
+                IceTSizeType _limit = CT_RUN_LIMIT(_pixels - _p);
+                IceTSizeType _run = CT_COUNT_RUN(_limit, ICET_FALSE);
+                CT_INCREMENT_PIXELS(_run);
+                _p += _run;
+                _count += _run;
+                if (_run < _limit) break;
+            }
+#else /* CT_COUNT_RUN */
             while ((_p < _pixels) && (!CT_ACTIVE())) {
                 _p++;
                 _count++;
                 CT_INCREMENT_PIXEL();
             }
+#endif /* CT_COUNT_RUN */
             INACTIVE_RUN_LENGTH(_runlengths) = _count;
 #ifdef DEBUG
             _totalcount += _count;
@@ -143,12 +213,24 @@
 
           /* Count and store active pixels. */
             _count = 0;
+#ifdef CT_COUNT_RUN
+            while (_p < _pixels) {
+                IceTSizeType _limit = CT_RUN_LIMIT(_pixels - _p);
+                IceTSizeType _run = CT_COUNT_RUN(_limit, ICET_TRUE);
+                CT_WRITE_PIXELS(_dest, _run);
+                CT_INCREMENT_PIXELS(_run);
+                _p += _run;
+                _count += _run;
+                if (_run < _limit) break;
+            }
+#else /* CT_COUNT_RUN */
             while ((_p < _pixels) && CT_ACTIVE()) {
                 CT_WRITE_PIXEL(_dest);
                 CT_INCREMENT_PIXEL();
                 _count++;
                 _p++;
             }
+#endif /* CT_COUNT_RUN */
             ACTIVE_RUN_LENGTH(_runlengths) = _count;
 #ifdef DEBUG
             _totalcount += _count;
@@ -184,14 +266,20 @@
     }
 #endif /*DEBUG*/
 
+#ifndef CT_NO_TIMING
     icetTimingCompressEnd();
+#endif
 
     _compressed_size
         = (IceTSizeType)
             (  (IceTPointerArithmetic)_dest
              - (IceTPointerArithmetic)ICET_IMAGE_HEADER(CT_COMPRESSED_IMAGE));
-    ICET_IMAGE_HEADER(CT_COMPRESSED_IMAGE)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
-      = (IceTInt)_compressed_size;
+    ICET_IMAGE_SIZE_HEADER(CT_COMPRESSED_IMAGE)
+        [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] = _compressed_size;
+    ICET_IMAGE_SIZE_HEADER(CT_COMPRESSED_IMAGE)
+        [ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+    ICET_IMAGE_SIZE_HEADER(CT_COMPRESSED_IMAGE)
+        [ICET_IMAGE_DEPTH_PLANE_INDEX] = 0;
 }
 
 #ifdef _MSC_VER
@@ -207,6 +295,16 @@
 #undef CT_INCREMENT_PIXEL
 #undef COMPRESSED_SIZE
 
+#ifdef CT_COUNT_RUN
+#undef CT_COUNT_RUN
+#undef CT_WRITE_PIXELS
+#undef CT_INCREMENT_PIXELS
+#undef CT_RUN_LIMIT
+#endif
+#ifdef CT_CONTIGUOUS_PIXELS
+#undef CT_CONTIGUOUS_PIXELS
+#endif
+
 #ifdef CT_PADDING
 #undef CT_PADDING
 #undef CT_SPACE_BOTTOM
@@ -13,6 +13,7 @@
 
 #include <IceTDevDiagnostics.h>
 #include <IceTDevImage.h>
+#include <IceTDevPorting.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -23,9 +24,10 @@ struct IceTContextStruct {
     IceTEnum magic_number;
     IceTState state;
     IceTCommunicator communicator;
+    IceTThreadPool thread_pool;
 };
 
-static IceTContext icet_current_context = NULL;
+ICET_THREAD_LOCAL IceTContext icet_current_context = NULL;
 
 IceTContext icetCreateContext(IceTCommunicator comm)
 {
@@ -41,6 +43,8 @@ IceTContext icetCreateContext(IceTCommunicator comm)
 
     context->communicator = comm->Duplicate(comm);
 
+    context->thread_pool = NULL;
+
     context->state = icetStateCreate();
 
     icetSetContext(context);
@@ -78,6 +82,9 @@ void icetDestroyContext(IceTContext context)
   /* Call destructors for other dependent units. */
     callDestructor(ICET_RENDER_LAYER_DESTRUCTOR);
 
+    icetDestroyThreadPool(context->thread_pool);
+    context->thread_pool = NULL;
+
   /* From here on out be careful.  We are invalidating the context. */
     context->magic_number = 0;
 
@@ -117,6 +124,16 @@ IceTCommunicator icetGetCommunicator()
     return icet_current_context->communicator;
 }
 
+IceTThreadPool icetGetThreadPool()
+{
+    return icet_current_context->thread_pool;
+}
+
+void icetSetThreadPool(IceTThreadPool pool)
+{
+    icet_current_context->thread_pool = pool;
+}
+
 void icetCopyState(IceTContext dest, const IceTContext src)
 {
     icetStateCopy(dest->state, src->state);
@@ -34,6 +34,11 @@
  *                      values.
  *              BLEND_RGBA_FLOAT(src, dest) - same as above except src and dest
  *                      are IceTFloat arrays.
+ *              BLEND_RGBA_HALF(src, dest, count) - same as above except src
+ *                      and dest are IceTUShort arrays of half precision values
+ *                      holding count pixels.
+ *              The blend macros are not used in additive mode, which does not
+ *              depend on order.
  *	CORRECT_BACKGROUND - if defined, the output color will be blended
  *		with the true background color.  This should only be set
  *		if ICET_NEED_BACKGROUND_CORRECTION is true.
@@ -101,8 +106,18 @@
     }
 #endif
 
-    if (_composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
-        if (_depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+    if (   (_composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER)
+#ifndef COMPOSITE
+           /* Plain decompression is the same for z-buffer, additive,
+              maximum, and minimum images with depth.  Only compositing
+              differs. */
+        || (   reductionCompositeMode(_composite_mode)
+            && (_depth_format != ICET_IMAGE_DEPTH_NONE) )
+#endif
+           ) {
+        if (   (_depth_format == ICET_IMAGE_DEPTH_FLOAT)
+            && (   (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                || (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
           /* Use Z buffer for active pixel testing and compositing. */
             IceTFloat *_depth = icetImageGetDepthf(OUTPUT_IMAGE);
 #ifdef OFFSET
@@ -110,7 +125,6 @@
 #endif
             if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
                 IceTUInt *_color;
-                const IceTUInt *_c_in;
                 const IceTFloat *_d_in;
                 IceTUInt _background_color;
                 _color = icetImageGetColorui(OUTPUT_IMAGE);
@@ -119,25 +133,28 @@
 #endif
                 icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,
                                 (IceTInt *)&_background_color);
+                _d_in = (const IceTFloat *)
+                    icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
 #ifdef COMPOSITE
-#define COPY_PIXEL(c_src, c_dest, d_src, d_dest)                \
-                                if (d_src[0] < d_dest[0]) {     \
-                                    c_dest[0] = c_src[0];       \
-                                    d_dest[0] = d_src[0];       \
-                                }
+#define COPY_PIXELS(c_src, count)                                       \
+                                icetSIMDZBufferUByte((const IceTUInt *)c_src, \
+                                                     _d_in,             \
+                                                     _color,            \
+                                                     _depth,            \
+                                                     count);
 #else
-#define COPY_PIXEL(c_src, c_dest, d_src, d_dest)                \
-                                c_dest[0] = c_src[0];           \
-                                d_dest[0] = d_src[0];
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       (count)*sizeof(IceTUInt));       \
+                                memcpy(_depth, _d_in,                   \
+                                       (count)*sizeof(IceTFloat));
 #endif
 #define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
-#define DT_READ_PIXEL(src)      _c_in = (IceTUInt *)src;        \
-                                src += sizeof(IceTUInt);        \
-                                _d_in = (IceTFloat *)src;       \
-                                src += sizeof(IceTFloat);       \
-                                COPY_PIXEL(_c_in, _color,       \
-                                           _d_in, _depth);      \
-                                _color++;  _depth++;
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += (count)*sizeof(IceTUInt);        \
+                                _d_in += (count);                       \
+                                _color += (count);  _depth += (count);
 #ifdef COMPOSITE
 #define DT_INCREMENT_INACTIVE_PIXELS(count) _color += count;  _depth += count;
 #else
@@ -151,10 +168,9 @@
                                 }
 #endif
 #include "decompress_template_body.h"
-#undef COPY_PIXEL
+#undef COPY_PIXELS
             } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
                 IceTFloat *_color;
-                const IceTFloat *_c_in;
                 const IceTFloat *_d_in;
                 IceTFloat _background_color[4];
                 _color = icetImageGetColorf(OUTPUT_IMAGE);
@@ -162,31 +178,28 @@
                 _color += 4*(OFFSET);
 #endif
                 icetGetFloatv(ICET_BACKGROUND_COLOR, _background_color);
+                _d_in = (const IceTFloat *)
+                    icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
 #ifdef COMPOSITE
-#define COPY_PIXEL(c_src, c_dest, d_src, d_dest)                \
-                                if (d_src[0] < d_dest[0]) {     \
-                                    c_dest[0] = c_src[0];       \
-                                    c_dest[1] = c_src[1];       \
-                                    c_dest[2] = c_src[2];       \
-                                    c_dest[3] = c_src[3];       \
-                                    d_dest[0] = d_src[0];       \
-                                }
+#define COPY_PIXELS(c_src, count)                                       \
+                                icetSIMDZBufferFloat((const IceTFloat *)c_src,\
+                                                     _d_in,             \
+                                                     _color,            \
+                                                     _depth,            \
+                                                     count);
 #else
-#define COPY_PIXEL(c_src, c_dest, d_src, d_dest)                \
-                                c_dest[0] = c_src[0];           \
-                                c_dest[1] = c_src[1];           \
-                                c_dest[2] = c_src[2];           \
-                                c_dest[3] = c_src[3];           \
-                                d_dest[0] = d_src[0];
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       4*(count)*sizeof(IceTFloat));    \
+                                memcpy(_depth, _d_in,                   \
+                                       (count)*sizeof(IceTFloat));
 #endif
 #define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
-#define DT_READ_PIXEL(src)      _c_in = (IceTFloat *)src;       \
-                                src += 4*sizeof(IceTFloat);     \
-                                _d_in = (IceTFloat *)src;       \
-                                src += sizeof(IceTFloat);       \
-                                COPY_PIXEL(_c_in, _color,       \
-                                           _d_in, _depth);      \
-                                _color += 4;  _depth++;
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += 4*(count)*sizeof(IceTFloat);     \
+                                _d_in += (count);                       \
+                                _color += 4*(count);  _depth += (count);
 #ifdef COMPOSITE
 #define DT_INCREMENT_INACTIVE_PIXELS(count) _color += 4*count;  _depth += count;
 #else
@@ -204,46 +217,91 @@
                                 }
 #endif
 #include "decompress_template_body.h"
-#undef COPY_PIXEL
-            } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
-                const IceTFloat *_d_in;
+#undef COPY_PIXELS
+            }
+        } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
+            icetRaiseError("Cannot use Z buffer compositing operation with no"
+                           " Z buffer.", ICET_INVALID_OPERATION);
+        } else {
+          /* Any other depth format (or float depth without color).  Pixels are
+             copied as bytes and depths compared with the helpers in image.c. */
+            IceTByte *_color;
+            IceTByte *_depth;
+            const IceTByte *_d_in;
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+#ifndef COMPOSITE
+            IceTFloat _background_color[4];
+            /* The accumulation formats are too big for _background_color.
+               Their inactive pixels are zero, as are those of counts. */
+            IceTBoolean _zero_inactive
+                = zeroInactiveColorFormat(_color_format);
+#endif
+            _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+            _depth = icetImageGetDepthVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += _color_size*(OFFSET);
+            _depth += _depth_size*(OFFSET);
+#endif
+#ifndef COMPOSITE
+            if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,
+                                (IceTInt *)_background_color);
+            } else if (   (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+                       || (scalarColorChannels(_color_format) > 0) ) {
+                icetGetFloatv(ICET_BACKGROUND_COLOR, _background_color);
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+                getBackgroundColorHalf(ICET_BACKGROUND_COLOR,
+                                       (IceTUShort *)_background_color);
+            }
+#endif
+            _d_in = icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
 #ifdef COMPOSITE
-#define COPY_PIXEL(d_src, d_dest)                               \
-                                if (d_src[0] < d_dest[0]) {     \
-                                    d_dest[0] = d_src[0];       \
-                                }
+#define COPY_PIXELS(c_src, count)                                       \
+                                depthZBufferPixels(_color_format,       \
+                                                   _depth_format,       \
+                                                   c_src, _d_in,        \
+                                                   _color, _depth,      \
+                                                   count);
 #else
-#define COPY_PIXEL(d_src, d_dest)                               \
-                                d_dest[0] = d_src[0];
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       (count)*_color_size);            \
+                                memcpy(_depth, _d_in,                   \
+                                       (count)*_depth_size);
 #endif
 #define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
-#define DT_READ_PIXEL(src)      _d_in = (IceTFloat *)src;       \
-                                src += sizeof(IceTFloat);       \
-                                COPY_PIXEL(_d_in, _depth);      \
-                                _depth++;
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += (count)*_color_size;             \
+                                _d_in += (count)*_depth_size;           \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
 #ifdef COMPOSITE
-#define DT_INCREMENT_INACTIVE_PIXELS(count) _depth += count;
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
 #else
 #define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
-                                {                                       \
+                                if (_zero_inactive) {                   \
+                                    memset(_color, 0,                   \
+                                           (count)*_color_size);        \
+                                    _color += (count)*_color_size;      \
+                                } else {                                \
                                     IceTSizeType __i;                   \
                                     for (__i = 0; __i < count; __i++) { \
-                                        *(_depth++) = 1.0f;             \
+                                        memcpy(_color,                  \
+                                               _background_color,       \
+                                               _color_size);            \
+                                        _color += _color_size;          \
                                     }                                   \
-                                }
+                                }                                       \
+                                depthFillInactive(_depth_format,        \
+                                                  _depth, count);       \
+                                _depth += (count)*_depth_size;
 #endif
 #include "decompress_template_body.h"
-#undef COPY_PIXEL
-            } else {
-                icetRaiseError("Encountered invalid color format.",
-                               ICET_SANITY_CHECK_FAIL);
-            }
-        } else if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
-            icetRaiseError("Cannot use Z buffer compositing operation with no"
-                           " Z buffer.", ICET_INVALID_OPERATION);
-        } else {
-            icetRaiseError("Encountered invalid depth format.",
-                           ICET_SANITY_CHECK_FAIL);
+#undef COPY_PIXELS
         }
     } else if (_composite_mode == ICET_COMPOSITE_MODE_BLEND) {
       /* Use alpha for active pixel and compositing. */
@@ -344,6 +402,62 @@
 #endif
 #include "decompress_template_body.h"
 #undef COPY_PIXEL
+        } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+            IceTUShort *_color;
+#ifndef COMPOSITE
+            IceTUShort _background_color[4];
+#endif
+            _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += 4*(OFFSET);
+#endif
+#ifdef CORRECT_BACKGROUND
+            getBackgroundColorHalf(ICET_TRUE_BACKGROUND_COLOR,
+                                   _background_color);
+#elif !defined(COMPOSITE)
+            getBackgroundColorHalf(ICET_BACKGROUND_COLOR, _background_color);
+#endif
+#ifdef COMPOSITE
+#define COPY_PIXELS(c_src, count)                                       \
+                                BLEND_RGBA_HALF((const IceTUShort *)c_src, \
+                                                _color, count);
+#elif defined(CORRECT_BACKGROUND)
+#define COPY_PIXELS(c_src, count)                                       \
+                                {                                       \
+                                    const IceTUShort *__s;              \
+                                    IceTSizeType __i;                   \
+                                    __s = (const IceTUShort *)c_src;    \
+                                    for (__i = 0; __i < count; __i++) { \
+                                        icetSIMDBlendHalf(__s + 4*__i,  \
+                                                          _background_color, \
+                                                          _color + 4*__i, \
+                                                          1);           \
+                                    }                                   \
+                                }
+#else
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       4*(count)*sizeof(IceTUShort));
+#endif
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += 4*(count)*sizeof(IceTUShort);    \
+                                _color += 4*(count);
+#ifdef COMPOSITE
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += 4*count;
+#else
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                colorFillHalf(_color,                   \
+                                              _background_color,        \
+                                              count);                   \
+                                _color += 4*count;
+#endif
+#include "decompress_template_body.h"
+#undef COPY_PIXELS
+        } else if (addOnlyColorFormat(_color_format)) {
+            icetRaiseError("Cannot blend colors without an alpha channel.",
+                           ICET_INVALID_OPERATION);
         } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
             icetRaiseWarning("Decompressing image with no data.",
                              ICET_INVALID_OPERATION);
@@ -351,6 +465,343 @@
             icetRaiseError("Encountered invalid color format.",
                            ICET_SANITY_CHECK_FAIL);
         }
+#ifdef COMPOSITE
+    } else if (   (_composite_mode == ICET_COMPOSITE_MODE_MAX)
+               || (_composite_mode == ICET_COMPOSITE_MODE_MIN) ) {
+      /* Pixels are handled as bytes with the helpers in image.c, which
+         only compare the channels of pixels active in both images. */
+        IceTByte *_color;
+        IceTSizeType _color_size = colorPixelSize(_color_format);
+        _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+        _color += _color_size*(OFFSET);
+#endif
+        if (_depth_format != ICET_IMAGE_DEPTH_NONE) {
+            IceTByte *_depth;
+            const IceTByte *_d_in;
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+            _depth = icetImageGetDepthVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _depth += _depth_size*(OFFSET);
+#endif
+            _d_in = icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                depthReducePixels(_composite_mode,      \
+                                                  _color_format,        \
+                                                  _depth_format,        \
+                                                  src, _d_in,           \
+                                                  _color, _depth,       \
+                                                  count);               \
+                                src += (count)*_color_size;             \
+                                _d_in += (count)*_depth_size;           \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
+#include "decompress_template_body.h"
+        } else if (_color_format != ICET_IMAGE_COLOR_NONE) {
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                colorExtremumPixels(_composite_mode,    \
+                                                    _color_format,      \
+                                                    src, _color,        \
+                                                    count);             \
+                                src += (count)*_color_size;             \
+                                _color += (count)*_color_size;
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                _color += (count)*_color_size;
+#include "decompress_template_body.h"
+        } else {
+            icetRaiseWarning("Decompressing image with no data.",
+                             ICET_INVALID_OPERATION);
+        }
+#endif /* COMPOSITE */
+    } else if (reductionCompositeMode(_composite_mode)) {
+        /* When compositing, only ICET_COMPOSITE_MODE_ADD gets here.  Plain
+           decompression is the same for all the modes. */
+        if (_depth_format == ICET_IMAGE_DEPTH_NONE) {
+          /* Without depth, inactive pixels have zero color and contribute
+             nothing to the sum. */
+            if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                IceTUInt *_color;
+                const IceTUInt *_c_in;
+                IceTUInt _background_color;
+                _color = icetImageGetColorui(OUTPUT_IMAGE);
+#ifdef OFFSET
+                _color += OFFSET;
+#endif
+#ifdef CORRECT_BACKGROUND
+                icetGetIntegerv(ICET_TRUE_BACKGROUND_COLOR_WORD,
+                                (IceTInt *)&_background_color);
+#else
+                icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,
+                                (IceTInt *)&_background_color);
+#endif
+#ifdef COMPOSITE
+#define COPY_PIXEL(c_src, c_dest)                               \
+                ICET_ADD_UBYTE(((IceTUByte*)c_src),             \
+                               ((IceTUByte*)c_dest),            \
+                               ((IceTUByte*)c_dest))
+#else
+#define COPY_PIXEL(c_src, c_dest) \
+                c_dest[0] = c_src[0];
+#endif
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXEL(src)      _c_in = (IceTUInt *)src;        \
+                                src += sizeof(IceTUInt);        \
+                                COPY_PIXEL(_c_in, _color);      \
+                                _color++;
+#ifdef COMPOSITE
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += count;
+#else
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                {                                       \
+                                    IceTSizeType __i;                   \
+                                    for (__i = 0; __i < count; __i++) { \
+                                        *(_color++) = _background_color;\
+                                    }                                   \
+                                }
+#endif
+#include "decompress_template_body.h"
+#undef COPY_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                IceTFloat *_color;
+                const IceTFloat *_c_in;
+                IceTFloat _background_color[4];
+                _color = icetImageGetColorf(OUTPUT_IMAGE);
+#ifdef OFFSET
+                _color += 4*(OFFSET);
+#endif
+#ifdef CORRECT_BACKGROUND
+                icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, _background_color);
+#else
+                icetGetFloatv(ICET_BACKGROUND_COLOR, _background_color);
+#endif
+#ifdef COMPOSITE
+#define COPY_PIXEL(c_src, c_dest) ICET_ADD_FLOAT(c_src, c_dest, c_dest);
+#else
+#define COPY_PIXEL(c_src, c_dest)                               \
+                                c_dest[0] = c_src[0];           \
+                                c_dest[1] = c_src[1];           \
+                                c_dest[2] = c_src[2];           \
+                                c_dest[3] = c_src[3];
+#endif
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXEL(src)      _c_in = (IceTFloat *)src;       \
+                                src += 4*sizeof(IceTFloat);     \
+                                COPY_PIXEL(_c_in, _color);      \
+                                _color += 4;
+#ifdef COMPOSITE
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += 4*count;
+#else
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                {                                       \
+                                    IceTSizeType __i;                   \
+                                    for (__i = 0; __i < count; __i++) { \
+                                        _color[0] =_background_color[0];\
+                                        _color[1] =_background_color[1];\
+                                        _color[2] =_background_color[2];\
+                                        _color[3] =_background_color[3];\
+                                        _color += 4;                    \
+                                    }                                   \
+                                }
+#endif
+#include "decompress_template_body.h"
+#undef COPY_PIXEL
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+                IceTUShort *_color;
+#ifndef COMPOSITE
+                IceTUShort _background_color[4];
+#endif
+                _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+                _color += 4*(OFFSET);
+#endif
+#ifdef CORRECT_BACKGROUND
+                getBackgroundColorHalf(ICET_TRUE_BACKGROUND_COLOR,
+                                       _background_color);
+#elif !defined(COMPOSITE)
+                getBackgroundColorHalf(ICET_BACKGROUND_COLOR,
+                                       _background_color);
+#endif
+#ifdef COMPOSITE
+#define COPY_PIXELS(c_src, count)                                       \
+                                icetSIMDAddHalf((const IceTUShort *)c_src, \
+                                                _color, _color, count);
+#else
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       4*(count)*sizeof(IceTUShort));
+#endif
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += 4*(count)*sizeof(IceTUShort);    \
+                                _color += 4*(count);
+#ifdef COMPOSITE
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += 4*count;
+#else
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                colorFillHalf(_color,                   \
+                                              _background_color,        \
+                                              count);                   \
+                                _color += 4*count;
+#endif
+#include "decompress_template_body.h"
+#undef COPY_PIXELS
+            } else if (addOnlyColorFormat(_color_format)) {
+                /* Use IceTByte for byte-based pointer arithmetic. */
+                IceTByte *_color;
+                IceTSizeType _color_size = colorPixelSize(_color_format);
+#ifndef COMPOSITE
+                IceTFloat _background_color[4];
+#endif
+                _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+                _color += _color_size*(OFFSET);
+#endif
+#ifdef CORRECT_BACKGROUND
+                icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, _background_color);
+#elif !defined(COMPOSITE)
+                icetGetFloatv(ICET_BACKGROUND_COLOR, _background_color);
+#endif
+#ifdef COMPOSITE
+#define COPY_PIXELS(c_src, count)                                       \
+                                colorAddValues(_color_format, c_src,    \
+                                               _color, _color, count);
+#else
+#define COPY_PIXELS(c_src, count)                                       \
+                                memcpy(_color, c_src,                   \
+                                       (count)*_color_size);
+#endif
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                COPY_PIXELS(src, count);                \
+                                src += (count)*_color_size;             \
+                                _color += (count)*_color_size;
+#ifdef COMPOSITE
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += (count)*_color_size;
+#else
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                colorFillValues(_color_format,          \
+                                                _color,                 \
+                                                _background_color,      \
+                                                count);                 \
+                                _color += (count)*_color_size;
+#endif
+#include "decompress_template_body.h"
+#undef COPY_PIXELS
+            } else if (_color_format == ICET_IMAGE_COLOR_NONE) {
+                icetRaiseWarning("Decompressing image with no data.",
+                                 ICET_INVALID_OPERATION);
+            } else {
+                icetRaiseError("Encountered invalid color format.",
+                               ICET_SANITY_CHECK_FAIL);
+            }
+#ifdef COMPOSITE
+        } else if (   (_depth_format == ICET_IMAGE_DEPTH_FLOAT)
+                   && (   (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                       || (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
+          /* Use Z buffer for active pixel testing.  Colors of pixels active
+             in both images are summed and the nearest depth is kept. */
+            IceTFloat *_depth = icetImageGetDepthf(OUTPUT_IMAGE);
+#ifdef OFFSET
+            _depth += OFFSET;
+#endif
+            if (_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                IceTUInt *_color;
+                const IceTUInt *_c_in;
+                const IceTFloat *_d_in;
+                _color = icetImageGetColorui(OUTPUT_IMAGE);
+#ifdef OFFSET
+                _color += OFFSET;
+#endif
+                _d_in = (const IceTFloat *)
+                    icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXEL(src)      _c_in = (IceTUInt *)src;                \
+                                src += sizeof(IceTUInt);                \
+                                if (_depth[0] < 1.0f) {                 \
+                                    ICET_ADD_UBYTE((IceTUByte *)_c_in,  \
+                                                   (IceTUByte *)_color, \
+                                                   (IceTUByte *)_color);\
+                                    if (_d_in[0] < _depth[0]) {         \
+                                        _depth[0] = _d_in[0];           \
+                                    }                                   \
+                                } else {                                \
+                                    _color[0] = _c_in[0];               \
+                                    _depth[0] = _d_in[0];               \
+                                }                                       \
+                                _color++;  _depth++;  _d_in++;
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += count;  _depth += count;
+#include "decompress_template_body.h"
+            } else if (_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                IceTFloat *_color;
+                const IceTFloat *_c_in;
+                const IceTFloat *_d_in;
+                _color = icetImageGetColorf(OUTPUT_IMAGE);
+#ifdef OFFSET
+                _color += 4*(OFFSET);
+#endif
+                _d_in = (const IceTFloat *)
+                    icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXEL(src)      _c_in = (IceTFloat *)src;               \
+                                src += 4*sizeof(IceTFloat);             \
+                                if (_depth[0] < 1.0f) {                 \
+                                    ICET_ADD_FLOAT(_c_in, _color, _color);\
+                                    if (_d_in[0] < _depth[0]) {         \
+                                        _depth[0] = _d_in[0];           \
+                                    }                                   \
+                                } else {                                \
+                                    _color[0] = _c_in[0];               \
+                                    _color[1] = _c_in[1];               \
+                                    _color[2] = _c_in[2];               \
+                                    _color[3] = _c_in[3];               \
+                                    _depth[0] = _d_in[0];               \
+                                }                                       \
+                                _color += 4;  _depth++;  _d_in++;
+#define DT_INCREMENT_INACTIVE_PIXELS(count) _color += 4*count;  _depth += count;
+#include "decompress_template_body.h"
+            }
+        } else {
+          /* Any other depth format (or float depth without color). */
+            IceTByte *_color;
+            IceTByte *_depth;
+            const IceTByte *_d_in;
+            IceTSizeType _color_size = colorPixelSize(_color_format);
+            IceTSizeType _depth_size = depthPixelSize(_depth_format);
+            _color = icetImageGetColorVoid(OUTPUT_IMAGE, NULL);
+            _depth = icetImageGetDepthVoid(OUTPUT_IMAGE, NULL);
+#ifdef OFFSET
+            _color += _color_size*(OFFSET);
+            _depth += _depth_size*(OFFSET);
+#endif
+            _d_in = icetSparseImageGetDepthPlane(INPUT_SPARSE_IMAGE);
+#define DT_COMPRESSED_IMAGE     INPUT_SPARSE_IMAGE
+#define DT_READ_PIXELS(src, count)                                      \
+                                depthReducePixels(_composite_mode,      \
+                                                  _color_format,        \
+                                                  _depth_format,        \
+                                                  src, _d_in,           \
+                                                  _color, _depth,       \
+                                                  count);               \
+                                src += (count)*_color_size;             \
+                                _d_in += (count)*_depth_size;           \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
+#define DT_INCREMENT_INACTIVE_PIXELS(count)                             \
+                                _color += (count)*_color_size;          \
+                                _depth += (count)*_depth_size;
+#include "decompress_template_body.h"
+#else /* COMPOSITE */
+        } else {
+            icetRaiseError("Encountered invalid depth format.",
+                           ICET_SANITY_CHECK_FAIL);
+#endif /* COMPOSITE */
+        }
     } else {
         icetRaiseError("Encountered invalid composite mode.",
                        ICET_SANITY_CHECK_FAIL);
@@ -368,10 +819,15 @@
 #undef TIME_DECOMPRESSION
 #endif
 
+#ifdef CORRECT_BACKGROUND
+#undef CORRECT_BACKGROUND
+#endif
+
 #ifdef COMPOSITE
 #undef COMPOSITE
 #undef BLEND_RGBA_UBYTE
 #undef BLEND_RGBA_FLOAT
+#undef BLEND_RGBA_HALF
 #endif
 
 #ifdef OFFSET
@@ -21,6 +21,11 @@
  *	DT_INCREMENT_INACTIVE_PIXELS(count) - Increments over count pixels,
  *		setting them all to appropriate inactive values.
  *
+ * The following macros are optional:
+ *	DT_READ_PIXELS(pointer, count) - reads count pixels from the pointer
+ *		and increments the pointer.  If defined, used in place of
+ *		DT_READ_PIXEL for whole active runs.
+ *
  * All of the above macros are undefined at the end of this file.
  */
 
@@ -67,12 +72,18 @@
 	    icetRaiseError("Corrupt compressed image.", ICET_INVALID_VALUE);
 	    break;
 	}
+#ifdef DT_READ_PIXELS
+	(void)_i;
+	DT_READ_PIXELS(_src, _rl);
+#else
 	for (_i = 0; _i < _rl; _i++) {
 	    DT_READ_PIXEL(_src);
 	}
+#endif
     }
 }
 
 #undef DT_COMPRESSED_IMAGE
 #undef DT_READ_PIXEL
+#undef DT_READ_PIXELS
 #undef DT_INCREMENT_INACTIVE_PIXELS
@@ -13,6 +13,7 @@
 
 #include <IceTDevCommunication.h>
 #include <IceTDevContext.h>
+#include <IceTDevPorting.h>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -24,16 +25,16 @@
 #include <unistd.h>
 #endif
 
-static IceTEnum currentError = ICET_NO_ERROR;
-static IceTEnum currentLevel;
+ICET_THREAD_LOCAL IceTEnum currentError = ICET_NO_ERROR;
+ICET_THREAD_LOCAL IceTEnum currentLevel;
 
 void icetRaiseDiagnostic(const char *msg, IceTEnum type,
                          IceTBitField level, const char *file, int line)
 {
-    static int raisingDiagnostic = 0;
+    ICET_THREAD_LOCAL int raisingDiagnostic = 0;
     IceTBitField diagLevel;
     IceTInt tmpInt;
-    static char full_message[1024];
+    ICET_THREAD_LOCAL char full_message[1024];
     char *m;
     int rank;
 
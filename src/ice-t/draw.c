@@ -77,7 +77,10 @@ const char *icetGetSingleImageStrategyName(void)
 void icetCompositeMode(IceTEnum mode)
 {
     if (    (mode != ICET_COMPOSITE_MODE_Z_BUFFER)
-         && (mode != ICET_COMPOSITE_MODE_BLEND) ) {
+         && (mode != ICET_COMPOSITE_MODE_BLEND)
+         && (mode != ICET_COMPOSITE_MODE_ADD)
+         && (mode != ICET_COMPOSITE_MODE_MAX)
+         && (mode != ICET_COMPOSITE_MODE_MIN) ) {
         icetRaiseError("Invalid composite mode.", ICET_INVALID_ENUM);
         return;
     }
@@ -204,9 +207,21 @@ static IceTFloat black[] = {0.0f, 0.0f, 0.0f, 0.0f};
 static void drawUseBackgroundColor(const IceTFloat *background_color)
 {
     IceTUInt background_color_word;
-    IceTBoolean use_color_blending
-        = (IceTBoolean)(   *(icetUnsafeStateGetInteger(ICET_COMPOSITE_MODE))
-                        == ICET_COMPOSITE_MODE_BLEND);
+    IceTEnum composite_mode;
+    IceTEnum depth_format;
+    IceTBoolean use_color_blending;
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    /* Additive, maximum, and minimum compositing without a depth buffer
+       find active pixels by their color, so like blending they need a zero
+       background. */
+    use_color_blending = (IceTBoolean)(
+             (composite_mode == ICET_COMPOSITE_MODE_BLEND)
+          || (   (   (composite_mode == ICET_COMPOSITE_MODE_ADD)
+                  || (composite_mode == ICET_COMPOSITE_MODE_MAX)
+                  || (composite_mode == ICET_COMPOSITE_MODE_MIN) )
+              && (depth_format == ICET_IMAGE_DEPTH_NONE) ) );
 
     ((IceTUByte *)&background_color_word)[0]
         = (IceTUByte)(255*background_color[0]);
@@ -735,6 +750,8 @@ static IceTImage drawInvokeStrategy(void)
     IceTEnum strategy;
     IceTInt display_tile;
     IceTInt valid_tile;
+    IceTEnum color_format;
+    IceTEnum accumulation_format;
 
     icetGetPointerv(ICET_DRAW_FUNCTION, &value);
     if (   (value == NULL)
@@ -744,6 +761,15 @@ static IceTImage drawInvokeStrategy(void)
         return icetImageNull();
     }
 
+    /* Images are rendered in the color format the application set, but the
+       strategy may composite them in a more precise accumulation format.
+       Swapping the format in the state makes all the strategy's buffers use
+       it. */
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    accumulation_format = icetAccumulationColorFormat(color_format);
+    icetStateSetInteger(ICET_RENDER_COLOR_FORMAT, color_format);
+    icetStateSetInteger(ICET_COLOR_FORMAT, accumulation_format);
+
     icetRaiseDebug("Calling strategy");
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 1);
     icetGetEnumv(ICET_STRATEGY, &strategy);
@@ -751,6 +777,11 @@ static IceTImage drawInvokeStrategy(void)
 
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 0);
 
+    icetStateSetInteger(ICET_COLOR_FORMAT, color_format);
+    if (accumulation_format != color_format) {
+        image = icetImageFinishAccumulation(image, color_format);
+    }
+
     /* Ensure that the returned image is the expected size. */
     icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
     icetGetIntegerv(ICET_TILE_DISPLAYED, &display_tile);
@@ -15,8 +15,11 @@
 #include <IceTDevState.h>
 #include <IceTDevDiagnostics.h>
 #include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+#include <IceTDevSIMD.h>
 #include <IceTDevTiming.h>
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,12 +33,22 @@
 #define ICET_IMAGE_WIDTH_INDEX                  3
 #define ICET_IMAGE_HEIGHT_INDEX                 4
 #define ICET_IMAGE_MAX_NUM_PIXELS_INDEX         5
-#define ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX     6
-#define ICET_IMAGE_DATA_START_INDEX             7
+#define ICET_IMAGE_ACTIVE_VIEWPORT_INDEX        6
+
+/* Byte sizes and offsets may not fit in an IceTInt (when IceTSizeType is 64
+   bits), so they are held in IceTSizeType entries following the IceTInt
+   entries.  Get them with ICET_IMAGE_SIZE_HEADER.  The number of each kind
+   of entry and the resulting ICET_IMAGE_HEADER_SIZE are in IceTDevImage.h. */
+#define ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX     0
+#define ICET_IMAGE_SEEK_TABLE_INDEX             1
+#define ICET_IMAGE_DEPTH_PLANE_INDEX            2
+#define ICET_IMAGE_ACTIVE_COUNT_INDEX           3
 
 #define ICET_IMAGE_HEADER(image)        ((IceTInt *)image.opaque_internals)
-#define ICET_IMAGE_DATA(image) \
-    ((IceTVoid *)&(ICET_IMAGE_HEADER(image)[ICET_IMAGE_DATA_START_INDEX]))
+#define ICET_IMAGE_SIZE_HEADER(image)                                   \
+    ((IceTSizeType *)(ICET_IMAGE_HEADER(image) + ICET_IMAGE_NUM_INT_ENTRIES))
+#define ICET_IMAGE_DATA(image)                                          \
+    ((IceTVoid *)((IceTByte *)image.opaque_internals + ICET_IMAGE_HEADER_SIZE))
 
 typedef IceTUnsignedInt32 IceTRunLengthType;
 
@@ -43,6 +56,53 @@ typedef IceTUnsignedInt32 IceTRunLengthType;
 #define ACTIVE_RUN_LENGTH(rl)   (((IceTRunLengthType *)(rl))[1])
 #define RUN_LENGTH_SIZE         ((IceTSizeType)(2*sizeof(IceTRunLengthType)))
 
+/* A sparse image with depth keeps its depths apart from the colors.  The run
+ * lengths are followed by the colors of the active pixels (if any) as in an
+ * image with only color, and the depths of all the active pixels follow this
+ * data in one contiguous depth plane.  (This also keeps the run lengths
+ * aligned for depth formats smaller than a run length.)  The ICET_IMAGE_DEPTH_PLANE_INDEX
+ * header entry holds the byte offset of the plane from the header or 0 if the
+ * image has no depth values (which happens when blending ignores the depth).
+ * The plane is part of the actual buffer size, so it is sent with the image,
+ * and the depth of an image can be dropped by cutting the actual buffer size
+ * back to the start of the plane.  Because the depths of a range of pixels are
+ * contiguous in the plane, they can be copied in bulk, and compositing can
+ * stream through depths without touching colors.
+ *
+ * Functions that write a sparse image with a depth plane write the depths in a
+ * staging area after the largest possible color data (see
+ * icetSparseImageDepthStage) and move them to the end of the color data with
+ * icetSparseImageAppendDepths when done. */
+
+/* A sparse image may have a seek table that records where every
+ * ICET_SPARSE_IMAGE_SEEK_SPACING'th pixel lies in the run lengths.  Each entry
+ * holds the in_data offset (from the start of the image data), inactive before,
+ * and active till next run length values that icetSparseImageScanPixels would
+ * have after scanning that many pixels from the start followed by the offset
+ * of the pixel's depth in the depth plane (if any).  The table sits in the
+ * buffer after the compressed data (so it is not part of the actual buffer
+ * size and is never sent), and the ICET_IMAGE_SEEK_TABLE_INDEX header entry
+ * holds its byte offset from the header or 0 if there is no table.  Anything
+ * that changes the compressed data sets the actual size, which drops the
+ * table. */
+
+/* A sparse image also records how many of its pixels are active in the
+ * ICET_IMAGE_ACTIVE_COUNT_INDEX header entry and the smallest rectangle that
+ * holds them in the four ICET_IMAGE_ACTIVE_VIEWPORT_INDEX entries (x, y,
+ * width, and height, all 0 if no pixel is active).  Unlike the seek table,
+ * these are sent with the image.  Setting the actual size sets the count to
+ * -1 to mark them unknown, and the functions that write sparse images find
+ * them again from the run lengths when done (see
+ * icetSparseImageFindActiveBounds).  Compositing and splitting use them to
+ * skip work on empty images and images whose active pixels do not overlap. */
+#define ICET_SPARSE_IMAGE_SEEK_SPACING  1024
+#define SEEK_TABLE_ENTRY_SIZE   ((IceTSizeType)(4*sizeof(IceTSizeType)))
+#define SEEK_TABLE_SIZE(num_pixels)                                     \
+    (  (IceTSizeType)sizeof(IceTSizeType)                               \
+     + SEEK_TABLE_ENTRY_SIZE                                            \
+       *(  ((num_pixels) + ICET_SPARSE_IMAGE_SEEK_SPACING - 1)          \
+         / ICET_SPARSE_IMAGE_SEEK_SPACING) )
+
 #ifdef DEBUG
 static void ICET_TEST_IMAGE_HEADER(IceTImage image)
 {
@@ -71,6 +131,10 @@ static void ICET_TEST_SPARSE_IMAGE_HEADER(IceTSparseImage image)
 #define ICET_TEST_SPARSE_IMAGE_HEADER(image)
 #endif /*DEBUG*/
 
+/* Number of values converted at a time from half precision when the
+   destination is not float. */
+#define ICET_HALF_CONVERT_CHUNK 1024
+
 #ifndef MIN
 #define MIN(x, y)       ((x) < (y) ? (x) : (y))
 #endif
@@ -98,11 +162,78 @@ static void ICET_TEST_SPARSE_IMAGE_HEADER(IceTSparseImage image)
 static IceTSizeType colorPixelSize(IceTEnum color_format);
 static IceTSizeType depthPixelSize(IceTEnum depth_format);
 
+/* Returns the size, in bytes, of an active pixel in the run length data of a
+   sparse image and of a value in its depth plane (0 if it has no plane). */
+static IceTSizeType sparseDataPixelSize(IceTEnum color_format,
+                                        IceTEnum depth_format);
+static IceTSizeType sparseDepthPlanePixelSize(IceTEnum color_format,
+                                              IceTEnum depth_format);
+
+/* Returns the largest size, in bytes, of the run length data (not counting
+   the depth plane) of a sparse image with the given number of pixels. */
+static IceTSizeType sparseDataMaxSize(IceTSizeType pixel_size,
+                                      IceTSizeType num_pixels);
+
+/* Returns the depth plane of a sparse image or NULL if it has none. */
+static const IceTVoid *icetSparseImageGetDepthPlane(
+                                                 const IceTSparseImage image);
+
+/* Returns where the functions writing a sparse image may stage its depths.
+   The staging area is after the largest possible run length data, so writing
+   the run lengths does not overwrite it. */
+static IceTVoid *icetSparseImageDepthStage(IceTSparseImage image);
+
+/* Appends the depths in [depths, depths_end) to the depth plane of a sparse
+   image after its actual buffer size is set.  If the image has no depth plane
+   yet, one is started at the end of the data.  The depths may come from the
+   image's own buffer, such as the staging area. */
+static void icetSparseImageAppendDepths(IceTSparseImage image,
+                                        const IceTVoid *depths,
+                                        const IceTVoid *depths_end);
+
 /* Given a sparse image and a pointer to the end of the data, fill in the entry
-   for the actual buffer size. */
+   for the actual buffer size.  This also drops any seek table and depth
+   plane. */
 static void icetSparseImageSetActualSize(IceTSparseImage image,
                                          const IceTVoid *data_end);
 
+/* Copies all of in_image to out_image (including any seek table) with a raw
+   copy of the buffer.  Returns ICET_FALSE without copying if out_image is too
+   small. */
+static IceTBoolean icetSparseImageCopyEntire(const IceTSparseImage in_image,
+                                             IceTSparseImage out_image);
+
+/* Records the active pixel count and bounding rectangle of a sparse image
+   after its data is written by scanning its run lengths.  If the run lengths
+   do not add up, they are left unknown. */
+static void icetSparseImageFindActiveBounds(IceTSparseImage image);
+
+/* Gives the range of pixels [*first_p, *end_p) that holds all the active
+   pixels of a sparse image with known active bounds. */
+static void icetSparseImageActiveRange(const IceTSparseImage image,
+                                       IceTSizeType *first_p,
+                                       IceTSizeType *end_p);
+
+/* Builds the seek table for a sparse image after its data is written.  If the
+   image buffer does not have room or the run lengths do not add up, the image
+   is left without one. */
+static void icetSparseImageBuildSeekTable(IceTSparseImage image);
+
+/* Advances in_data_p, in_depth_p, inactive_before_p, and
+   active_till_next_runl_p (as used by icetSparseImageScanPixels) from
+   from_pixel to to_pixel in the given image.  If the image has a seek table
+   that has an entry past from_pixel, the scan starts from the last such entry
+   before to_pixel rather than from_pixel. */
+static void icetSparseImageSeek(const IceTSparseImage image,
+                                IceTSizeType from_pixel,
+                                IceTSizeType to_pixel,
+                                IceTSizeType pixel_size,
+                                IceTSizeType depth_size,
+                                const IceTVoid **in_data_p,
+                                const IceTVoid **in_depth_p,
+                                IceTSizeType *inactive_before_p,
+                                IceTSizeType *active_till_next_runl_p);
+
 /* Given a pointer to a data element in a sparse image data buffer, the amount
  * of inactive pixels before this data element, and the number of active pixels
  * until the next run length, advance the pointer for the number of pixels given
@@ -115,6 +246,11 @@ static void icetSparseImageSetActualSize(IceTSparseImage image,
  * in_data_p (input/output): Points to the data part of a sparse image.
  *     This is where data will be read from.  When this function returns,
  *     this parameter will be set after the last data point read.
+ * in_depth_p (input/output): If non-NULL, points to the depth in the depth
+ *     plane of the next active pixel at in_data_p.  This parameter will be
+ *     set after the depths of the active pixels scanned.  Depths are not
+ *     copied to the output, but as they are contiguous in the plane, the
+ *     caller can copy those between the old and new value in one go.
  * inactive_before_p (input/output): The input may be in the middle of a
  *     run length.  The number of inactive to be considered before in_data_p
  *     should be passed here.  Likewise, this parameter will be set based on
@@ -131,6 +267,8 @@ static void icetSparseImageSetActualSize(IceTSparseImage image,
  * pixels_to_skip (input): The number of pixels to advance (and optionally
  *     copy) in_data_p (and inactive_before_p and active_till_next_runl_p).
  * pixel_size (input): The size, in bytes, for the data of each pixel.
+ * depth_size (input): The size, in bytes, of each value in the depth plane.
+ *     Ignored if in_depth_p is NULL.
  * out_data_p (input/output): If the intention is to copy the data, this
  *     points to the end of a data part of another sparse image.  The
  *     scanned pixels will be copied to this buffer.  This parameter will
@@ -145,22 +283,26 @@ static void icetSparseImageSetActualSize(IceTSparseImage image,
  *     This parameter is ignored if out_data_p is NULL.
  */
 static void icetSparseImageScanPixels(const IceTVoid **in_data_p,
+                                      const IceTVoid **in_depth_p,
                                       IceTSizeType *inactive_before_p,
                                       IceTSizeType *active_till_next_runl_p,
                                       IceTVoid **last_in_run_length_p,
                                       IceTSizeType pixels_to_skip,
                                       IceTSizeType pixel_size,
+                                      IceTSizeType depth_size,
                                       IceTVoid **out_data_p,
                                       IceTVoid **out_run_length_p);
 
 /* Similar calling structure as icetSparseImageScanPixels except that the
-   data is also copied to out_image. */
+   data (and depths, if in_depth_p is not NULL) is also copied to out_image. */
 static void icetSparseImageCopyPixelsInternal(
                                           const IceTVoid **data_p,
+                                          const IceTVoid **depth_p,
                                           IceTSizeType *inactive_before_p,
                                           IceTSizeType *active_till_next_runl_p,
                                           IceTSizeType pixels_to_copy,
                                           IceTSizeType pixel_size,
+                                          IceTSizeType depth_size,
                                           IceTSparseImage out_image);
 
 /* Similar to icetSparseImageCopyPixelsInternal except that data_p should be
@@ -168,13 +310,18 @@ static void icetSparseImageCopyPixelsInternal(
    active_till_next_runl should be 0.  The pixels in the input (and output since
    they are the same) will be skipped as normal except that the header
    information and last run length for the image will be adjusted so that it is
-   equivalent to a copy. */
+   equivalent to a copy.  Likewise, depth_p should be NULL or point to the
+   start of the depth plane.  The kept depths are moved to the end of the kept
+   data, which overwrites the data after it, so this has to be done after any
+   other copies from the image. */
 static void icetSparseImageCopyPixelsInPlaceInternal(
                                           const IceTVoid **data_p,
+                                          const IceTVoid **depth_p,
                                           IceTSizeType *inactive_before_p,
                                           IceTSizeType *active_till_next_runl_p,
                                           IceTSizeType pixels_to_copy,
                                           IceTSizeType pixel_size,
+                                          IceTSizeType depth_size,
                                           IceTSparseImage out_image);
 
 /* Choose the partitions (defined by offsets) for the given number of partitions
@@ -186,11 +333,21 @@ static void icetSparseImageCopyPixelsInPlaceInternal(
    the partitions in the same way. */
 static void icetSparseImageSplitChoosePartitions(
                                            IceTInt num_partitions,
-                                           IceTSizeType eventual_num_partitions,
+                                           IceTInt eventual_num_partitions,
                                            IceTSizeType size,
                                            IceTSizeType first_offset,
                                            IceTSizeType *offsets);
 
+/* Copies the partitions for icetSparseImageSplit on multiple threads (when
+   ICET_COMPRESS_THREADS allows and the input has a seek table).  Returns
+   ICET_FALSE, having done nothing, if the split should be done serially. */
+static IceTBoolean icetSparseImageSplitThreaded(
+                                            const IceTSparseImage in_image,
+                                            IceTSizeType in_image_offset,
+                                            IceTInt num_partitions,
+                                            IceTSparseImage *out_images,
+                                            const IceTSizeType *offsets);
+
 /* This function is used to get the image for a tile. It will either render
    the tile on demand (with renderTile) or get the image from a pre-rendered
    image (with prerenderedTile). The screen_viewport is set to the region of
@@ -231,11 +388,35 @@ static IceTImage prerenderedTile(int tile,
 /* Gets an image buffer attached to this context. */
 static IceTImage getRenderBuffer(void);
 
+/* If images are composited in one of the accumulation formats, converts the
+   screen_viewport region of a rendered image to it in an internal buffer.
+   Pixels outside the region are undefined.  Otherwise returns the image. */
+static IceTImage promoteTile(const IceTImage rendered_image,
+                             const IceTInt *screen_viewport);
+
+/* Like icetImageAssignBuffer with the given formats rather than those in the
+   state. */
+static IceTImage imageAssignBufferType(IceTVoid *buffer,
+                                       IceTEnum color_format,
+                                       IceTEnum depth_format,
+                                       IceTSizeType width,
+                                       IceTSizeType height);
+
 static IceTSizeType colorPixelSize(IceTEnum color_format)
 {
     switch (color_format) {
       case ICET_IMAGE_COLOR_RGBA_UBYTE: return 4;
       case ICET_IMAGE_COLOR_RGBA_FLOAT: return 4*sizeof(IceTFloat);
+      case ICET_IMAGE_COLOR_RGBA_HALF:  return 4*sizeof(IceTUShort);
+      case ICET_IMAGE_COLOR_R_FLOAT:    return sizeof(IceTFloat);
+      case ICET_IMAGE_COLOR_RG_FLOAT:   return 2*sizeof(IceTFloat);
+      case ICET_IMAGE_COLOR_R_UINT:     return sizeof(IceTUInt);
+      case ICET_IMAGE_COLOR_R_DOUBLE:   return sizeof(IceTDouble);
+      case ICET_IMAGE_COLOR_RG_DOUBLE:  return 2*sizeof(IceTDouble);
+      case ICET_IMAGE_COLOR_RGBA_DOUBLE: return 4*sizeof(IceTDouble);
+      case ICET_IMAGE_COLOR_R_BINNED:   return 3*sizeof(IceTDouble);
+      case ICET_IMAGE_COLOR_RG_BINNED:  return 6*sizeof(IceTDouble);
+      case ICET_IMAGE_COLOR_RGBA_BINNED: return 12*sizeof(IceTDouble);
       case ICET_IMAGE_COLOR_NONE:       return 0;
       default:
           icetRaiseError("Invalid color format.", ICET_INVALID_ENUM);
@@ -246,671 +427,1526 @@ static IceTSizeType colorPixelSize(IceTEnum color_format)
 static IceTSizeType depthPixelSize(IceTEnum depth_format)
 {
     switch (depth_format) {
-      case ICET_IMAGE_DEPTH_FLOAT: return sizeof(IceTFloat);
-      case ICET_IMAGE_DEPTH_NONE:  return 0;
+      case ICET_IMAGE_DEPTH_FLOAT:   return sizeof(IceTFloat);
+      case ICET_IMAGE_DEPTH_HALF:    return sizeof(IceTUShort);
+      case ICET_IMAGE_DEPTH_UNORM24: return 3;
+      case ICET_IMAGE_DEPTH_NONE:    return 0;
       default:
           icetRaiseError("Invalid depth format.", ICET_INVALID_ENUM);
           return 0;
     }
 }
 
-IceTSizeType icetImageBufferSize(IceTSizeType width, IceTSizeType height)
+static IceTSizeType sparseDataPixelSize(IceTEnum color_format,
+                                        IceTEnum depth_format)
 {
-    IceTEnum color_format, depth_format;
-
-    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
-    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
-
-    return icetImageBufferSizeType(color_format, depth_format,
-                                   width, height);
+    (void)depth_format;
+    return colorPixelSize(color_format);
 }
 
-IceTSizeType icetImageBufferSizeType(IceTEnum color_format,
-                                     IceTEnum depth_format,
-                                     IceTSizeType width,
-                                     IceTSizeType height)
+static IceTSizeType sparseDepthPlanePixelSize(IceTEnum color_format,
+                                              IceTEnum depth_format)
 {
-    IceTSizeType color_pixel_size = colorPixelSize(color_format);
-    IceTSizeType depth_pixel_size = depthPixelSize(depth_format);
-
-    return (  ICET_IMAGE_DATA_START_INDEX*sizeof(IceTUInt)
-            + width*height*(color_pixel_size + depth_pixel_size) );
+    (void)color_format;
+    return depthPixelSize(depth_format);
 }
 
-IceTSizeType icetImagePointerBufferSize(void)
+/* Gets a background color state variable (ICET_BACKGROUND_COLOR or
+   ICET_TRUE_BACKGROUND_COLOR) as half precision. */
+static void getBackgroundColorHalf(IceTEnum pname, IceTUShort *color)
 {
-    return (  ICET_IMAGE_DATA_START_INDEX*sizeof(IceTUInt)
-            + 2*(sizeof(const IceTVoid *)) );
+    IceTFloat color_f[4];
+    icetGetFloatv(pname, color_f);
+    icetSIMDFloatToHalf(color_f, color, 4);
 }
 
-IceTSizeType icetSparseImageBufferSize(IceTSizeType width, IceTSizeType height)
+/* Sets num_pixels half precision RGBA pixels to the given color. */
+static void colorFillHalf(IceTUShort *color_buffer,
+                          const IceTUShort *color,
+                          IceTSizeType num_pixels)
 {
-    IceTEnum color_format, depth_format;
-
-    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
-    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
-
-    return icetSparseImageBufferSizeType(color_format, depth_format,
-                                         width, height);
+    IceTSizeType i;
+    for (i = 0; i < num_pixels; i++) {
+        memcpy(color_buffer + 4*i, color, 4*sizeof(IceTUShort));
+    }
 }
 
-IceTSizeType icetSparseImageBufferSizeType(IceTEnum color_format,
-                                           IceTEnum depth_format,
-                                           IceTSizeType width,
-                                           IceTSizeType height)
+/* Returns the number of channels in the single and dual channel float
+   formats, which carry a value rather than a color and have no alpha.  Returns
+   0 for any other format. */
+static IceTSizeType scalarColorChannels(IceTEnum color_format)
 {
-    IceTSizeType size;
-    IceTSizeType pixel_size;
-
-    /* A sparse image full of active pixels will be the same size as a full
-       image plus a set of run lengths. */
-    size = (  RUN_LENGTH_SIZE
-            + icetImageBufferSizeType(color_format,depth_format,width,height) );
-
-    /* For most common image formats, this is as large as the sparse image may
-       be.  When the size of the run length pair is no bigger than the size of a
-       pixel (the amount of data saved by writing the run lengths), then even in
-       the pathological case of every other pixel being active.  However, it is
-       possible that the run lengths take more space to store than the pixel
-       data.  Thus, if there is an inactive run length of one, it is possible to
-       have the data set a little bigger.  It is extremely unlikely to need this
-       much memory, but we will have to allocate it just in case.  I suppose we
-       could change the compress functions to not allow run lengths of size 1,
-       but that could increase the time to compress and would definitely
-       increase the complexity of the code. */
-    pixel_size = colorPixelSize(color_format) + depthPixelSize(depth_format);
-    if (pixel_size < RUN_LENGTH_SIZE) {
-        size += (RUN_LENGTH_SIZE - pixel_size)*((width*height+1)/2);
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_R_FLOAT:  return 1;
+      case ICET_IMAGE_COLOR_RG_FLOAT: return 2;
+      default:                        return 0;
     }
-    return size;
 }
 
-IceTImage icetGetStateBufferImage(IceTEnum pname,
-                                  IceTSizeType width,
-                                  IceTSizeType height)
+/* Sets num_pixels pixels of num_channels floats to the first channels of the
+   given color. */
+static void colorFillFloat(IceTFloat *color_buffer,
+                           const IceTFloat *color,
+                           IceTSizeType num_channels,
+                           IceTSizeType num_pixels)
 {
-    IceTVoid *buffer;
-    IceTSizeType buffer_size;
+    IceTSizeType i;
+    for (i = 0; i < num_pixels; i++) {
+        memcpy(color_buffer + num_channels*i,
+               color,
+               num_channels*sizeof(IceTFloat));
+    }
+}
 
-    buffer_size = icetImageBufferSize(width, height);
-    buffer = icetGetStateBuffer(pname, buffer_size);
+/* Expands a pixel of num_channels floats to RGBA.  Missing color channels
+   are 0 and alpha is 1. */
+static void colorExpandFloat(const IceTFloat *in,
+                             IceTSizeType num_channels,
+                             IceTFloat *rgba)
+{
+    rgba[0] = in[0];
+    rgba[1] = (num_channels > 1) ? in[1] : 0.0f;
+    rgba[2] = 0.0f;
+    rgba[3] = 1.0f;
+}
 
-    return icetImageAssignBuffer(buffer, width, height);
+/* Sums count float values. */
+static void colorAddFloat(const IceTFloat *src1,
+                          const IceTFloat *src2,
+                          IceTFloat *dest,
+                          IceTSizeType count)
+{
+    IceTSizeType i;
+    for (i = 0; i < count; i++) {
+        dest[i] = src1[i] + src2[i];
+    }
 }
 
-IceTImage icetRetrieveStateImage(IceTEnum pname)
+/* Like icetSIMDCountColorFloatRun for pixels of num_channels floats. */
+static IceTSizeType colorCountFloatRun(const IceTFloat *color,
+                                       IceTSizeType num_channels,
+                                       IceTSizeType num_pixels,
+                                       IceTBoolean active)
 {
-    return icetImageUnpackageFromReceive(
-                (IceTVoid *)icetUnsafeStateGetBuffer(pname));
+    IceTSizeType count;
+    for (count = 0; count < num_pixels; count++) {
+        IceTBoolean pixel_active = (color[0] != 0.0f);
+        if (num_channels > 1) {
+            pixel_active = pixel_active || (color[1] != 0.0f);
+        }
+        if (pixel_active != active) break;
+        color += num_channels;
+    }
+    return count;
 }
 
-IceTImage icetGetStatePointerImage(IceTEnum pname,
-                                   IceTSizeType width,
-                                   IceTSizeType height,
-                                   const IceTVoid *color_buffer,
-                                   const IceTVoid *depth_buffer)
+/* Returns the number of channels in the accumulation formats (see
+   icetAccumulationColorFormat) or 0 for any other format. */
+static IceTSizeType accumulationChannels(IceTEnum color_format)
 {
-    IceTVoid *buffer;
-    IceTSizeType buffer_size;
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_R_DOUBLE:
+      case ICET_IMAGE_COLOR_R_BINNED:     return 1;
+      case ICET_IMAGE_COLOR_RG_DOUBLE:
+      case ICET_IMAGE_COLOR_RG_BINNED:    return 2;
+      case ICET_IMAGE_COLOR_RGBA_DOUBLE:
+      case ICET_IMAGE_COLOR_RGBA_BINNED:  return 4;
+      default:                            return 0;
+    }
+}
 
-    buffer_size = icetImagePointerBufferSize();
-    buffer = icetGetStateBuffer(pname, buffer_size);
+static IceTBoolean binnedColorFormat(IceTEnum color_format)
+{
+    return (   (color_format == ICET_IMAGE_COLOR_R_BINNED)
+            || (color_format == ICET_IMAGE_COLOR_RG_BINNED)
+            || (color_format == ICET_IMAGE_COLOR_RGBA_BINNED) );
+}
 
-    return icetImagePointerAssignBuffer(
-                buffer, width, height, color_buffer, depth_buffer);
+/* Returns true for the formats that cannot be blended: the single and dual
+   channel float formats, the integer count format, and the accumulation
+   formats. */
+static IceTBoolean addOnlyColorFormat(IceTEnum color_format)
+{
+    return (   (scalarColorChannels(color_format) > 0)
+            || (color_format == ICET_IMAGE_COLOR_R_UINT)
+            || (accumulationChannels(color_format) > 0) );
 }
 
-IceTImage icetImageAssignBuffer(IceTVoid *buffer,
-                                IceTSizeType width,
-                                IceTSizeType height)
+/* Returns true for the formats whose inactive pixels are zero rather than
+   the background color: the integer count format and the accumulation
+   formats. */
+static IceTBoolean zeroInactiveColorFormat(IceTEnum color_format)
 {
-    IceTImage image;
-    IceTEnum color_format, depth_format;
-    IceTInt *header;
+    return (   (color_format == ICET_IMAGE_COLOR_R_UINT)
+            || (accumulationChannels(color_format) > 0) );
+}
 
-    image.opaque_internals = buffer;
+/* The binned accumulation formats split values at multiples of this many
+   bits.  A bin sums values that are multiples of the bin's lowest bit and
+   have at most this many bits, so sums of up to 2^(53-ICET_BIN_WIDTH) values
+   are exact in a double. */
+#define ICET_BIN_WIDTH          32
+/* Added to bin numbers when they are stored so that the all-zero (empty)
+   accumulator is more than one bin below any accumulator holding a value.
+   Float values fall in bins -5 through 3. */
+#define ICET_BIN_OFFSET         16
+/* Bin of an accumulator holding an infinity or NaN, which overrides any
+   finite values. */
+#define ICET_BIN_NONFINITE      1024
+
+/* Sets a binned accumulator to hold value. */
+static void binnedSet(IceTDouble value, IceTDouble *accumulator)
+{
+    IceTDouble scale;
+    int exponent;
+    int bin;
 
-    if (buffer == NULL) {
-        icetRaiseError("Tried to create image with NULL buffer.",
-                       ICET_INVALID_VALUE);
-        return icetImageNull();
+    if (value == 0.0) {
+        accumulator[0] = accumulator[1] = accumulator[2] = 0.0;
+        return;
+    }
+    if (value - value != 0.0) {
+        accumulator[0] = ICET_BIN_NONFINITE;
+        accumulator[1] = value;
+        accumulator[2] = 0.0;
+        return;
     }
 
-    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
-    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    /* Find the bin of the leading bit. */
+    frexp(value, &exponent);
+    exponent--;
+    if (exponent >= 0) {
+        bin = exponent/ICET_BIN_WIDTH;
+    } else {
+        bin = -((ICET_BIN_WIDTH - 1 - exponent)/ICET_BIN_WIDTH);
+    }
 
-    header = ICET_IMAGE_HEADER(image);
+    /* A float has fewer bits than a bin, so what is not in the leading bin
+       is in the one below. */
+    scale = ldexp(1.0, bin*ICET_BIN_WIDTH);
+    accumulator[0] = (IceTDouble)(bin + ICET_BIN_OFFSET);
+    if (value > 0.0) {
+        accumulator[1] = floor(value/scale)*scale;
+    } else {
+        accumulator[1] = ceil(value/scale)*scale;
+    }
+    accumulator[2] = value - accumulator[1];
+}
 
-    if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
-        && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
-        && (color_format != ICET_IMAGE_COLOR_NONE) ) {
-        icetRaiseError("Invalid color format.", ICET_INVALID_ENUM);
-        color_format = ICET_IMAGE_COLOR_NONE;
+/* Adds the binned accumulator src into dest.  Parts of either that fall
+   below the lower of the two bins kept are dropped.  Because the bins kept
+   depend only on the largest value added and all the sums are exact, the
+   result is the same no matter in what order accumulators are added. */
+static void binnedAdd(const IceTDouble *src, IceTDouble *dest)
+{
+    if (src[0] > dest[0]) {
+        dest[2] = (src[0] == dest[0] + 1.0) ? dest[1] : 0.0;
+        dest[1] = 0.0;
+        dest[0] = src[0];
     }
-    if (   (depth_format != ICET_IMAGE_DEPTH_FLOAT)
-        && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
-        icetRaiseError("Invalid depth format.", ICET_INVALID_ENUM);
-        depth_format = ICET_IMAGE_DEPTH_NONE;
+    if (src[0] == dest[0]) {
+        dest[1] += src[1];
+        dest[2] += src[2];
+    } else if (src[0] == dest[0] - 1.0) {
+        dest[2] += src[1];
     }
+}
 
-    header[ICET_IMAGE_MAGIC_NUM_INDEX]          = ICET_IMAGE_MAGIC_NUM;
-    header[ICET_IMAGE_COLOR_FORMAT_INDEX]       = color_format;
-    header[ICET_IMAGE_DEPTH_FORMAT_INDEX]       = depth_format;
-    header[ICET_IMAGE_WIDTH_INDEX]              = (IceTInt)width;
-    header[ICET_IMAGE_HEIGHT_INDEX]             = (IceTInt)height;
-    header[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]     = (IceTInt)(width*height);
-    header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
-        = (IceTInt)icetImageBufferSizeType(color_format,
-                                           depth_format,
-                                           width,
-                                           height);
+/* Like colorCountFloatRun for any of the add only formats. */
+static IceTSizeType colorCountValueRun(IceTEnum color_format,
+                                       const IceTVoid *color,
+                                       IceTSizeType num_pixels,
+                                       IceTBoolean active)
+{
+    const IceTDouble *color_d = (const IceTDouble *)color;
+    IceTSizeType num_values;
+    IceTSizeType count;
+
+    if (scalarColorChannels(color_format) > 0) {
+        return colorCountFloatRun((const IceTFloat *)color,
+                                  scalarColorChannels(color_format),
+                                  num_pixels,
+                                  active);
+    }
+    if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+        const IceTUInt *color_ui = (const IceTUInt *)color;
+        for (count = 0; count < num_pixels; count++) {
+            if ((color_ui[count] != 0) != active) break;
+        }
+        return count;
+    }
 
-    return image;
+    num_values = colorPixelSize(color_format)/sizeof(IceTDouble);
+    for (count = 0; count < num_pixels; count++) {
+        IceTBoolean pixel_active = ICET_FALSE;
+        IceTSizeType i;
+        for (i = 0; i < num_values; i++) {
+            if (color_d[i] != 0.0) {
+                pixel_active = ICET_TRUE;
+                break;
+            }
+        }
+        if (pixel_active != active) break;
+        color_d += num_values;
+    }
+    return count;
 }
 
-IceTImage icetImagePointerAssignBuffer(IceTVoid *buffer,
-                                       IceTSizeType width,
-                                       IceTSizeType height,
-                                       const IceTVoid *color_buffer,
-                                       const IceTVoid *depth_buffer)
+/* Sums num_pixels pixels of any of the add only formats.  dest may be the
+   same as either input. */
+static void colorAddValues(IceTEnum color_format,
+                           const IceTVoid *src1,
+                           const IceTVoid *src2,
+                           IceTVoid *dest,
+                           IceTSizeType num_pixels)
 {
-    /* This is a bit hacky, but most of the entries for regular images and
-     * pointer images are the same. Use that function to fill in most of
-     * the entries and fix those that are different. */
-    IceTImage image = icetImageAssignBuffer(buffer, width, height);
+    const IceTDouble *src1_d = (const IceTDouble *)src1;
+    const IceTDouble *src2_d = (const IceTDouble *)src2;
+    IceTDouble *dest_d = (IceTDouble *)dest;
+    IceTSizeType count;
+    IceTSizeType i;
 
-    {
-        IceTInt *header = ICET_IMAGE_HEADER(image);
-        /* Our magic number is different. */
-        header[ICET_IMAGE_MAGIC_NUM_INDEX] = ICET_IMAGE_POINTERS_MAGIC_NUM;
-        /* It is invalid to use this type of image as a single buffer. */
-        header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] = -1;
+    if (scalarColorChannels(color_format) > 0) {
+        colorAddFloat((const IceTFloat *)src1,
+                      (const IceTFloat *)src2,
+                      (IceTFloat *)dest,
+                      scalarColorChannels(color_format)*num_pixels);
+        return;
     }
-
-    /* Check that the image buffers make sense. */
-    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_NONE) {
-        if (color_buffer != NULL) {
-            icetRaiseError(
-                "Given a color buffer when color format is set to none.",
-                ICET_INVALID_VALUE);
-        }
-    } else {
-        if (color_buffer == NULL) {
-            icetRaiseError(
-                "Not given a color buffer when color format requires one.",
-                ICET_INVALID_VALUE);
+    if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+        const IceTUInt *src1_ui = (const IceTUInt *)src1;
+        const IceTUInt *src2_ui = (const IceTUInt *)src2;
+        IceTUInt *dest_ui = (IceTUInt *)dest;
+        for (i = 0; i < num_pixels; i++) {
+            dest_ui[i] = src1_ui[i] + src2_ui[i];
         }
+        return;
     }
-    if (icetImageGetDepthFormat(image) == ICET_IMAGE_DEPTH_NONE) {
-        if (depth_buffer != NULL) {
-            icetRaiseError(
-                "Given a depth buffer when depth format is set to none.",
-                ICET_INVALID_VALUE);
+
+    count = accumulationChannels(color_format)*num_pixels;
+    if (binnedColorFormat(color_format)) {
+        for (i = 0; i < count; i++) {
+            IceTDouble sum[3];
+            memcpy(sum, src2_d + 3*i, sizeof(sum));
+            binnedAdd(src1_d + 3*i, sum);
+            memcpy(dest_d + 3*i, sum, sizeof(sum));
         }
     } else {
-        if (depth_buffer == NULL) {
-            icetRaiseError(
-                "Not given a depth buffer when depth format requires one.",
-                ICET_INVALID_VALUE);
+        for (i = 0; i < count; i++) {
+            dest_d[i] = src1_d[i] + src2_d[i];
         }
     }
+}
 
-    {
-        const IceTVoid **data = ICET_IMAGE_DATA(image);
-        data[0] = color_buffer;
-        data[1] = depth_buffer;
+/* Sets num_pixels pixels of any of the add only formats to be inactive.  The
+   single and dual channel float formats get the first channels of
+   background_color, and the rest are zeroed. */
+static void colorFillValues(IceTEnum color_format,
+                            IceTVoid *color,
+                            const IceTFloat *background_color,
+                            IceTSizeType num_pixels)
+{
+    if (scalarColorChannels(color_format) > 0) {
+        colorFillFloat((IceTFloat *)color,
+                       background_color,
+                       scalarColorChannels(color_format),
+                       num_pixels);
+    } else if (num_pixels > 0) {
+        memset(color, 0, colorPixelSize(color_format)*num_pixels);
     }
-
-    return image;
 }
 
-IceTImage icetImageNull(void)
+/* Returns true for the order independent composite modes that combine the
+   values of active pixels: ICET_COMPOSITE_MODE_ADD, ICET_COMPOSITE_MODE_MAX,
+   and ICET_COMPOSITE_MODE_MIN.  Images for all of them are compressed and
+   decompressed the same way; only compositing differs. */
+static IceTBoolean reductionCompositeMode(IceTEnum composite_mode)
 {
-    IceTImage image;
-    image.opaque_internals = NULL;
-    return image;
+    return (   (composite_mode == ICET_COMPOSITE_MODE_ADD)
+            || (composite_mode == ICET_COMPOSITE_MODE_MAX)
+            || (composite_mode == ICET_COMPOSITE_MODE_MIN) );
 }
 
-IceTBoolean icetImageIsNull(const IceTImage image)
+/* Returns true if a pixel in any format has a nonzero channel, which is how
+   active pixels are found without a depth buffer. */
+static IceTBoolean colorPixelIsActive(IceTEnum color_format,
+                                      const IceTVoid *color)
 {
-    if (image.opaque_internals == NULL) {
-        return ICET_TRUE;
-    } else {
-        return ICET_FALSE;
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_RGBA_UBYTE:
+          return (icetSIMDCountColorUByteRun(color, 1, ICET_TRUE) == 1);
+      case ICET_IMAGE_COLOR_RGBA_FLOAT:
+          return (icetSIMDCountColorFloatRun(color, 1, ICET_TRUE) == 1);
+      case ICET_IMAGE_COLOR_RGBA_HALF:
+          return (icetSIMDCountColorHalfRun(color, 1, ICET_TRUE) == 1);
+      case ICET_IMAGE_COLOR_NONE:
+          return ICET_FALSE;
+      default:
+          return (colorCountValueRun(color_format, color, 1, ICET_TRUE) == 1);
     }
 }
 
-IceTSparseImage icetGetStateBufferSparseImage(IceTEnum pname,
-                                              IceTSizeType width,
-                                              IceTSizeType height)
+/* Keeps the larger (ICET_COMPOSITE_MODE_MAX) or smaller
+   (ICET_COMPOSITE_MODE_MIN) of each channel of num_pixels pixels of src and
+   dest in dest.  A NaN in src never replaces a value in dest. */
+static void colorExtremumValues(IceTEnum composite_mode,
+                                IceTEnum color_format,
+                                const IceTVoid *src,
+                                IceTVoid *dest,
+                                IceTSizeType num_pixels)
 {
-    IceTVoid *buffer;
-    IceTSizeType buffer_size;
-
-    buffer_size = icetSparseImageBufferSize(width, height);
-    buffer = icetGetStateBuffer(pname, buffer_size);
+    IceTBoolean use_max = (composite_mode == ICET_COMPOSITE_MODE_MAX);
+    IceTSizeType i;
 
-    return icetSparseImageAssignBuffer(buffer, width, height);
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        const IceTUByte *src_ub = (const IceTUByte *)src;
+        IceTUByte *dest_ub = (IceTUByte *)dest;
+        for (i = 0; i < 4*num_pixels; i++) {
+            if (use_max ? (src_ub[i] > dest_ub[i]) : (src_ub[i] < dest_ub[i])) {
+                dest_ub[i] = src_ub[i];
+            }
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+        const IceTUInt *src_ui = (const IceTUInt *)src;
+        IceTUInt *dest_ui = (IceTUInt *)dest;
+        for (i = 0; i < num_pixels; i++) {
+            if (use_max ? (src_ui[i] > dest_ui[i]) : (src_ui[i] < dest_ui[i])) {
+                dest_ui[i] = src_ui[i];
+            }
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        /* Halves are compared as floats, but the winning half is copied
+           as is. */
+        const IceTUShort *src_h = (const IceTUShort *)src;
+        IceTUShort *dest_h = (IceTUShort *)dest;
+        for (i = 0; i < num_pixels; i++) {
+            IceTFloat src_f[4];
+            IceTFloat dest_f[4];
+            int channel;
+            icetSIMDHalfToFloat(src_h + 4*i, src_f, 4);
+            icetSIMDHalfToFloat(dest_h + 4*i, dest_f, 4);
+            for (channel = 0; channel < 4; channel++) {
+                if (  use_max
+                    ? (src_f[channel] > dest_f[channel])
+                    : (src_f[channel] < dest_f[channel]) ) {
+                    dest_h[4*i + channel] = src_h[4*i + channel];
+                }
+            }
+        }
+    } else if (   (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+               || (scalarColorChannels(color_format) > 0) ) {
+        const IceTFloat *src_f = (const IceTFloat *)src;
+        IceTFloat *dest_f = (IceTFloat *)dest;
+        IceTSizeType count
+            = num_pixels*colorPixelSize(color_format)/sizeof(IceTFloat);
+        for (i = 0; i < count; i++) {
+            if (use_max ? (src_f[i] > dest_f[i]) : (src_f[i] < dest_f[i])) {
+                dest_f[i] = src_f[i];
+            }
+        }
+    }
 }
 
-IceTSparseImage icetSparseImageAssignBuffer(IceTVoid *buffer,
-                                            IceTSizeType width,
-                                            IceTSizeType height)
+/* Like colorExtremumValues, but only pixels active in both src and dest are
+   compared (see colorPixelIsActive).  Inactive source pixels leave dest
+   alone and inactive destination pixels are replaced by the source.  This
+   keeps the zero value of empty pixels from winning a minimum. */
+static void colorExtremumPixels(IceTEnum composite_mode,
+                                IceTEnum color_format,
+                                const IceTVoid *src,
+                                IceTVoid *dest,
+                                IceTSizeType num_pixels)
 {
-    IceTSparseImage image;
-    IceTEnum color_format, depth_format;
-    IceTInt *header;
-
-    image.opaque_internals = buffer;
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *src_c = (const IceTByte *)src;
+    IceTByte *dest_c = (IceTByte *)dest;
+    IceTSizeType color_size = colorPixelSize(color_format);
+    IceTSizeType i;
 
-    if (buffer == NULL) {
-        icetRaiseError("Tried to create sparse image with NULL buffer.",
-                       ICET_INVALID_VALUE);
-        return image;
+    for (i = 0; i < num_pixels; i++) {
+        if (!colorPixelIsActive(color_format, src_c)) {
+            /* Nothing to compare. */
+        } else if (colorPixelIsActive(color_format, dest_c)) {
+            colorExtremumValues(composite_mode, color_format,
+                                src_c, dest_c, 1);
+        } else {
+            memcpy(dest_c, src_c, color_size);
+        }
+        src_c += color_size;
+        dest_c += color_size;
     }
+}
 
-    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
-    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
-
-    header = ICET_IMAGE_HEADER(image);
+/* Half and 24-bit depths are compared as unsigned integers, which orders them
+   the same as the depths they encode as long as those are in [0, 1]. */
+#define ICET_DEPTH_HALF_FAR     0x3C00
+#define ICET_DEPTH_UNORM24_FAR  0xFFFFFF
 
-    if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
-        && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
-        && (color_format != ICET_IMAGE_COLOR_NONE) ) {
-        icetRaiseError("Invalid color format.", ICET_INVALID_ENUM);
-        color_format = ICET_IMAGE_COLOR_NONE;
+static IceTUInt depthKey(IceTEnum depth_format, const IceTByte *depth)
+{
+    const IceTUByte *bytes = (const IceTUByte *)depth;
+    if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        return ((const IceTUShort *)depth)[0];
+    } else {
+        return (  (IceTUInt)bytes[0]
+                | ((IceTUInt)bytes[1] << 8)
+                | ((IceTUInt)bytes[2] << 16) );
     }
-    if (   (depth_format != ICET_IMAGE_DEPTH_FLOAT)
-        && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
-        icetRaiseError("Invalid depth format.", ICET_INVALID_ENUM);
-        depth_format = ICET_IMAGE_DEPTH_NONE;
-    }
-
-    header[ICET_IMAGE_MAGIC_NUM_INDEX]          = ICET_SPARSE_IMAGE_MAGIC_NUM;
-    header[ICET_IMAGE_COLOR_FORMAT_INDEX]       = color_format;
-    header[ICET_IMAGE_DEPTH_FORMAT_INDEX]       = depth_format;
-    header[ICET_IMAGE_WIDTH_INDEX]              = (IceTInt)width;
-    header[ICET_IMAGE_HEIGHT_INDEX]             = (IceTInt)height;
-    header[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]     = (IceTInt)(width*height);
-    header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] = 0;
-
-  /* Make sure the runlengths are valid. */
-    icetClearSparseImage(image);
-
-    return image;
 }
 
-IceTSparseImage icetSparseImageNull(void)
+static IceTBoolean depthIsActive(IceTEnum depth_format, const IceTByte *depth)
 {
-    IceTSparseImage image;
-    image.opaque_internals = NULL;
-    return image;
+    switch (depth_format) {
+      case ICET_IMAGE_DEPTH_FLOAT:
+          return ((const IceTFloat *)depth)[0] < 1.0f;
+      case ICET_IMAGE_DEPTH_HALF:
+          return depthKey(depth_format, depth) < ICET_DEPTH_HALF_FAR;
+      default:
+          return depthKey(depth_format, depth) < ICET_DEPTH_UNORM24_FAR;
+    }
 }
 
-IceTBoolean icetSparseImageIsNull(const IceTSparseImage image)
+static IceTBoolean depthLess(IceTEnum depth_format,
+                             const IceTByte *depth1,
+                             const IceTByte *depth2)
 {
-    if (image.opaque_internals == NULL) {
-        return ICET_TRUE;
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        return ((const IceTFloat *)depth1)[0] < ((const IceTFloat *)depth2)[0];
     } else {
-        return ICET_FALSE;
+        return depthKey(depth_format, depth1) < depthKey(depth_format, depth2);
     }
 }
 
-void icetImageAdjustForOutput(IceTImage image)
+static IceTFloat depthToFloat(IceTEnum depth_format, const IceTByte *depth)
 {
-    IceTEnum color_format;
-
-    if (icetImageIsNull(image)) return;
-
-    ICET_TEST_IMAGE_HEADER(image);
-
-    if (icetIsEnabled(ICET_COMPOSITE_ONE_BUFFER)) {
-        color_format = icetImageGetColorFormat(image);
-        if (color_format != ICET_IMAGE_COLOR_NONE) {
-          /* Set to no depth information. */
-            ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX]
-                = ICET_IMAGE_DEPTH_NONE;
-          /* Reset the image size (changes actual buffer size). */
-            icetImageSetDimensions(image,
-                                   icetImageGetWidth(image),
-                                   icetImageGetHeight(image));
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        return ((const IceTFloat *)depth)[0];
+    } else if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        IceTUInt half = depthKey(depth_format, depth);
+        IceTUInt exponent = (half >> 10) & 0x1F;
+        IceTUInt mantissa = half & 0x3FF;
+        IceTFloat value;
+        if (exponent == 0) {
+            value = (IceTFloat)mantissa/16777216.0f;
+        } else if (exponent == 0x1F) {
+            /* Infinity or NaN. */
+            IceTUInt bits = 0x7F800000 | (mantissa << 13);
+            memcpy(&value, &bits, sizeof(IceTFloat));
+        } else {
+            IceTUInt bits = ((exponent + 112) << 23) | (mantissa << 13);
+            memcpy(&value, &bits, sizeof(IceTFloat));
         }
+        return (half & 0x8000) ? -value : value;
+    } else {
+        return (IceTFloat)depthKey(depth_format, depth)/16777215.0f;
     }
 }
 
-void icetImageAdjustForInput(IceTImage image)
+/* Sets num_pixels depths to the far plane, which marks the pixels inactive. */
+static void depthFillInactive(IceTEnum depth_format,
+                                  IceTVoid *depth,
+                                  IceTSizeType num_pixels)
 {
-    IceTEnum color_format, depth_format;
-
-    if (icetImageIsNull(image)) return;
-
-    ICET_TEST_IMAGE_HEADER(image);
+    IceTSizeType i;
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        IceTFloat *depth_f = (IceTFloat *)depth;
+        for (i = 0; i < num_pixels; i++) { depth_f[i] = 1.0f; }
+    } else if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        IceTUShort *depth_h = (IceTUShort *)depth;
+        for (i = 0; i < num_pixels; i++) { depth_h[i] = ICET_DEPTH_HALF_FAR; }
+    } else if (num_pixels > 0) {
+        memset(depth, 0xFF, 3*num_pixels);
+    }
+}
 
-    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
-    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+/* Like icetSIMDCountDepthRun for any depth format. */
+static IceTSizeType depthCountRun(IceTEnum depth_format,
+                                      const IceTVoid *depth,
+                                      IceTSizeType num_pixels,
+                                      IceTBoolean active)
+{
+    const IceTByte *depth_b = (const IceTByte *)depth;
+    IceTSizeType depth_size;
+    IceTSizeType count;
 
-  /* Reset to the specified image format. */
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX] = color_format;
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX] = depth_format;
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        return icetSIMDCountDepthRun((const IceTFloat *)depth,
+                                     num_pixels,
+                                     active);
+    }
 
-  /* Reset the image size (changes actual buffer size). */
-    icetImageSetDimensions(image,
-                           icetImageGetWidth(image),
-                           icetImageGetHeight(image));
+    depth_size = depthPixelSize(depth_format);
+    for (count = 0; count < num_pixels; count++) {
+        if (depthIsActive(depth_format, depth_b) != active) break;
+        depth_b += depth_size;
+    }
+    return count;
 }
 
-IceTEnum icetImageGetColorFormat(const IceTImage image)
-{
-    ICET_TEST_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return ICET_IMAGE_COLOR_NONE;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX];
-}
-IceTEnum icetImageGetDepthFormat(const IceTImage image)
-{
-    ICET_TEST_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return ICET_IMAGE_DEPTH_NONE;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX];
-}
-IceTSizeType icetImageGetWidth(const IceTImage image)
-{
-    ICET_TEST_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX];
-}
-IceTSizeType icetImageGetHeight(const IceTImage image)
+/* Z-buffer composite of num_pixels pixels in any format.  Wherever the source
+ * depth is less than the destination depth, the source color and depth replace
+ * the destination.  Float depths use the vector kernels. */
+static void depthZBufferPixels(IceTEnum color_format,
+                                   IceTEnum depth_format,
+                                   const IceTVoid *src_color,
+                                   const IceTVoid *src_depth,
+                                   IceTVoid *dest_color,
+                                   IceTVoid *dest_depth,
+                                   IceTSizeType num_pixels)
 {
-    ICET_TEST_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX];
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *src_c = (const IceTByte *)src_color;
+    const IceTByte *src_d = (const IceTByte *)src_depth;
+    IceTByte *dest_c = (IceTByte *)dest_color;
+    IceTByte *dest_d = (IceTByte *)dest_depth;
+    IceTSizeType color_size;
+    IceTSizeType depth_size;
+    IceTSizeType i;
+
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            icetSIMDZBufferUByte((const IceTUInt *)src_color,
+                                 (const IceTFloat *)src_depth,
+                                 (IceTUInt *)dest_color,
+                                 (IceTFloat *)dest_depth,
+                                 num_pixels);
+            return;
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            icetSIMDZBufferFloat((const IceTFloat *)src_color,
+                                 (const IceTFloat *)src_depth,
+                                 (IceTFloat *)dest_color,
+                                 (IceTFloat *)dest_depth,
+                                 num_pixels);
+            return;
+        } else if (color_format == ICET_IMAGE_COLOR_NONE) {
+            icetSIMDZBufferDepth((const IceTFloat *)src_depth,
+                                 (IceTFloat *)dest_depth,
+                                 num_pixels);
+            return;
+        }
+    }
+
+    color_size = colorPixelSize(color_format);
+    depth_size = depthPixelSize(depth_format);
+    for (i = 0; i < num_pixels; i++) {
+        if (depthLess(depth_format, src_d, dest_d)) {
+            memcpy(dest_c, src_c, color_size);
+            memcpy(dest_d, src_d, depth_size);
+        }
+        src_c += color_size;  src_d += depth_size;
+        dest_c += color_size;  dest_d += depth_size;
+    }
 }
-IceTSizeType icetImageGetNumPixels(const IceTImage image)
+
+/* Additive, maximum, or minimum composite (see reductionCompositeMode) of
+ * num_pixels pixels with depth in any format.  Active source pixels are
+ * combined with active destination pixels, which keep the nearest depth, and
+ * replace inactive destination pixels. */
+static void depthReducePixels(IceTEnum composite_mode,
+                              IceTEnum color_format,
+                              IceTEnum depth_format,
+                              const IceTVoid *src_color,
+                              const IceTVoid *src_depth,
+                              IceTVoid *dest_color,
+                              IceTVoid *dest_depth,
+                              IceTSizeType num_pixels)
 {
-    ICET_TEST_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return (  ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX]
-            * ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] );
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *src_c = (const IceTByte *)src_color;
+    const IceTByte *src_d = (const IceTByte *)src_depth;
+    IceTByte *dest_c = (IceTByte *)dest_color;
+    IceTByte *dest_d = (IceTByte *)dest_depth;
+    IceTSizeType color_size = colorPixelSize(color_format);
+    IceTSizeType depth_size = depthPixelSize(depth_format);
+    IceTSizeType i;
+
+    for (i = 0; i < num_pixels; i++) {
+        if (!depthIsActive(depth_format, src_d)) {
+            /* Nothing to add. */
+        } else if (depthIsActive(depth_format, dest_d)) {
+            if (composite_mode != ICET_COMPOSITE_MODE_ADD) {
+                colorExtremumValues(composite_mode, color_format,
+                                    src_c, dest_c, 1);
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                ICET_ADD_UBYTE((const IceTUByte *)src_c,
+                               (IceTUByte *)dest_c,
+                               (IceTUByte *)dest_c);
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                ICET_ADD_FLOAT((const IceTFloat *)src_c,
+                               (IceTFloat *)dest_c,
+                               (IceTFloat *)dest_c);
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+                icetSIMDAddHalf((const IceTUShort *)src_c,
+                                (IceTUShort *)dest_c,
+                                (IceTUShort *)dest_c,
+                                1);
+            } else if (addOnlyColorFormat(color_format)) {
+                colorAddValues(color_format, src_c, dest_c, dest_c, 1);
+            }
+            if (depthLess(depth_format, src_d, dest_d)) {
+                memcpy(dest_d, src_d, depth_size);
+            }
+        } else {
+            memcpy(dest_c, src_c, color_size);
+            memcpy(dest_d, src_d, depth_size);
+        }
+        src_c += color_size;  src_d += depth_size;
+        dest_c += color_size;  dest_d += depth_size;
+    }
 }
 
-IceTEnum icetSparseImageGetColorFormat(const IceTSparseImage image)
+/* Composites num_pixels source pixels in front of the same number of
+ * destination pixels, in place.  Colors and depths are in separate arrays, as
+ * in sparse images, and the depths are NULL without depth.  The composite
+ * mode and formats must be ones that compositing sparse images accepts
+ * without a diagnostic. */
+static void compositePixels(IceTEnum composite_mode,
+                            IceTEnum color_format,
+                            IceTEnum depth_format,
+                            const IceTVoid *src_color,
+                            const IceTVoid *src_depth,
+                            IceTVoid *dest_color,
+                            IceTVoid *dest_depth,
+                            IceTSizeType num_pixels)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return ICET_IMAGE_COLOR_NONE;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX];
+    IceTSizeType i;
+
+    if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+        depthZBufferPixels(color_format, depth_format,
+                           src_color, src_depth, dest_color, dest_depth,
+                           num_pixels);
+    } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            for (i = 0; i < num_pixels; i++) {
+                ICET_OVER_UBYTE((const IceTUByte *)src_color + 4*i,
+                                (IceTUByte *)dest_color + 4*i);
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            for (i = 0; i < num_pixels; i++) {
+                ICET_OVER_FLOAT((const IceTFloat *)src_color + 4*i,
+                                (IceTFloat *)dest_color + 4*i);
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+            icetSIMDBlendHalf((const IceTUShort *)src_color,
+                              (IceTUShort *)dest_color,
+                              (IceTUShort *)dest_color,
+                              num_pixels);
+        }
+    } else if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+        depthReducePixels(composite_mode, color_format, depth_format,
+                          src_color, src_depth, dest_color, dest_depth,
+                          num_pixels);
+    } else if (composite_mode != ICET_COMPOSITE_MODE_ADD) {
+        colorExtremumPixels(composite_mode, color_format,
+                            src_color, dest_color, num_pixels);
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        for (i = 0; i < num_pixels; i++) {
+            ICET_ADD_UBYTE((const IceTUByte *)src_color + 4*i,
+                           (IceTUByte *)dest_color + 4*i,
+                           (IceTUByte *)dest_color + 4*i);
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        for (i = 0; i < num_pixels; i++) {
+            ICET_ADD_FLOAT((const IceTFloat *)src_color + 4*i,
+                           (IceTFloat *)dest_color + 4*i,
+                           (IceTFloat *)dest_color + 4*i);
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        icetSIMDAddHalf((const IceTUShort *)src_color,
+                        (IceTUShort *)dest_color,
+                        (IceTUShort *)dest_color,
+                        num_pixels);
+    } else if (addOnlyColorFormat(color_format)) {
+        colorAddValues(color_format, src_color, dest_color, dest_color,
+                       num_pixels);
+    }
 }
-IceTEnum icetSparseImageGetDepthFormat(const IceTSparseImage image)
+
+static IceTSizeType sparseDataMaxSize(IceTSizeType pixel_size,
+                                      IceTSizeType num_pixels)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return ICET_IMAGE_DEPTH_NONE;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX];
+    /* A sparse image full of active pixels will be the size of the pixels plus
+       a set of run lengths. */
+    IceTSizeType size = RUN_LENGTH_SIZE + num_pixels*pixel_size;
+
+    /* For most common image formats, this is as large as the sparse image may
+       be.  When the size of the run length pair is no bigger than the size of a
+       pixel (the amount of data saved by writing the run lengths), then even in
+       the pathological case of every other pixel being active.  However, it is
+       possible that the run lengths take more space to store than the pixel
+       data.  Thus, if there is an inactive run length of one, it is possible to
+       have the data set a little bigger.  It is extremely unlikely to need this
+       much memory, but we will have to allocate it just in case.  I suppose we
+       could change the compress functions to not allow run lengths of size 1,
+       but that could increase the time to compress and would definitely
+       increase the complexity of the code. */
+    if (pixel_size < RUN_LENGTH_SIZE) {
+        size += (RUN_LENGTH_SIZE - pixel_size)*((num_pixels+1)/2);
+    }
+
+    return size;
 }
-IceTSizeType icetSparseImageGetWidth(const IceTSparseImage image)
+
+IceTSizeType icetImageBufferSize(IceTSizeType width, IceTSizeType height)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX];
+    IceTEnum color_format, depth_format;
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+
+    return icetImageBufferSizeType(color_format, depth_format,
+                                   width, height);
 }
-IceTSizeType icetSparseImageGetHeight(const IceTSparseImage image)
+
+IceTSizeType icetImageBufferSizeType(IceTEnum color_format,
+                                     IceTEnum depth_format,
+                                     IceTSizeType width,
+                                     IceTSizeType height)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX];
+    IceTSizeType color_pixel_size = colorPixelSize(color_format);
+    IceTSizeType depth_pixel_size = depthPixelSize(depth_format);
+
+    return (  ICET_IMAGE_HEADER_SIZE
+            + width*height*(color_pixel_size + depth_pixel_size) );
 }
-IceTSizeType icetSparseImageGetNumPixels(const IceTSparseImage image)
+
+IceTSizeType icetImagePointerBufferSize(void)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return (  ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX]
-            * ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] );
+    return (  ICET_IMAGE_HEADER_SIZE
+            + 2*(IceTSizeType)(sizeof(const IceTVoid *)) );
 }
-IceTSizeType icetSparseImageGetCompressedBufferSize(
-                                             const IceTSparseImage image)
+
+IceTSizeType icetSparseImageBufferSize(IceTSizeType width, IceTSizeType height)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-    if (!image.opaque_internals) return 0;
-    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    IceTEnum color_format, depth_format;
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+
+    return icetSparseImageBufferSizeType(color_format, depth_format,
+                                         width, height);
 }
 
-void icetImageSetDimensions(IceTImage image,
-                            IceTSizeType width,
-                            IceTSizeType height)
+IceTSizeType icetSparseImageBufferSizeType(IceTEnum color_format,
+                                           IceTEnum depth_format,
+                                           IceTSizeType width,
+                                           IceTSizeType height)
 {
-    ICET_TEST_IMAGE_HEADER(image);
+    IceTSizeType size;
 
-    if (icetImageIsNull(image)) {
-        icetRaiseError("Cannot set number of pixels on null image.",
-                       ICET_INVALID_VALUE);
-        return;
-    }
+    size = (  ICET_IMAGE_HEADER_SIZE
+            + sparseDataMaxSize(sparseDataPixelSize(color_format,
+                                                    depth_format),
+                                width*height)
+            + width*height*sparseDepthPlanePixelSize(color_format,
+                                                     depth_format) );
 
-    if (   width*height
-         > ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX] ){
-        icetRaiseError("Cannot set an image size to greater than what the"
-                       " image was originally created.", ICET_INVALID_VALUE);
-        return;
-    }
+    /* Leave room for a seek table after the data. */
+    size += SEEK_TABLE_SIZE(width*height);
 
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX] = (IceTInt)width;
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] = (IceTInt)height;
-    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
-        == ICET_IMAGE_MAGIC_NUM) {
-        ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
-              = (IceTInt)icetImageBufferSizeType(icetImageGetColorFormat(image),
-                                                 icetImageGetDepthFormat(image),
-                                                 width,
-                                                 height);
-    }
+    return size;
 }
 
-void icetSparseImageSetDimensions(IceTSparseImage image,
+IceTImage icetGetStateBufferImage(IceTEnum pname,
                                   IceTSizeType width,
                                   IceTSizeType height)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
-
-    if (image.opaque_internals == NULL) {
-        icetRaiseError("Cannot set number of pixels on null image.",
-                       ICET_INVALID_VALUE);
-        return;
-    }
-
-    if (   width*height
-         > ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX] ){
-        icetRaiseError("Cannot set an image size to greater than what the"
-                       " image was originally created.", ICET_INVALID_VALUE);
-        return;
-    }
+    IceTVoid *buffer;
+    IceTSizeType buffer_size;
 
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX] = (IceTInt)width;
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] = (IceTInt)height;
+    buffer_size = icetImageBufferSize(width, height);
+    buffer = icetGetStateBuffer(pname, buffer_size);
 
-  /* Make sure the runlengths are valid. */
-    icetClearSparseImage(image);
+    return icetImageAssignBuffer(buffer, width, height);
 }
 
-static void icetSparseImageSetActualSize(IceTSparseImage image,
-                                         const IceTVoid *data_end)
+IceTImage icetRetrieveStateImage(IceTEnum pname)
 {
-    /* Compute the actual number of bytes used to store the image. */
-    IceTPointerArithmetic buffer_begin
-        =(IceTPointerArithmetic)ICET_IMAGE_HEADER(image);
-    IceTPointerArithmetic buffer_end
-        =(IceTPointerArithmetic)data_end;
-    IceTPointerArithmetic compressed_size = buffer_end - buffer_begin;
-    ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
-        = (IceTInt)compressed_size;
+    return icetImageUnpackageFromReceive(
+                (IceTVoid *)icetUnsafeStateGetBuffer(pname));
 }
 
-const IceTVoid *icetImageGetColorConstVoid(const IceTImage image,
-                                           IceTSizeType *pixel_size)
-{
-    if (pixel_size) {
-        IceTEnum color_format = icetImageGetColorFormat(image);
-        *pixel_size = colorPixelSize(color_format);
-    }
-
-    switch (ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]) {
-    case ICET_IMAGE_MAGIC_NUM:
-        return ICET_IMAGE_DATA(image);
-    case ICET_IMAGE_POINTERS_MAGIC_NUM:
-        return ((const IceTVoid **)ICET_IMAGE_DATA(image))[0];
-    default:
-        icetRaiseError("Detected invalid image header.",
-                       ICET_SANITY_CHECK_FAIL);
-        return NULL;
-    }
-}
-IceTVoid *icetImageGetColorVoid(IceTImage image, IceTSizeType *pixel_size)
+IceTImage icetGetStatePointerImage(IceTEnum pname,
+                                   IceTSizeType width,
+                                   IceTSizeType height,
+                                   const IceTVoid *color_buffer,
+                                   const IceTVoid *depth_buffer)
 {
-    const IceTVoid *const_buffer = icetImageGetColorConstVoid(image, pixel_size);
+    IceTVoid *buffer;
+    IceTSizeType buffer_size;
 
-    /* Raise an exception for images made of pointers, which we set as constant
-     * since all internally made pointers are single buffers. */
-    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
-        == ICET_IMAGE_POINTERS_MAGIC_NUM) {
-        icetRaiseError("Images of pointers are for reading only.",
-                       ICET_SANITY_CHECK_FAIL);
-    }
+    buffer_size = icetImagePointerBufferSize();
+    buffer = icetGetStateBuffer(pname, buffer_size);
 
-    /* This const cast is OK because we actually got the pointer from a
-       non-const image. */
-    return (IceTVoid *)const_buffer;
+    return icetImagePointerAssignBuffer(
+                buffer, width, height, color_buffer, depth_buffer);
 }
 
-const IceTUByte *icetImageGetColorcub(const IceTImage image)
+IceTImage icetImageAssignBuffer(IceTVoid *buffer,
+                                IceTSizeType width,
+                                IceTSizeType height)
 {
-    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum color_format, depth_format;
 
-    if (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
-        icetRaiseError("Color format is not of type ubyte.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
-    }
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
 
-    return icetImageGetColorConstVoid(image, NULL);
+    return imageAssignBufferType(buffer,
+                                 color_format,
+                                 depth_format,
+                                 width,
+                                 height);
 }
-IceTUByte *icetImageGetColorub(IceTImage image)
-{
-    IceTEnum color_format = icetImageGetColorFormat(image);
-
-    if (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
-        icetRaiseError("Color format is not of type ubyte.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
-    }
 
-    return icetImageGetColorVoid(image, NULL);
-}
-const IceTUInt *icetImageGetColorcui(const IceTImage image)
-{
-    return (const IceTUInt *)icetImageGetColorcub(image);
-}
-IceTUInt *icetImageGetColorui(IceTImage image)
-{
-    return (IceTUInt *)icetImageGetColorub(image);
-}
-const IceTFloat *icetImageGetColorcf(const IceTImage image)
+static IceTImage imageAssignBufferType(IceTVoid *buffer,
+                                       IceTEnum color_format,
+                                       IceTEnum depth_format,
+                                       IceTSizeType width,
+                                       IceTSizeType height)
 {
-    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTImage image;
+    IceTInt *header;
 
-    if (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT) {
-        icetRaiseError("Color format is not of type float.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
+    image.opaque_internals = buffer;
+
+    if (buffer == NULL) {
+        icetRaiseError("Tried to create image with NULL buffer.",
+                       ICET_INVALID_VALUE);
+        return icetImageNull();
     }
 
-    return icetImageGetColorConstVoid(image, NULL);
-}
-IceTFloat *icetImageGetColorf(IceTImage image)
-{
-    IceTEnum color_format = icetImageGetColorFormat(image);
+    header = ICET_IMAGE_HEADER(image);
 
-    if (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT) {
-        icetRaiseError("Color format is not of type float.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
+    if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+        && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+        && (color_format != ICET_IMAGE_COLOR_R_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_RG_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_R_UINT)
+        && (accumulationChannels(color_format) == 0)
+        && (color_format != ICET_IMAGE_COLOR_NONE) ) {
+        icetRaiseError("Invalid color format.", ICET_INVALID_ENUM);
+        color_format = ICET_IMAGE_COLOR_NONE;
+    }
+    if (   (depth_format != ICET_IMAGE_DEPTH_FLOAT)
+        && (depth_format != ICET_IMAGE_DEPTH_HALF)
+        && (depth_format != ICET_IMAGE_DEPTH_UNORM24)
+        && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
+        icetRaiseError("Invalid depth format.", ICET_INVALID_ENUM);
+        depth_format = ICET_IMAGE_DEPTH_NONE;
     }
 
-    return icetImageGetColorVoid(image, NULL);
+    memset(header, 0, ICET_IMAGE_HEADER_SIZE);
+    header[ICET_IMAGE_MAGIC_NUM_INDEX]          = ICET_IMAGE_MAGIC_NUM;
+    header[ICET_IMAGE_COLOR_FORMAT_INDEX]       = color_format;
+    header[ICET_IMAGE_DEPTH_FORMAT_INDEX]       = depth_format;
+    header[ICET_IMAGE_WIDTH_INDEX]              = (IceTInt)width;
+    header[ICET_IMAGE_HEIGHT_INDEX]             = (IceTInt)height;
+    header[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]     = (IceTInt)(width*height);
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
+        = icetImageBufferSizeType(color_format, depth_format, width, height);
+
+    return image;
 }
 
-const IceTVoid *icetImageGetDepthConstVoid(const IceTImage image,
-                                           IceTSizeType *pixel_size)
+IceTImage icetImagePointerAssignBuffer(IceTVoid *buffer,
+                                       IceTSizeType width,
+                                       IceTSizeType height,
+                                       const IceTVoid *color_buffer,
+                                       const IceTVoid *depth_buffer)
 {
-    IceTEnum color_format = icetImageGetColorFormat(image);
-
-    if (pixel_size) {
-        IceTEnum depth_format = icetImageGetDepthFormat(image);
-        *pixel_size = depthPixelSize(depth_format);
-    }
+    /* This is a bit hacky, but most of the entries for regular images and
+     * pointer images are the same. Use that function to fill in most of
+     * the entries and fix those that are different. */
+    IceTImage image = icetImageAssignBuffer(buffer, width, height);
 
-    switch (ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]) {
-    case ICET_IMAGE_MAGIC_NUM:
     {
-        IceTSizeType color_format_bytes = (  icetImageGetNumPixels(image)
-                                           * colorPixelSize(color_format) );
-
-        /* Cast to IceTByte to ensure pointer arithmetic is correct. */
-        const IceTByte *image_data_pointer =
-                (const IceTByte*)ICET_IMAGE_DATA(image);
+        IceTInt *header = ICET_IMAGE_HEADER(image);
+        /* Our magic number is different. */
+        header[ICET_IMAGE_MAGIC_NUM_INDEX] = ICET_IMAGE_POINTERS_MAGIC_NUM;
+        /* It is invalid to use this type of image as a single buffer. */
+        ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
+            = -1;
+    }
 
-        return image_data_pointer + color_format_bytes;
+    /* Check that the image buffers make sense. */
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_NONE) {
+        if (color_buffer != NULL) {
+            icetRaiseError(
+                "Given a color buffer when color format is set to none.",
+                ICET_INVALID_VALUE);
+        }
+    } else {
+        if (color_buffer == NULL) {
+            icetRaiseError(
+                "Not given a color buffer when color format requires one.",
+                ICET_INVALID_VALUE);
+        }
     }
-    case ICET_IMAGE_POINTERS_MAGIC_NUM:
-        return ((const IceTVoid **)ICET_IMAGE_DATA(image))[1];
-    default:
-        icetRaiseError("Detected invalid image header.",
-                       ICET_SANITY_CHECK_FAIL);
-        return NULL;
+    if (icetImageGetDepthFormat(image) == ICET_IMAGE_DEPTH_NONE) {
+        if (depth_buffer != NULL) {
+            icetRaiseError(
+                "Given a depth buffer when depth format is set to none.",
+                ICET_INVALID_VALUE);
+        }
+    } else {
+        if (depth_buffer == NULL) {
+            icetRaiseError(
+                "Not given a depth buffer when depth format requires one.",
+                ICET_INVALID_VALUE);
+        }
     }
-}
-IceTVoid *icetImageGetDepthVoid(IceTImage image, IceTSizeType *pixel_size)
-{
-    const IceTVoid *const_buffer =icetImageGetDepthConstVoid(image, pixel_size);
 
-    /* Raise an exception for images made of pointers, which we set as constant
-     * since all internally made pointers are single buffers. */
-    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
-        == ICET_IMAGE_POINTERS_MAGIC_NUM) {
-        icetRaiseError("Images of pointers are for reading only.",
-                       ICET_SANITY_CHECK_FAIL);
+    {
+        const IceTVoid **data = ICET_IMAGE_DATA(image);
+        data[0] = color_buffer;
+        data[1] = depth_buffer;
     }
 
-    /* This const cast is OK because we actually got the pointer from a
-       non-const image. */
-    return (IceTVoid *)const_buffer;
+    return image;
 }
-const IceTFloat *icetImageGetDepthcf(const IceTImage image)
+
+IceTImage icetImageNull(void)
 {
-    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTImage image;
+    image.opaque_internals = NULL;
+    return image;
+}
 
-    if (depth_format != ICET_IMAGE_DEPTH_FLOAT) {
-        icetRaiseError("Depth format is not of type float.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
+IceTBoolean icetImageIsNull(const IceTImage image)
+{
+    if (image.opaque_internals == NULL) {
+        return ICET_TRUE;
+    } else {
+        return ICET_FALSE;
     }
-
-    return icetImageGetDepthConstVoid(image, NULL);
 }
-IceTFloat *icetImageGetDepthf(IceTImage image)
+
+IceTSparseImage icetGetStateBufferSparseImage(IceTEnum pname,
+                                              IceTSizeType width,
+                                              IceTSizeType height)
 {
-    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTVoid *buffer;
+    IceTSizeType buffer_size;
 
-    if (depth_format != ICET_IMAGE_DEPTH_FLOAT) {
-        icetRaiseError("Depth format is not of type float.",
-                       ICET_INVALID_OPERATION);
-        return NULL;
-    }
+    buffer_size = icetSparseImageBufferSize(width, height);
+    buffer = icetGetStateBuffer(pname, buffer_size);
 
-    return icetImageGetDepthVoid(image, NULL);
+    return icetSparseImageAssignBuffer(buffer, width, height);
 }
 
-void icetImageCopyColorub(const IceTImage image,
-                          IceTUByte *color_buffer,
-                          IceTEnum out_color_format)
+IceTSparseImage icetSparseImageAssignBuffer(IceTVoid *buffer,
+                                            IceTSizeType width,
+                                            IceTSizeType height)
 {
-    IceTEnum in_color_format = icetImageGetColorFormat(image);
+    IceTSparseImage image;
+    IceTEnum color_format, depth_format;
+    IceTInt *header;
 
-    if (out_color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
+    image.opaque_internals = buffer;
+
+    if (buffer == NULL) {
+        icetRaiseError("Tried to create sparse image with NULL buffer.",
+                       ICET_INVALID_VALUE);
+        return image;
+    }
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+
+    header = ICET_IMAGE_HEADER(image);
+
+    if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+        && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+        && (color_format != ICET_IMAGE_COLOR_R_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_RG_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_R_UINT)
+        && (accumulationChannels(color_format) == 0)
+        && (color_format != ICET_IMAGE_COLOR_NONE) ) {
+        icetRaiseError("Invalid color format.", ICET_INVALID_ENUM);
+        color_format = ICET_IMAGE_COLOR_NONE;
+    }
+    if (   (depth_format != ICET_IMAGE_DEPTH_FLOAT)
+        && (depth_format != ICET_IMAGE_DEPTH_HALF)
+        && (depth_format != ICET_IMAGE_DEPTH_UNORM24)
+        && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
+        icetRaiseError("Invalid depth format.", ICET_INVALID_ENUM);
+        depth_format = ICET_IMAGE_DEPTH_NONE;
+    }
+
+    memset(header, 0, ICET_IMAGE_HEADER_SIZE);
+    header[ICET_IMAGE_MAGIC_NUM_INDEX]          = ICET_SPARSE_IMAGE_MAGIC_NUM;
+    header[ICET_IMAGE_COLOR_FORMAT_INDEX]       = color_format;
+    header[ICET_IMAGE_DEPTH_FORMAT_INDEX]       = depth_format;
+    header[ICET_IMAGE_WIDTH_INDEX]              = (IceTInt)width;
+    header[ICET_IMAGE_HEIGHT_INDEX]             = (IceTInt)height;
+    header[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]     = (IceTInt)(width*height);
+
+  /* Make sure the runlengths are valid. */
+    icetClearSparseImage(image);
+
+    return image;
+}
+
+IceTSparseImage icetSparseImageNull(void)
+{
+    IceTSparseImage image;
+    image.opaque_internals = NULL;
+    return image;
+}
+
+IceTBoolean icetSparseImageIsNull(const IceTSparseImage image)
+{
+    if (image.opaque_internals == NULL) {
+        return ICET_TRUE;
+    } else {
+        return ICET_FALSE;
+    }
+}
+
+void icetImageAdjustForOutput(IceTImage image)
+{
+    IceTEnum color_format;
+
+    if (icetImageIsNull(image)) return;
+
+    ICET_TEST_IMAGE_HEADER(image);
+
+    if (icetIsEnabled(ICET_COMPOSITE_ONE_BUFFER)) {
+        color_format = icetImageGetColorFormat(image);
+        if (color_format != ICET_IMAGE_COLOR_NONE) {
+          /* Set to no depth information. */
+            ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX]
+                = ICET_IMAGE_DEPTH_NONE;
+          /* Reset the image size (changes actual buffer size). */
+            icetImageSetDimensions(image,
+                                   icetImageGetWidth(image),
+                                   icetImageGetHeight(image));
+        }
+    }
+}
+
+void icetImageAdjustForInput(IceTImage image)
+{
+    IceTEnum color_format, depth_format;
+
+    if (icetImageIsNull(image)) return;
+
+    ICET_TEST_IMAGE_HEADER(image);
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+
+  /* Reset to the specified image format. */
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX] = color_format;
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX] = depth_format;
+
+  /* Reset the image size (changes actual buffer size). */
+    icetImageSetDimensions(image,
+                           icetImageGetWidth(image),
+                           icetImageGetHeight(image));
+}
+
+IceTEnum icetImageGetColorFormat(const IceTImage image)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return ICET_IMAGE_COLOR_NONE;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX];
+}
+IceTEnum icetImageGetDepthFormat(const IceTImage image)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return ICET_IMAGE_DEPTH_NONE;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX];
+}
+IceTSizeType icetImageGetWidth(const IceTImage image)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX];
+}
+IceTSizeType icetImageGetHeight(const IceTImage image)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX];
+}
+IceTSizeType icetImageGetNumPixels(const IceTImage image)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return (  (IceTSizeType)ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX]
+            * ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] );
+}
+
+IceTEnum icetSparseImageGetColorFormat(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return ICET_IMAGE_COLOR_NONE;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_COLOR_FORMAT_INDEX];
+}
+IceTEnum icetSparseImageGetDepthFormat(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return ICET_IMAGE_DEPTH_NONE;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_DEPTH_FORMAT_INDEX];
+}
+IceTSizeType icetSparseImageGetWidth(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX];
+}
+IceTSizeType icetSparseImageGetHeight(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX];
+}
+IceTSizeType icetSparseImageGetNumPixels(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return (  (IceTSizeType)ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX]
+            * ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] );
+}
+IceTSizeType icetSparseImageGetCompressedBufferSize(
+                                             const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    return ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+}
+
+IceTSizeType icetSparseImageGetActiveCount(const IceTSparseImage image)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) return 0;
+    if (ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] < 0) {
+        icetSparseImageFindActiveBounds(image);
+    }
+    return ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX];
+}
+
+void icetSparseImageGetActiveViewport(const IceTSparseImage image,
+                                      IceTInt *viewport)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (!image.opaque_internals) {
+        viewport[0] = viewport[1] = viewport[2] = viewport[3] = 0;
+        return;
+    }
+    if (icetSparseImageGetActiveCount(image) < 0) {
+        /* The run lengths are bad, so anything may be active. */
+        viewport[0] = viewport[1] = 0;
+        viewport[2] = (IceTInt)icetSparseImageGetWidth(image);
+        viewport[3] = (IceTInt)icetSparseImageGetHeight(image);
+        return;
+    }
+    memcpy(viewport,
+           ICET_IMAGE_HEADER(image) + ICET_IMAGE_ACTIVE_VIEWPORT_INDEX,
+           4*sizeof(IceTInt));
+}
+
+void icetImageSetDimensions(IceTImage image,
+                            IceTSizeType width,
+                            IceTSizeType height)
+{
+    ICET_TEST_IMAGE_HEADER(image);
+
+    if (icetImageIsNull(image)) {
+        icetRaiseError("Cannot set number of pixels on null image.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    if (   width*height
+         > ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX] ){
+        icetRaiseError("Cannot set an image size to greater than what the"
+                       " image was originally created.", ICET_INVALID_VALUE);
+        return;
+    }
+
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX] = (IceTInt)width;
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] = (IceTInt)height;
+    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        == ICET_IMAGE_MAGIC_NUM) {
+        ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
+            = icetImageBufferSizeType(icetImageGetColorFormat(image),
+                                      icetImageGetDepthFormat(image),
+                                      width,
+                                      height);
+    }
+}
+
+void icetSparseImageSetDimensions(IceTSparseImage image,
+                                  IceTSizeType width,
+                                  IceTSizeType height)
+{
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+
+    if (image.opaque_internals == NULL) {
+        icetRaiseError("Cannot set number of pixels on null image.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    if (   width*height
+         > ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX] ){
+        icetRaiseError("Cannot set an image size to greater than what the"
+                       " image was originally created.", ICET_INVALID_VALUE);
+        return;
+    }
+
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_WIDTH_INDEX] = (IceTInt)width;
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_HEIGHT_INDEX] = (IceTInt)height;
+
+  /* Make sure the runlengths are valid. */
+    icetClearSparseImage(image);
+}
+
+static void icetSparseImageSetActualSize(IceTSparseImage image,
+                                         const IceTVoid *data_end)
+{
+    /* Compute the actual number of bytes used to store the image. */
+    IceTPointerArithmetic buffer_begin
+        =(IceTPointerArithmetic)ICET_IMAGE_HEADER(image);
+    IceTPointerArithmetic buffer_end
+        =(IceTPointerArithmetic)data_end;
+    IceTPointerArithmetic compressed_size = buffer_end - buffer_begin;
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX]
+        = (IceTSizeType)compressed_size;
+    /* Any seek table or depth plane no longer matches the data. */
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_DEPTH_PLANE_INDEX] = 0;
+    /* Nor do the active bounds. */
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] = -1;
+}
+
+static const IceTVoid *icetSparseImageGetDepthPlane(
+                                                  const IceTSparseImage image)
+{
+    IceTSizeType plane_offset
+        = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_DEPTH_PLANE_INDEX];
+    if (plane_offset == 0) return NULL;
+    return (const IceTByte *)ICET_IMAGE_HEADER(image) + plane_offset;
+}
+
+static IceTVoid *icetSparseImageDepthStage(IceTSparseImage image)
+{
+    IceTSizeType pixel_size
+        = sparseDataPixelSize(icetSparseImageGetColorFormat(image),
+                              icetSparseImageGetDepthFormat(image));
+    return (  (IceTByte *)ICET_IMAGE_DATA(image)
+            + sparseDataMaxSize(
+                  pixel_size,
+                  ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]) );
+}
+
+static void icetSparseImageAppendDepths(IceTSparseImage image,
+                                        const IceTVoid *depths,
+                                        const IceTVoid *depths_end)
+{
+    IceTSizeType *size_header = ICET_IMAGE_SIZE_HEADER(image);
+    IceTSizeType num_bytes
+        = (IceTSizeType)(  (IceTPointerArithmetic)depths_end
+                         - (IceTPointerArithmetic)depths );
+
+    if (size_header[ICET_IMAGE_DEPTH_PLANE_INDEX] == 0) {
+        size_header[ICET_IMAGE_DEPTH_PLANE_INDEX]
+            = size_header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    }
+    if (num_bytes > 0) {
+        memmove(  (IceTByte *)ICET_IMAGE_HEADER(image)
+                + size_header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX],
+                depths,
+                num_bytes);
+        size_header[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] += num_bytes;
+    }
+    /* The seek table, if any, was after the old end of the data. */
+    size_header[ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+}
+
+const IceTVoid *icetImageGetColorConstVoid(const IceTImage image,
+                                           IceTSizeType *pixel_size)
+{
+    if (pixel_size) {
+        IceTEnum color_format = icetImageGetColorFormat(image);
+        *pixel_size = colorPixelSize(color_format);
+    }
+
+    switch (ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]) {
+    case ICET_IMAGE_MAGIC_NUM:
+        return ICET_IMAGE_DATA(image);
+    case ICET_IMAGE_POINTERS_MAGIC_NUM:
+        return ((const IceTVoid **)ICET_IMAGE_DATA(image))[0];
+    default:
+        icetRaiseError("Detected invalid image header.",
+                       ICET_SANITY_CHECK_FAIL);
+        return NULL;
+    }
+}
+IceTVoid *icetImageGetColorVoid(IceTImage image, IceTSizeType *pixel_size)
+{
+    const IceTVoid *const_buffer = icetImageGetColorConstVoid(image, pixel_size);
+
+    /* Raise an exception for images made of pointers, which we set as constant
+     * since all internally made pointers are single buffers. */
+    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        == ICET_IMAGE_POINTERS_MAGIC_NUM) {
+        icetRaiseError("Images of pointers are for reading only.",
+                       ICET_SANITY_CHECK_FAIL);
+    }
+
+    /* This const cast is OK because we actually got the pointer from a
+       non-const image. */
+    return (IceTVoid *)const_buffer;
+}
+
+const IceTUByte *icetImageGetColorcub(const IceTImage image)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+
+    if (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        icetRaiseError("Color format is not of type ubyte.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetColorConstVoid(image, NULL);
+}
+IceTUByte *icetImageGetColorub(IceTImage image)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+
+    if (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        icetRaiseError("Color format is not of type ubyte.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetColorVoid(image, NULL);
+}
+const IceTUInt *icetImageGetColorcui(const IceTImage image)
+{
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_R_UINT) {
+        return icetImageGetColorConstVoid(image, NULL);
+    }
+    return (const IceTUInt *)icetImageGetColorcub(image);
+}
+IceTUInt *icetImageGetColorui(IceTImage image)
+{
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_R_UINT) {
+        return icetImageGetColorVoid(image, NULL);
+    }
+    return (IceTUInt *)icetImageGetColorub(image);
+}
+const IceTFloat *icetImageGetColorcf(const IceTImage image)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+
+    if (   (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (scalarColorChannels(color_format) == 0) ) {
+        icetRaiseError("Color format is not of type float.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetColorConstVoid(image, NULL);
+}
+IceTFloat *icetImageGetColorf(IceTImage image)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+
+    if (   (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (scalarColorChannels(color_format) == 0) ) {
+        icetRaiseError("Color format is not of type float.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetColorVoid(image, NULL);
+}
+
+const IceTVoid *icetImageGetDepthConstVoid(const IceTImage image,
+                                           IceTSizeType *pixel_size)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+
+    if (pixel_size) {
+        IceTEnum depth_format = icetImageGetDepthFormat(image);
+        *pixel_size = depthPixelSize(depth_format);
+    }
+
+    switch (ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]) {
+    case ICET_IMAGE_MAGIC_NUM:
+    {
+        IceTSizeType color_format_bytes = (  icetImageGetNumPixels(image)
+                                           * colorPixelSize(color_format) );
+
+        /* Cast to IceTByte to ensure pointer arithmetic is correct. */
+        const IceTByte *image_data_pointer =
+                (const IceTByte*)ICET_IMAGE_DATA(image);
+
+        return image_data_pointer + color_format_bytes;
+    }
+    case ICET_IMAGE_POINTERS_MAGIC_NUM:
+        return ((const IceTVoid **)ICET_IMAGE_DATA(image))[1];
+    default:
+        icetRaiseError("Detected invalid image header.",
+                       ICET_SANITY_CHECK_FAIL);
+        return NULL;
+    }
+}
+IceTVoid *icetImageGetDepthVoid(IceTImage image, IceTSizeType *pixel_size)
+{
+    const IceTVoid *const_buffer =icetImageGetDepthConstVoid(image, pixel_size);
+
+    /* Raise an exception for images made of pointers, which we set as constant
+     * since all internally made pointers are single buffers. */
+    if (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        == ICET_IMAGE_POINTERS_MAGIC_NUM) {
+        icetRaiseError("Images of pointers are for reading only.",
+                       ICET_SANITY_CHECK_FAIL);
+    }
+
+    /* This const cast is OK because we actually got the pointer from a
+       non-const image. */
+    return (IceTVoid *)const_buffer;
+}
+const IceTFloat *icetImageGetDepthcf(const IceTImage image)
+{
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+
+    if (depth_format != ICET_IMAGE_DEPTH_FLOAT) {
+        icetRaiseError("Depth format is not of type float.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetDepthConstVoid(image, NULL);
+}
+IceTFloat *icetImageGetDepthf(IceTImage image)
+{
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+
+    if (depth_format != ICET_IMAGE_DEPTH_FLOAT) {
+        icetRaiseError("Depth format is not of type float.",
+                       ICET_INVALID_OPERATION);
+        return NULL;
+    }
+
+    return icetImageGetDepthVoid(image, NULL);
+}
+
+void icetImageCopyColorub(const IceTImage image,
+                          IceTUByte *color_buffer,
+                          IceTEnum out_color_format)
+{
+    IceTEnum in_color_format = icetImageGetColorFormat(image);
+
+    if (out_color_format != ICET_IMAGE_COLOR_RGBA_UBYTE) {
         icetRaiseError("Color format is not of type ubyte.",
                        ICET_INVALID_ENUM);
         return;
@@ -937,6 +1973,50 @@ void icetImageCopyColorub(const IceTImage image,
              i++, in++, out++) {
             out[0] = (IceTUByte)(255*in[0]);
         }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_HALF)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
+        const IceTUShort *in_buffer = icetImageGetColorConstVoid(image, NULL);
+        IceTSizeType num_values = 4*icetImageGetNumPixels(image);
+        IceTFloat converted[ICET_HALF_CONVERT_CHUNK];
+        IceTSizeType start;
+        for (start = 0; start < num_values; start += ICET_HALF_CONVERT_CHUNK) {
+            IceTSizeType count = num_values - start;
+            IceTSizeType i;
+            if (count > ICET_HALF_CONVERT_CHUNK) {
+                count = ICET_HALF_CONVERT_CHUNK;
+            }
+            icetSIMDHalfToFloat(in_buffer + start, converted, count);
+            for (i = 0; i < count; i++) {
+                color_buffer[start + i] = (IceTUByte)(255*converted[i]);
+            }
+        }
+    } else if (   (scalarColorChannels(in_color_format) > 0)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
+        const IceTFloat *in_buffer = icetImageGetColorcf(image);
+        IceTSizeType num_channels = scalarColorChannels(in_color_format);
+        IceTSizeType num_pixels = icetImageGetNumPixels(image);
+        IceTSizeType i;
+        IceTFloat rgba[4];
+        for (i = 0; i < num_pixels; i++) {
+            colorExpandFloat(in_buffer + num_channels*i, num_channels, rgba);
+            color_buffer[4*i + 0] = (IceTUByte)(255*rgba[0]);
+            color_buffer[4*i + 1] = (IceTUByte)(255*rgba[1]);
+            color_buffer[4*i + 2] = (IceTUByte)(255*rgba[2]);
+            color_buffer[4*i + 3] = (IceTUByte)(255*rgba[3]);
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_R_UINT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
+        /* Counts are clamped to 255 in the red channel. */
+        const IceTUInt *in_buffer = icetImageGetColorcui(image);
+        IceTSizeType num_pixels = icetImageGetNumPixels(image);
+        IceTSizeType i;
+        for (i = 0; i < num_pixels; i++) {
+            color_buffer[4*i + 0]
+                = (IceTUByte)((in_buffer[i] < 255) ? in_buffer[i] : 255);
+            color_buffer[4*i + 1] = 0;
+            color_buffer[4*i + 2] = 0;
+            color_buffer[4*i + 3] = 255;
+        }
     } else {
         icetRaiseError("Encountered unexpected color format combination.",
                        ICET_SANITY_CHECK_FAIL);
@@ -949,7 +2029,9 @@ void icetImageCopyColorf(const IceTImage image,
 {
     IceTEnum in_color_format = icetImageGetColorFormat(image);
 
-    if (out_color_format != ICET_IMAGE_COLOR_RGBA_FLOAT) {
+    if (   (out_color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (   (out_color_format != in_color_format)
+            || (scalarColorChannels(out_color_format) == 0) ) ) {
         icetRaiseError("Color format is not of type float.",
                        ICET_INVALID_ENUM);
         return;
@@ -976,6 +2058,35 @@ void icetImageCopyColorf(const IceTImage image,
              i++, in++, out++) {
             out[0] = (IceTFloat)in[0]/255.0f;
         }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_HALF)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
+        const IceTUShort *in_buffer = icetImageGetColorConstVoid(image, NULL);
+        icetSIMDHalfToFloat(in_buffer,
+                            color_buffer,
+                            4*icetImageGetNumPixels(image));
+    } else if (   (scalarColorChannels(in_color_format) > 0)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
+        const IceTFloat *in_buffer = icetImageGetColorcf(image);
+        IceTSizeType num_channels = scalarColorChannels(in_color_format);
+        IceTSizeType num_pixels = icetImageGetNumPixels(image);
+        IceTSizeType i;
+        for (i = 0; i < num_pixels; i++) {
+            colorExpandFloat(in_buffer + num_channels*i,
+                             num_channels,
+                             color_buffer + 4*i);
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_R_UINT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
+        /* Counts are converted to float in the red channel. */
+        const IceTUInt *in_buffer = icetImageGetColorcui(image);
+        IceTSizeType num_pixels = icetImageGetNumPixels(image);
+        IceTSizeType i;
+        for (i = 0; i < num_pixels; i++) {
+            color_buffer[4*i + 0] = (IceTFloat)in_buffer[i];
+            color_buffer[4*i + 1] = 0.0f;
+            color_buffer[4*i + 2] = 0.0f;
+            color_buffer[4*i + 3] = 1.0f;
+        }
     } else {
         icetRaiseError("Unexpected format combination.",
                        ICET_SANITY_CHECK_FAIL);
@@ -999,13 +2110,21 @@ void icetImageCopyDepthf(const IceTImage image,
         return;
     }
 
-  /* Currently only possibility is
-     in_color_format == out_color_format == ICET_IMAGE_DEPTH_FLOAT. */
-    {
+    if (in_depth_format == ICET_IMAGE_DEPTH_FLOAT) {
         const IceTFloat *in_buffer = icetImageGetDepthcf(image);
         IceTSizeType depth_format_bytes = (  icetImageGetNumPixels(image)
                                            * depthPixelSize(in_depth_format) );
         memcpy(depth_buffer, in_buffer, depth_format_bytes);
+    } else {
+        /* Half and 24-bit depths are expanded to float. */
+        const IceTByte *in_buffer = icetImageGetDepthConstVoid(image, NULL);
+        IceTSizeType depth_size = depthPixelSize(in_depth_format);
+        IceTSizeType num_pixels = icetImageGetNumPixels(image);
+        IceTSizeType i;
+        for (i = 0; i < num_pixels; i++) {
+            depth_buffer[i] = depthToFloat(in_depth_format,
+                                           in_buffer + i*depth_size);
+        }
     }
 }
 
@@ -1208,38 +2327,104 @@ void icetImageClearAroundRegion(IceTImage image, const IceTInt *region)
                 color_buffer[4*(y*width + x) + 3] = background_color[3];
             }
         }
-    } else if (color_format != ICET_IMAGE_COLOR_NONE) {
-        icetRaiseError("Invalid color format.", ICET_SANITY_CHECK_FAIL);
-    }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        IceTUShort *color_buffer = icetImageGetColorVoid(image, NULL);
+        IceTUShort background_color[4];
 
-    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
-        IceTFloat *depth_buffer = icetImageGetDepthf(image);
+        getBackgroundColorHalf(ICET_BACKGROUND_COLOR, background_color);
 
       /* Clear out bottom. */
-        for (y = 0; y < region[1]; y++) {
-            for (x = 0; x < width; x++) {
-                depth_buffer[y*width + x] = 1.0f;
+        colorFillHalf(color_buffer, background_color, region[1]*width);
+      /* Clear out left and right. */
+        if ((region[0] > 0) || (region[0]+region[2] < width)) {
+            for (y = region[1]; y < region[1]+region[3]; y++) {
+                IceTUShort *row = color_buffer + 4*y*width;
+                colorFillHalf(row, background_color, region[0]);
+                colorFillHalf(row + 4*(region[0]+region[2]),
+                              background_color,
+                              width - (region[0]+region[2]));
             }
         }
+      /* Clear out top. */
+        colorFillHalf(color_buffer + 4*(region[1]+region[3])*width,
+                      background_color,
+                      (height - (region[1]+region[3]))*width);
+    } else if (scalarColorChannels(color_format) > 0) {
+        IceTFloat *color_buffer = icetImageGetColorf(image);
+        IceTSizeType num_channels = scalarColorChannels(color_format);
+        IceTFloat background_color[4];
+
+        icetGetFloatv(ICET_BACKGROUND_COLOR, background_color);
+
+      /* Clear out bottom. */
+        colorFillFloat(color_buffer,
+                       background_color,
+                       num_channels,
+                       region[1]*width);
       /* Clear out left and right. */
         if ((region[0] > 0) || (region[0]+region[2] < width)) {
             for (y = region[1]; y < region[1]+region[3]; y++) {
-                for (x = 0; x < region[0]; x++) {
-                    depth_buffer[y*width + x] = 1.0f;
-                }
-                for (x = region[0]+region[2]; x < width; x++) {
-                    depth_buffer[y*width + x] = 1.0f;
-                }
+                IceTFloat *row = color_buffer + num_channels*y*width;
+                colorFillFloat(row, background_color, num_channels, region[0]);
+                colorFillFloat(row + num_channels*(region[0]+region[2]),
+                               background_color,
+                               num_channels,
+                               width - (region[0]+region[2]));
             }
         }
       /* Clear out top. */
-        for (y = region[1]+region[3]; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                depth_buffer[y*width + x] = 1.0f;
+        colorFillFloat(color_buffer + num_channels*(region[1]+region[3])*width,
+                       background_color,
+                       num_channels,
+                       (height - (region[1]+region[3]))*width);
+    } else if (zeroInactiveColorFormat(color_format)) {
+        /* Use IceTByte for byte-based pointer arithmetic. */
+        IceTByte *color_buffer = icetImageGetColorVoid(image, NULL);
+        IceTSizeType color_size = colorPixelSize(color_format);
+
+      /* Clear out bottom. */
+        colorFillValues(color_format, color_buffer, NULL, region[1]*width);
+      /* Clear out left and right. */
+        if ((region[0] > 0) || (region[0]+region[2] < width)) {
+            for (y = region[1]; y < region[1]+region[3]; y++) {
+                IceTByte *row = color_buffer + color_size*y*width;
+                colorFillValues(color_format, row, NULL, region[0]);
+                colorFillValues(color_format,
+                                row + color_size*(region[0]+region[2]),
+                                NULL,
+                                width - (region[0]+region[2]));
             }
         }
-    } else if (depth_format != ICET_IMAGE_DEPTH_NONE) {
-        icetRaiseError("Invalid depth format.", ICET_SANITY_CHECK_FAIL);
+      /* Clear out top. */
+        colorFillValues(color_format,
+                        color_buffer + color_size*(region[1]+region[3])*width,
+                        NULL,
+                        (height - (region[1]+region[3]))*width);
+    } else if (color_format != ICET_IMAGE_COLOR_NONE) {
+        icetRaiseError("Invalid color format.", ICET_SANITY_CHECK_FAIL);
+    }
+
+    if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+        /* Use IceTByte for byte-based pointer arithmetic. */
+        IceTByte *depth_buffer = icetImageGetDepthVoid(image, NULL);
+        IceTSizeType depth_size = depthPixelSize(depth_format);
+
+      /* Clear out bottom. */
+        depthFillInactive(depth_format, depth_buffer, region[1]*width);
+      /* Clear out left and right. */
+        if ((region[0] > 0) || (region[0]+region[2] < width)) {
+            for (y = region[1]; y < region[1]+region[3]; y++) {
+                IceTByte *row = depth_buffer + depth_size*y*width;
+                depthFillInactive(depth_format, row, region[0]);
+                depthFillInactive(depth_format,
+                                  row + depth_size*(region[0]+region[2]),
+                                  width - (region[0]+region[2]));
+            }
+        }
+      /* Clear out top. */
+        depthFillInactive(depth_format,
+                          depth_buffer + depth_size*(region[1]+region[3])*width,
+                          (height - (region[1]+region[3]))*width);
     }
 }
 
@@ -1249,7 +2434,7 @@ void icetImagePackageForSend(IceTImage image,
     ICET_TEST_IMAGE_HEADER(image);
 
     *buffer = image.opaque_internals;
-    *size = ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    *size = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
 
     if (*size < 0) {
         /* Images of pointers have less than zero size to alert they are not
@@ -1289,6 +2474,11 @@ IceTImage icetImageUnpackageFromReceive(IceTVoid *buffer)
     color_format = icetImageGetColorFormat(image);
     if (    (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
          && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+         && (color_format != ICET_IMAGE_COLOR_R_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_RG_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_R_UINT)
+         && (accumulationChannels(color_format) == 0)
          && (color_format != ICET_IMAGE_COLOR_NONE) ) {
         icetRaiseError("Invalid image buffer: invalid color format.",
                        ICET_INVALID_VALUE);
@@ -1298,6 +2488,8 @@ IceTImage icetImageUnpackageFromReceive(IceTVoid *buffer)
 
     depth_format = icetImageGetDepthFormat(image);
     if (    (depth_format != ICET_IMAGE_DEPTH_FLOAT)
+         && (depth_format != ICET_IMAGE_DEPTH_HALF)
+         && (depth_format != ICET_IMAGE_DEPTH_UNORM24)
          && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
         icetRaiseError("Invalid image buffer: invalid depth format.",
                        ICET_INVALID_VALUE);
@@ -1307,7 +2499,7 @@ IceTImage icetImageUnpackageFromReceive(IceTVoid *buffer)
 
     if (magic_number == ICET_IMAGE_MAGIC_NUM) {
         IceTSizeType buffer_size =
-                ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+            ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
         if (   icetImageBufferSizeType(color_format, depth_format,
                                        icetImageGetWidth(image),
                                        icetImageGetHeight(image))
@@ -1318,7 +2510,7 @@ IceTImage icetImageUnpackageFromReceive(IceTVoid *buffer)
         }
     } else {
         IceTSizeType buffer_size =
-                ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+            ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
         if (buffer_size != -1) {
             icetRaiseError("Size information not consistent with image type.",
                            ICET_INVALID_VALUE);
@@ -1352,7 +2544,7 @@ void icetSparseImagePackageForSend(IceTSparseImage image,
     }
 
     *buffer = image.opaque_internals;
-    *size = ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    *size = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
 }
 
 IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
@@ -1374,6 +2566,11 @@ IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
     color_format = icetSparseImageGetColorFormat(image);
     if (    (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
          && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+         && (color_format != ICET_IMAGE_COLOR_R_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_RG_FLOAT)
+         && (color_format != ICET_IMAGE_COLOR_R_UINT)
+         && (accumulationChannels(color_format) == 0)
          && (color_format != ICET_IMAGE_COLOR_NONE) ) {
         icetRaiseError("Invalid image buffer: invalid color format.",
                        ICET_INVALID_VALUE);
@@ -1383,6 +2580,8 @@ IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
 
     depth_format = icetSparseImageGetDepthFormat(image);
     if (    (depth_format != ICET_IMAGE_DEPTH_FLOAT)
+         && (depth_format != ICET_IMAGE_DEPTH_HALF)
+         && (depth_format != ICET_IMAGE_DEPTH_UNORM24)
          && (depth_format != ICET_IMAGE_DEPTH_NONE) ) {
         icetRaiseError("Invalid image buffer: invalid depth format.",
                        ICET_INVALID_VALUE);
@@ -1393,17 +2592,58 @@ IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
     if (   icetSparseImageBufferSizeType(color_format, depth_format,
                                          icetSparseImageGetWidth(image),
                                          icetSparseImageGetHeight(image))
-         < ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] ) {
+         < ICET_IMAGE_SIZE_HEADER(image)
+               [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] ) {
         icetRaiseError("Inconsistent sizes in image data.", ICET_INVALID_VALUE);
         image.opaque_internals = NULL;
         return image;
     }
 
+    {
+        IceTSizeType plane_offset
+            = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_DEPTH_PLANE_INDEX];
+        IceTSizeType depth_size
+            = sparseDepthPlanePixelSize(color_format, depth_format);
+        IceTSizeType data_start = ICET_IMAGE_HEADER_SIZE;
+        IceTSizeType data_end
+            = ICET_IMAGE_SIZE_HEADER(image)
+                  [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+        if (   (plane_offset != 0)
+            && (   (depth_size == 0)
+                || (plane_offset < data_start)
+                || (plane_offset > data_end)
+                || ((data_end - plane_offset)%depth_size != 0) ) ) {
+            icetRaiseError("Invalid image buffer: bad depth plane.",
+                           ICET_INVALID_VALUE);
+            image.opaque_internals = NULL;
+            return image;
+        }
+    }
+
   /* The source may have used a bigger buffer than allocated here at the
      receiver.  Record only size that holds current image. */
     ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]
         = (IceTInt)icetSparseImageGetNumPixels(image);
 
+  /* The seek table, if the source had one, was not sent. */
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+
+  /* Do not trust active bounds that do not fit in the image. */
+    {
+        const IceTInt *viewport
+            = ICET_IMAGE_HEADER(image) + ICET_IMAGE_ACTIVE_VIEWPORT_INDEX;
+        IceTSizeType active_count
+            = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX];
+        if (   (active_count > icetSparseImageGetNumPixels(image))
+            || (viewport[0] < 0) || (viewport[1] < 0)
+            || (viewport[2] < 0) || (viewport[3] < 0)
+            || (viewport[0] + viewport[2] > icetSparseImageGetWidth(image))
+            || (viewport[1] + viewport[3] > icetSparseImageGetHeight(image))
+            || ((IceTSizeType)viewport[2]*viewport[3] < active_count) ) {
+            ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] = -1;
+        }
+    }
+
   /* The image is valid (as far as we can tell). */
     return image;
 }
@@ -1415,15 +2655,18 @@ IceTBoolean icetSparseImageEqual(const IceTSparseImage image1,
 }
 
 static void icetSparseImageScanPixels(const IceTVoid **in_data_p,
+                                      const IceTVoid **in_depth_p,
                                       IceTSizeType *inactive_before_p,
                                       IceTSizeType *active_till_next_runl_p,
                                       IceTVoid **last_in_run_length_p,
                                       IceTSizeType pixels_to_skip,
                                       IceTSizeType pixel_size,
+                                      IceTSizeType depth_size,
                                       IceTVoid **out_data_p,
                                       IceTVoid **out_run_length_p)
 {
     const IceTByte *in_data = *in_data_p; /* IceTByte for byte-pointer arithmetic. */
+    IceTSizeType active_scanned = 0;
     IceTSizeType inactive_before = *inactive_before_p;
     IceTSizeType active_till_next_runl = *active_till_next_runl_p;
     IceTSizeType pixels_left = pixels_to_skip;
@@ -1482,6 +2725,7 @@ static void icetSparseImageScanPixels(const IceTVoid **in_data_p,
                 out_data += count*pixel_size;
             }
             in_data += count*pixel_size;
+            active_scanned += count;
             active_till_next_runl -= count;
             pixels_left -= count;
         }
@@ -1491,57 +2735,292 @@ static void icetSparseImageScanPixels(const IceTVoid **in_data_p,
     }
 
     *in_data_p = in_data;
+    if (in_depth_p) {
+        *in_depth_p = (const IceTByte *)*in_depth_p + active_scanned*depth_size;
+    }
     *inactive_before_p = inactive_before;
     *active_till_next_runl_p = active_till_next_runl;
     if (last_in_run_length_p) {
         *last_in_run_length_p = (IceTVoid *)last_in_run_length;
     }
-    if (out_data_p) {
-        *out_data_p = out_data;
+    if (out_data_p) {
+        *out_data_p = out_data;
+    }
+    if (out_run_length_p) {
+        *out_run_length_p = last_out_run_length;
+    }
+
+#undef ADVANCE_OUT_RUN_LENGTH
+}
+
+static void icetSparseImageBuildSeekTable(IceTSparseImage image)
+{
+    IceTSizeType num_pixels = icetSparseImageGetNumPixels(image);
+    IceTEnum color_format = icetSparseImageGetColorFormat(image);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(image);
+    IceTSizeType pixel_size;
+    IceTSizeType depth_size;
+    IceTSizeType table_offset;
+    IceTSizeType *table;
+    const IceTByte *data_start;
+    const IceTByte *data_end;
+    const IceTByte *data;
+    IceTSizeType pixel;
+    IceTSizeType entry_pixel;
+    IceTSizeType active_before;
+
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_SEEK_TABLE_INDEX] = 0;
+
+    /* A scan from the start is just as fast for small images. */
+    if (num_pixels <= ICET_SPARSE_IMAGE_SEEK_SPACING) return;
+
+    /* Place the table after the data, aligned for IceTSizeType. */
+    table_offset
+        = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    table_offset = (  (  (table_offset + (IceTSizeType)sizeof(IceTSizeType) - 1)
+                       / (IceTSizeType)sizeof(IceTSizeType) )
+                    * (IceTSizeType)sizeof(IceTSizeType) );
+    if (   table_offset + SEEK_TABLE_SIZE(num_pixels)
+         > icetSparseImageBufferSizeType(
+               color_format,
+               depth_format,
+               ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX],
+               1) ) {
+        return;
+    }
+
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    table = (IceTSizeType *)(  (IceTByte *)ICET_IMAGE_HEADER(image)
+                             + table_offset);
+    data_start = ICET_IMAGE_DATA(image);
+    if (icetSparseImageGetDepthPlane(image) != NULL) {
+        depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
+        data_end = icetSparseImageGetDepthPlane(image);
+    } else {
+        depth_size = 0;
+        data_end = (  (const IceTByte *)ICET_IMAGE_HEADER(image)
+                    + ICET_IMAGE_SIZE_HEADER(image)
+                          [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] );
+    }
+    data = data_start;
+    pixel = 0;
+    entry_pixel = 0;
+    active_before = 0;
+    while (pixel < num_pixels) {
+        IceTSizeType inactive;
+        IceTSizeType active;
+        IceTSizeType run_end;
+
+        if (data + RUN_LENGTH_SIZE > data_end) return;
+        inactive = INACTIVE_RUN_LENGTH(data);
+        active = ACTIVE_RUN_LENGTH(data);
+        data += RUN_LENGTH_SIZE;
+        run_end = pixel + inactive + active;
+        if ((run_end <= pixel) || (run_end > num_pixels)) return;
+
+        while (entry_pixel < run_end) {
+            IceTSizeType into_run = entry_pixel - pixel;
+            if (into_run < inactive) {
+                table[0] = (IceTSizeType)(data - data_start);
+                table[1] = inactive - into_run;
+                table[2] = active;
+                table[3] = active_before*depth_size;
+            } else {
+                table[0] = (IceTSizeType)(  data
+                                          + (into_run - inactive)*pixel_size
+                                          - data_start);
+                table[1] = 0;
+                table[2] = active - (into_run - inactive);
+                table[3] = (active_before + into_run - inactive)*depth_size;
+            }
+            table += 4;
+            entry_pixel += ICET_SPARSE_IMAGE_SEEK_SPACING;
+        }
+
+        pixel = run_end;
+        data += active*pixel_size;
+        active_before += active;
+    }
+    if (data > data_end) return;
+
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_SEEK_TABLE_INDEX] = table_offset;
+}
+
+static void icetSparseImageFindActiveBounds(IceTSparseImage image)
+{
+    IceTSizeType width = icetSparseImageGetWidth(image);
+    IceTSizeType num_pixels = icetSparseImageGetNumPixels(image);
+    IceTSizeType pixel_size;
+    const IceTByte *data;
+    const IceTByte *data_end;
+    IceTSizeType pixel;
+    IceTSizeType active_count;
+    IceTSizeType x_min, y_min, x_max, y_max;
+    IceTInt *viewport;
+
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] = -1;
+
+    pixel_size = sparseDataPixelSize(icetSparseImageGetColorFormat(image),
+                                     icetSparseImageGetDepthFormat(image));
+    data = ICET_IMAGE_DATA(image);
+    data_end = icetSparseImageGetDepthPlane(image);
+    if (data_end == NULL) {
+        data_end = (  (const IceTByte *)ICET_IMAGE_HEADER(image)
+                    + ICET_IMAGE_SIZE_HEADER(image)
+                          [ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX] );
+    }
+
+    pixel = 0;
+    active_count = 0;
+    x_min = width;  y_min = num_pixels;
+    x_max = -1;     y_max = -1;
+    while (pixel < num_pixels) {
+        IceTSizeType inactive;
+        IceTSizeType active;
+
+        if (data + RUN_LENGTH_SIZE > data_end) return;
+        inactive = INACTIVE_RUN_LENGTH(data);
+        active = ACTIVE_RUN_LENGTH(data);
+        data += RUN_LENGTH_SIZE + active*pixel_size;
+        if (   (inactive + active <= 0)
+            || (pixel + inactive + active > num_pixels) ) {
+            return;
+        }
+
+        pixel += inactive;
+        if (active > 0) {
+            IceTSizeType first_y = pixel/width;
+            IceTSizeType last_y = (pixel + active - 1)/width;
+            if (first_y == last_y) {
+                x_min = MIN(x_min, pixel%width);
+                x_max = MAX(x_max, (pixel + active - 1)%width);
+            } else {
+                x_min = 0;
+                x_max = width - 1;
+            }
+            y_min = MIN(y_min, first_y);
+            y_max = MAX(y_max, last_y);
+            active_count += active;
+            pixel += active;
+        }
+    }
+    if (data > data_end) return;
+
+    viewport = ICET_IMAGE_HEADER(image) + ICET_IMAGE_ACTIVE_VIEWPORT_INDEX;
+    if (active_count > 0) {
+        viewport[0] = (IceTInt)x_min;
+        viewport[1] = (IceTInt)y_min;
+        viewport[2] = (IceTInt)(x_max - x_min + 1);
+        viewport[3] = (IceTInt)(y_max - y_min + 1);
+    } else {
+        viewport[0] = viewport[1] = viewport[2] = viewport[3] = 0;
     }
-    if (out_run_length_p) {
-        *out_run_length_p = last_out_run_length;
+    ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX]
+        = active_count;
+}
+
+static void icetSparseImageSeek(const IceTSparseImage image,
+                                IceTSizeType from_pixel,
+                                IceTSizeType to_pixel,
+                                IceTSizeType pixel_size,
+                                IceTSizeType depth_size,
+                                const IceTVoid **in_data_p,
+                                const IceTVoid **in_depth_p,
+                                IceTSizeType *inactive_before_p,
+                                IceTSizeType *active_till_next_runl_p)
+{
+    IceTSizeType table_offset
+        = ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_SEEK_TABLE_INDEX];
+
+    if (table_offset != 0) {
+        IceTSizeType num_entries
+            = (  (icetSparseImageGetNumPixels(image)
+                  + ICET_SPARSE_IMAGE_SEEK_SPACING - 1)
+               / ICET_SPARSE_IMAGE_SEEK_SPACING );
+        IceTSizeType entry = to_pixel/ICET_SPARSE_IMAGE_SEEK_SPACING;
+        if (entry >= num_entries) { entry = num_entries - 1; }
+        if (entry*ICET_SPARSE_IMAGE_SEEK_SPACING > from_pixel) {
+            const IceTSizeType *table
+                = (const IceTSizeType *)(  (const IceTByte *)
+                                               ICET_IMAGE_HEADER(image)
+                                         + table_offset);
+            table += 4*entry;
+            *in_data_p = (const IceTByte *)ICET_IMAGE_DATA(image) + table[0];
+            if (in_depth_p) {
+                *in_depth_p = (  (const IceTByte *)
+                                     icetSparseImageGetDepthPlane(image)
+                               + table[3] );
+            }
+            *inactive_before_p = table[1];
+            *active_till_next_runl_p = table[2];
+            from_pixel = entry*ICET_SPARSE_IMAGE_SEEK_SPACING;
+        }
     }
 
-#undef ADVANCE_OUT_RUN_LENGTH
+    icetSparseImageScanPixels(in_data_p,
+                              in_depth_p,
+                              inactive_before_p,
+                              active_till_next_runl_p,
+                              NULL,
+                              to_pixel - from_pixel,
+                              pixel_size,
+                              depth_size,
+                              NULL,
+                              NULL);
 }
 
 static void icetSparseImageCopyPixelsInternal(
                                           const IceTVoid **in_data_p,
+                                          const IceTVoid **in_depth_p,
                                           IceTSizeType *inactive_before_p,
                                           IceTSizeType *active_till_next_runl_p,
                                           IceTSizeType pixels_to_copy,
                                           IceTSizeType pixel_size,
+                                          IceTSizeType depth_size,
                                           IceTSparseImage out_image)
 {
     IceTVoid *out_data = ICET_IMAGE_DATA(out_image);
+    const IceTVoid *in_depth = NULL;
 
     icetSparseImageSetDimensions(out_image, pixels_to_copy, 1);
 
+    if (in_depth_p) { in_depth = *in_depth_p; }
+
     icetSparseImageScanPixels(in_data_p,
+                              in_depth_p,
                               inactive_before_p,
                               active_till_next_runl_p,
                               NULL,
                               pixels_to_copy,
                               pixel_size,
+                              depth_size,
                               &out_data,
                               NULL);
 
     icetSparseImageSetActualSize(out_image, out_data);
+    if (in_depth_p) {
+        icetSparseImageAppendDepths(out_image, in_depth, *in_depth_p);
+    }
+    icetSparseImageFindActiveBounds(out_image);
 }
 
 static void icetSparseImageCopyPixelsInPlaceInternal(
                                           const IceTVoid **in_data_p,
+                                          const IceTVoid **in_depth_p,
                                           IceTSizeType *inactive_before_p,
                                           IceTSizeType *active_till_next_runl_p,
                                           IceTSizeType pixels_to_copy,
                                           IceTSizeType pixel_size,
+                                          IceTSizeType depth_size,
                                           IceTSparseImage out_image)
 {
     IceTVoid *last_run_length = NULL;
+    const IceTVoid *in_depth = NULL;
 
 #ifdef DEBUG
     if (   (*in_data_p != ICET_IMAGE_DATA(out_image))
+        || (   (in_depth_p != NULL)
+            && (*in_depth_p != icetSparseImageGetDepthPlane(out_image)) )
         || (*inactive_before_p != 0)
         || (*active_till_next_runl_p != 0) ) {
         icetRaiseError("icetSparseImageCopyPixelsInPlaceInternal not called"
@@ -1550,12 +3029,16 @@ static void icetSparseImageCopyPixelsInPlaceInternal(
     }
 #endif
 
+    if (in_depth_p) { in_depth = *in_depth_p; }
+
     icetSparseImageScanPixels(in_data_p,
+                              in_depth_p,
                               inactive_before_p,
                               active_till_next_runl_p,
                               &last_run_length,
                               pixels_to_copy,
                               pixel_size,
+                              depth_size,
                               NULL,
                               NULL);
 
@@ -1569,6 +3052,40 @@ static void icetSparseImageCopyPixelsInPlaceInternal(
     }
 
     icetSparseImageSetActualSize(out_image, *in_data_p);
+    if (in_depth_p) {
+        icetSparseImageAppendDepths(out_image, in_depth, *in_depth_p);
+    }
+    icetSparseImageFindActiveBounds(out_image);
+}
+
+static IceTBoolean icetSparseImageCopyEntire(const IceTSparseImage in_image,
+                                             IceTSparseImage out_image)
+{
+    IceTSizeType num_pixels = icetSparseImageGetNumPixels(in_image);
+    IceTSizeType bytes_to_copy
+        = ICET_IMAGE_SIZE_HEADER(in_image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    IceTSizeType max_pixels
+        = ICET_IMAGE_HEADER(out_image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX];
+
+    if (max_pixels < num_pixels) return ICET_FALSE;
+
+    memcpy(ICET_IMAGE_HEADER(out_image),
+           ICET_IMAGE_HEADER(in_image),
+           bytes_to_copy);
+
+    ICET_IMAGE_HEADER(out_image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX] = max_pixels;
+
+    /* The seek table is not part of the actual size.  It fits in the output
+       at the same place because the output holds as many pixels. */
+    if (ICET_IMAGE_SIZE_HEADER(in_image)[ICET_IMAGE_SEEK_TABLE_INDEX] != 0) {
+        IceTSizeType table_offset
+            = ICET_IMAGE_SIZE_HEADER(in_image)[ICET_IMAGE_SEEK_TABLE_INDEX];
+        memcpy((IceTByte *)ICET_IMAGE_HEADER(out_image) + table_offset,
+               (IceTByte *)ICET_IMAGE_HEADER(in_image) + table_offset,
+               SEEK_TABLE_SIZE(num_pixels) - sizeof(IceTSizeType));
+    }
+
+    return ICET_TRUE;
 }
 
 void icetSparseImageCopyPixels(const IceTSparseImage in_image,
@@ -1579,8 +3096,10 @@ void icetSparseImageCopyPixels(const IceTSparseImage in_image,
     IceTEnum color_format;
     IceTEnum depth_format;
     IceTSizeType pixel_size;
+    IceTSizeType depth_size;
 
     const IceTVoid *in_data;
+    const IceTVoid *in_depth;
     IceTSizeType start_inactive;
     IceTSizeType start_active;
 
@@ -1600,50 +3119,41 @@ void icetSparseImageCopyPixels(const IceTSparseImage in_image,
         && (num_pixels == icetSparseImageGetNumPixels(in_image)) ) {
         /* Special case, copying image in its entirety.  Using the standard
          * method will work, but doing a raw data copy can be faster. */
-        IceTSizeType bytes_to_copy
-            = ICET_IMAGE_HEADER(in_image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
-        IceTSizeType max_pixels
-            = ICET_IMAGE_HEADER(out_image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX];
-
         ICET_TEST_SPARSE_IMAGE_HEADER(out_image);
 
-        if (max_pixels < num_pixels) {
+        if (!icetSparseImageCopyEntire(in_image, out_image)) {
             icetRaiseError("Cannot set an image size to greater than what the"
                            " image was originally created.",
                            ICET_INVALID_VALUE);
-            icetTimingCompressEnd();
-            return;
         }
 
-        memcpy(ICET_IMAGE_HEADER(out_image),
-               ICET_IMAGE_HEADER(in_image),
-               bytes_to_copy);
-
-        ICET_IMAGE_HEADER(out_image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]
-            = max_pixels;
-
         icetTimingCompressEnd();
         return;
     }
 
-    pixel_size = colorPixelSize(color_format) + depthPixelSize(depth_format);
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
 
     in_data = ICET_IMAGE_DATA(in_image);
+    in_depth = icetSparseImageGetDepthPlane(in_image);
     start_inactive = start_active = 0;
-    icetSparseImageScanPixels(&in_data,
-                              &start_inactive,
-                              &start_active,
-                              NULL,
-                              in_offset,
-                              pixel_size,
-                              NULL,
-                              NULL);
+    icetSparseImageSeek(in_image,
+                        0,
+                        in_offset,
+                        pixel_size,
+                        depth_size,
+                        &in_data,
+                        (in_depth != NULL) ? &in_depth : NULL,
+                        &start_inactive,
+                        &start_active);
 
     icetSparseImageCopyPixelsInternal(&in_data,
+                                      (in_depth != NULL) ? &in_depth : NULL,
                                       &start_inactive,
                                       &start_active,
                                       num_pixels,
                                       pixel_size,
+                                      depth_size,
                                       out_image);
 
     icetTimingCompressEnd();
@@ -1714,12 +3224,18 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
     IceTEnum color_format;
     IceTEnum depth_format;
     IceTSizeType pixel_size;
+    IceTSizeType depth_size;
 
     const IceTVoid *in_data;
+    const IceTVoid *in_depth;
+    const IceTVoid **in_depth_p;
     IceTSizeType start_inactive;
     IceTSizeType start_active;
 
+    IceTSizeType active_first, active_end;
+
     IceTInt partition;
+    IceTBoolean in_place;
 
     icetTimingCompressBegin();
 
@@ -1735,10 +3251,14 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
 
     color_format = icetSparseImageGetColorFormat(in_image);
     depth_format = icetSparseImageGetDepthFormat(in_image);
-    pixel_size = colorPixelSize(color_format) + depthPixelSize(depth_format);
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
 
     in_data = ICET_IMAGE_DATA(in_image);
+    in_depth = icetSparseImageGetDepthPlane(in_image);
+    in_depth_p = (in_depth != NULL) ? &in_depth : NULL;
     start_inactive = start_active = 0;
+    in_place = ICET_FALSE;
 
     icetSparseImageSplitChoosePartitions(num_partitions,
                                          eventual_num_partitions,
@@ -1746,6 +3266,24 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
                                          in_image_offset,
                                          offsets);
 
+    /* Partitions past the last active pixel are left empty without scanning
+       the input (which is all of them for an empty image). */
+    if (ICET_IMAGE_SIZE_HEADER(in_image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] < 0) {
+        active_end = total_num_pixels;
+    } else {
+        icetSparseImageActiveRange(in_image, &active_first, &active_end);
+    }
+
+    if (   (active_end > 0)
+        && icetSparseImageSplitThreaded(in_image,
+                                        in_image_offset,
+                                        num_partitions,
+                                        out_images,
+                                        offsets) ) {
+        icetTimingCompressEnd();
+        return;
+    }
+
     for (partition = 0; partition < num_partitions; partition++) {
         IceTSparseImage out_image = out_images[partition];
         IceTSizeType partition_num_pixels;
@@ -1766,14 +3304,25 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
                 = total_num_pixels + in_image_offset - offsets[partition];
         }
 
-        if (icetSparseImageEqual(in_image, out_image)) {
+        if (   !icetSparseImageEqual(in_image, out_image)
+            && (offsets[partition] - in_image_offset >= active_end) ) {
+            icetSparseImageSetDimensions(out_image, partition_num_pixels, 1);
+        } else if (icetSparseImageEqual(in_image, out_image)) {
             if (partition == 0) {
-                icetSparseImageCopyPixelsInPlaceInternal(&in_data,
-                                                         &start_inactive,
-                                                         &start_active,
-                                                         partition_num_pixels,
-                                                         pixel_size,
-                                                         out_image);
+                /* Moving the depths of the partition in place overwrites the
+                   data after it, so skip it for now and come back to it after
+                   the other partitions are copied. */
+                in_place = ICET_TRUE;
+                icetSparseImageScanPixels(&in_data,
+                                          in_depth_p,
+                                          &start_inactive,
+                                          &start_active,
+                                          NULL,
+                                          partition_num_pixels,
+                                          pixel_size,
+                                          depth_size,
+                                          NULL,
+                                          NULL);
             } else {
                 icetRaiseError("icetSparseImageSplit copy in place only allowed"
                                " in first partition.",
@@ -1781,21 +3330,38 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
             }
         } else {
             icetSparseImageCopyPixelsInternal(&in_data,
+                                              in_depth_p,
                                               &start_inactive,
                                               &start_active,
                                               partition_num_pixels,
                                               pixel_size,
+                                              depth_size,
                                               out_image);
         }
     }
 
 #ifdef DEBUG
-    if (   (start_inactive != 0)
-        || (start_active != 0) ) {
+    if (   (offsets[num_partitions-1] - in_image_offset < active_end)
+        && (   (start_inactive != 0)
+            || (start_active != 0) ) ) {
         icetRaiseError("Counting problem.", ICET_SANITY_CHECK_FAIL);
     }
 #endif
 
+    if (in_place) {
+        in_data = ICET_IMAGE_DATA(in_image);
+        in_depth = icetSparseImageGetDepthPlane(in_image);
+        start_inactive = start_active = 0;
+        icetSparseImageCopyPixelsInPlaceInternal(&in_data,
+                                                 in_depth_p,
+                                                 &start_inactive,
+                                                 &start_active,
+                                                 offsets[1] - offsets[0],
+                                                 pixel_size,
+                                                 depth_size,
+                                                 out_images[0]);
+    }
+
     icetTimingCompressEnd();
 }
 
@@ -1810,15 +3376,21 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
     IceTSizeType lower_partition_size = num_pixels/eventual_num_partitions;
     IceTSizeType remaining_pixels = num_pixels%eventual_num_partitions;
     IceTSizeType pixel_size;
+    IceTSizeType depth_size;
     IceTInt original_partition_idx;
     IceTInt interlaced_partition_idx;
     const IceTVoid **in_data_array;
+    const IceTVoid **in_depth_array;
+    const IceTVoid **in_depth_end_array;
     IceTSizeType *inactive_before_array;
     IceTSizeType *active_till_next_runl_array;
     const IceTVoid *in_data;
+    const IceTVoid *in_depth;
+    const IceTVoid **in_depth_p;
     IceTVoid *out_data;
     IceTSizeType inactive_before;
     IceTSizeType active_till_next_runl;
+    IceTSizeType position;
     IceTVoid *last_run_length;
 
     /* Special case, nothing to do. */
@@ -1836,17 +3408,20 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
 
     icetTimingInterlaceBegin();
 
-    pixel_size = colorPixelSize(color_format) + depthPixelSize(depth_format);
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
 
     {
         IceTByte *buffer = icetGetStateBuffer(
                               scratch_state_buffer,
-                                eventual_num_partitions*sizeof(IceTVoid*)
+                                3*eventual_num_partitions*sizeof(IceTVoid*)
                               + 2*eventual_num_partitions*sizeof(IceTSizeType));
         in_data_array = (const IceTVoid **)buffer;
+        in_depth_array = in_data_array + eventual_num_partitions;
+        in_depth_end_array = in_depth_array + eventual_num_partitions;
         inactive_before_array
             = (IceTSizeType *)(  buffer
-                               + eventual_num_partitions*sizeof(IceTVoid*));
+                               + 3*eventual_num_partitions*sizeof(IceTVoid*));
         active_till_next_runl_array
             = inactive_before_array + eventual_num_partitions;
     }
@@ -1854,8 +3429,11 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
     /* Run through the input data and figure out where each interlaced
        partition needs to read from. */
     in_data = ICET_IMAGE_DATA(in_image);
+    in_depth = icetSparseImageGetDepthPlane(in_image);
+    in_depth_p = (in_depth != NULL) ? &in_depth : NULL;
     inactive_before = 0;
     active_till_next_runl = 0;
+    position = 0;
     for (original_partition_idx = 0;
          original_partition_idx < eventual_num_partitions;
          original_partition_idx++) {
@@ -1874,19 +3452,22 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
         }
 
         in_data_array[interlaced_partition_idx] = in_data;
+        in_depth_array[interlaced_partition_idx] = in_depth;
         inactive_before_array[interlaced_partition_idx] = inactive_before;
         active_till_next_runl_array[interlaced_partition_idx]
             = active_till_next_runl;
 
         if (original_partition_idx < eventual_num_partitions-1) {
-            icetSparseImageScanPixels((const IceTVoid**)&in_data,
-                                      &inactive_before,
-                                      &active_till_next_runl,
-                                      NULL,
-                                      pixels_to_skip,
-                                      pixel_size,
-                                      NULL,
-                                      NULL);
+            icetSparseImageSeek(in_image,
+                                position,
+                                position + pixels_to_skip,
+                                pixel_size,
+                                depth_size,
+                                &in_data,
+                                in_depth_p,
+                                &inactive_before,
+                                &active_till_next_runl);
+            position += pixels_to_skip;
         }
     }
 
@@ -1911,22 +3492,41 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
         }
 
         in_data = in_data_array[interlaced_partition_idx];
+        in_depth = in_depth_array[interlaced_partition_idx];
         inactive_before = inactive_before_array[interlaced_partition_idx];
         active_till_next_runl
             = active_till_next_runl_array[interlaced_partition_idx];
 
         icetSparseImageScanPixels((const IceTVoid **)&in_data,
+                                  in_depth_p,
                                   &inactive_before,
                                   &active_till_next_runl,
                                   NULL,
                                   pixels_left,
                                   pixel_size,
+                                  depth_size,
                                   (IceTVoid **)&out_data,
                                   &last_run_length);
+        in_depth_end_array[interlaced_partition_idx] = in_depth;
     }
 
     icetSparseImageSetActualSize(out_image, out_data);
 
+    /* The depths of each partition are contiguous in the input, so they can
+       follow the data in bulk. */
+    if (in_depth_p != NULL) {
+        for (interlaced_partition_idx = 0;
+             interlaced_partition_idx < eventual_num_partitions;
+             interlaced_partition_idx++) {
+            icetSparseImageAppendDepths(
+                                 out_image,
+                                 in_depth_array[interlaced_partition_idx],
+                                 in_depth_end_array[interlaced_partition_idx]);
+        }
+    }
+
+    icetSparseImageFindActiveBounds(out_image);
+
     icetTimingInterlaceEnd();
 }
 
@@ -1984,6 +3584,204 @@ IceTSizeType icetGetInterlaceOffset(IceTInt partition_index,
     return 0;
 }
 
+void icetSparseImageTileBlocks(const IceTSparseImage in_image,
+                               IceTSparseImage out_image)
+{
+    IceTSizeType width = icetSparseImageGetWidth(in_image);
+    IceTSizeType height = icetSparseImageGetHeight(in_image);
+    IceTEnum color_format = icetSparseImageGetColorFormat(in_image);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(in_image);
+    IceTSizeType pixel_size;
+    IceTSizeType depth_size;
+    const IceTVoid *row_data[ICET_IMAGE_BLOCK_SIZE];
+    const IceTVoid *row_depth[ICET_IMAGE_BLOCK_SIZE];
+    IceTSizeType row_inactive_before[ICET_IMAGE_BLOCK_SIZE];
+    IceTSizeType row_active_till_next_runl[ICET_IMAGE_BLOCK_SIZE];
+    const IceTVoid *in_depth;
+    IceTByte *depth_stage;
+    IceTByte *depth_stage_end;
+    IceTVoid *out_data;
+    IceTVoid *last_run_length;
+    IceTSizeType block_y;
+
+    if (   (color_format != icetSparseImageGetColorFormat(out_image))
+        || (depth_format != icetSparseImageGetDepthFormat(out_image)) ) {
+        icetRaiseError("Cannot copy pixels of images with different formats.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    if (icetSparseImageEqual(in_image, out_image)) {
+        icetRaiseError("Cannot tile the blocks of an image in place.",
+                       ICET_INVALID_VALUE);
+        return;
+    }
+
+    icetTimingInterlaceBegin();
+
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
+
+    icetSparseImageSetDimensions(out_image, width, height);
+    out_data = ICET_IMAGE_DATA(out_image);
+    INACTIVE_RUN_LENGTH(out_data) = 0;
+    ACTIVE_RUN_LENGTH(out_data) = 0;
+    last_run_length = out_data;
+    out_data = (IceTByte*)out_data + RUN_LENGTH_SIZE;
+
+    /* The depths of the active pixels are gathered in block order in the
+       staging area and follow the data once it is all written. */
+    depth_stage = depth_stage_end = icetSparseImageDepthStage(out_image);
+
+    row_data[0] = ICET_IMAGE_DATA(in_image);
+    row_depth[0] = in_depth = icetSparseImageGetDepthPlane(in_image);
+    row_inactive_before[0] = row_active_till_next_runl[0] = 0;
+
+    for (block_y = 0; block_y < height; block_y += ICET_IMAGE_BLOCK_SIZE) {
+        IceTSizeType block_height = MIN(ICET_IMAGE_BLOCK_SIZE,
+                                        height - block_y);
+        IceTSizeType row;
+        IceTSizeType block_x;
+
+        /* Find where each row of this band of blocks starts.  The first row
+           starts where the last band left off. */
+        for (row = 1; row < block_height; row++) {
+            row_data[row] = row_data[row-1];
+            row_depth[row] = row_depth[row-1];
+            row_inactive_before[row] = row_inactive_before[row-1];
+            row_active_till_next_runl[row] = row_active_till_next_runl[row-1];
+            icetSparseImageScanPixels(&row_data[row],
+                                      (in_depth != NULL) ? &row_depth[row]
+                                                         : NULL,
+                                      &row_inactive_before[row],
+                                      &row_active_till_next_runl[row],
+                                      NULL,
+                                      width,
+                                      pixel_size,
+                                      depth_size,
+                                      NULL,
+                                      NULL);
+        }
+
+        /* Copy each block a row segment at a time, advancing the row starts
+           to the next block. */
+        for (block_x = 0; block_x < width; block_x += ICET_IMAGE_BLOCK_SIZE) {
+            IceTSizeType block_width = MIN(ICET_IMAGE_BLOCK_SIZE,
+                                           width - block_x);
+            for (row = 0; row < block_height; row++) {
+                const IceTVoid *segment_depth = row_depth[row];
+                icetSparseImageScanPixels(&row_data[row],
+                                          (in_depth != NULL) ? &row_depth[row]
+                                                             : NULL,
+                                          &row_inactive_before[row],
+                                          &row_active_till_next_runl[row],
+                                          NULL,
+                                          block_width,
+                                          pixel_size,
+                                          depth_size,
+                                          &out_data,
+                                          &last_run_length);
+                if (in_depth != NULL) {
+                    IceTSizeType num_bytes = (IceTSizeType)(
+                                    (IceTPointerArithmetic)row_depth[row]
+                                  - (IceTPointerArithmetic)segment_depth );
+                    memcpy(depth_stage_end, segment_depth, num_bytes);
+                    depth_stage_end += num_bytes;
+                }
+            }
+        }
+
+        /* The last row of the band is now at the start of the next one. */
+        row_data[0] = row_data[block_height-1];
+        row_depth[0] = row_depth[block_height-1];
+        row_inactive_before[0] = row_inactive_before[block_height-1];
+        row_active_till_next_runl[0]
+            = row_active_till_next_runl[block_height-1];
+    }
+
+    icetSparseImageSetActualSize(out_image, out_data);
+    if (in_depth != NULL) {
+        icetSparseImageAppendDepths(out_image, depth_stage, depth_stage_end);
+    }
+
+    icetSparseImageFindActiveBounds(out_image);
+    icetSparseImageBuildSeekTable(out_image);
+
+    icetTimingInterlaceEnd();
+}
+
+void icetImageUntileBlocks(IceTImage image, IceTEnum scratch_state_buffer)
+{
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType num_pixels;
+    IceTByte *planes[2];
+    IceTSizeType plane_pixel_sizes[2];
+    IceTByte *scratch;
+    int plane;
+
+    if (icetImageIsNull(image)) return;
+
+    width = icetImageGetWidth(image);
+    height = icetImageGetHeight(image);
+    num_pixels = width*height;
+
+    /* With a single column or row of blocks, block order is scanline
+       order. */
+    if ((width <= ICET_IMAGE_BLOCK_SIZE) || (height == 1)) return;
+
+    icetTimingInterlaceBegin();
+
+    if (icetImageGetColorFormat(image) != ICET_IMAGE_COLOR_NONE) {
+        planes[0] = icetImageGetColorVoid(image, &plane_pixel_sizes[0]);
+    } else {
+        planes[0] = NULL;
+        plane_pixel_sizes[0] = 0;
+    }
+    if (icetImageGetDepthFormat(image) != ICET_IMAGE_DEPTH_NONE) {
+        planes[1] = icetImageGetDepthVoid(image, &plane_pixel_sizes[1]);
+    } else {
+        planes[1] = NULL;
+        plane_pixel_sizes[1] = 0;
+    }
+
+    scratch = icetGetStateBuffer(scratch_state_buffer,
+                                 num_pixels*MAX(plane_pixel_sizes[0],
+                                                plane_pixel_sizes[1]));
+
+    for (plane = 0; plane < 2; plane++) {
+        IceTSizeType pixel_size = plane_pixel_sizes[plane];
+        const IceTByte *in_pixels = scratch;
+        IceTSizeType block_y;
+
+        if (planes[plane] == NULL) continue;
+
+        memcpy(scratch, planes[plane], num_pixels*pixel_size);
+
+        for (block_y = 0; block_y < height; block_y += ICET_IMAGE_BLOCK_SIZE) {
+            IceTSizeType block_height = MIN(ICET_IMAGE_BLOCK_SIZE,
+                                            height - block_y);
+            IceTSizeType block_x;
+            for (block_x = 0;
+                 block_x < width;
+                 block_x += ICET_IMAGE_BLOCK_SIZE) {
+                IceTSizeType segment_size
+                    = MIN(ICET_IMAGE_BLOCK_SIZE, width - block_x)*pixel_size;
+                IceTSizeType row;
+                for (row = 0; row < block_height; row++) {
+                    memcpy(  planes[plane]
+                           + ((block_y + row)*width + block_x)*pixel_size,
+                           in_pixels,
+                           segment_size);
+                    in_pixels += segment_size;
+                }
+            }
+        }
+    }
+
+    icetTimingInterlaceEnd();
+}
+
 void icetClearImage(IceTImage image)
 {
     IceTInt region[4] = {0, 0, 0, 0};
@@ -2004,6 +3802,12 @@ void icetClearSparseImage(IceTSparseImage image)
     ACTIVE_RUN_LENGTH(data) = 0;
 
     icetSparseImageSetActualSize(image, data+RUN_LENGTH_SIZE);
+    if (sparseDepthPlanePixelSize(icetSparseImageGetColorFormat(image),
+                                  icetSparseImageGetDepthFormat(image)) > 0) {
+        /* Empty depth plane. */
+        icetSparseImageAppendDepths(image, data, data);
+    }
+    icetSparseImageFindActiveBounds(image);
 }
 
 void icetSetColorFormat(IceTEnum color_format)
@@ -2022,6 +3826,10 @@ void icetSetColorFormat(IceTEnum color_format)
 
     if (   (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
         || (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+        || (color_format == ICET_IMAGE_COLOR_RGBA_HALF)
+        || (color_format == ICET_IMAGE_COLOR_R_FLOAT)
+        || (color_format == ICET_IMAGE_COLOR_RG_FLOAT)
+        || (color_format == ICET_IMAGE_COLOR_R_UINT)
         || (color_format == ICET_IMAGE_COLOR_NONE) ) {
         icetStateSetInteger(ICET_COLOR_FORMAT, color_format);
     } else {
@@ -2044,6 +3852,8 @@ void icetSetDepthFormat(IceTEnum depth_format)
     }
 
     if (   (depth_format == ICET_IMAGE_DEPTH_FLOAT)
+        || (depth_format == ICET_IMAGE_DEPTH_HALF)
+        || (depth_format == ICET_IMAGE_DEPTH_UNORM24)
         || (depth_format == ICET_IMAGE_DEPTH_NONE) ) {
         icetStateSetInteger(ICET_DEPTH_FORMAT, depth_format);
     } else {
@@ -2088,6 +3898,366 @@ void icetGetTileImage(IceTInt tile, IceTImage image)
     icetTimingBufferReadEnd();
 }
 
+/* Compressing or compositing with threads splits the pixels into bands that
+ * are processed independently into scratch sparse images and then joined.
+ * Because the joined run lengths are merged across band boundaries, the result
+ * is byte-for-byte the same as processing all the pixels at once.  The
+ * threads are kept by the context (see icetParallelFor), but handing out a
+ * band and joining its result still costs more than processing a band
+ * smaller than this. */
+#define ICET_MIN_BAND_PIXELS    16384
+
+/* Returns the size of the given band when splitting total into num_bands
+ * nearly equal pieces. */
+#define ICET_BAND_SIZE(total, band, num_bands)                          \
+    (((total)*((band)+1))/(num_bands) - ((total)*(band))/(num_bands))
+
+struct IceTCompressBands {
+    IceTImage image;
+    IceTSparseImage *bands;
+    IceTInt num_bands;
+    /* For icetCompressSubImage. */
+    IceTSizeType offset;
+    IceTSizeType pixels;
+    /* For icetGetCompressedTileImage. */
+    const IceTInt *screen_viewport;
+    IceTSizeType width;
+    IceTSizeType space_left;
+    IceTSizeType space_right;
+};
+
+/* Where a band of a compressed-compressed composite starts in each input, as
+ * returned by icetSparseImageScanPixels. */
+struct IceTCCCompositeSeek {
+    const IceTVoid *front;
+    const IceTVoid *front_depth;
+    IceTSizeType front_inactive;
+    IceTSizeType front_active;
+    const IceTVoid *back;
+    const IceTVoid *back_depth;
+    IceTSizeType back_inactive;
+    IceTSizeType back_active;
+    IceTBoolean corrupt;
+};
+
+struct IceTCCCompositeBands {
+    IceTSparseImage front;
+    IceTSparseImage back;
+    IceTSparseImage *bands;
+    struct IceTCCCompositeSeek *seeks;
+    IceTInt num_bands;
+    IceTSizeType num_pixels;
+};
+
+/* Returns the number of bands to use when processing the given number of
+ * pixels with up to the number of threads in the state variable threads_pname.
+ * Returns 1 if the pixels should be processed serially, which includes all
+ * the configurations where compressing or compositing raises a diagnostic
+ * (since diagnostics cannot be raised from a worker thread). */
+static IceTInt icetSparseImageNumBands(IceTEnum threads_pname,
+                                       IceTEnum color_format,
+                                       IceTEnum depth_format,
+                                       IceTSizeType pixels)
+{
+    IceTInt num_threads;
+    IceTEnum composite_mode;
+    IceTSizeType max_bands;
+
+    icetGetIntegerv(threads_pname, &num_threads);
+    if (num_threads < 2) return 1;
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+    if (   (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER)
+        || (   reductionCompositeMode(composite_mode)
+            && (depth_format != ICET_IMAGE_DEPTH_NONE) ) ) {
+        if (depth_format == ICET_IMAGE_DEPTH_NONE) return 1;
+        if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+            && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+            && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+            && (color_format != ICET_IMAGE_COLOR_R_FLOAT)
+            && (color_format != ICET_IMAGE_COLOR_RG_FLOAT)
+            && (color_format != ICET_IMAGE_COLOR_R_UINT)
+            && (accumulationChannels(color_format) == 0)
+            && (color_format != ICET_IMAGE_COLOR_NONE) ) {
+            return 1;
+        }
+    } else if (   (composite_mode == ICET_COMPOSITE_MODE_BLEND)
+               || reductionCompositeMode(composite_mode) ) {
+        if (depth_format != ICET_IMAGE_DEPTH_NONE) return 1;
+        if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+            && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+            && (color_format != ICET_IMAGE_COLOR_RGBA_HALF)
+            && (   (composite_mode == ICET_COMPOSITE_MODE_BLEND)
+                || !addOnlyColorFormat(color_format) ) ) {
+            return 1;
+        }
+    } else {
+        return 1;
+    }
+
+    max_bands = pixels/ICET_MIN_BAND_PIXELS;
+    if (max_bands < num_threads) {
+        return (max_bands > 1) ? (IceTInt)max_bands : 1;
+    }
+    return num_threads;
+}
+
+/* Creates num_bands scratch sparse images in the state buffer buffer_id for
+ * the pieces of a width x height region.  If split_rows is true, each band
+ * gets a range of rows.  Otherwise the region is treated as a single line of
+ * pixels, and each band gets a range of them.  If extra_size is not 0, that
+ * many bytes are also reserved in the buffer and returned in extra_p. */
+static IceTSparseImage *icetSparseImageAllocateBands(
+                                          IceTEnum buffer_id,
+                                          const IceTSparseImage out_image,
+                                          IceTInt num_bands,
+                                          IceTSizeType width,
+                                          IceTSizeType height,
+                                          IceTBoolean split_rows,
+                                          IceTSizeType extra_size,
+                                          IceTVoid **extra_p)
+{
+    IceTEnum color_format = icetSparseImageGetColorFormat(out_image);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(out_image);
+    IceTSizeType total_size;
+    IceTSparseImage *bands;
+    IceTByte *buffer;
+    IceTInt band;
+
+    total_size = extra_size + num_bands*sizeof(IceTSparseImage);
+    for (band = 0; band < num_bands; band++) {
+        if (split_rows) {
+            total_size += icetSparseImageBufferSizeType(
+                color_format, depth_format,
+                width, ICET_BAND_SIZE(height, band, num_bands));
+        } else {
+            total_size += icetSparseImageBufferSizeType(
+                color_format, depth_format,
+                ICET_BAND_SIZE(width*height, band, num_bands), 1);
+        }
+    }
+
+    buffer = icetGetStateBuffer(buffer_id, total_size);
+    if (extra_p != NULL) {
+        *extra_p = buffer;
+    }
+    buffer += extra_size;
+    bands = (IceTSparseImage *)buffer;
+    buffer += num_bands*sizeof(IceTSparseImage);
+    for (band = 0; band < num_bands; band++) {
+        IceTSizeType band_width, band_height;
+        if (split_rows) {
+            band_width = width;
+            band_height = ICET_BAND_SIZE(height, band, num_bands);
+        } else {
+            band_width = ICET_BAND_SIZE(width*height, band, num_bands);
+            band_height = 1;
+        }
+        bands[band] = icetSparseImageAssignBuffer(buffer,
+                                                  band_width,
+                                                  band_height);
+        ICET_IMAGE_HEADER(bands[band])[ICET_IMAGE_COLOR_FORMAT_INDEX]
+            = color_format;
+        ICET_IMAGE_HEADER(bands[band])[ICET_IMAGE_DEPTH_FORMAT_INDEX]
+            = depth_format;
+        buffer += icetSparseImageBufferSizeType(color_format,
+                                                depth_format,
+                                                band_width,
+                                                band_height);
+    }
+
+    return bands;
+}
+
+/* Appends the run lengths in [in_data, in_end) to the sparse data at
+ * *out_data_p.  *last_run_p points to the last run length pair already
+ * written (or NULL if none).  If the output ends in an inactive run or the
+ * input starts with an active one, the two runs are merged so that the
+ * result is the same as if the pixels were compressed together.  Both
+ * pointers are updated. */
+static void icetSparseImageAppendRuns(const IceTByte *in_data,
+                                      const IceTByte *in_end,
+                                      IceTSizeType pixel_size,
+                                      IceTByte **out_data_p,
+                                      IceTByte **last_run_p)
+{
+    IceTByte *out_data = *out_data_p;
+    IceTByte *last_run = *last_run_p;
+    const IceTByte *in_last_run;
+    const IceTByte *scan;
+
+    if (in_data >= in_end) return;
+
+    /* Find the last run length of the input. */
+    in_last_run = in_data;
+    for (scan = in_data; scan < in_end;
+         scan += RUN_LENGTH_SIZE + ACTIVE_RUN_LENGTH(scan)*pixel_size) {
+        in_last_run = scan;
+    }
+
+    if (   (last_run != NULL)
+        && (   (ACTIVE_RUN_LENGTH(last_run) == 0)
+            || (INACTIVE_RUN_LENGTH(in_data) == 0) ) ) {
+        /* Merge the first input run length into the last output run length.
+           In either case, the pixel data of the last output run is at the end
+           of the output, so the input data can follow directly. */
+        if (ACTIVE_RUN_LENGTH(last_run) == 0) {
+            INACTIVE_RUN_LENGTH(last_run) += INACTIVE_RUN_LENGTH(in_data);
+            ACTIVE_RUN_LENGTH(last_run) = ACTIVE_RUN_LENGTH(in_data);
+        } else {
+            ACTIVE_RUN_LENGTH(last_run) += ACTIVE_RUN_LENGTH(in_data);
+        }
+        in_data += RUN_LENGTH_SIZE;
+        if (in_last_run >= in_data) {
+            last_run = out_data + (in_last_run - in_data);
+        }
+    } else {
+        last_run = out_data + (in_last_run - in_data);
+    }
+
+    memcpy(out_data, in_data, in_end - in_data);
+    out_data += in_end - in_data;
+
+    *out_data_p = out_data;
+    *last_run_p = last_run;
+}
+
+/* Appends an inactive run of the given length. */
+static void icetSparseImageAppendInactive(IceTSizeType num_inactive,
+                                          IceTByte **out_data_p,
+                                          IceTByte **last_run_p)
+{
+    IceTRunLengthType run_lengths[2];
+    if (num_inactive < 1) return;
+    run_lengths[0] = (IceTRunLengthType)num_inactive;
+    run_lengths[1] = 0;
+    icetSparseImageAppendRuns((const IceTByte *)run_lengths,
+                              (const IceTByte *)run_lengths + RUN_LENGTH_SIZE,
+                              0,
+                              out_data_p,
+                              last_run_p);
+}
+
+/* Joins the bands (in order) into out_image with the given amount
+ * of inactive pixels before and after and builds its seek table. */
+static void icetSparseImageJoinBands(const IceTSparseImage *bands,
+                                  IceTInt num_bands,
+                                  IceTSizeType inactive_before,
+                                  IceTSizeType inactive_after,
+                                  IceTSparseImage out_image)
+{
+    IceTSizeType pixel_size;
+    IceTByte *out_data;
+    IceTByte *last_run = NULL;
+    IceTInt band;
+
+    pixel_size
+        = sparseDataPixelSize(icetSparseImageGetColorFormat(out_image),
+                              icetSparseImageGetDepthFormat(out_image));
+
+    out_data = ICET_IMAGE_DATA(out_image);
+    icetSparseImageAppendInactive(inactive_before, &out_data, &last_run);
+    for (band = 0; band < num_bands; band++) {
+        const IceTByte *band_data = ICET_IMAGE_DATA(bands[band]);
+        const IceTByte *band_end
+            = (const IceTByte *)icetSparseImageGetDepthPlane(bands[band]);
+        if (band_end == NULL) {
+            band_end = (  (const IceTByte *)ICET_IMAGE_HEADER(bands[band])
+                        + icetSparseImageGetCompressedBufferSize(bands[band]));
+        }
+        icetSparseImageAppendRuns(band_data, band_end, pixel_size,
+                                  &out_data, &last_run);
+    }
+    icetSparseImageAppendInactive(inactive_after, &out_data, &last_run);
+
+    icetSparseImageSetActualSize(out_image, out_data);
+
+    /* The depth planes of the bands follow each other in order. */
+    for (band = 0; band < num_bands; band++) {
+        const IceTByte *band_depth
+            = (const IceTByte *)icetSparseImageGetDepthPlane(bands[band]);
+        if (band_depth != NULL) {
+            icetSparseImageAppendDepths(
+                       out_image,
+                       band_depth,
+                       (  (const IceTByte *)ICET_IMAGE_HEADER(bands[band])
+                        + icetSparseImageGetCompressedBufferSize(bands[band])));
+        }
+    }
+
+    icetSparseImageFindActiveBounds(out_image);
+    icetSparseImageBuildSeekTable(out_image);
+}
+
+static void icetCompressSubImageBand(const IceTImage image,
+                                     IceTSizeType offset,
+                                     IceTSizeType pixels,
+                                     IceTSparseImage compressed_image)
+{
+#define INPUT_IMAGE             image
+#define OUTPUT_SPARSE_IMAGE     compressed_image
+#define OFFSET                  offset
+#define PIXEL_COUNT             pixels
+#define WORKER_THREAD
+#include "compress_func_body.h"
+}
+
+static void icetCompressSubImageBandFunc(IceTInt band, IceTVoid *data)
+{
+    const struct IceTCompressBands *work = (struct IceTCompressBands *)data;
+    IceTSizeType band_start = (work->pixels*band)/work->num_bands;
+    icetCompressSubImageBand(work->image,
+                             work->offset + band_start,
+                             ICET_BAND_SIZE(work->pixels,
+                                                     band,
+                                                     work->num_bands),
+                             work->bands[band]);
+}
+
+static void icetCompressTileBand(const IceTImage raw_image,
+                                 const IceTInt *screen_viewport,
+                                 IceTSizeType row_start,
+                                 IceTSizeType num_rows,
+                                 IceTSizeType width,
+                                 IceTSizeType space_left,
+                                 IceTSizeType space_right,
+                                 IceTSparseImage compressed_image)
+{
+#define INPUT_IMAGE             raw_image
+#define OUTPUT_SPARSE_IMAGE     compressed_image
+#define PADDING
+#define SPACE_BOTTOM            0
+#define SPACE_TOP               0
+#define SPACE_LEFT              space_left
+#define SPACE_RIGHT             space_right
+#define FULL_WIDTH              width
+#define FULL_HEIGHT             num_rows
+#define REGION
+#define REGION_OFFSET_X         screen_viewport[0]
+#define REGION_OFFSET_Y         (screen_viewport[1] + row_start)
+#define REGION_WIDTH            screen_viewport[2]
+#define REGION_HEIGHT           num_rows
+#define WORKER_THREAD
+#include "compress_func_body.h"
+}
+
+static void icetCompressTileBandFunc(IceTInt band, IceTVoid *data)
+{
+    const struct IceTCompressBands *work = (struct IceTCompressBands *)data;
+    IceTSizeType num_rows = work->screen_viewport[3];
+    IceTSizeType row_start = (num_rows*band)/work->num_bands;
+    icetCompressTileBand(work->image,
+                         work->screen_viewport,
+                         row_start,
+                         ICET_BAND_SIZE(num_rows,
+                                                 band,
+                                                 work->num_bands),
+                         work->width,
+                         work->space_left,
+                         work->space_right,
+                         work->bands[band]);
+}
+
 void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
 {
     IceTInt screen_viewport[4], target_viewport[4];
@@ -2095,6 +4265,7 @@ void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
     const IceTInt *viewports;
     IceTSizeType width, height;
     IceTSizeType space_left, space_right, space_bottom, space_top;
+    IceTInt num_bands;
 
     viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
     width = viewports[4*tile+2];
@@ -2117,6 +4288,38 @@ void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
 
     icetSparseImageSetDimensions(compressed_image, width, height);
 
+    num_bands = icetSparseImageNumBands(ICET_COMPRESS_THREADS,
+                                        icetImageGetColorFormat(raw_image),
+                                        icetImageGetDepthFormat(raw_image),
+                                        target_viewport[2]*target_viewport[3]);
+    if (num_bands > target_viewport[3]) num_bands = target_viewport[3];
+    if (num_bands > 1) {
+        struct IceTCompressBands work;
+
+        work.image = raw_image;
+        work.bands = icetSparseImageAllocateBands(ICET_COMPRESS_BAND_BUF,
+                                                  compressed_image,
+                                                  num_bands,
+                                                  width,
+                                                  target_viewport[3],
+                                                  ICET_TRUE,
+                                                  0,
+                                                  NULL);
+        work.num_bands = num_bands;
+        work.screen_viewport = screen_viewport;
+        work.width = width;
+        work.space_left = space_left;
+        work.space_right = space_right;
+
+        icetTimingCompressBegin();
+        icetParallelFor(num_bands, num_bands, icetCompressTileBandFunc, &work);
+        icetSparseImageJoinBands(work.bands, num_bands,
+                              space_bottom*width, space_top*width,
+                              compressed_image);
+        icetTimingCompressEnd();
+        return;
+    }
+
 #define INPUT_IMAGE             raw_image
 #define OUTPUT_SPARSE_IMAGE     compressed_image
 #define PADDING
@@ -2146,17 +4349,48 @@ void icetCompressImage(const IceTImage image,
         = (IceTInt)icetImageGetWidth(image);
     ICET_IMAGE_HEADER(compressed_image)[ICET_IMAGE_HEIGHT_INDEX]
         = (IceTInt)icetImageGetHeight(image);
+    icetSparseImageFindActiveBounds(compressed_image);
 }
 
 void icetCompressSubImage(const IceTImage image,
                           IceTSizeType offset, IceTSizeType pixels,
                           IceTSparseImage compressed_image)
 {
+    IceTInt num_bands;
+
     ICET_TEST_IMAGE_HEADER(image);
     ICET_TEST_SPARSE_IMAGE_HEADER(compressed_image);
 
     icetSparseImageSetDimensions(compressed_image, pixels, 1);
 
+    num_bands = icetSparseImageNumBands(ICET_COMPRESS_THREADS,
+                                        icetImageGetColorFormat(image),
+                                        icetImageGetDepthFormat(image),
+                                        pixels);
+    if (num_bands > 1) {
+        struct IceTCompressBands work;
+
+        work.image = image;
+        work.bands = icetSparseImageAllocateBands(ICET_COMPRESS_BAND_BUF,
+                                                  compressed_image,
+                                                  num_bands,
+                                                  pixels,
+                                                  1,
+                                                  ICET_FALSE,
+                                                  0,
+                                                  NULL);
+        work.num_bands = num_bands;
+        work.offset = offset;
+        work.pixels = pixels;
+
+        icetTimingCompressBegin();
+        icetParallelFor(num_bands, num_bands,
+                        icetCompressSubImageBandFunc, &work);
+        icetSparseImageJoinBands(work.bands, num_bands, 0, 0, compressed_image);
+        icetTimingCompressEnd();
+        return;
+    }
+
 #define INPUT_IMAGE             image
 #define OUTPUT_SPARSE_IMAGE     compressed_image
 #define OFFSET                  offset
@@ -2266,19 +4500,124 @@ void icetComposite(IceTImage destBuffer, const IceTImage srcBuffer,
             IceTFloat *destDepthBuffer = icetImageGetDepthf(destBuffer);
 
             if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-                const IceTUInt *srcColorBuffer=icetImageGetColorui(srcBuffer);
-                IceTUInt *destColorBuffer = icetImageGetColorui(destBuffer);
+                const IceTUInt *srcColorBuffer=icetImageGetColorcui(srcBuffer);
+                IceTUInt *destColorBuffer = icetImageGetColorui(destBuffer);
+                icetSIMDZBufferUByte(srcColorBuffer, srcDepthBuffer,
+                                     destColorBuffer, destDepthBuffer,
+                                     pixels);
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                const IceTFloat *srcColorBuffer=icetImageGetColorcf(srcBuffer);
+                IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
+                icetSIMDZBufferFloat(srcColorBuffer, srcDepthBuffer,
+                                     destColorBuffer, destDepthBuffer,
+                                     pixels);
+            } else if (color_format == ICET_IMAGE_COLOR_NONE) {
+                icetSIMDZBufferDepth(srcDepthBuffer, destDepthBuffer, pixels);
+            } else {
+                depthZBufferPixels(color_format,
+                                   depth_format,
+                                   icetImageGetColorConstVoid(srcBuffer, NULL),
+                                   srcDepthBuffer,
+                                   icetImageGetColorVoid(destBuffer, NULL),
+                                   destDepthBuffer,
+                                   pixels);
+            }
+        } else if (depth_format == ICET_IMAGE_DEPTH_NONE) {
+            icetRaiseError("Cannot use Z buffer compositing operation with no"
+                           " Z buffer.", ICET_INVALID_OPERATION);
+        } else {
+            depthZBufferPixels(color_format,
+                               depth_format,
+                               icetImageGetColorConstVoid(srcBuffer, NULL),
+                               icetImageGetDepthConstVoid(srcBuffer, NULL),
+                               icetImageGetColorVoid(destBuffer, NULL),
+                               icetImageGetDepthVoid(destBuffer, NULL),
+                               pixels);
+        }
+    } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+        if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+            icetRaiseWarning("Z buffer ignored during blend composite"
+                             " operation.  Output z buffer meaningless.",
+                             ICET_INVALID_VALUE);
+        }
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            const IceTUByte *srcColorBuffer = icetImageGetColorcub(srcBuffer);
+            IceTUByte *destColorBuffer = icetImageGetColorub(destBuffer);
+            if (srcOnTop) {
+                icetSIMDBlendUByte(srcColorBuffer, destColorBuffer,
+                                   destColorBuffer, pixels);
+            } else {
+                icetSIMDBlendUByte(destColorBuffer, srcColorBuffer,
+                                   destColorBuffer, pixels);
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            const IceTFloat *srcColorBuffer = icetImageGetColorcf(srcBuffer);
+            IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
+            if (srcOnTop) {
+                icetSIMDBlendFloat(srcColorBuffer, destColorBuffer,
+                                   destColorBuffer, pixels);
+            } else {
+                icetSIMDBlendFloat(destColorBuffer, srcColorBuffer,
+                                   destColorBuffer, pixels);
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+            const IceTUShort *srcColorBuffer
+                = icetImageGetColorConstVoid(srcBuffer, NULL);
+            IceTUShort *destColorBuffer = icetImageGetColorVoid(destBuffer, NULL);
+            if (srcOnTop) {
+                icetSIMDBlendHalf(srcColorBuffer, destColorBuffer,
+                                  destColorBuffer, pixels);
+            } else {
+                icetSIMDBlendHalf(destColorBuffer, srcColorBuffer,
+                                  destColorBuffer, pixels);
+            }
+        } else if (addOnlyColorFormat(color_format)) {
+            icetRaiseError("Cannot blend colors without an alpha channel.",
+                           ICET_INVALID_OPERATION);
+        } else if (color_format == ICET_IMAGE_COLOR_NONE) {
+            icetRaiseWarning("Compositing image with no data.",
+                             ICET_INVALID_OPERATION);
+        } else {
+            icetRaiseError("Encountered invalid color format.",
+                           ICET_SANITY_CHECK_FAIL);
+        }
+    } else if (composite_mode == ICET_COMPOSITE_MODE_ADD) {
+        if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+            /* Pixels at the far plane are inactive and hold the background
+               color, so they are replaced rather than summed. */
+            const IceTFloat *srcDepthBuffer = icetImageGetDepthf(srcBuffer);
+            IceTFloat *destDepthBuffer = icetImageGetDepthf(destBuffer);
+
+            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                const IceTUByte *srcColorBuffer=icetImageGetColorcub(srcBuffer);
+                IceTUByte *destColorBuffer = icetImageGetColorub(destBuffer);
                 for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    if (srcDepthBuffer[i] >= 1.0f) continue;
+                    if (destDepthBuffer[i] < 1.0f) {
+                        ICET_ADD_UBYTE(srcColorBuffer + i*4,
+                                       destColorBuffer + i*4,
+                                       destColorBuffer + i*4);
+                        if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                            destDepthBuffer[i] = srcDepthBuffer[i];
+                        }
+                    } else {
                         destDepthBuffer[i] = srcDepthBuffer[i];
-                        destColorBuffer[i] = srcColorBuffer[i];
+                        memcpy(destColorBuffer + i*4, srcColorBuffer + i*4, 4);
                     }
                 }
             } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-                const IceTFloat *srcColorBuffer = icetImageGetColorf(srcBuffer);
+                const IceTFloat *srcColorBuffer = icetImageGetColorcf(srcBuffer);
                 IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
                 for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    if (srcDepthBuffer[i] >= 1.0f) continue;
+                    if (destDepthBuffer[i] < 1.0f) {
+                        ICET_ADD_FLOAT(srcColorBuffer + i*4,
+                                       destColorBuffer + i*4,
+                                       destColorBuffer + i*4);
+                        if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                            destDepthBuffer[i] = srcDepthBuffer[i];
+                        }
+                    } else {
                         destDepthBuffer[i] = srcDepthBuffer[i];
                         destColorBuffer[4*i+0] = srcColorBuffer[4*i+0];
                         destColorBuffer[4*i+1] = srcColorBuffer[4*i+1];
@@ -2293,110 +4632,765 @@ void icetComposite(IceTImage destBuffer, const IceTImage srcBuffer,
                     }
                 }
             } else {
-                icetRaiseError("Encountered invalid color format.",
-                               ICET_SANITY_CHECK_FAIL);
+                depthReducePixels(composite_mode,
+                                  color_format,
+                                  depth_format,
+                                  icetImageGetColorConstVoid(srcBuffer, NULL),
+                                  srcDepthBuffer,
+                                  icetImageGetColorVoid(destBuffer, NULL),
+                                  destDepthBuffer,
+                                  pixels);
             }
         } else if (depth_format == ICET_IMAGE_DEPTH_NONE) {
-            icetRaiseError("Cannot use Z buffer compositing operation with no"
-                           " Z buffer.", ICET_INVALID_OPERATION);
-        } else {
-            icetRaiseError("Encountered invalid depth format.",
-                           ICET_SANITY_CHECK_FAIL);
-        }
-    } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
-        if (depth_format != ICET_IMAGE_DEPTH_NONE) {
-            icetRaiseWarning("Z buffer ignored during blend composite"
-                             " operation.  Output z buffer meaningless.",
-                             ICET_INVALID_VALUE);
-        }
-        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-            const IceTUByte *srcColorBuffer = icetImageGetColorcub(srcBuffer);
-            IceTUByte *destColorBuffer = icetImageGetColorub(destBuffer);
-            if (srcOnTop) {
-                for (i = 0; i < pixels; i++) {
-                    ICET_OVER_UBYTE(srcColorBuffer + i*4,
-                                    destColorBuffer + i*4);
-                }
-            } else {
+            /* Without depth, empty pixels have zero color, which adds
+               nothing. */
+            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                const IceTUByte *srcColorBuffer=icetImageGetColorcub(srcBuffer);
+                IceTUByte *destColorBuffer = icetImageGetColorub(destBuffer);
                 for (i = 0; i < pixels; i++) {
-                    ICET_UNDER_UBYTE(srcColorBuffer + i*4,
-                                     destColorBuffer + i*4);
+                    ICET_ADD_UBYTE(srcColorBuffer + i*4,
+                                   destColorBuffer + i*4,
+                                   destColorBuffer + i*4);
                 }
-            }
-        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-            const IceTFloat *srcColorBuffer = icetImageGetColorcf(srcBuffer);
-            IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
-            if (srcOnTop) {
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                const IceTFloat *srcColorBuffer = icetImageGetColorcf(srcBuffer);
+                IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
                 for (i = 0; i < pixels; i++) {
-                    ICET_OVER_FLOAT(srcColorBuffer + i*4,
-                                    destColorBuffer + i*4);
+                    ICET_ADD_FLOAT(srcColorBuffer + i*4,
+                                   destColorBuffer + i*4,
+                                   destColorBuffer + i*4);
                 }
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+                icetSIMDAddHalf(icetImageGetColorConstVoid(srcBuffer, NULL),
+                                icetImageGetColorVoid(destBuffer, NULL),
+                                icetImageGetColorVoid(destBuffer, NULL),
+                                pixels);
+            } else if (addOnlyColorFormat(color_format)) {
+                colorAddValues(color_format,
+                               icetImageGetColorConstVoid(srcBuffer, NULL),
+                               icetImageGetColorVoid(destBuffer, NULL),
+                               icetImageGetColorVoid(destBuffer, NULL),
+                               pixels);
+            } else if (color_format == ICET_IMAGE_COLOR_NONE) {
+                icetRaiseWarning("Compositing image with no data.",
+                                 ICET_INVALID_OPERATION);
             } else {
-                for (i = 0; i < pixels; i++) {
-                    ICET_UNDER_FLOAT(srcColorBuffer + i*4,
-                                     destColorBuffer + i*4);
-                }
+                icetRaiseError("Encountered invalid color format.",
+                               ICET_SANITY_CHECK_FAIL);
             }
-        } else if (color_format == ICET_IMAGE_COLOR_NONE) {
+        } else {
+            depthReducePixels(composite_mode,
+                              color_format,
+                              depth_format,
+                              icetImageGetColorConstVoid(srcBuffer, NULL),
+                              icetImageGetDepthConstVoid(srcBuffer, NULL),
+                              icetImageGetColorVoid(destBuffer, NULL),
+                              icetImageGetDepthVoid(destBuffer, NULL),
+                              pixels);
+        }
+    } else if (   (composite_mode == ICET_COMPOSITE_MODE_MAX)
+               || (composite_mode == ICET_COMPOSITE_MODE_MIN) ) {
+        /* Empty pixels hold zero colors or the far depth, so they must
+           not be compared with other pixels. */
+        if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+            depthReducePixels(composite_mode,
+                              color_format,
+                              depth_format,
+                              icetImageGetColorConstVoid(srcBuffer, NULL),
+                              icetImageGetDepthConstVoid(srcBuffer, NULL),
+                              icetImageGetColorVoid(destBuffer, NULL),
+                              icetImageGetDepthVoid(destBuffer, NULL),
+                              pixels);
+        } else if (color_format != ICET_IMAGE_COLOR_NONE) {
+            colorExtremumPixels(composite_mode,
+                                color_format,
+                                icetImageGetColorConstVoid(srcBuffer, NULL),
+                                icetImageGetColorVoid(destBuffer, NULL),
+                                pixels);
+        } else {
             icetRaiseWarning("Compositing image with no data.",
                              ICET_INVALID_OPERATION);
-        } else {
-            icetRaiseError("Encountered invalid color format.",
-                           ICET_SANITY_CHECK_FAIL);
         }
     } else {
         icetRaiseError("Encountered invalid composite mode.",
                        ICET_SANITY_CHECK_FAIL);
     }
 
-    icetTimingBlendEnd();
-}
+    icetTimingBlendEnd();
+}
+
+IceTSizeType icetImagePackedPixelSize(IceTEnum color_format,
+                                      IceTEnum depth_format)
+{
+    IceTSizeType size = colorPixelSize(color_format)
+                        + depthPixelSize(depth_format);
+    IceTSizeType alignment
+        = (accumulationChannels(color_format) > 0) ? sizeof(IceTDouble) : 4;
+
+    return ((size + alignment - 1)/alignment)*alignment;
+}
+
+void icetImagePackPixels(const IceTImage image,
+                         IceTSizeType offset,
+                         IceTSizeType num_pixels,
+                         IceTVoid *buffer)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType color_size = colorPixelSize(color_format);
+    IceTSizeType depth_size = depthPixelSize(depth_format);
+    IceTSizeType pixel_size
+        = icetImagePackedPixelSize(color_format, depth_format);
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *color = NULL;
+    const IceTByte *depth = NULL;
+    IceTByte *out = (IceTByte *)buffer;
+    IceTSizeType i;
+
+    if (color_size > 0) {
+        color = (const IceTByte *)icetImageGetColorConstVoid(image, NULL)
+                + offset*color_size;
+    }
+    if (depth_size > 0) {
+        depth = (const IceTByte *)icetImageGetDepthConstVoid(image, NULL)
+                + offset*depth_size;
+    }
+
+    if ((depth_size == 0) && (color_size == pixel_size)) {
+        memcpy(out, color, num_pixels*pixel_size);
+        return;
+    }
+
+    for (i = 0; i < num_pixels; i++) {
+        if (color_size > 0) {
+            memcpy(out, color, color_size);
+            color += color_size;
+        }
+        if (depth_size > 0) {
+            memcpy(out + color_size, depth, depth_size);
+            depth += depth_size;
+        }
+        memset(out + color_size + depth_size,
+               0,
+               pixel_size - color_size - depth_size);
+        out += pixel_size;
+    }
+}
+
+void icetImageUnpackPixels(const IceTVoid *buffer,
+                           IceTImage image,
+                           IceTSizeType offset,
+                           IceTSizeType num_pixels)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType color_size = colorPixelSize(color_format);
+    IceTSizeType depth_size = depthPixelSize(depth_format);
+    IceTSizeType pixel_size
+        = icetImagePackedPixelSize(color_format, depth_format);
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    IceTByte *color = NULL;
+    IceTByte *depth = NULL;
+    const IceTByte *in = (const IceTByte *)buffer;
+    IceTSizeType i;
+
+    if (color_size > 0) {
+        color = (IceTByte *)icetImageGetColorVoid(image, NULL)
+                + offset*color_size;
+    }
+    if (depth_size > 0) {
+        depth = (IceTByte *)icetImageGetDepthVoid(image, NULL)
+                + offset*depth_size;
+    }
+
+    if ((depth_size == 0) && (color_size == pixel_size)) {
+        memcpy(color, in, num_pixels*pixel_size);
+        return;
+    }
+
+    for (i = 0; i < num_pixels; i++) {
+        if (color_size > 0) {
+            memcpy(color, in, color_size);
+            color += color_size;
+        }
+        if (depth_size > 0) {
+            memcpy(depth, in + color_size, depth_size);
+            depth += depth_size;
+        }
+        in += pixel_size;
+    }
+}
+
+void icetImageReducePackedPixels(IceTEnum composite_mode,
+                                 IceTEnum color_format,
+                                 IceTEnum depth_format,
+                                 const IceTVoid *src,
+                                 IceTVoid *dest,
+                                 IceTSizeType num_pixels)
+{
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *src_b = (const IceTByte *)src;
+    IceTByte *dest_b = (IceTByte *)dest;
+    IceTSizeType color_size = colorPixelSize(color_format);
+    IceTSizeType pixel_size
+        = icetImagePackedPixelSize(color_format, depth_format);
+    IceTSizeType i;
+
+    if (!reductionCompositeMode(composite_mode)) {
+        icetRaiseError("Only order independent composite modes can reduce"
+                       " packed pixels.",
+                       ICET_SANITY_CHECK_FAIL);
+        return;
+    }
+
+    if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+        for (i = 0; i < num_pixels; i++) {
+            depthReducePixels(composite_mode,
+                              color_format,
+                              depth_format,
+                              src_b,
+                              src_b + color_size,
+                              dest_b,
+                              dest_b + color_size,
+                              1);
+            src_b += pixel_size;
+            dest_b += pixel_size;
+        }
+    } else {
+        compositePixels(composite_mode, color_format, depth_format,
+                        src, NULL, dest, NULL, num_pixels);
+    }
+}
+
+void icetCompressedComposite(IceTImage destBuffer,
+                             const IceTSparseImage srcBuffer,
+                             int srcOnTop)
+{
+    if (    icetImageGetNumPixels(destBuffer)
+         != icetSparseImageGetNumPixels(srcBuffer) ) {
+        icetRaiseError("Size of input and output buffers do not agree.",
+                       ICET_INVALID_VALUE);
+    }
+    icetCompressedSubComposite(destBuffer, 0, srcBuffer, srcOnTop);
+}
+void icetCompressedSubComposite(IceTImage destBuffer,
+                                IceTSizeType offset,
+                                const IceTSparseImage srcBuffer,
+                                int srcOnTop)
+{
+    icetTimingBlendBegin();
+
+    if (srcOnTop) {
+#define INPUT_SPARSE_IMAGE      srcBuffer
+#define OUTPUT_IMAGE            destBuffer
+#define OFFSET                  offset
+#define PIXEL_COUNT             icetSparseImageGetNumPixels(srcBuffer)
+#define COMPOSITE
+#define BLEND_RGBA_UBYTE        ICET_OVER_UBYTE
+#define BLEND_RGBA_FLOAT        ICET_OVER_FLOAT
+#define BLEND_RGBA_HALF(src, dest, count) \
+                                icetSIMDBlendHalf(src, dest, dest, count)
+#include "decompress_func_body.h"
+    } else {
+#define INPUT_SPARSE_IMAGE      srcBuffer
+#define OUTPUT_IMAGE            destBuffer
+#define OFFSET                  offset
+#define PIXEL_COUNT             icetSparseImageGetNumPixels(srcBuffer)
+#define COMPOSITE
+#define BLEND_RGBA_UBYTE        ICET_UNDER_UBYTE
+#define BLEND_RGBA_FLOAT        ICET_UNDER_FLOAT
+#define BLEND_RGBA_HALF(src, dest, count) \
+                                icetSIMDBlendHalf(dest, src, dest, count)
+#include "decompress_func_body.h"
+    }
+
+    icetTimingBlendEnd();
+}
+
+static void icetCompressedCompressedCompositeBand(
+                                        const IceTSparseImage front_buffer,
+                                        const IceTSparseImage back_buffer,
+                                        struct IceTCCCompositeSeek *seek,
+                                        IceTSizeType num_pixels,
+                                        IceTSparseImage dest_buffer)
+{
+    /* The formats come from the front buffer; the caller checked that the
+       back buffer agrees. */
+    (void)back_buffer;
+
+#define FRONT_SPARSE_IMAGE front_buffer
+#define BACK_SPARSE_IMAGE back_buffer
+#define DEST_SPARSE_IMAGE dest_buffer
+#define PARTITION
+#define PARTITION_PIXELS num_pixels
+#define FRONT_START seek->front
+#define FRONT_DEPTH_START seek->front_depth
+#define FRONT_INACTIVE seek->front_inactive
+#define FRONT_ACTIVE seek->front_active
+#define BACK_START seek->back
+#define BACK_DEPTH_START seek->back_depth
+#define BACK_INACTIVE seek->back_inactive
+#define BACK_ACTIVE seek->back_active
+#define CORRUPT seek->corrupt
+#include "cc_composite_func_body.h"
+}
+
+static void icetCompressedCompressedCompositeBandFunc(IceTInt band,
+                                                      IceTVoid *data)
+{
+    const struct IceTCCCompositeBands *work
+        = (struct IceTCCCompositeBands *)data;
+    icetCompressedCompressedCompositeBand(work->front,
+                                          work->back,
+                                          work->seeks + band,
+                                          ICET_BAND_SIZE(work->num_pixels,
+                                                         band,
+                                                         work->num_bands),
+                                          work->bands[band]);
+}
+
+/* Composites front_buffer and back_buffer in num_bands bands on separate
+ * threads.  Each band seeks into the inputs at its first pixel and composites
+ * into its own scratch image, and the results are joined in dest_buffer. */
+static void icetCompressedCompressedCompositeThreaded(
+                                           const IceTSparseImage front_buffer,
+                                           const IceTSparseImage back_buffer,
+                                           IceTSparseImage dest_buffer,
+                                           IceTInt num_bands)
+{
+    struct IceTCCCompositeBands work;
+    IceTSizeType pixel_size;
+    IceTSizeType depth_size;
+    const IceTVoid *front_data;
+    const IceTVoid *front_depth;
+    const IceTVoid **front_depth_p;
+    IceTSizeType front_inactive;
+    IceTSizeType front_active;
+    const IceTVoid *back_data;
+    const IceTVoid *back_depth;
+    const IceTVoid **back_depth_p;
+    IceTSizeType back_inactive;
+    IceTSizeType back_active;
+    IceTBoolean corrupt;
+    IceTInt band;
+
+    pixel_size
+        = sparseDataPixelSize(icetSparseImageGetColorFormat(front_buffer),
+                              icetSparseImageGetDepthFormat(front_buffer));
+    depth_size
+        = sparseDepthPlanePixelSize(
+                                icetSparseImageGetColorFormat(front_buffer),
+                                icetSparseImageGetDepthFormat(front_buffer));
+
+    icetSparseImageSetDimensions(dest_buffer,
+                                 icetSparseImageGetWidth(front_buffer),
+                                 icetSparseImageGetHeight(back_buffer));
+
+    work.front = front_buffer;
+    work.back = back_buffer;
+    work.num_bands = num_bands;
+    work.num_pixels = icetSparseImageGetNumPixels(front_buffer);
+    work.bands = icetSparseImageAllocateBands(
+                                ICET_CC_COMPOSITE_BAND_BUF,
+                                dest_buffer,
+                                num_bands,
+                                work.num_pixels,
+                                1,
+                                ICET_FALSE,
+                                num_bands*sizeof(struct IceTCCCompositeSeek),
+                                (IceTVoid **)&work.seeks);
+
+    /* Find where each band starts in the inputs.  This only hops over run
+       lengths (or jumps with the seek tables), so it is cheap compared to
+       compositing. */
+    front_data = ICET_IMAGE_DATA(front_buffer);
+    back_data = ICET_IMAGE_DATA(back_buffer);
+    front_depth = icetSparseImageGetDepthPlane(front_buffer);
+    back_depth = icetSparseImageGetDepthPlane(back_buffer);
+    front_depth_p = (front_depth != NULL) ? &front_depth : NULL;
+    back_depth_p = (back_depth != NULL) ? &back_depth : NULL;
+    front_inactive = front_active = 0;
+    back_inactive = back_active = 0;
+    for (band = 0; band < num_bands; band++) {
+        struct IceTCCCompositeSeek *seek = work.seeks + band;
+        if (band > 0) {
+            IceTSizeType from = (work.num_pixels*(band-1))/num_bands;
+            IceTSizeType to = (work.num_pixels*band)/num_bands;
+            icetSparseImageSeek(front_buffer,
+                                from,
+                                to,
+                                pixel_size,
+                                depth_size,
+                                &front_data,
+                                front_depth_p,
+                                &front_inactive,
+                                &front_active);
+            icetSparseImageSeek(back_buffer,
+                                from,
+                                to,
+                                pixel_size,
+                                depth_size,
+                                &back_data,
+                                back_depth_p,
+                                &back_inactive,
+                                &back_active);
+        }
+        seek->front = front_data;
+        seek->front_depth = front_depth;
+        seek->front_inactive = front_inactive;
+        seek->front_active = front_active;
+        seek->back = back_data;
+        seek->back_depth = back_depth;
+        seek->back_inactive = back_inactive;
+        seek->back_active = back_active;
+        seek->corrupt = ICET_FALSE;
+    }
+
+    icetParallelFor(num_bands,
+                    num_bands,
+                    icetCompressedCompressedCompositeBandFunc,
+                    &work);
+
+    corrupt = ICET_FALSE;
+    for (band = 0; band < num_bands; band++) {
+        if (work.seeks[band].corrupt) { corrupt = ICET_TRUE; }
+    }
+    if (corrupt) {
+        icetRaiseError("Corrupt compressed image.", ICET_INVALID_VALUE);
+        icetClearSparseImage(dest_buffer);
+        return;
+    }
+
+    icetSparseImageJoinBands(work.bands, num_bands, 0, 0, dest_buffer);
+}
+
+/* Where a partition of icetSparseImageSplit starts in the input. */
+struct IceTSparseImageSplitPart {
+    const IceTVoid *in_data;
+    const IceTVoid *in_depth;
+    IceTSizeType inactive_before;
+    IceTSizeType active_till_next_runl;
+    IceTSizeType num_pixels;
+};
+
+struct IceTSparseImageSplitWork {
+    IceTSparseImage *out_images;
+    struct IceTSparseImageSplitPart *parts;
+    IceTInt first_partition;
+    IceTSizeType pixel_size;
+    IceTSizeType depth_size;
+};
+
+static void icetSparseImageSplitFunc(IceTInt index, IceTVoid *data)
+{
+    const struct IceTSparseImageSplitWork *work
+        = (struct IceTSparseImageSplitWork *)data;
+    IceTInt partition = work->first_partition + index;
+    struct IceTSparseImageSplitPart *part = work->parts + partition;
+    icetSparseImageCopyPixelsInternal(
+                           &part->in_data,
+                           (part->in_depth != NULL) ? &part->in_depth : NULL,
+                           &part->inactive_before,
+                           &part->active_till_next_runl,
+                           part->num_pixels,
+                           work->pixel_size,
+                           work->depth_size,
+                           work->out_images[partition]);
+}
+
+static IceTBoolean icetSparseImageSplitThreaded(
+                                            const IceTSparseImage in_image,
+                                            IceTSizeType in_image_offset,
+                                            IceTInt num_partitions,
+                                            IceTSparseImage *out_images,
+                                            const IceTSizeType *offsets)
+{
+    IceTSizeType total_num_pixels = icetSparseImageGetNumPixels(in_image);
+    IceTEnum color_format = icetSparseImageGetColorFormat(in_image);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(in_image);
+    IceTInt num_threads;
+    struct IceTSparseImageSplitWork work;
+    const IceTVoid *in_data;
+    const IceTVoid *in_depth;
+    const IceTVoid **in_depth_p;
+    IceTSizeType inactive_before;
+    IceTSizeType active_till_next_runl;
+    IceTSizeType position;
+    IceTInt partition;
+
+    /* Without a seek table, finding where the partitions start is as much
+       work as copying them. */
+    if (ICET_IMAGE_SIZE_HEADER(in_image)[ICET_IMAGE_SEEK_TABLE_INDEX] == 0) {
+        return ICET_FALSE;
+    }
+
+    icetGetIntegerv(ICET_COMPRESS_THREADS, &num_threads);
+    if (num_threads > total_num_pixels/ICET_MIN_BAND_PIXELS) {
+        num_threads = (IceTInt)(total_num_pixels/ICET_MIN_BAND_PIXELS);
+    }
+    if (num_threads > num_partitions) {
+        num_threads = num_partitions;
+    }
+    if (num_threads < 2) return ICET_FALSE;
+
+    work.out_images = out_images;
+    work.parts = icetGetStateBuffer(
+                    ICET_SPARSE_SPLIT_BUF,
+                    num_partitions*sizeof(struct IceTSparseImageSplitPart));
+    work.first_partition = 0;
+    work.pixel_size = sparseDataPixelSize(color_format, depth_format);
+    work.depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
+
+    /* Anything that would raise a diagnostic is left to the serial code. */
+    for (partition = 0; partition < num_partitions; partition++) {
+        IceTSparseImage out_image = out_images[partition];
+        IceTSizeType partition_num_pixels;
+
+        if (partition < num_partitions-1) {
+            partition_num_pixels = offsets[partition+1] - offsets[partition];
+        } else {
+            partition_num_pixels
+                = total_num_pixels + in_image_offset - offsets[partition];
+        }
+        work.parts[partition].num_pixels = partition_num_pixels;
+
+        if (   (color_format != icetSparseImageGetColorFormat(out_image))
+            || (depth_format != icetSparseImageGetDepthFormat(out_image)) ) {
+            return ICET_FALSE;
+        }
+        if (icetSparseImageEqual(in_image, out_image)) {
+            /* The in place partition only rewrites its last run length, so it
+               can be done after the others have been copied. */
+            if (partition != 0) return ICET_FALSE;
+            work.first_partition = 1;
+        } else if (   ICET_IMAGE_HEADER(out_image)
+                          [ICET_IMAGE_MAX_NUM_PIXELS_INDEX]
+                    < partition_num_pixels ) {
+            return ICET_FALSE;
+        }
+    }
+
+    in_data = ICET_IMAGE_DATA(in_image);
+    in_depth = icetSparseImageGetDepthPlane(in_image);
+    in_depth_p = (in_depth != NULL) ? &in_depth : NULL;
+    inactive_before = active_till_next_runl = 0;
+    position = 0;
+    for (partition = 0; partition < num_partitions; partition++) {
+        struct IceTSparseImageSplitPart *part = work.parts + partition;
+        icetSparseImageSeek(in_image,
+                            position,
+                            offsets[partition] - in_image_offset,
+                            work.pixel_size,
+                            work.depth_size,
+                            &in_data,
+                            in_depth_p,
+                            &inactive_before,
+                            &active_till_next_runl);
+        position = offsets[partition] - in_image_offset;
+        part->in_data = in_data;
+        part->in_depth = in_depth;
+        part->inactive_before = inactive_before;
+        part->active_till_next_runl = active_till_next_runl;
+    }
+
+    icetParallelFor(num_threads,
+                    num_partitions - work.first_partition,
+                    icetSparseImageSplitFunc,
+                    &work);
+
+    if (work.first_partition == 1) {
+        in_data = ICET_IMAGE_DATA(in_image);
+        in_depth = icetSparseImageGetDepthPlane(in_image);
+        inactive_before = active_till_next_runl = 0;
+        icetSparseImageCopyPixelsInPlaceInternal(&in_data,
+                                                 in_depth_p,
+                                                 &inactive_before,
+                                                 &active_till_next_runl,
+                                                 work.parts[0].num_pixels,
+                                                 work.pixel_size,
+                                                 work.depth_size,
+                                                 out_images[0]);
+    }
+
+    return ICET_TRUE;
+}
+
+static void icetSparseImageActiveRange(const IceTSparseImage image,
+                                       IceTSizeType *first_p,
+                                       IceTSizeType *end_p)
+{
+    const IceTInt *viewport
+        = ICET_IMAGE_HEADER(image) + ICET_IMAGE_ACTIVE_VIEWPORT_INDEX;
+    IceTSizeType width = icetSparseImageGetWidth(image);
+
+    if (ICET_IMAGE_SIZE_HEADER(image)[ICET_IMAGE_ACTIVE_COUNT_INDEX] == 0) {
+        *first_p = *end_p = 0;
+        return;
+    }
+    *first_p = (IceTSizeType)viewport[1]*width + viewport[0];
+    *end_p = (  (IceTSizeType)(viewport[1] + viewport[3] - 1)*width
+              + viewport[0] + viewport[2] );
+}
+
+/* Composites two images whose active pixels are known not to overlap.  No
+ * pixels need compositing, so if one image is empty the other is copied, and
+ * if the active pixels of one image all come before those of the other, the
+ * first part of the one is joined to the last part of the other.  Returns
+ * ICET_FALSE, doing nothing, if the active pixels may overlap or the
+ * composite would raise a diagnostic. */
+static IceTBoolean icetCompressedCompressedCompositeDisjoint(
+                                           const IceTSparseImage front_buffer,
+                                           const IceTSparseImage back_buffer,
+                                           IceTSparseImage dest_buffer)
+{
+    IceTEnum composite_mode;
+    IceTEnum color_format = icetSparseImageGetColorFormat(front_buffer);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(front_buffer);
+    IceTSizeType num_pixels = icetSparseImageGetNumPixels(front_buffer);
+    IceTSizeType front_count
+        = ICET_IMAGE_SIZE_HEADER(front_buffer)[ICET_IMAGE_ACTIVE_COUNT_INDEX];
+    IceTSizeType back_count
+        = ICET_IMAGE_SIZE_HEADER(back_buffer)[ICET_IMAGE_ACTIVE_COUNT_INDEX];
+    IceTSizeType front_first, front_end, back_first, back_end;
+    IceTSparseImage first_image, last_image;
+    IceTSizeType split;
+    IceTSizeType pixel_size, depth_size;
+    const IceTVoid *in_data;
+    const IceTVoid *in_depth;
+    const IceTVoid *first_depth;
+    const IceTVoid *first_depth_end;
+    const IceTVoid *last_depth;
+    IceTSizeType inactive_before, active_till_next_runl;
+    IceTVoid *out_data;
+    IceTVoid *last_run_length;
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+    switch (composite_mode) {
+      case ICET_COMPOSITE_MODE_Z_BUFFER:
+          if (depth_format == ICET_IMAGE_DEPTH_NONE) return ICET_FALSE;
+          break;
+      case ICET_COMPOSITE_MODE_BLEND:
+          if (   (depth_format != ICET_IMAGE_DEPTH_NONE)
+              || (color_format == ICET_IMAGE_COLOR_NONE)
+              || addOnlyColorFormat(color_format) ) {
+              return ICET_FALSE;
+          }
+          break;
+      case ICET_COMPOSITE_MODE_ADD:
+      case ICET_COMPOSITE_MODE_MAX:
+      case ICET_COMPOSITE_MODE_MIN:
+          if (   (color_format == ICET_IMAGE_COLOR_NONE)
+              && (depth_format == ICET_IMAGE_DEPTH_NONE) ) {
+              return ICET_FALSE;
+          }
+          break;
+      default:
+          return ICET_FALSE;
+    }
+
+    if ((front_count < 0) || (back_count < 0)) return ICET_FALSE;
+    if (   ICET_IMAGE_HEADER(dest_buffer)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]
+         < num_pixels ) {
+        return ICET_FALSE;
+    }
+
+    if (back_count == 0) {
+        return icetSparseImageCopyEntire(front_buffer, dest_buffer);
+    }
+    if (front_count == 0) {
+        return icetSparseImageCopyEntire(back_buffer, dest_buffer);
+    }
+
+    icetSparseImageActiveRange(front_buffer, &front_first, &front_end);
+    icetSparseImageActiveRange(back_buffer, &back_first, &back_end);
+    if (front_end <= back_first) {
+        first_image = front_buffer;
+        last_image = back_buffer;
+        split = back_first;
+    } else if (back_end <= front_first) {
+        first_image = back_buffer;
+        last_image = front_buffer;
+        split = front_first;
+    } else {
+        return ICET_FALSE;
+    }
+
+    pixel_size = sparseDataPixelSize(color_format, depth_format);
+    depth_size = sparseDepthPlanePixelSize(color_format, depth_format);
 
-void icetCompressedComposite(IceTImage destBuffer,
-                             const IceTSparseImage srcBuffer,
-                             int srcOnTop)
-{
-    if (    icetImageGetNumPixels(destBuffer)
-         != icetSparseImageGetNumPixels(srcBuffer) ) {
-        icetRaiseError("Size of input and output buffers do not agree.",
-                       ICET_INVALID_VALUE);
-    }
-    icetCompressedSubComposite(destBuffer, 0, srcBuffer, srcOnTop);
-}
-void icetCompressedSubComposite(IceTImage destBuffer,
-                                IceTSizeType offset,
-                                const IceTSparseImage srcBuffer,
-                                int srcOnTop)
-{
-    icetTimingBlendBegin();
+    icetSparseImageSetDimensions(dest_buffer,
+                                 icetSparseImageGetWidth(front_buffer),
+                                 icetSparseImageGetHeight(front_buffer));
 
-    if (srcOnTop) {
-#define INPUT_SPARSE_IMAGE      srcBuffer
-#define OUTPUT_IMAGE            destBuffer
-#define OFFSET                  offset
-#define PIXEL_COUNT             icetSparseImageGetNumPixels(srcBuffer)
-#define COMPOSITE
-#define BLEND_RGBA_UBYTE        ICET_OVER_UBYTE
-#define BLEND_RGBA_FLOAT        ICET_OVER_FLOAT
-#include "decompress_func_body.h"
-    } else {
-#define INPUT_SPARSE_IMAGE      srcBuffer
-#define OUTPUT_IMAGE            destBuffer
-#define OFFSET                  offset
-#define PIXEL_COUNT             icetSparseImageGetNumPixels(srcBuffer)
-#define COMPOSITE
-#define BLEND_RGBA_UBYTE        ICET_UNDER_UBYTE
-#define BLEND_RGBA_FLOAT        ICET_UNDER_FLOAT
-#include "decompress_func_body.h"
+    /* Start a run length that both scans add to. */
+    out_data = ICET_IMAGE_DATA(dest_buffer);
+    last_run_length = out_data;
+    INACTIVE_RUN_LENGTH(last_run_length) = 0;
+    ACTIVE_RUN_LENGTH(last_run_length) = 0;
+    out_data = (IceTByte *)out_data + RUN_LENGTH_SIZE;
+
+    in_data = ICET_IMAGE_DATA(first_image);
+    first_depth = in_depth = icetSparseImageGetDepthPlane(first_image);
+    inactive_before = active_till_next_runl = 0;
+    icetSparseImageScanPixels(&in_data,
+                              (in_depth != NULL) ? &in_depth : NULL,
+                              &inactive_before,
+                              &active_till_next_runl,
+                              NULL,
+                              split,
+                              pixel_size,
+                              depth_size,
+                              &out_data,
+                              &last_run_length);
+    first_depth_end = in_depth;
+
+    in_data = ICET_IMAGE_DATA(last_image);
+    in_depth = icetSparseImageGetDepthPlane(last_image);
+    inactive_before = active_till_next_runl = 0;
+    icetSparseImageSeek(last_image,
+                        0,
+                        split,
+                        pixel_size,
+                        depth_size,
+                        &in_data,
+                        (in_depth != NULL) ? &in_depth : NULL,
+                        &inactive_before,
+                        &active_till_next_runl);
+    last_depth = in_depth;
+    icetSparseImageScanPixels(&in_data,
+                              (in_depth != NULL) ? &in_depth : NULL,
+                              &inactive_before,
+                              &active_till_next_runl,
+                              NULL,
+                              num_pixels - split,
+                              pixel_size,
+                              depth_size,
+                              &out_data,
+                              &last_run_length);
+
+    icetSparseImageSetActualSize(dest_buffer, out_data);
+    if (first_depth != NULL) {
+        icetSparseImageAppendDepths(dest_buffer, first_depth, first_depth_end);
+    }
+    if (last_depth != NULL) {
+        icetSparseImageAppendDepths(dest_buffer, last_depth, in_depth);
     }
 
-    icetTimingBlendEnd();
+    icetSparseImageFindActiveBounds(dest_buffer);
+    icetSparseImageBuildSeekTable(dest_buffer);
+
+    return ICET_TRUE;
 }
 
 void icetCompressedCompressedComposite(const IceTSparseImage front_buffer,
                                        const IceTSparseImage back_buffer,
                                        IceTSparseImage dest_buffer)
 {
+    IceTEnum color_format;
+    IceTEnum depth_format;
+    IceTSizeType num_pixels;
+    IceTInt num_bands;
+
     if (   icetSparseImageEqual(front_buffer, back_buffer)
         || icetSparseImageEqual(front_buffer, dest_buffer)
         || icetSparseImageEqual(back_buffer, dest_buffer) ) {
@@ -2407,11 +5401,375 @@ void icetCompressedCompressedComposite(const IceTSparseImage front_buffer,
 
     icetTimingBlendBegin();
 
+    color_format = icetSparseImageGetColorFormat(front_buffer);
+    depth_format = icetSparseImageGetDepthFormat(front_buffer);
+    num_pixels = icetSparseImageGetNumPixels(front_buffer);
+    if (   (color_format == icetSparseImageGetColorFormat(back_buffer))
+        && (color_format == icetSparseImageGetColorFormat(dest_buffer))
+        && (depth_format == icetSparseImageGetDepthFormat(back_buffer))
+        && (depth_format == icetSparseImageGetDepthFormat(dest_buffer))
+        && (num_pixels == icetSparseImageGetNumPixels(back_buffer)) ) {
+        if (icetCompressedCompressedCompositeDisjoint(front_buffer,
+                                                      back_buffer,
+                                                      dest_buffer)) {
+            icetTimingBlendEnd();
+            return;
+        }
+        num_bands = icetSparseImageNumBands(ICET_COMPOSITE_THREADS,
+                                            color_format,
+                                            depth_format,
+                                            num_pixels);
+    } else {
+        /* Let the serial code report the problem. */
+        num_bands = 1;
+    }
+    if (num_bands > 1) {
+        icetCompressedCompressedCompositeThreaded(front_buffer,
+                                                  back_buffer,
+                                                  dest_buffer,
+                                                  num_bands);
+        icetTimingBlendEnd();
+        return;
+    }
+
 #define FRONT_SPARSE_IMAGE front_buffer
 #define BACK_SPARSE_IMAGE back_buffer
 #define DEST_SPARSE_IMAGE dest_buffer
 #include "cc_composite_func_body.h"
 
+    icetSparseImageFindActiveBounds(dest_buffer);
+    icetSparseImageBuildSeekTable(dest_buffer);
+
+    icetTimingBlendEnd();
+}
+
+/* Where a composite of several sparse images reads each of them, as used by
+ * icetSparseImageScanPixels. */
+struct IceTMergeCursor {
+    const IceTVoid *data;
+    const IceTVoid *depth;
+    IceTSizeType inactive;
+    IceTSizeType active;
+};
+
+struct IceTMergeCompositeBands {
+    IceTEnum composite_mode;
+    IceTEnum color_format;
+    IceTEnum depth_format;
+    IceTInt num_images;
+    IceTSparseImage *bands;
+    struct IceTMergeCursor *cursors;
+    IceTInt num_bands;
+    IceTSizeType num_pixels;
+};
+
+/* Returns true if compressed-compressed compositing of images in the given
+ * formats raises no diagnostic. */
+static IceTBoolean icetSparseImageCompositeValid(IceTEnum composite_mode,
+                                                 IceTEnum color_format,
+                                                 IceTEnum depth_format)
+{
+    switch (composite_mode) {
+      case ICET_COMPOSITE_MODE_Z_BUFFER:
+          return (depth_format != ICET_IMAGE_DEPTH_NONE);
+      case ICET_COMPOSITE_MODE_BLEND:
+          return (   (depth_format == ICET_IMAGE_DEPTH_NONE)
+                  && (   (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                      || (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+                      || (color_format == ICET_IMAGE_COLOR_RGBA_HALF) ) );
+      case ICET_COMPOSITE_MODE_MAX:
+      case ICET_COMPOSITE_MODE_MIN:
+          return (   (color_format != ICET_IMAGE_COLOR_NONE)
+                  || (depth_format != ICET_IMAGE_DEPTH_NONE) );
+      case ICET_COMPOSITE_MODE_ADD:
+          return (   (depth_format != ICET_IMAGE_DEPTH_NONE)
+                  || (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+                  || (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+                  || (color_format == ICET_IMAGE_COLOR_RGBA_HALF)
+                  || addOnlyColorFormat(color_format) );
+      default:
+          return ICET_FALSE;
+    }
+}
+
+/* Composites num_pixels pixels of num_images sparse images read from cursors,
+ * the first in front, into dest_buffer with one pass over their run lengths.
+ * Wherever only one image is active its pixels are copied.  Elsewhere the
+ * back-most active pixels are copied and the others composited in front of
+ * them in order.  The cursors are left after the pixels. */
+static void icetSparseImageMergeComposite(IceTEnum composite_mode,
+                                          IceTEnum color_format,
+                                          IceTEnum depth_format,
+                                          struct IceTMergeCursor *cursors,
+                                          IceTInt num_images,
+                                          IceTSizeType num_pixels,
+                                          IceTSparseImage dest_buffer)
+{
+    IceTSizeType pixel_size = sparseDataPixelSize(color_format, depth_format);
+    IceTSizeType depth_size = sparseDepthPlanePixelSize(color_format,
+                                                        depth_format);
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    IceTByte *out_data = ICET_IMAGE_DATA(dest_buffer);
+    IceTByte *out_run = NULL;
+    IceTByte *depth_stage = icetSparseImageDepthStage(dest_buffer);
+    IceTByte *out_depth = depth_stage;
+    IceTSizeType pixel = 0;
+    IceTInt image;
+
+    while (pixel < num_pixels) {
+        IceTSizeType segment = num_pixels - pixel;
+        IceTInt back_image = -1;
+
+        /* Find the longest segment where every image stays active or
+           inactive. */
+        for (image = 0; image < num_images; image++) {
+            struct IceTMergeCursor *cursor = cursors + image;
+            while (   (cursor->active == 0)
+                   && ((cursor->inactive + pixel) < num_pixels) ) {
+                cursor->inactive += INACTIVE_RUN_LENGTH(cursor->data);
+                cursor->active = ACTIVE_RUN_LENGTH(cursor->data);
+                cursor->data = (const IceTByte *)cursor->data + RUN_LENGTH_SIZE;
+            }
+            if (cursor->inactive > 0) {
+                segment = MIN(segment, cursor->inactive);
+            } else {
+                segment = MIN(segment, cursor->active);
+                back_image = image;
+            }
+        }
+
+        if (back_image < 0) {
+            if ((out_run == NULL) || (ACTIVE_RUN_LENGTH(out_run) > 0)) {
+                out_run = out_data;
+                INACTIVE_RUN_LENGTH(out_run) = 0;
+                ACTIVE_RUN_LENGTH(out_run) = 0;
+                out_data += RUN_LENGTH_SIZE;
+            }
+            INACTIVE_RUN_LENGTH(out_run) += (IceTRunLengthType)segment;
+        } else {
+            if (out_run == NULL) {
+                out_run = out_data;
+                INACTIVE_RUN_LENGTH(out_run) = 0;
+                ACTIVE_RUN_LENGTH(out_run) = 0;
+                out_data += RUN_LENGTH_SIZE;
+            }
+            ACTIVE_RUN_LENGTH(out_run) += (IceTRunLengthType)segment;
+
+            memcpy(out_data,
+                   cursors[back_image].data,
+                   segment*pixel_size);
+            if (depth_size > 0) {
+                memcpy(out_depth,
+                       cursors[back_image].depth,
+                       segment*depth_size);
+            }
+            for (image = back_image - 1; image >= 0; image--) {
+                if (cursors[image].inactive == 0) {
+                    compositePixels(composite_mode,
+                                    color_format,
+                                    depth_format,
+                                    cursors[image].data,
+                                    cursors[image].depth,
+                                    out_data,
+                                    (depth_size > 0) ? out_depth : NULL,
+                                    segment);
+                }
+            }
+            out_data += segment*pixel_size;
+            out_depth += segment*depth_size;
+        }
+
+        for (image = 0; image < num_images; image++) {
+            struct IceTMergeCursor *cursor = cursors + image;
+            if (cursor->inactive > 0) {
+                cursor->inactive -= segment;
+            } else {
+                cursor->active -= segment;
+                cursor->data
+                    = (const IceTByte *)cursor->data + segment*pixel_size;
+                if (depth_size > 0) {
+                    cursor->depth
+                        = (const IceTByte *)cursor->depth + segment*depth_size;
+                }
+            }
+        }
+        pixel += segment;
+    }
+
+    icetSparseImageSetActualSize(dest_buffer, out_data);
+    if (depth_size > 0) {
+        icetSparseImageAppendDepths(dest_buffer, depth_stage, out_depth);
+    }
+}
+
+static void icetSparseImageMergeCompositeBandFunc(IceTInt band,
+                                                  IceTVoid *data)
+{
+    const struct IceTMergeCompositeBands *work
+        = (struct IceTMergeCompositeBands *)data;
+    icetSparseImageMergeComposite(work->composite_mode,
+                                  work->color_format,
+                                  work->depth_format,
+                                  work->cursors + band*work->num_images,
+                                  work->num_images,
+                                  ICET_BAND_SIZE(work->num_pixels,
+                                                 band,
+                                                 work->num_bands),
+                                  work->bands[band]);
+}
+
+void icetCompressedCompressedCompositeImages(const IceTSparseImage *images,
+                                             IceTInt num_images,
+                                             IceTSparseImage dest_buffer)
+{
+    struct IceTMergeCompositeBands work;
+    struct IceTMergeCursor *last_cursors;
+    IceTSizeType pixel_size;
+    IceTSizeType depth_size;
+    IceTInt image;
+    IceTInt band;
+
+    if (num_images < 1) {
+        icetRaiseError("No images to composite.", ICET_INVALID_VALUE);
+        return;
+    }
+    if (num_images == 1) {
+        icetSparseImageCopyPixels(images[0],
+                                  0,
+                                  icetSparseImageGetNumPixels(images[0]),
+                                  dest_buffer);
+        return;
+    }
+    if (num_images == 2) {
+        icetCompressedCompressedComposite(images[0], images[1], dest_buffer);
+        return;
+    }
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &work.composite_mode);
+    work.color_format = icetSparseImageGetColorFormat(images[0]);
+    work.depth_format = icetSparseImageGetDepthFormat(images[0]);
+    work.num_images = num_images;
+    work.num_pixels = icetSparseImageGetNumPixels(images[0]);
+
+    for (image = 0; image < num_images; image++) {
+        if (icetSparseImageEqual(images[image], dest_buffer)) {
+            icetRaiseError("Detected reused buffer in"
+                           " compressed-compressed composite.",
+                           ICET_SANITY_CHECK_FAIL);
+            return;
+        }
+        if (   (   icetSparseImageGetColorFormat(images[image])
+                != work.color_format)
+            || (   icetSparseImageGetDepthFormat(images[image])
+                != work.depth_format)
+            || (   icetSparseImageGetNumPixels(images[image])
+                != work.num_pixels) ) {
+            icetRaiseError("Input buffers do not agree for"
+                           " compressed-compressed composite.",
+                           ICET_SANITY_CHECK_FAIL);
+            return;
+        }
+    }
+    if (   (work.color_format != icetSparseImageGetColorFormat(dest_buffer))
+        || (work.depth_format != icetSparseImageGetDepthFormat(dest_buffer))
+        || !icetSparseImageCompositeValid(work.composite_mode,
+                                          work.color_format,
+                                          work.depth_format) ) {
+        /* Let the two image composite report the problem. */
+        icetCompressedCompressedComposite(images[0], images[1], dest_buffer);
+        return;
+    }
+
+    icetTimingBlendBegin();
+
+    pixel_size = sparseDataPixelSize(work.color_format, work.depth_format);
+    depth_size = sparseDepthPlanePixelSize(work.color_format,
+                                           work.depth_format);
+
+    icetSparseImageSetDimensions(dest_buffer,
+                                 icetSparseImageGetWidth(images[0]),
+                                 icetSparseImageGetHeight(images[0]));
+
+    work.num_bands = icetSparseImageNumBands(ICET_COMPOSITE_THREADS,
+                                             work.color_format,
+                                             work.depth_format,
+                                             work.num_pixels);
+    if (work.num_bands > 1) {
+        work.bands = icetSparseImageAllocateBands(
+                         ICET_CC_COMPOSITE_BAND_BUF,
+                         dest_buffer,
+                         work.num_bands,
+                         work.num_pixels,
+                         1,
+                         ICET_FALSE,
+                         work.num_bands*num_images
+                             *sizeof(struct IceTMergeCursor),
+                         (IceTVoid **)&work.cursors);
+    } else {
+        work.bands = NULL;
+        work.cursors = icetGetStateBuffer(
+                                 ICET_CC_COMPOSITE_BAND_BUF,
+                                 num_images*sizeof(struct IceTMergeCursor));
+    }
+
+    /* Find where each band starts in the inputs. */
+    for (image = 0; image < num_images; image++) {
+        struct IceTMergeCursor cursor;
+        cursor.data = ICET_IMAGE_DATA(images[image]);
+        cursor.depth = icetSparseImageGetDepthPlane(images[image]);
+        cursor.inactive = cursor.active = 0;
+        for (band = 0; band < work.num_bands; band++) {
+            if (band > 0) {
+                icetSparseImageSeek(
+                              images[image],
+                              (work.num_pixels*(band-1))/work.num_bands,
+                              (work.num_pixels*band)/work.num_bands,
+                              pixel_size,
+                              depth_size,
+                              &cursor.data,
+                              (cursor.depth != NULL) ? &cursor.depth : NULL,
+                              &cursor.inactive,
+                              &cursor.active);
+            }
+            work.cursors[band*num_images + image] = cursor;
+        }
+    }
+
+    if (work.num_bands > 1) {
+        icetParallelFor(work.num_bands,
+                        work.num_bands,
+                        icetSparseImageMergeCompositeBandFunc,
+                        &work);
+    } else {
+        icetSparseImageMergeComposite(work.composite_mode,
+                                      work.color_format,
+                                      work.depth_format,
+                                      work.cursors,
+                                      num_images,
+                                      work.num_pixels,
+                                      dest_buffer);
+    }
+
+    /* Active pixels left over at the end mean the run lengths do not add
+       up. */
+    last_cursors = work.cursors + (work.num_bands - 1)*num_images;
+    for (image = 0; image < num_images; image++) {
+        if (last_cursors[image].active > 0) {
+            icetRaiseError("Corrupt compressed image.", ICET_INVALID_VALUE);
+            icetClearSparseImage(dest_buffer);
+            icetTimingBlendEnd();
+            return;
+        }
+    }
+
+    if (work.num_bands > 1) {
+        icetSparseImageJoinBands(work.bands, work.num_bands, 0, 0,
+                                 dest_buffer);
+    } else {
+        icetSparseImageFindActiveBounds(dest_buffer);
+        icetSparseImageBuildSeekTable(dest_buffer);
+    }
+
     icetTimingBlendEnd();
 }
 
@@ -2420,12 +5778,24 @@ void icetImageCorrectBackground(IceTImage image)
     IceTBoolean need_correction;
     IceTSizeType num_pixels;
     IceTEnum color_format;
+    IceTEnum composite_mode;
 
     icetGetBooleanv(ICET_NEED_BACKGROUND_CORRECTION, &need_correction);
     if (!need_correction) { return; }
 
     num_pixels = icetImageGetNumPixels(image);
     color_format = icetImageGetColorFormat(image);
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+
+    if (accumulationChannels(color_format) > 0) {
+        /* Inactive pixels get the background once the image is converted
+           back with icetImageFinishAccumulation. */
+        return;
+    }
+    if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+        /* Counts have no background. */
+        return;
+    }
 
     icetTimingBlendBegin();
 
@@ -2439,9 +5809,19 @@ void icetImageCorrectBackground(IceTImage image)
                         &background_color_word);
         bc = (IceTUByte *)(&background_color_word);
 
-        for (p = 0; p < num_pixels; p++) {
-            ICET_UNDER_UBYTE(bc, color);
-            color += 4;
+        if (reductionCompositeMode(composite_mode)) {
+            /* Only pixels no process contributed to show the background. */
+            for (p = 0; p < num_pixels; p++) {
+                if (*((IceTUInt *)color) == 0) {
+                    *((IceTUInt *)color) = (IceTUInt)background_color_word;
+                }
+                color += 4;
+            }
+        } else {
+            for (p = 0; p < num_pixels; p++) {
+                ICET_UNDER_UBYTE(bc, color);
+                color += 4;
+            }
         }
     } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
         IceTFloat *color = icetImageGetColorf(image);
@@ -2450,9 +5830,62 @@ void icetImageCorrectBackground(IceTImage image)
 
         icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, background_color);
 
+        if (reductionCompositeMode(composite_mode)) {
+            /* Only pixels no process contributed to show the background. */
+            for (p = 0; p < num_pixels; p++) {
+                if (   (color[0] == 0.0f) && (color[1] == 0.0f)
+                    && (color[2] == 0.0f) && (color[3] == 0.0f) ) {
+                    color[0] = background_color[0];
+                    color[1] = background_color[1];
+                    color[2] = background_color[2];
+                    color[3] = background_color[3];
+                }
+                color += 4;
+            }
+        } else {
+            for (p = 0; p < num_pixels; p++) {
+                ICET_UNDER_FLOAT(background_color, color);
+                color += 4;
+            }
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        IceTUShort *color = icetImageGetColorVoid(image, NULL);
+        IceTUShort background_color[4];
+        IceTSizeType p;
+
+        getBackgroundColorHalf(ICET_TRUE_BACKGROUND_COLOR, background_color);
+
+        if (reductionCompositeMode(composite_mode)) {
+            /* Only pixels no process contributed to show the background. */
+            for (p = 0; p < num_pixels; p++) {
+                if (icetSIMDCountColorHalfRun(color, 1, ICET_FALSE) == 1) {
+                    memcpy(color, background_color, sizeof(background_color));
+                }
+                color += 4;
+            }
+        } else {
+            for (p = 0; p < num_pixels; p++) {
+                icetSIMDBlendHalf(color, background_color, color, 1);
+                color += 4;
+            }
+        }
+    } else if (   (scalarColorChannels(color_format) > 0)
+               && reductionCompositeMode(composite_mode) ) {
+        IceTFloat *color = icetImageGetColorf(image);
+        IceTSizeType num_channels = scalarColorChannels(color_format);
+        IceTFloat background_color[4];
+        IceTSizeType p;
+
+        icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, background_color);
+
+        /* Only pixels no process contributed to show the background. */
         for (p = 0; p < num_pixels; p++) {
-            ICET_UNDER_FLOAT(background_color, color);
-            color += 4;
+            if (colorCountFloatRun(color, num_channels, 1, ICET_FALSE) == 1) {
+                memcpy(color,
+                       background_color,
+                       num_channels*sizeof(IceTFloat));
+            }
+            color += num_channels;
         }
     } else {
         icetRaiseError("Encountered invalid color buffer type"
@@ -2484,18 +5917,138 @@ void icetClearImageTrueBackground(IceTImage image)
     icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, original_background_word);
 }
 
+IceTEnum icetAccumulationColorFormat(IceTEnum color_format)
+{
+    IceTEnum composite_mode;
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+    if (composite_mode != ICET_COMPOSITE_MODE_ADD) { return color_format; }
+
+    if (icetIsEnabled(ICET_REPRODUCIBLE_ACCUMULATION)) {
+        switch (color_format) {
+          case ICET_IMAGE_COLOR_R_FLOAT:    return ICET_IMAGE_COLOR_R_BINNED;
+          case ICET_IMAGE_COLOR_RG_FLOAT:   return ICET_IMAGE_COLOR_RG_BINNED;
+          case ICET_IMAGE_COLOR_RGBA_FLOAT: return ICET_IMAGE_COLOR_RGBA_BINNED;
+          default:                          return color_format;
+        }
+    } else if (icetIsEnabled(ICET_DOUBLE_ACCUMULATION)) {
+        switch (color_format) {
+          case ICET_IMAGE_COLOR_R_FLOAT:    return ICET_IMAGE_COLOR_R_DOUBLE;
+          case ICET_IMAGE_COLOR_RG_FLOAT:   return ICET_IMAGE_COLOR_RG_DOUBLE;
+          case ICET_IMAGE_COLOR_RGBA_FLOAT: return ICET_IMAGE_COLOR_RGBA_DOUBLE;
+          default:                          return color_format;
+        }
+    } else {
+        return color_format;
+    }
+}
+
+IceTImage icetImageFinishAccumulation(const IceTImage image,
+                                      IceTEnum color_format)
+{
+    IceTEnum accumulation_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTSizeType num_channels = accumulationChannels(accumulation_format);
+    IceTBoolean binned = binnedColorFormat(accumulation_format);
+    IceTBoolean need_correction;
+    IceTFloat background_color[4];
+    IceTImage result;
+    const IceTDouble *in_color;
+    IceTFloat *out_color;
+    /* Use IceTByte for byte-based pointer arithmetic. */
+    const IceTByte *depth;
+    IceTSizeType depth_size;
+    IceTSizeType num_pixels;
+    IceTSizeType p;
+
+    if (icetImageIsNull(image)) { return image; }
+
+    if (   (num_channels == 0)
+        || (colorPixelSize(color_format)
+            != (IceTSizeType)(num_channels*sizeof(IceTFloat))) ) {
+        icetRaiseError("Invalid formats for finishing accumulation.",
+                       ICET_SANITY_CHECK_FAIL);
+        return image;
+    }
+
+    result = imageAssignBufferType(
+                icetGetStateBuffer(ICET_ACCUMULATION_RESULT_BUF,
+                                   icetImageBufferSizeType(color_format,
+                                                           depth_format,
+                                                           width,
+                                                           height)),
+                color_format,
+                depth_format,
+                width,
+                height);
+
+    icetGetBooleanv(ICET_NEED_BACKGROUND_CORRECTION, &need_correction);
+    if (need_correction) {
+        icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, background_color);
+    } else {
+        icetGetFloatv(ICET_BACKGROUND_COLOR, background_color);
+    }
+
+    icetTimingBlendBegin();
+
+    num_pixels = width*height;
+    in_color = icetImageGetColorConstVoid(image, NULL);
+    out_color = icetImageGetColorVoid(result, NULL);
+    if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+        depth = icetImageGetDepthConstVoid(image, &depth_size);
+        memcpy(icetImageGetDepthVoid(result, NULL),
+               depth,
+               num_pixels*depth_size);
+    } else {
+        depth = NULL;
+        depth_size = 0;
+    }
+
+    for (p = 0; p < num_pixels; p++) {
+        IceTBoolean active = ICET_FALSE;
+        IceTSizeType c;
+        for (c = 0; c < num_channels; c++) {
+            if (binned) {
+                out_color[c] = (IceTFloat)(in_color[3*c+1] + in_color[3*c+2]);
+            } else {
+                out_color[c] = (IceTFloat)in_color[c];
+            }
+            active = active || (out_color[c] != 0.0f);
+        }
+        if (depth != NULL) {
+            active = depthIsActive(depth_format, depth);
+            depth += depth_size;
+        }
+        if (!active) {
+            memcpy(out_color, background_color, num_channels*sizeof(IceTFloat));
+        }
+        in_color += (binned ? 3 : 1)*num_channels;
+        out_color += num_channels;
+    }
+
+    icetTimingBlendEnd();
+
+    return result;
+}
+
 static IceTImage generateTile(int tile,
                               IceTInt *screen_viewport,
                               IceTInt *target_viewport,
                               IceTImage tile_buffer)
 {
     IceTBoolean use_prerender;
+    IceTImage rendered_image;
     icetGetBooleanv(ICET_PRE_RENDERED, &use_prerender);
     if (use_prerender) {
-        return prerenderedTile(tile, screen_viewport, target_viewport);
+        rendered_image
+            = prerenderedTile(tile, screen_viewport, target_viewport);
     } else {
-        return renderTile(tile, screen_viewport, target_viewport, tile_buffer);
+        rendered_image = renderTile(tile, screen_viewport, target_viewport,
+                                    tile_buffer);
     }
+    return promoteTile(rendered_image, screen_viewport);
 }
 
 static IceTImage renderTile(int tile,
@@ -2515,6 +6068,7 @@ static IceTImage renderTile(int tile,
     IceTDouble projection_matrix[16];
     IceTDouble modelview_matrix[16];
     IceTFloat background_color[4];
+    IceTEnum render_color_format;
 
     icetRaiseDebug1("Rendering tile %d", tile);
     contained_viewport = icetUnsafeStateGetInteger(ICET_CONTAINED_VIEWPORT);
@@ -2706,9 +6260,12 @@ static IceTImage renderTile(int tile,
     }
 
   /* Make sure that the current render_buffer is sized appropriately for the
-     physical viewport.  If not, use our own buffer. */
+     physical viewport and in the format the application renders (rather than
+     an accumulation format).  If not, use our own buffer. */
+    icetGetEnumv(ICET_RENDER_COLOR_FORMAT, &render_color_format);
     if (    (icetImageGetWidth(render_buffer) != physical_width)
-         || (icetImageGetHeight(render_buffer) != physical_height) ) {
+         || (icetImageGetHeight(render_buffer) != physical_height)
+         || (icetImageGetColorFormat(render_buffer) != render_color_format) ) {
         render_buffer = getRenderBuffer();
     }
 
@@ -2764,11 +6321,99 @@ static IceTImage getRenderBuffer(void)
         return icetRetrieveStateImage(ICET_RENDER_BUFFER);
     } else {
         IceTInt dim[2];
+        IceTEnum color_format, depth_format;
+        IceTVoid *buffer;
 
         icetGetIntegerv(ICET_PHYSICAL_RENDER_WIDTH, &dim[0]);
         icetGetIntegerv(ICET_PHYSICAL_RENDER_HEIGHT, &dim[1]);
+        icetGetEnumv(ICET_RENDER_COLOR_FORMAT, &color_format);
+        icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
 
         /* Create a new image object. */
-        return icetGetStateBufferImage(ICET_RENDER_BUFFER, dim[0], dim[1]);
+        buffer = icetGetStateBuffer(ICET_RENDER_BUFFER,
+                                    icetImageBufferSizeType(color_format,
+                                                            depth_format,
+                                                            dim[0],
+                                                            dim[1]));
+        return imageAssignBufferType(buffer,
+                                     color_format,
+                                     depth_format,
+                                     dim[0],
+                                     dim[1]);
+    }
+}
+
+static IceTImage promoteTile(const IceTImage rendered_image,
+                             const IceTInt *screen_viewport)
+{
+    IceTEnum color_format;
+    IceTEnum depth_format;
+    IceTSizeType width;
+    IceTSizeType num_values;
+    IceTBoolean binned;
+    IceTImage image;
+    const IceTFloat *in_color;
+    IceTDouble *out_color;
+    IceTSizeType y;
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    if (   icetImageIsNull(rendered_image)
+        || (icetImageGetColorFormat(rendered_image) == color_format) ) {
+        return rendered_image;
+    }
+    if (   (accumulationChannels(color_format) == 0)
+        || (   icetAccumulationColorFormat(
+                                       icetImageGetColorFormat(rendered_image))
+            != color_format) ) {
+        icetRaiseError("Rendered image has unexpected color format.",
+                       ICET_SANITY_CHECK_FAIL);
+        return rendered_image;
+    }
+
+    width = icetImageGetWidth(rendered_image);
+    image = icetGetStateBufferImage(ICET_ACCUMULATION_BUF,
+                                    width,
+                                    icetImageGetHeight(rendered_image));
+
+    icetTimingBufferReadBegin();
+
+    num_values = accumulationChannels(color_format);
+    binned = binnedColorFormat(color_format);
+    in_color = icetImageGetColorcf(rendered_image);
+    out_color = icetImageGetColorVoid(image, NULL);
+    for (y = screen_viewport[1];
+         y < screen_viewport[1] + screen_viewport[3];
+         y++) {
+        IceTSizeType start = num_values*(y*width + screen_viewport[0]);
+        IceTSizeType i;
+        for (i = start; i < start + num_values*screen_viewport[2]; i++) {
+            if (binned) {
+                binnedSet(in_color[i], out_color + 3*i);
+            } else {
+                out_color[i] = in_color[i];
+            }
+        }
+    }
+
+    depth_format = icetImageGetDepthFormat(image);
+    if (depth_format != ICET_IMAGE_DEPTH_NONE) {
+        /* Use IceTByte for byte-based pointer arithmetic. */
+        const IceTByte *in_depth;
+        IceTByte *out_depth;
+        IceTSizeType depth_size;
+        in_depth = icetImageGetDepthConstVoid(rendered_image, &depth_size);
+        out_depth = icetImageGetDepthVoid(image, NULL);
+        for (y = screen_viewport[1];
+             y < screen_viewport[1]+screen_viewport[3];
+             y++) {
+            IceTSizeType start = depth_size*(y*width + screen_viewport[0]);
+            memcpy(out_depth + start,
+                   in_depth + start,
+                   depth_size*screen_viewport[2]);
+        }
     }
+
+    icetTimingBufferReadEnd();
+
+    return image;
 }
@@ -11,8 +11,11 @@
 
 #include <IceT.h>
 
+#include <IceTDevContext.h>
 #include <IceTDevDiagnostics.h>
 
+#include <stdlib.h>
+
 #ifndef WIN32
 #include <sys/time.h>
 #else
@@ -20,6 +23,10 @@
 #include <winbase.h>
 #endif
 
+#ifdef ICET_USE_PTHREADS
+#include <pthread.h>
+#endif
+
 #ifndef WIN32
 double icetWallTime(void)
 {
@@ -69,6 +76,8 @@ IceTInt icetTypeWidth(IceTEnum type)
           return sizeof(IceTFloat);
       case ICET_DOUBLE:
           return sizeof(IceTDouble);
+      case ICET_INT64:
+          return sizeof(IceTInt64);
       case ICET_POINTER:
           return sizeof(IceTVoid *);
       case ICET_VOID:
@@ -81,3 +90,216 @@ IceTInt icetTypeWidth(IceTEnum type)
 
     return 0;
 }
+
+#ifdef ICET_USE_PTHREADS
+/* Worker threads kept by a context for icetParallelFor.  The calling thread
+   hands out a job by filling in the job fields and bumping generation, then
+   waits on done until every worker taking part has finished its indices. */
+struct IceTThreadPoolStruct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    IceTInt num_workers;
+    pthread_t *workers;
+    unsigned long generation;
+    IceTBoolean shutdown;
+
+    IceTContext context;
+    IceTParallelForFunction func;
+    IceTVoid *data;
+    IceTInt num_threads; /* Threads in the job, counting the caller. */
+    IceTInt count;
+    IceTInt num_finished;
+};
+
+struct IceTThreadPoolWorker {
+    IceTThreadPool pool;
+    IceTInt index;
+    unsigned long generation;
+};
+
+static void icetParallelForRun(IceTParallelForFunction func,
+                               IceTVoid *data,
+                               IceTInt first_index,
+                               IceTInt stride,
+                               IceTInt count)
+{
+    IceTInt index;
+    for (index = first_index; index < count; index += stride) {
+        func(index, data);
+    }
+}
+
+static void *icetThreadPoolWorkerMain(void *arg)
+{
+    struct IceTThreadPoolWorker worker = *(struct IceTThreadPoolWorker *)arg;
+    IceTThreadPool pool = worker.pool;
+
+    free(arg);
+
+    pthread_mutex_lock(&pool->lock);
+    while (ICET_TRUE) {
+        IceTParallelForFunction func;
+        IceTVoid *data;
+        IceTInt num_threads;
+        IceTInt count;
+
+        while (!pool->shutdown && (pool->generation == worker.generation)) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        worker.generation = pool->generation;
+        if (worker.index >= pool->num_threads) continue;
+
+        func = pool->func;
+        data = pool->data;
+        num_threads = pool->num_threads;
+        count = pool->count;
+        /* The current context is kept per thread. */
+        icetSetContext(pool->context);
+        pthread_mutex_unlock(&pool->lock);
+
+        icetParallelForRun(func, data, worker.index, num_threads, count);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->num_finished++;
+        if (pool->num_finished == pool->num_threads - 1) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Returns the pool of the current context with at least num_workers
+   workers, making or growing it as needed.  The pool may have fewer workers
+   (even none) if threads cannot be started, and NULL is returned if it cannot
+   be made at all. */
+static IceTThreadPool icetThreadPoolGet(IceTInt num_workers)
+{
+    IceTThreadPool pool;
+    pthread_t *workers;
+
+    /* Without a context there is nowhere to keep workers. */
+    if (icetGetContext() == NULL) return NULL;
+
+    pool = icetGetThreadPool();
+    if (pool == NULL) {
+        pool = malloc(sizeof(struct IceTThreadPoolStruct));
+        if (pool == NULL) return NULL;
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+        pool->num_workers = 0;
+        pool->workers = NULL;
+        pool->generation = 0;
+        pool->shutdown = ICET_FALSE;
+        pool->num_threads = 0;
+        icetSetThreadPool(pool);
+    }
+
+    if (pool->num_workers >= num_workers) return pool;
+
+    workers = realloc(pool->workers, num_workers*sizeof(pthread_t));
+    if (workers == NULL) return pool;
+    pool->workers = workers;
+
+    /* No job is in progress here, so generation does not change while the
+       workers start. */
+    while (pool->num_workers < num_workers) {
+        struct IceTThreadPoolWorker *worker
+            = malloc(sizeof(struct IceTThreadPoolWorker));
+        if (worker == NULL) break;
+        /* Worker 0 is the calling thread. */
+        worker->pool = pool;
+        worker->index = pool->num_workers + 1;
+        worker->generation = pool->generation;
+        if (pthread_create(&pool->workers[pool->num_workers],
+                           NULL,
+                           icetThreadPoolWorkerMain,
+                           worker) != 0) {
+            free(worker);
+            break;
+        }
+        pool->num_workers++;
+    }
+
+    return pool;
+}
+#endif /*ICET_USE_PTHREADS*/
+
+void icetDestroyThreadPool(IceTThreadPool pool)
+{
+#ifdef ICET_USE_PTHREADS
+    IceTInt i;
+
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = ICET_TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+#else /*ICET_USE_PTHREADS*/
+    (void)pool;
+#endif /*ICET_USE_PTHREADS*/
+}
+
+void icetParallelFor(IceTInt num_threads,
+                     IceTInt count,
+                     IceTParallelForFunction func,
+                     IceTVoid *data)
+{
+#ifdef ICET_USE_PTHREADS
+    IceTThreadPool pool = NULL;
+
+    if (num_threads > count) num_threads = count;
+    if (num_threads > 1) {
+        pool = icetThreadPoolGet(num_threads - 1);
+    }
+    if ((pool != NULL) && (pool->num_workers > 0)) {
+        if (num_threads > pool->num_workers + 1) {
+            num_threads = pool->num_workers + 1;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->context = icetGetContext();
+        pool->func = func;
+        pool->data = data;
+        pool->num_threads = num_threads;
+        pool->count = count;
+        pool->num_finished = 0;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        icetParallelForRun(func, data, 0, num_threads, count);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->num_finished < num_threads - 1) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+#else /*ICET_USE_PTHREADS*/
+    (void)num_threads;
+#endif /*ICET_USE_PTHREADS*/
+
+    {
+        IceTInt index;
+        for (index = 0; index < count; index++) {
+            func(index, data);
+        }
+    }
+}
@@ -0,0 +1,1406 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2011 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* Vectorized kernels for compositing dense images.  Each kernel has a plain
+ * C implementation plus SSE2, AVX2, and AVX-512 versions that are compiled
+ * with per-function target attributes, so the library itself does not need to
+ * be built for any particular processor.  The version to run is picked when
+ * the kernel is called based on what the processor reports it supports.
+ *
+ * All versions produce exactly the same bits as the scalar code (and the
+ * ICET_BLEND_* macros).  In particular, the float blend does not use fused
+ * multiply-add, and the byte blend replaces the divide by 255 with a multiply
+ * and shifts that give the same (truncated) quotient for every product of two
+ * bytes. */
+
+#include <IceTDevSIMD.h>
+
+#include <IceTDevImage.h>
+
+#if defined(ICET_USE_SIMD)                                      \
+    && (defined(__x86_64__) || defined(__i386__))               \
+    && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#define ICET_SIMD_X86
+#endif
+
+#include <string.h>
+
+#ifdef ICET_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#ifdef ICET_SIMD_X86
+#include <immintrin.h>
+#include <cpuid.h>
+#define ICET_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* What the processor supports, found once by icetSIMDDetect. */
+static IceTInt icet_simd_supported = ICET_SIMD_LEVEL_SCALAR;
+#ifdef ICET_SIMD_X86
+static IceTBoolean icet_simd_f16c = ICET_FALSE;
+#endif
+
+/* The level set with icetSIMDSetLevel, or -1 to use icet_simd_supported. */
+static IceTInt icet_simd_level = -1;
+
+static IceTInt icetSIMDDetectLevel(void)
+{
+#ifdef ICET_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return ICET_SIMD_LEVEL_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return ICET_SIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ICET_SIMD_LEVEL_SSE2;
+    }
+#endif
+    return ICET_SIMD_LEVEL_SCALAR;
+}
+
+/* The half precision kernels use the F16C conversions with AVX2.  Every
+   processor with AVX2 has them in practice, but they have their own CPUID
+   bit, so check it anyway. */
+static void icetSIMDDetect(void)
+{
+    icet_simd_supported = icetSIMDDetectLevel();
+#ifdef ICET_SIMD_X86
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C)) {
+            icet_simd_f16c = ICET_TRUE;
+        }
+    }
+#endif
+}
+
+/* Kernels run on compression workers and on threads acting as IceT
+   processes, so the processor is checked exactly once. */
+#ifdef ICET_USE_PTHREADS
+static pthread_once_t icet_simd_detect_once = PTHREAD_ONCE_INIT;
+#define icetSIMDEnsureDetected() \
+    pthread_once(&icet_simd_detect_once, icetSIMDDetect)
+#else
+static IceTBoolean icet_simd_detected = ICET_FALSE;
+#define icetSIMDEnsureDetected()                \
+    if (!icet_simd_detected) {                  \
+        icetSIMDDetect();                       \
+        icet_simd_detected = ICET_TRUE;         \
+    }
+#endif
+
+IceTInt icetSIMDGetLevel(void)
+{
+    icetSIMDEnsureDetected();
+    if (icet_simd_level >= 0) {
+        return icet_simd_level;
+    }
+    return icet_simd_supported;
+}
+
+void icetSIMDSetLevel(IceTInt level)
+{
+    icetSIMDEnsureDetected();
+    if ((level < 0) || (level > icet_simd_supported)) {
+        level = -1;
+    }
+    icet_simd_level = level;
+}
+
+/* ---------------------------------------------------------------------
+ * Z-buffer compositing
+ * --------------------------------------------------------------------- */
+
+#ifdef ICET_SIMD_X86
+ICET_SIMD_TARGET("sse2")
+static IceTSizeType icetZBufferUByteSSE2(const IceTUInt *src_color,
+                                         const IceTFloat *src_depth,
+                                         IceTUInt *dest_color,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 4 <= num_pixels; i += 4) {
+        __m128 sd = _mm_loadu_ps(src_depth + i);
+        __m128 dd = _mm_loadu_ps(dest_depth + i);
+        __m128i mask = _mm_castps_si128(_mm_cmplt_ps(sd, dd));
+        __m128i sc = _mm_loadu_si128((const __m128i *)(src_color + i));
+        __m128i dc = _mm_loadu_si128((const __m128i *)(dest_color + i));
+        _mm_storeu_ps(dest_depth + i, _mm_min_ps(sd, dd));
+        _mm_storeu_si128((__m128i *)(dest_color + i),
+                         _mm_or_si128(_mm_and_si128(mask, sc),
+                                      _mm_andnot_si128(mask, dc)));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetZBufferUByteAVX2(const IceTUInt *src_color,
+                                         const IceTFloat *src_depth,
+                                         IceTUInt *dest_color,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256 sd = _mm256_loadu_ps(src_depth + i);
+        __m256 dd = _mm256_loadu_ps(dest_depth + i);
+        __m256 mask = _mm256_cmp_ps(sd, dd, _CMP_LT_OQ);
+        __m256 sc = _mm256_loadu_ps((const float *)(src_color + i));
+        __m256 dc = _mm256_loadu_ps((const float *)(dest_color + i));
+        _mm256_storeu_ps(dest_depth + i, _mm256_min_ps(sd, dd));
+        _mm256_storeu_ps((float *)(dest_color + i),
+                         _mm256_blendv_ps(dc, sc, mask));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetZBufferUByteAVX512(const IceTUInt *src_color,
+                                           const IceTFloat *src_depth,
+                                           IceTUInt *dest_color,
+                                           IceTFloat *dest_depth,
+                                           IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512 sd = _mm512_loadu_ps(src_depth + i);
+        __m512 dd = _mm512_loadu_ps(dest_depth + i);
+        __mmask16 mask = _mm512_cmp_ps_mask(sd, dd, _CMP_LT_OQ);
+        if (mask == 0) continue;
+        _mm512_mask_storeu_ps(dest_depth + i, mask, sd);
+        _mm512_mask_storeu_epi32(dest_color + i, mask,
+                                 _mm512_loadu_si512(src_color + i));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("sse2")
+static IceTSizeType icetZBufferFloatSSE2(const IceTFloat *src_color,
+                                         const IceTFloat *src_depth,
+                                         IceTFloat *dest_color,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 4 <= num_pixels; i += 4) {
+        __m128 sd = _mm_loadu_ps(src_depth + i);
+        __m128 dd = _mm_loadu_ps(dest_depth + i);
+        __m128 mask = _mm_cmplt_ps(sd, dd);
+        __m128 pixel_mask;
+        _mm_storeu_ps(dest_depth + i, _mm_min_ps(sd, dd));
+        if (_mm_movemask_ps(mask) == 0) continue;
+
+#define ICET_ZBUFFER_FLOAT_SSE2_PIXEL(p)                                \
+        pixel_mask = _mm_shuffle_ps(mask, mask, _MM_SHUFFLE(p,p,p,p));  \
+        _mm_storeu_ps(dest_color + 4*(i+p),                             \
+            _mm_or_ps(_mm_and_ps(pixel_mask,                            \
+                                 _mm_loadu_ps(src_color + 4*(i+p))),    \
+                      _mm_andnot_ps(pixel_mask,                         \
+                                    _mm_loadu_ps(dest_color + 4*(i+p)))));
+        ICET_ZBUFFER_FLOAT_SSE2_PIXEL(0)
+        ICET_ZBUFFER_FLOAT_SSE2_PIXEL(1)
+        ICET_ZBUFFER_FLOAT_SSE2_PIXEL(2)
+        ICET_ZBUFFER_FLOAT_SSE2_PIXEL(3)
+#undef ICET_ZBUFFER_FLOAT_SSE2_PIXEL
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetZBufferFloatAVX2(const IceTFloat *src_color,
+                                         const IceTFloat *src_depth,
+                                         IceTFloat *dest_color,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m256i spread0 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    const __m256i spread1 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+    const __m256i spread2 = _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5);
+    const __m256i spread3 = _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256 sd = _mm256_loadu_ps(src_depth + i);
+        __m256 dd = _mm256_loadu_ps(dest_depth + i);
+        __m256 mask = _mm256_cmp_ps(sd, dd, _CMP_LT_OQ);
+        _mm256_storeu_ps(dest_depth + i, _mm256_min_ps(sd, dd));
+        if (_mm256_movemask_ps(mask) == 0) continue;
+
+        /* Each 256-bit color register holds two pixels. */
+#define ICET_ZBUFFER_FLOAT_AVX2_PAIR(p, spread)                         \
+        _mm256_storeu_ps(dest_color + 4*(i+2*p),                        \
+            _mm256_blendv_ps(_mm256_loadu_ps(dest_color + 4*(i+2*p)),   \
+                             _mm256_loadu_ps(src_color + 4*(i+2*p)),    \
+                             _mm256_permutevar8x32_ps(mask, spread)));
+        ICET_ZBUFFER_FLOAT_AVX2_PAIR(0, spread0)
+        ICET_ZBUFFER_FLOAT_AVX2_PAIR(1, spread1)
+        ICET_ZBUFFER_FLOAT_AVX2_PAIR(2, spread2)
+        ICET_ZBUFFER_FLOAT_AVX2_PAIR(3, spread3)
+#undef ICET_ZBUFFER_FLOAT_AVX2_PAIR
+    }
+    return i;
+}
+
+/* Expands a 4-bit pixel mask to a 16-bit channel mask. */
+static const IceTUnsignedInt16 icet_simd_spread_nibble[16] = {
+    0x0000, 0x000F, 0x00F0, 0x00FF, 0x0F00, 0x0F0F, 0x0FF0, 0x0FFF,
+    0xF000, 0xF00F, 0xF0F0, 0xF0FF, 0xFF00, 0xFF0F, 0xFFF0, 0xFFFF
+};
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetZBufferFloatAVX512(const IceTFloat *src_color,
+                                           const IceTFloat *src_depth,
+                                           IceTFloat *dest_color,
+                                           IceTFloat *dest_depth,
+                                           IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512 sd = _mm512_loadu_ps(src_depth + i);
+        __m512 dd = _mm512_loadu_ps(dest_depth + i);
+        __mmask16 mask = _mm512_cmp_ps_mask(sd, dd, _CMP_LT_OQ);
+        int quad;
+        if (mask == 0) continue;
+        _mm512_mask_storeu_ps(dest_depth + i, mask, sd);
+        /* Each 512-bit color register holds four pixels. */
+        for (quad = 0; quad < 4; quad++) {
+            __mmask16 channel_mask
+                = icet_simd_spread_nibble[(mask >> (4*quad)) & 0xF];
+            if (channel_mask == 0) continue;
+            _mm512_mask_storeu_ps(dest_color + 4*(i+4*quad), channel_mask,
+                                  _mm512_loadu_ps(src_color + 4*(i+4*quad)));
+        }
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("sse2")
+static IceTSizeType icetZBufferDepthSSE2(const IceTFloat *src_depth,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 4 <= num_pixels; i += 4) {
+        _mm_storeu_ps(dest_depth + i,
+                      _mm_min_ps(_mm_loadu_ps(src_depth + i),
+                                 _mm_loadu_ps(dest_depth + i)));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetZBufferDepthAVX2(const IceTFloat *src_depth,
+                                         IceTFloat *dest_depth,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        _mm256_storeu_ps(dest_depth + i,
+                         _mm256_min_ps(_mm256_loadu_ps(src_depth + i),
+                                       _mm256_loadu_ps(dest_depth + i)));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetZBufferDepthAVX512(const IceTFloat *src_depth,
+                                           IceTFloat *dest_depth,
+                                           IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        _mm512_storeu_ps(dest_depth + i,
+                         _mm512_min_ps(_mm512_loadu_ps(src_depth + i),
+                                       _mm512_loadu_ps(dest_depth + i)));
+    }
+    return i;
+}
+#endif /* ICET_SIMD_X86 */
+
+void icetSIMDZBufferUByte(const IceTUInt *src_color,
+                          const IceTFloat *src_depth,
+                          IceTUInt *dest_color,
+                          IceTFloat *dest_depth,
+                          IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetZBufferUByteAVX512(src_color, src_depth,
+                                     dest_color, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetZBufferUByteAVX2(src_color, src_depth,
+                                   dest_color, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_SSE2:
+          i = icetZBufferUByteSSE2(src_color, src_depth,
+                                   dest_color, dest_depth, num_pixels);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        if (src_depth[i] < dest_depth[i]) {
+            dest_depth[i] = src_depth[i];
+            dest_color[i] = src_color[i];
+        }
+    }
+}
+
+void icetSIMDZBufferFloat(const IceTFloat *src_color,
+                          const IceTFloat *src_depth,
+                          IceTFloat *dest_color,
+                          IceTFloat *dest_depth,
+                          IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetZBufferFloatAVX512(src_color, src_depth,
+                                     dest_color, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetZBufferFloatAVX2(src_color, src_depth,
+                                   dest_color, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_SSE2:
+          i = icetZBufferFloatSSE2(src_color, src_depth,
+                                   dest_color, dest_depth, num_pixels);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        if (src_depth[i] < dest_depth[i]) {
+            dest_depth[i] = src_depth[i];
+            dest_color[4*i+0] = src_color[4*i+0];
+            dest_color[4*i+1] = src_color[4*i+1];
+            dest_color[4*i+2] = src_color[4*i+2];
+            dest_color[4*i+3] = src_color[4*i+3];
+        }
+    }
+}
+
+void icetSIMDZBufferDepth(const IceTFloat *src_depth,
+                          IceTFloat *dest_depth,
+                          IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetZBufferDepthAVX512(src_depth, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetZBufferDepthAVX2(src_depth, dest_depth, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_SSE2:
+          i = icetZBufferDepthSSE2(src_depth, dest_depth, num_pixels);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        if (src_depth[i] < dest_depth[i]) {
+            dest_depth[i] = src_depth[i];
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Blending
+ * --------------------------------------------------------------------- */
+
+/* The byte blend computes back*(255-front_alpha)/255 + front in 16-bit lanes.
+ * For any t = a*b with a, b <= 255, floor(t/255) == (t + 1 + (t >> 8)) >> 8,
+ * and the intermediate sum never exceeds 16 bits.  The final sum is masked to
+ * 8 bits before packing so that it wraps the same way the scalar cast to
+ * IceTUByte does on (invalid) non-premultiplied input. */
+
+#ifdef ICET_SIMD_X86
+ICET_SIMD_TARGET("sse2")
+static IceTSizeType icetBlendUByteSSE2(const IceTUByte *front,
+                                       const IceTUByte *back,
+                                       IceTUByte *dest,
+                                       IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i c255 = _mm_set1_epi16(255);
+    for (i = 0; i + 4 <= num_pixels; i += 4) {
+        __m128i f = _mm_loadu_si128((const __m128i *)(front + 4*i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(back + 4*i));
+        __m128i result[2];
+        int half;
+        for (half = 0; half < 2; half++) {
+            __m128i fw = half ? _mm_unpackhi_epi8(f, zero)
+                              : _mm_unpacklo_epi8(f, zero);
+            __m128i bw = half ? _mm_unpackhi_epi8(b, zero)
+                              : _mm_unpacklo_epi8(b, zero);
+            __m128i alpha = _mm_shufflehi_epi16(
+                                _mm_shufflelo_epi16(fw, _MM_SHUFFLE(3,3,3,3)),
+                                _MM_SHUFFLE(3,3,3,3));
+            __m128i t = _mm_mullo_epi16(bw, _mm_sub_epi16(c255, alpha));
+            __m128i q = _mm_srli_epi16(
+                            _mm_add_epi16(_mm_add_epi16(t, ones),
+                                          _mm_srli_epi16(t, 8)),
+                            8);
+            result[half] = _mm_and_si128(_mm_add_epi16(q, fw), c255);
+        }
+        _mm_storeu_si128((__m128i *)(dest + 4*i),
+                         _mm_packus_epi16(result[0], result[1]));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetBlendUByteAVX2(const IceTUByte *front,
+                                       const IceTUByte *back,
+                                       IceTUByte *dest,
+                                       IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i c255 = _mm256_set1_epi16(255);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256i f = _mm256_loadu_si256((const __m256i *)(front + 4*i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(back + 4*i));
+        __m256i result[2];
+        int half;
+        /* Unpack and pack both work within 128-bit lanes, so the pixels come
+           back out in their original order. */
+        for (half = 0; half < 2; half++) {
+            __m256i fw = half ? _mm256_unpackhi_epi8(f, zero)
+                              : _mm256_unpacklo_epi8(f, zero);
+            __m256i bw = half ? _mm256_unpackhi_epi8(b, zero)
+                              : _mm256_unpacklo_epi8(b, zero);
+            __m256i alpha = _mm256_shufflehi_epi16(
+                             _mm256_shufflelo_epi16(fw, _MM_SHUFFLE(3,3,3,3)),
+                             _MM_SHUFFLE(3,3,3,3));
+            __m256i t = _mm256_mullo_epi16(bw, _mm256_sub_epi16(c255, alpha));
+            __m256i q = _mm256_srli_epi16(
+                            _mm256_add_epi16(_mm256_add_epi16(t, ones),
+                                             _mm256_srli_epi16(t, 8)),
+                            8);
+            result[half] = _mm256_and_si256(_mm256_add_epi16(q, fw), c255);
+        }
+        _mm256_storeu_si256((__m256i *)(dest + 4*i),
+                            _mm256_packus_epi16(result[0], result[1]));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f,avx512bw")
+static IceTSizeType icetBlendUByteAVX512(const IceTUByte *front,
+                                         const IceTUByte *back,
+                                         IceTUByte *dest,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ones = _mm512_set1_epi16(1);
+    const __m512i c255 = _mm512_set1_epi16(255);
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512i f = _mm512_loadu_si512(front + 4*i);
+        __m512i b = _mm512_loadu_si512(back + 4*i);
+        __m512i result[2];
+        int half;
+        for (half = 0; half < 2; half++) {
+            __m512i fw = half ? _mm512_unpackhi_epi8(f, zero)
+                              : _mm512_unpacklo_epi8(f, zero);
+            __m512i bw = half ? _mm512_unpackhi_epi8(b, zero)
+                              : _mm512_unpacklo_epi8(b, zero);
+            __m512i alpha = _mm512_shufflehi_epi16(
+                             _mm512_shufflelo_epi16(fw, _MM_SHUFFLE(3,3,3,3)),
+                             _MM_SHUFFLE(3,3,3,3));
+            __m512i t = _mm512_mullo_epi16(bw, _mm512_sub_epi16(c255, alpha));
+            __m512i q = _mm512_srli_epi16(
+                            _mm512_add_epi16(_mm512_add_epi16(t, ones),
+                                             _mm512_srli_epi16(t, 8)),
+                            8);
+            result[half] = _mm512_and_si512(_mm512_add_epi16(q, fw), c255);
+        }
+        _mm512_storeu_si512(dest + 4*i,
+                            _mm512_packus_epi16(result[0], result[1]));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("sse2")
+static IceTSizeType icetBlendFloatSSE2(const IceTFloat *front,
+                                       const IceTFloat *back,
+                                       IceTFloat *dest,
+                                       IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (i = 0; i < num_pixels; i++) {
+        __m128 f = _mm_loadu_ps(front + 4*i);
+        __m128 b = _mm_loadu_ps(back + 4*i);
+        __m128 afactor = _mm_sub_ps(one,
+                                    _mm_shuffle_ps(f, f, _MM_SHUFFLE(3,3,3,3)));
+        _mm_storeu_ps(dest + 4*i, _mm_add_ps(_mm_mul_ps(b, afactor), f));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetBlendFloatAVX2(const IceTFloat *front,
+                                       const IceTFloat *back,
+                                       IceTFloat *dest,
+                                       IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (i = 0; i + 2 <= num_pixels; i += 2) {
+        __m256 f = _mm256_loadu_ps(front + 4*i);
+        __m256 b = _mm256_loadu_ps(back + 4*i);
+        __m256 afactor = _mm256_sub_ps(one,
+                                  _mm256_permute_ps(f, _MM_SHUFFLE(3,3,3,3)));
+        _mm256_storeu_ps(dest + 4*i,
+                         _mm256_add_ps(_mm256_mul_ps(b, afactor), f));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetBlendFloatAVX512(const IceTFloat *front,
+                                         const IceTFloat *back,
+                                         IceTFloat *dest,
+                                         IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m512 one = _mm512_set1_ps(1.0f);
+    for (i = 0; i + 4 <= num_pixels; i += 4) {
+        __m512 f = _mm512_loadu_ps(front + 4*i);
+        __m512 b = _mm512_loadu_ps(back + 4*i);
+        __m512 afactor = _mm512_sub_ps(one,
+                                  _mm512_permute_ps(f, _MM_SHUFFLE(3,3,3,3)));
+        _mm512_storeu_ps(dest + 4*i,
+                         _mm512_add_ps(_mm512_mul_ps(b, afactor), f));
+    }
+    return i;
+}
+#endif /* ICET_SIMD_X86 */
+
+void icetSIMDBlendUByte(const IceTUByte *front,
+                        const IceTUByte *back,
+                        IceTUByte *dest,
+                        IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetBlendUByteAVX512(front, back, dest, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetBlendUByteAVX2(front, back, dest, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_SSE2:
+          i = icetBlendUByteSSE2(front, back, dest, num_pixels);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        ICET_BLEND_UBYTE(front + 4*i, back + 4*i, dest + 4*i);
+    }
+}
+
+void icetSIMDBlendFloat(const IceTFloat *front,
+                        const IceTFloat *back,
+                        IceTFloat *dest,
+                        IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetBlendFloatAVX512(front, back, dest, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetBlendFloatAVX2(front, back, dest, num_pixels);
+          break;
+      case ICET_SIMD_LEVEL_SSE2:
+          i = icetBlendFloatSSE2(front, back, dest, num_pixels);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        ICET_BLEND_FLOAT(front + 4*i, back + 4*i, dest + 4*i);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Half precision
+ * --------------------------------------------------------------------- */
+
+/* Half precision pixels are converted to float, blended or added exactly as
+ * the float kernels do, and rounded back to the nearest even half.  The
+ * scalar conversions give the same bits as the F16C instructions, including
+ * for overflow (to infinity), subnormals, and NaN (which become quiet). */
+
+static IceTFloat icetHalfToFloatScalar(IceTUShort half)
+{
+    IceTUInt sign = ((IceTUInt)half & 0x8000) << 16;
+    IceTUInt exponent = ((IceTUInt)half >> 10) & 0x1F;
+    IceTUInt mantissa = (IceTUInt)half & 0x3FF;
+    IceTUInt bits;
+    IceTFloat value;
+
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+        if (mantissa != 0) bits |= 0x400000;
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        /* Subnormal half.  Normalize it for the float. */
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    } else {
+        bits = sign;
+    }
+
+    memcpy(&value, &bits, sizeof(IceTFloat));
+    return value;
+}
+
+static IceTUShort icetFloatToHalfScalar(IceTFloat value)
+{
+    IceTUInt bits;
+    IceTUInt sign;
+    IceTUInt exponent;
+    IceTUInt mantissa;
+    IceTUInt half;
+    IceTUInt rest;
+    IceTUInt halfway;
+
+    memcpy(&bits, &value, sizeof(IceTFloat));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (bits >> 23) & 0xFF;
+    mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF) {
+        /* Infinity or NaN. */
+        if (mantissa == 0) return (IceTUShort)(sign | 0x7C00);
+        return (IceTUShort)(sign | 0x7E00 | (mantissa >> 13));
+    } else if (exponent >= 113) {
+        /* Normal half, or overflow to infinity. */
+        half = ((exponent - 112) << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1FFF;
+        halfway = 0x1000;
+    } else if (exponent >= 102) {
+        /* Subnormal half. */
+        IceTUInt shift = 126 - exponent;
+        mantissa |= 0x800000;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        /* Rounds to zero. */
+        return (IceTUShort)sign;
+    }
+
+    if ((rest > halfway) || ((rest == halfway) && (half & 1))) {
+        half++;
+    }
+    if (half > 0x7C00) half = 0x7C00;
+    return (IceTUShort)(sign | half);
+}
+
+#ifdef ICET_SIMD_X86
+static IceTBoolean icetSIMDUseF16C(void)
+{
+    return ((icetSIMDGetLevel() >= ICET_SIMD_LEVEL_AVX2) && icet_simd_f16c);
+}
+
+ICET_SIMD_TARGET("avx2,f16c")
+static IceTSizeType icetHalfToFloatF16C(const IceTUShort *src,
+                                        IceTFloat *dest,
+                                        IceTSizeType count)
+{
+    IceTSizeType i;
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2,f16c")
+static IceTSizeType icetFloatToHalfF16C(const IceTFloat *src,
+                                        IceTUShort *dest,
+                                        IceTSizeType count)
+{
+    IceTSizeType i;
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256 f = _mm256_loadu_ps(src + i);
+        _mm_storeu_si128((__m128i *)(dest + i),
+                         _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2,f16c")
+static IceTSizeType icetBlendHalfF16C(const IceTUShort *front,
+                                      const IceTUShort *back,
+                                      IceTUShort *dest,
+                                      IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (i = 0; i + 2 <= num_pixels; i += 2) {
+        __m256 f = _mm256_cvtph_ps(
+                           _mm_loadu_si128((const __m128i *)(front + 4*i)));
+        __m256 b = _mm256_cvtph_ps(
+                           _mm_loadu_si128((const __m128i *)(back + 4*i)));
+        __m256 afactor = _mm256_sub_ps(one,
+                                  _mm256_permute_ps(f, _MM_SHUFFLE(3,3,3,3)));
+        __m256 result = _mm256_add_ps(_mm256_mul_ps(b, afactor), f);
+        _mm_storeu_si128((__m128i *)(dest + 4*i),
+                         _mm256_cvtps_ph(result, _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2,f16c")
+static IceTSizeType icetAddHalfF16C(const IceTUShort *src1,
+                                    const IceTUShort *src2,
+                                    IceTUShort *dest,
+                                    IceTSizeType num_pixels)
+{
+    IceTSizeType i;
+    for (i = 0; i + 2 <= num_pixels; i += 2) {
+        __m256 a = _mm256_cvtph_ps(
+                           _mm_loadu_si128((const __m128i *)(src1 + 4*i)));
+        __m256 b = _mm256_cvtph_ps(
+                           _mm_loadu_si128((const __m128i *)(src2 + 4*i)));
+        _mm_storeu_si128((__m128i *)(dest + 4*i),
+                         _mm256_cvtps_ph(_mm256_add_ps(a, b),
+                                         _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+#endif /* ICET_SIMD_X86 */
+
+void icetSIMDHalfToFloat(const IceTUShort *src,
+                         IceTFloat *dest,
+                         IceTSizeType count)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    if (icetSIMDUseF16C()) {
+        i = icetHalfToFloatF16C(src, dest, count);
+    }
+#endif
+
+    for ( ; i < count; i++) {
+        dest[i] = icetHalfToFloatScalar(src[i]);
+    }
+}
+
+void icetSIMDFloatToHalf(const IceTFloat *src,
+                         IceTUShort *dest,
+                         IceTSizeType count)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    if (icetSIMDUseF16C()) {
+        i = icetFloatToHalfF16C(src, dest, count);
+    }
+#endif
+
+    for ( ; i < count; i++) {
+        dest[i] = icetFloatToHalfScalar(src[i]);
+    }
+}
+
+void icetSIMDBlendHalf(const IceTUShort *front,
+                       const IceTUShort *back,
+                       IceTUShort *dest,
+                       IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    if (icetSIMDUseF16C()) {
+        i = icetBlendHalfF16C(front, back, dest, num_pixels);
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        IceTFloat front_f[4], back_f[4], dest_f[4];
+        int channel;
+        for (channel = 0; channel < 4; channel++) {
+            front_f[channel] = icetHalfToFloatScalar(front[4*i + channel]);
+            back_f[channel] = icetHalfToFloatScalar(back[4*i + channel]);
+        }
+        ICET_BLEND_FLOAT(front_f, back_f, dest_f);
+        for (channel = 0; channel < 4; channel++) {
+            dest[4*i + channel] = icetFloatToHalfScalar(dest_f[channel]);
+        }
+    }
+}
+
+void icetSIMDAddHalf(const IceTUShort *src1,
+                     const IceTUShort *src2,
+                     IceTUShort *dest,
+                     IceTSizeType num_pixels)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    if (icetSIMDUseF16C()) {
+        i = icetAddHalfF16C(src1, src2, dest, num_pixels);
+    }
+#endif
+
+    for ( ; i < num_pixels; i++) {
+        int channel;
+        for (channel = 0; channel < 4; channel++) {
+            IceTSizeType index = 4*i + channel;
+            dest[index] = icetFloatToHalfScalar(
+                                          icetHalfToFloatScalar(src1[index])
+                                        + icetHalfToFloatScalar(src2[index]));
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Run detection
+ * --------------------------------------------------------------------- */
+
+/* The vector scans build a bit mask with one bit per pixel that is set for
+ * active pixels.  Comparing that against the activity being counted gives
+ * the run end with a single count of trailing zeros.  Runs are only scanned
+ * in blocks of 8 (AVX2) or 16 (AVX-512) pixels; SSE2 is not worth it here
+ * and falls through to the scalar loops, which also finish partial blocks. */
+
+#ifdef ICET_SIMD_X86
+/* Gathers bits 0, 4, 8, and 12 into bits 0-3. */
+#define ICET_SIMD_COMPACT_NIBBLES(bits)                                 \
+    (((bits) | ((bits) >> 3) | ((bits) >> 6) | ((bits) >> 9)) & 0xF)
+
+#define ICET_SIMD_RUN_CHECK(active_bits)                                \
+    {                                                                   \
+        IceTUInt _mismatch = (active_bits) ^ want;                      \
+        if (_mismatch != 0) {                                           \
+            return i + (IceTSizeType)__builtin_ctz(_mismatch);          \
+        }                                                               \
+    }
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetCountDepthRunAVX2(const IceTFloat *depth,
+                                          IceTSizeType num_pixels,
+                                          IceTBoolean active)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFF : 0;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256 d = _mm256_loadu_ps(depth + i);
+        ICET_SIMD_RUN_CHECK(
+               (IceTUInt)_mm256_movemask_ps(_mm256_cmp_ps(d, one, _CMP_LT_OQ)));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetCountDepthRunAVX512(const IceTFloat *depth,
+                                            IceTSizeType num_pixels,
+                                            IceTBoolean active)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFFFF : 0;
+    const __m512 one = _mm512_set1_ps(1.0f);
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512 d = _mm512_loadu_ps(depth + i);
+        ICET_SIMD_RUN_CHECK((IceTUInt)_mm512_cmp_ps_mask(d, one, _CMP_LT_OQ));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetCountUByteRunAVX2(const IceTUInt *color,
+                                          IceTSizeType num_pixels,
+                                          IceTBoolean active,
+                                          IceTUInt channel_mask)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFF : 0;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask = _mm256_set1_epi32((int)channel_mask);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(color + i));
+        __m256i inactive = _mm256_cmpeq_epi32(_mm256_and_si256(c, mask), zero);
+        ICET_SIMD_RUN_CHECK(
+               ~(IceTUInt)_mm256_movemask_ps(_mm256_castsi256_ps(inactive))
+                   & 0xFF);
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetCountUByteRunAVX512(const IceTUInt *color,
+                                            IceTSizeType num_pixels,
+                                            IceTBoolean active,
+                                            IceTUInt channel_mask)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFFFF : 0;
+    const __m512i mask = _mm512_set1_epi32((int)channel_mask);
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512i c = _mm512_loadu_si512(color + i);
+        ICET_SIMD_RUN_CHECK((IceTUInt)_mm512_test_epi32_mask(c, mask));
+    }
+    return i;
+}
+
+/* For float colors, alpha_only selects testing just the alpha channel (blend)
+   rather than any channel (additive). */
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetCountFloatRunAVX2(const IceTFloat *color,
+                                          IceTSizeType num_pixels,
+                                          IceTBoolean active,
+                                          IceTBoolean alpha_only)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFF : 0;
+    const __m256 zero = _mm256_setzero_ps();
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        IceTUInt active_bits = 0;
+        int pair;
+        /* Each register holds two pixels. */
+        for (pair = 0; pair < 4; pair++) {
+            __m256 c = _mm256_loadu_ps(color + 4*(i + 2*pair));
+            IceTUInt nonzero = (IceTUInt)_mm256_movemask_ps(
+                                         _mm256_cmp_ps(c, zero, _CMP_NEQ_UQ));
+            IceTUInt pixel_bits;
+            if (alpha_only) {
+                pixel_bits = ((nonzero >> 3) & 0x1) | ((nonzero >> 6) & 0x2);
+            } else {
+                pixel_bits = (((nonzero & 0x0F) != 0) ? 0x1 : 0)
+                           | (((nonzero & 0xF0) != 0) ? 0x2 : 0);
+            }
+            active_bits |= pixel_bits << (2*pair);
+        }
+        ICET_SIMD_RUN_CHECK(active_bits);
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetCountFloatRunAVX512(const IceTFloat *color,
+                                            IceTSizeType num_pixels,
+                                            IceTBoolean active,
+                                            IceTBoolean alpha_only)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFFFF : 0;
+    const __m512 zero = _mm512_setzero_ps();
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        IceTUInt active_bits = 0;
+        int quad;
+        /* Each register holds four pixels. */
+        for (quad = 0; quad < 4; quad++) {
+            __m512 c = _mm512_loadu_ps(color + 4*(i + 4*quad));
+            IceTUInt nonzero
+                = (IceTUInt)_mm512_cmp_ps_mask(c, zero, _CMP_NEQ_UQ);
+            IceTUInt pixel_bits;
+            if (alpha_only) {
+                pixel_bits = (nonzero >> 3) & 0x1111;
+            } else {
+                pixel_bits = (  nonzero | (nonzero >> 1)
+                              | (nonzero >> 2) | (nonzero >> 3) ) & 0x1111;
+            }
+            active_bits |= ICET_SIMD_COMPACT_NIBBLES(pixel_bits) << (4*quad);
+        }
+        ICET_SIMD_RUN_CHECK(active_bits);
+    }
+    return i;
+}
+
+/* With an alpha cutoff, pixels are active if their alpha is at least
+   min_alpha. */
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetCountAlphaCutoffUByteRunAVX2(const IceTUInt *color,
+                                                     IceTSizeType num_pixels,
+                                                     IceTBoolean active,
+                                                     IceTUInt min_alpha)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFF : 0;
+    const __m256i threshold = _mm256_set1_epi32((int)min_alpha - 1);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(color + i));
+        __m256i above
+            = _mm256_cmpgt_epi32(_mm256_srli_epi32(c, 24), threshold);
+        ICET_SIMD_RUN_CHECK(
+               (IceTUInt)_mm256_movemask_ps(_mm256_castsi256_ps(above)));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetCountAlphaCutoffUByteRunAVX512(const IceTUInt *color,
+                                                       IceTSizeType num_pixels,
+                                                       IceTBoolean active,
+                                                       IceTUInt min_alpha)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFFFF : 0;
+    const __m512i threshold = _mm512_set1_epi32((int)min_alpha);
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        __m512i c = _mm512_loadu_si512(color + i);
+        ICET_SIMD_RUN_CHECK((IceTUInt)_mm512_cmpge_epu32_mask(
+                                      _mm512_srli_epi32(c, 24), threshold));
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx2")
+static IceTSizeType icetCountAlphaCutoffFloatRunAVX2(const IceTFloat *color,
+                                                     IceTSizeType num_pixels,
+                                                     IceTBoolean active,
+                                                     IceTFloat min_alpha)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFF : 0;
+    const __m256 threshold = _mm256_set1_ps(min_alpha);
+    for (i = 0; i + 8 <= num_pixels; i += 8) {
+        IceTUInt active_bits = 0;
+        int pair;
+        /* Each register holds two pixels. */
+        for (pair = 0; pair < 4; pair++) {
+            __m256 c = _mm256_loadu_ps(color + 4*(i + 2*pair));
+            IceTUInt above = (IceTUInt)_mm256_movemask_ps(
+                                   _mm256_cmp_ps(c, threshold, _CMP_GE_OQ));
+            active_bits
+                |= (((above >> 3) & 0x1) | ((above >> 6) & 0x2)) << (2*pair);
+        }
+        ICET_SIMD_RUN_CHECK(active_bits);
+    }
+    return i;
+}
+
+ICET_SIMD_TARGET("avx512f")
+static IceTSizeType icetCountAlphaCutoffFloatRunAVX512(const IceTFloat *color,
+                                                       IceTSizeType num_pixels,
+                                                       IceTBoolean active,
+                                                       IceTFloat min_alpha)
+{
+    IceTSizeType i;
+    IceTUInt want = active ? 0xFFFF : 0;
+    const __m512 threshold = _mm512_set1_ps(min_alpha);
+    for (i = 0; i + 16 <= num_pixels; i += 16) {
+        IceTUInt active_bits = 0;
+        int quad;
+        /* Each register holds four pixels. */
+        for (quad = 0; quad < 4; quad++) {
+            __m512 c = _mm512_loadu_ps(color + 4*(i + 4*quad));
+            IceTUInt above = (IceTUInt)_mm512_cmp_ps_mask(c, threshold,
+                                                          _CMP_GE_OQ);
+            active_bits
+                |= ICET_SIMD_COMPACT_NIBBLES((above >> 3) & 0x1111)
+                   << (4*quad);
+        }
+        ICET_SIMD_RUN_CHECK(active_bits);
+    }
+    return i;
+}
+
+#undef ICET_SIMD_RUN_CHECK
+#undef ICET_SIMD_COMPACT_NIBBLES
+#endif /* ICET_SIMD_X86 */
+
+IceTSizeType icetSIMDCountDepthRun(const IceTFloat *depth,
+                                   IceTSizeType num_pixels,
+                                   IceTBoolean active)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountDepthRunAVX512(depth, num_pixels, active);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountDepthRunAVX2(depth, num_pixels, active);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    if (active) {
+        while ((i < num_pixels) && (depth[i] < 1.0)) i++;
+    } else {
+        while ((i < num_pixels) && !(depth[i] < 1.0)) i++;
+    }
+    return i;
+}
+
+IceTSizeType icetSIMDCountAlphaUByteRun(const IceTUInt *color,
+                                        IceTSizeType num_pixels,
+                                        IceTBoolean active)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    /* Alpha is the last byte in memory, which is the high byte of the
+       (little endian) 32-bit word. */
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountUByteRunAVX512(color, num_pixels, active, 0xFF000000u);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountUByteRunAVX2(color, num_pixels, active, 0xFF000000u);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    if (active) {
+        while ((i < num_pixels) && (((const IceTUByte *)(color+i))[3] != 0)) {
+            i++;
+        }
+    } else {
+        while ((i < num_pixels) && (((const IceTUByte *)(color+i))[3] == 0)) {
+            i++;
+        }
+    }
+    return i;
+}
+
+IceTSizeType icetSIMDCountAlphaFloatRun(const IceTFloat *color,
+                                        IceTSizeType num_pixels,
+                                        IceTBoolean active)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountFloatRunAVX512(color, num_pixels, active, ICET_TRUE);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountFloatRunAVX2(color, num_pixels, active, ICET_TRUE);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    if (active) {
+        while ((i < num_pixels) && (color[4*i+3] != 0.0)) i++;
+    } else {
+        while ((i < num_pixels) && !(color[4*i+3] != 0.0)) i++;
+    }
+    return i;
+}
+
+IceTSizeType icetSIMDCountColorUByteRun(const IceTUInt *color,
+                                        IceTSizeType num_pixels,
+                                        IceTBoolean active)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountUByteRunAVX512(color, num_pixels, active, 0xFFFFFFFFu);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountUByteRunAVX2(color, num_pixels, active, 0xFFFFFFFFu);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    if (active) {
+        while ((i < num_pixels) && (color[i] != 0)) i++;
+    } else {
+        while ((i < num_pixels) && (color[i] == 0)) i++;
+    }
+    return i;
+}
+
+#define ICET_SIMD_COLOR_FLOAT_ACTIVE(c)                                 \
+    (((c)[0] != 0.0) || ((c)[1] != 0.0) || ((c)[2] != 0.0) || ((c)[3] != 0.0))
+
+IceTSizeType icetSIMDCountColorFloatRun(const IceTFloat *color,
+                                        IceTSizeType num_pixels,
+                                        IceTBoolean active)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountFloatRunAVX512(color, num_pixels, active, ICET_FALSE);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountFloatRunAVX2(color, num_pixels, active, ICET_FALSE);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    if (active) {
+        while ((i < num_pixels) && ICET_SIMD_COLOR_FLOAT_ACTIVE(color + 4*i)) {
+            i++;
+        }
+    } else {
+        while ((i < num_pixels) && !ICET_SIMD_COLOR_FLOAT_ACTIVE(color + 4*i)) {
+            i++;
+        }
+    }
+    return i;
+}
+
+#undef ICET_SIMD_COLOR_FLOAT_ACTIVE
+
+/* Half precision runs are only scanned with plain C.  The sign bit is
+   ignored so that negative zero counts as zero. */
+IceTSizeType icetSIMDCountAlphaHalfRun(const IceTUShort *color,
+                                       IceTSizeType num_pixels,
+                                       IceTBoolean active)
+{
+    IceTSizeType i = 0;
+    if (active) {
+        while ((i < num_pixels) && ((color[4*i+3] & 0x7FFF) != 0)) i++;
+    } else {
+        while ((i < num_pixels) && ((color[4*i+3] & 0x7FFF) == 0)) i++;
+    }
+    return i;
+}
+
+IceTSizeType icetSIMDCountAlphaCutoffUByteRun(const IceTUInt *color,
+                                              IceTSizeType num_pixels,
+                                              IceTBoolean active,
+                                              IceTUInt min_alpha)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountAlphaCutoffUByteRunAVX512(color, num_pixels, active,
+                                                 min_alpha);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountAlphaCutoffUByteRunAVX2(color, num_pixels, active,
+                                               min_alpha);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    while (   (i < num_pixels)
+           && ((((const IceTUByte *)(color+i))[3] >= min_alpha) == active)) {
+        i++;
+    }
+    return i;
+}
+
+IceTSizeType icetSIMDCountAlphaCutoffFloatRun(const IceTFloat *color,
+                                              IceTSizeType num_pixels,
+                                              IceTBoolean active,
+                                              IceTFloat min_alpha)
+{
+    IceTSizeType i = 0;
+
+#ifdef ICET_SIMD_X86
+    switch (icetSIMDGetLevel()) {
+      case ICET_SIMD_LEVEL_AVX512:
+          i = icetCountAlphaCutoffFloatRunAVX512(color, num_pixels, active,
+                                                 min_alpha);
+          break;
+      case ICET_SIMD_LEVEL_AVX2:
+          i = icetCountAlphaCutoffFloatRunAVX2(color, num_pixels, active,
+                                               min_alpha);
+          break;
+      default:
+          break;
+    }
+#endif
+
+    while ((i < num_pixels) && ((color[4*i+3] >= min_alpha) == active)) i++;
+    return i;
+}
+
+IceTSizeType icetSIMDCountAlphaCutoffHalfRun(const IceTUShort *color,
+                                             IceTSizeType num_pixels,
+                                             IceTBoolean active,
+                                             IceTFloat min_alpha)
+{
+    IceTSizeType i = 0;
+    while (   (i < num_pixels)
+           && ((icetHalfToFloatScalar(color[4*i+3]) >= min_alpha) == active)) {
+        i++;
+    }
+    return i;
+}
+
+#define ICET_SIMD_COLOR_HALF_ACTIVE(c)                                  \
+    ((((c)[0] | (c)[1] | (c)[2] | (c)[3]) & 0x7FFF) != 0)
+
+IceTSizeType icetSIMDCountColorHalfRun(const IceTUShort *color,
+                                       IceTSizeType num_pixels,
+                                       IceTBoolean active)
+{
+    IceTSizeType i = 0;
+    if (active) {
+        while ((i < num_pixels) && ICET_SIMD_COLOR_HALF_ACTIVE(color + 4*i)) {
+            i++;
+        }
+    } else {
+        while ((i < num_pixels) && !ICET_SIMD_COLOR_HALF_ACTIVE(color + 4*i)) {
+            i++;
+        }
+    }
+    return i;
+}
+
+#undef ICET_SIMD_COLOR_HALF_ACTIVE
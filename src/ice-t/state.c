@@ -186,6 +186,53 @@ void icetStateSetDefaults(void)
         icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, ICET_MAX_IMAGE_SPLIT_DEFAULT);
     }
 
+    if (getenv("ICET_COMPRESS_THREADS") != NULL) {
+        IceTInt compress_threads = atoi(getenv("ICET_COMPRESS_THREADS"));
+        if (compress_threads > 0) {
+            icetStateSetInteger(ICET_COMPRESS_THREADS, compress_threads);
+        } else {
+            icetRaiseError("Environment variable ICET_COMPRESS_THREADS must be"
+                           " set to an integer greater than 0.",
+                           ICET_INVALID_VALUE);
+            icetStateSetInteger(ICET_COMPRESS_THREADS,
+                                ICET_COMPRESS_THREADS_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_COMPRESS_THREADS,
+                            ICET_COMPRESS_THREADS_DEFAULT);
+    }
+
+    if (getenv("ICET_COMPOSITE_THREADS") != NULL) {
+        IceTInt composite_threads = atoi(getenv("ICET_COMPOSITE_THREADS"));
+        if (composite_threads > 0) {
+            icetStateSetInteger(ICET_COMPOSITE_THREADS, composite_threads);
+        } else {
+            icetRaiseError("Environment variable ICET_COMPOSITE_THREADS must"
+                           " be set to an integer greater than 0.",
+                           ICET_INVALID_VALUE);
+            icetStateSetInteger(ICET_COMPOSITE_THREADS,
+                                ICET_COMPOSITE_THREADS_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_COMPOSITE_THREADS,
+                            ICET_COMPOSITE_THREADS_DEFAULT);
+    }
+
+    if (getenv("ICET_BLEND_ALPHA_CUTOFF") != NULL) {
+        IceTFloat alpha_cutoff
+            = (IceTFloat)atof(getenv("ICET_BLEND_ALPHA_CUTOFF"));
+        if (alpha_cutoff >= 0.0f) {
+            icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, alpha_cutoff);
+        } else {
+            icetRaiseError("Environment variable ICET_BLEND_ALPHA_CUTOFF must"
+                           " be set to a number no less than 0.",
+                           ICET_INVALID_VALUE);
+            icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, 0.0f);
+        }
+    } else {
+        icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, 0.0f);
+    }
+
     icetStateSetPointer(ICET_DRAW_FUNCTION, NULL);
     icetStateSetPointer(ICET_RENDER_LAYER_DESTRUCTOR, NULL);
 
@@ -196,6 +243,9 @@ void icetStateSetDefaults(void)
     icetEnable(ICET_INTERLACE_IMAGES);
     icetEnable(ICET_COLLECT_IMAGES);
     icetDisable(ICET_RENDER_EMPTY_IMAGES);
+    icetDisable(ICET_DOUBLE_ACCUMULATION);
+    icetDisable(ICET_REPRODUCIBLE_ACCUMULATION);
+    icetDisable(ICET_BLOCK_TILED_IMAGES);
 
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 0);
 
@@ -703,7 +753,7 @@ IceTVoid *icetGetStateBuffer(IceTEnum pname, IceTSizeType num_bytes)
 
 IceTTimeStamp icetGetTimeStamp(void)
 {
-    static IceTTimeStamp current_time = 0;
+    ICET_THREAD_LOCAL IceTTimeStamp current_time = 0;
 
     return current_time++;
 }
@@ -33,7 +33,11 @@ typedef IceTInt8                IceTByte;
 typedef IceTUnsignedInt8        IceTUByte;
 typedef IceTUnsignedInt8        IceTBoolean;
 typedef void                    IceTVoid;
+#ifdef ICET_USE_64BIT_SIZE
+typedef IceTInt64               IceTSizeType;
+#else
 typedef IceTInt32               IceTSizeType;
+#endif
 
 struct IceTContextStruct;
 typedef struct IceTContextStruct *IceTContext;
@@ -46,6 +50,19 @@ typedef struct IceTCommRequestStruct {
 } *IceTCommRequest;
 #define ICET_COMM_REQUEST_NULL ((IceTCommRequest)NULL)
 
+/* Combines count elements of inbuf into the matching elements of inoutbuf
+   for the ReduceScatterBlock method of a communicator.  The data pointer is
+   passed through unchanged.  ReduceScatterBlock is collective over only the
+   group_size processes listed in group.  The sendbuf of each holds
+   group_size blocks of recvcount elements that are element_size bytes each.
+   Block i from all the processes is reduced (in any order) and left in
+   recvbuf of group[i].  A communicator that cannot do this sets the method
+   to NULL. */
+typedef void (*IceTCommReduceFunction)(const void *inbuf,
+                                       void *inoutbuf,
+                                       IceTSizeType count,
+                                       void *data);
+
 struct IceTCommunicatorStruct {
     struct IceTCommunicatorStruct *
          (*Duplicate)(struct IceTCommunicatorStruct *self);
@@ -57,69 +74,113 @@ struct IceTCommunicatorStruct {
     void (*Barrier)(struct IceTCommunicatorStruct *self);
     void (*Send)(struct IceTCommunicatorStruct *self,
                  const void *buf,
-                 int count,
+                 IceTSizeType count,
                  IceTEnum datatype,
                  int dest,
                  int tag);
     void (*Recv)(struct IceTCommunicatorStruct *self,
                  void *buf,
-                 int count,
+                 IceTSizeType count,
                  IceTEnum datatype,
                  int src,
                  int tag);
 
     void (*Sendrecv)(struct IceTCommunicatorStruct *self,
                      const void *sendbuf,
-                     int sendcount,
+                     IceTSizeType sendcount,
                      IceTEnum sendtype,
                      int dest,
                      int sendtag,
                      void *recvbuf,
-                     int recvcount,
+                     IceTSizeType recvcount,
                      IceTEnum recvtype,
                      int src,
                      int recvtag);
     void (*Gather)(struct IceTCommunicatorStruct *self,
                    const void *sendbuf,
-                   int sendcount,
+                   IceTSizeType sendcount,
                    IceTEnum datatype,
                    void *recvbuf,
                    int root);
     void (*Gatherv)(struct IceTCommunicatorStruct *self,
                     const void *sendbuf,
-                    int sendcount,
+                    IceTSizeType sendcount,
                     IceTEnum datatype,
                     void *recvbuf,
-                    const int *recvcounts,
-                    const int *recvoffsets,
+                    const IceTSizeType *recvcounts,
+                    const IceTSizeType *recvoffsets,
                     int root);
     void (*Allgather)(struct IceTCommunicatorStruct *self,
                       const void *sendbuf,
-                      int sendcount,
+                      IceTSizeType sendcount,
                       IceTEnum datatype,
                       void *recvbuf);
     void (*Alltoall)(struct IceTCommunicatorStruct *self,
                      const void *sendbuf,
-                     int sendcount,
+                     IceTSizeType sendcount,
                      IceTEnum datatype,
                      void *recvbuf);
+    void (*ReduceScatterBlock)(struct IceTCommunicatorStruct *self,
+                               int group_size,
+                               const IceTInt32 *group,
+                               const void *sendbuf,
+                               void *recvbuf,
+                               IceTSizeType recvcount,
+                               IceTSizeType element_size,
+                               IceTCommReduceFunction reduce,
+                               void *reduce_data);
 
     IceTCommRequest (*Isend)(struct IceTCommunicatorStruct *self,
                              const void *buf,
-                             int count,
+                             IceTSizeType count,
                              IceTEnum datatype,
                              int dest,
                              int tag);
     IceTCommRequest (*Irecv)(struct IceTCommunicatorStruct *self,
                              void *buf,
-                             int count,
+                             IceTSizeType count,
                              IceTEnum datatype,
                              int src,
                              int tag);
+    /* Like Isend and Irecv, but a communicator may keep the underlying
+       request once it completes and start it again the next time the same
+       buffer is exchanged with the same process and tag, which saves setting
+       up the message every frame.  Either method may be NULL, in which case
+       Isend or Irecv is used instead. */
+    IceTCommRequest (*PersistentIsend)(struct IceTCommunicatorStruct *self,
+                                       const void *buf,
+                                       IceTSizeType count,
+                                       IceTEnum datatype,
+                                       int dest,
+                                       int tag);
+    IceTCommRequest (*PersistentIrecv)(struct IceTCommunicatorStruct *self,
+                                       void *buf,
+                                       IceTSizeType count,
+                                       IceTEnum datatype,
+                                       int src,
+                                       int tag);
 
     void (*Wait)(struct IceTCommunicatorStruct *self, IceTCommRequest *request);
     int  (*Waitany)(struct IceTCommunicatorStruct *self,
                     int count, IceTCommRequest *array_of_requests);
+    /* Waitsome blocks until at least one of the requests has finished and
+       Testsome returns right away.  Both set every finished request to NULL,
+       write their indices to array_of_indices, and return how many there
+       were (0 if no request was active).  Test sets the request to NULL and
+       returns nonzero if it has finished.  Any of these may be NULL.  A
+       missing Waitsome is replaced with Waitany and a missing Testsome with
+       Test, but without Test nothing can be tested, so testing then always
+       reports that nothing has finished. */
+    int  (*Waitsome)(struct IceTCommunicatorStruct *self,
+                     int count,
+                     IceTCommRequest *array_of_requests,
+                     int *array_of_indices);
+    int  (*Testsome)(struct IceTCommunicatorStruct *self,
+                     int count,
+                     IceTCommRequest *array_of_requests,
+                     int *array_of_indices);
+    int  (*Test)(struct IceTCommunicatorStruct *self,
+                 IceTCommRequest *request);
 
     int  (*Comm_size)(struct IceTCommunicatorStruct *self);
     int  (*Comm_rank)(struct IceTCommunicatorStruct *self);
@@ -143,7 +204,12 @@ ICET_EXPORT void        icetCopyState(IceTContext dest, const IceTContext src);
 #define ICET_INT        (IceTEnum)0x8003
 #define ICET_FLOAT      (IceTEnum)0x8004
 #define ICET_DOUBLE     (IceTEnum)0x8005
+#define ICET_INT64      (IceTEnum)0x8006
+#ifdef ICET_USE_64BIT_SIZE
+#define ICET_SIZE_TYPE  ICET_INT64
+#else
 #define ICET_SIZE_TYPE  ICET_INT
+#endif
 #define ICET_POINTER    (IceTEnum)0x8008
 #define ICET_VOID       (IceTEnum)0x800F
 #define ICET_NULL       (IceTEnum)0x0000
@@ -172,9 +238,15 @@ typedef struct { IceTVoid *opaque_internals; } IceTImage;
 
 #define ICET_IMAGE_COLOR_RGBA_UBYTE     (IceTEnum)0xC001
 #define ICET_IMAGE_COLOR_RGBA_FLOAT     (IceTEnum)0xC002
+#define ICET_IMAGE_COLOR_RGBA_HALF      (IceTEnum)0xC003
+#define ICET_IMAGE_COLOR_R_FLOAT        (IceTEnum)0xC004
+#define ICET_IMAGE_COLOR_RG_FLOAT       (IceTEnum)0xC005
+#define ICET_IMAGE_COLOR_R_UINT         (IceTEnum)0xC006
 #define ICET_IMAGE_COLOR_NONE           (IceTEnum)0xC000
 
 #define ICET_IMAGE_DEPTH_FLOAT          (IceTEnum)0xD001
+#define ICET_IMAGE_DEPTH_HALF           (IceTEnum)0xD002
+#define ICET_IMAGE_DEPTH_UNORM24        (IceTEnum)0xD003
 #define ICET_IMAGE_DEPTH_NONE           (IceTEnum)0xD000
 
 ICET_EXPORT void icetSetColorFormat(IceTEnum color_format);
@@ -221,6 +293,7 @@ ICET_EXPORT const char *icetGetStrategyName(void);
 #define ICET_SINGLE_IMAGE_STRATEGY_RADIXK       (IceTEnum)0x7004
 #define ICET_SINGLE_IMAGE_STRATEGY_RADIXKR      (IceTEnum)0x7005
 #define ICET_SINGLE_IMAGE_STRATEGY_BSWAP_FOLDING (IceTEnum)0x7006
+#define ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER (IceTEnum)0x7007
 
 ICET_EXPORT void icetSingleImageStrategy(IceTEnum strategy);
 
@@ -228,6 +301,9 @@ ICET_EXPORT const char *icetGetSingleImageStrategyName(void);
 
 #define ICET_COMPOSITE_MODE_Z_BUFFER    (IceTEnum)0x0301
 #define ICET_COMPOSITE_MODE_BLEND       (IceTEnum)0x0302
+#define ICET_COMPOSITE_MODE_ADD         (IceTEnum)0x0303
+#define ICET_COMPOSITE_MODE_MAX         (IceTEnum)0x0304
+#define ICET_COMPOSITE_MODE_MIN         (IceTEnum)0x0305
 ICET_EXPORT void icetCompositeMode(IceTEnum mode);
 
 ICET_EXPORT void icetCompositeOrder(const IceTInt *process_ranks);
@@ -301,6 +377,9 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 
 #define ICET_MAGIC_K            (ICET_STATE_ENGINE_START | (IceTEnum)0x0040)
 #define ICET_MAX_IMAGE_SPLIT    (ICET_STATE_ENGINE_START | (IceTEnum)0x0041)
+#define ICET_COMPRESS_THREADS   (ICET_STATE_ENGINE_START | (IceTEnum)0x0042)
+#define ICET_COMPOSITE_THREADS  (ICET_STATE_ENGINE_START | (IceTEnum)0x0043)
+#define ICET_BLEND_ALPHA_CUTOFF (ICET_STATE_ENGINE_START | (IceTEnum)0x0044)
 
 #define ICET_DRAW_FUNCTION      (ICET_STATE_ENGINE_START | (IceTEnum)0x0060)
 #define ICET_RENDER_LAYER_DESTRUCTOR (ICET_STATE_ENGINE_START|(IceTEnum)0x0061)
@@ -331,6 +410,7 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_RENDER_BUFFER      (ICET_STATE_FRAME_START | (IceTEnum)0x0021)
 #define ICET_PRE_RENDERED       (ICET_STATE_FRAME_START | (IceTEnum)0x0022)
 #define ICET_TILE_PROJECTIONS   (ICET_STATE_FRAME_START | (IceTEnum)0x0023)
+#define ICET_RENDER_COLOR_FORMAT (ICET_STATE_FRAME_START | (IceTEnum)0x0024)
 
 #define ICET_STATE_TIMING_START (IceTEnum)0x000000C0
 
@@ -365,6 +445,9 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_INTERLACE_IMAGES   (ICET_STATE_ENABLE_START | (IceTEnum)0x0005)
 #define ICET_COLLECT_IMAGES     (ICET_STATE_ENABLE_START | (IceTEnum)0x0006)
 #define ICET_RENDER_EMPTY_IMAGES (ICET_STATE_ENABLE_START | (IceTEnum)0x0007)
+#define ICET_DOUBLE_ACCUMULATION (ICET_STATE_ENABLE_START | (IceTEnum)0x0008)
+#define ICET_REPRODUCIBLE_ACCUMULATION (ICET_STATE_ENABLE_START | (IceTEnum)0x0009)
+#define ICET_BLOCK_TILED_IMAGES (ICET_STATE_ENABLE_START | (IceTEnum)0x000A)
 
 /* This set of enable state variables are reserved for the rendering layer. */
 #define ICET_RENDER_LAYER_ENABLE_START (ICET_STATE_ENABLE_START | (IceTEnum)0x0030)
@@ -386,6 +469,13 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_STRATEGY_COMMON_BUF_0 (ICET_CORE_BUFFER_START | (IceTEnum)0x0006)
 #define ICET_STRATEGY_COMMON_BUF_1 (ICET_CORE_BUFFER_START | (IceTEnum)0x0007)
 #define ICET_STRATEGY_COMMON_BUF_2 (ICET_CORE_BUFFER_START | (IceTEnum)0x0008)
+#define ICET_COMPRESS_BAND_BUF  (ICET_CORE_BUFFER_START | (IceTEnum)0x0009)
+#define ICET_CC_COMPOSITE_BAND_BUF (ICET_CORE_BUFFER_START | (IceTEnum)0x000A)
+#define ICET_SPARSE_SPLIT_BUF   (ICET_CORE_BUFFER_START | (IceTEnum)0x000B)
+#define ICET_ACCUMULATION_BUF   (ICET_CORE_BUFFER_START | (IceTEnum)0x000C)
+#define ICET_ACCUMULATION_RESULT_BUF (ICET_CORE_BUFFER_START | (IceTEnum)0x000D)
+#define ICET_BLOCK_TILE_BUF     (ICET_CORE_BUFFER_START | (IceTEnum)0x000E)
+#define ICET_BLOCK_UNTILE_BUF   (ICET_CORE_BUFFER_START | (IceTEnum)0x000F)
 
 #define ICET_RENDER_LAYER_BUFFER_START (ICET_STATE_BUFFER_START | (IceTEnum)0x0010)
 #define ICET_RENDER_LAYER_BUFFER_END   (ICET_STATE_BUFFER_START | (IceTEnum)0x0020)
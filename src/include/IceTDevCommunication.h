@@ -65,6 +65,14 @@ ICET_EXPORT void icetCommAlltoall(const void *sendbuf,
                                   IceTSizeType sendcount,
                                   IceTEnum type,
                                   void *recvbuf);
+ICET_EXPORT void icetCommReduceScatterBlock(int group_size,
+                                            const IceTInt32 *group,
+                                            const void *sendbuf,
+                                            void *recvbuf,
+                                            IceTSizeType recvcount,
+                                            IceTSizeType element_size,
+                                            IceTCommReduceFunction reduce,
+                                            void *reduce_data);
 ICET_EXPORT IceTCommRequest icetCommIsend(const void *buf,
                                           IceTSizeType count,
                                           IceTEnum datatype,
@@ -75,8 +83,32 @@ ICET_EXPORT IceTCommRequest icetCommIrecv(void *buf,
                                           IceTEnum datatype,
                                           int src,
                                           int tag);
+ICET_EXPORT IceTCommRequest icetCommPersistentIsend(const void *buf,
+                                                    IceTSizeType count,
+                                                    IceTEnum datatype,
+                                                    int dest,
+                                                    int tag);
+ICET_EXPORT IceTCommRequest icetCommPersistentIrecv(void *buf,
+                                                    IceTSizeType count,
+                                                    IceTEnum datatype,
+                                                    int src,
+                                                    int tag);
 ICET_EXPORT void icetCommWait(IceTCommRequest *request);
 ICET_EXPORT int icetCommWaitany(int count, IceTCommRequest *array_of_requests);
+/* icetCommWaitsome blocks until at least one active request finishes and
+ * returns how many finished, writing their indices to array_of_indices and
+ * setting them to ICET_COMM_REQUEST_NULL.  It returns 0 only if no request is
+ * active.  icetCommTestsome and icetCommTest never block.  icetCommTestsome
+ * returns 0 and icetCommTest returns ICET_FALSE when nothing has finished,
+ * which is always the case if the communicator cannot test requests, so a
+ * caller that polls must fall back to a wait to make progress. */
+ICET_EXPORT int icetCommWaitsome(int count,
+                                 IceTCommRequest *array_of_requests,
+                                 int *array_of_indices);
+ICET_EXPORT int icetCommTestsome(int count,
+                                 IceTCommRequest *array_of_requests,
+                                 int *array_of_indices);
+ICET_EXPORT IceTBoolean icetCommTest(IceTCommRequest *request);
 ICET_EXPORT void icetCommWaitall(int count, IceTCommRequest *array_of_requests);
 ICET_EXPORT int icetCommSize();
 ICET_EXPORT int icetCommRank();
@@ -11,6 +11,7 @@
 #define _ICET_CONTEXT_H_
 
 #include <IceT.h>
+#include <IceTDevPorting.h>
 #include <IceTDevState.h>
 
 #ifdef __cplusplus
@@ -23,6 +24,11 @@ extern "C" {
 ICET_EXPORT IceTState icetGetState();
 ICET_EXPORT IceTCommunicator icetGetCommunicator();
 
+/* The worker threads icetParallelFor keeps for the current context, or NULL
+   if it has not started any.  The context destroys the pool with itself. */
+ICET_EXPORT IceTThreadPool icetGetThreadPool();
+ICET_EXPORT void icetSetThreadPool(IceTThreadPool pool);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,37 @@ extern "C" {
 #define ICET_SRC_ON_TOP         ICET_TRUE
 #define ICET_DEST_ON_TOP        ICET_FALSE
 
+/* Color formats used internally while additively compositing float colors
+   with ICET_DOUBLE_ACCUMULATION or ICET_REPRODUCIBLE_ACCUMULATION enabled.
+   They hold the same channels as the R, RG, and RGBA float formats.  The
+   double formats store each channel as an IceTDouble.  The binned formats
+   store each channel as three IceTDoubles: a bin number and the (exact) sums
+   of the parts of the values falling in that bin and the bin below.  Pixels
+   that are all zero are inactive.  icetSetColorFormat does not accept these
+   formats. */
+#define ICET_IMAGE_COLOR_R_DOUBLE       (IceTEnum)0xC101
+#define ICET_IMAGE_COLOR_RG_DOUBLE      (IceTEnum)0xC102
+#define ICET_IMAGE_COLOR_RGBA_DOUBLE    (IceTEnum)0xC104
+#define ICET_IMAGE_COLOR_R_BINNED       (IceTEnum)0xC201
+#define ICET_IMAGE_COLOR_RG_BINNED      (IceTEnum)0xC202
+#define ICET_IMAGE_COLOR_RGBA_BINNED    (IceTEnum)0xC204
+
+/* Returns the color format images of the given format are composited in,
+   which is one of the accumulation formats above if enabled for the current
+   composite mode and otherwise color_format itself. */
+ICET_EXPORT IceTEnum icetAccumulationColorFormat(IceTEnum color_format);
+
+/* The layout of the header at the front of every image buffer.  The data
+   starts on an 8 byte boundary to keep it aligned for the pointers of pointer
+   images, so ICET_IMAGE_HEADER_SIZE is also the size of a buffer for an image
+   with no pixels.  It is a constant expression, so it can size arrays. */
+#define ICET_IMAGE_NUM_INT_ENTRIES              10
+#define ICET_IMAGE_NUM_SIZE_ENTRIES             4
+#define ICET_IMAGE_HEADER_SIZE                                          \
+    ((IceTSizeType)(  (  ICET_IMAGE_NUM_INT_ENTRIES*sizeof(IceTInt)     \
+                       + ICET_IMAGE_NUM_SIZE_ENTRIES*sizeof(IceTSizeType) \
+                       + 7) & ~(size_t)7 ))
+
 ICET_EXPORT IceTImage icetGetStateBufferImage(IceTEnum pname,
                                               IceTSizeType width,
                                               IceTSizeType height);
@@ -107,6 +138,15 @@ ICET_EXPORT void icetSparseImageSetDimensions(IceTSparseImage image,
                                               IceTSizeType height);
 ICET_EXPORT IceTSizeType icetSparseImageGetCompressedBufferSize(
                                                    const IceTSparseImage image);
+/* The number of active pixels in a sparse image and the smallest viewport
+   (x, y, width, height) that holds them, which is all zeros if there are
+   none.  Compressing, compositing, and splitting record these in the image,
+   and they are sent with it.  The count is -1 (and the viewport the whole
+   image) if the run lengths are corrupt. */
+ICET_EXPORT IceTSizeType icetSparseImageGetActiveCount(
+                                                   const IceTSparseImage image);
+ICET_EXPORT void icetSparseImageGetActiveViewport(const IceTSparseImage image,
+                                                  IceTInt *viewport);
 ICET_EXPORT void icetSparseImagePackageForSend(IceTSparseImage image,
                                                IceTVoid **buffer,
                                                IceTSizeType *size);
@@ -142,6 +182,24 @@ ICET_EXPORT IceTSizeType icetGetInterlaceOffset(
                                               IceTInt eventual_num_partitions,
                                               IceTSizeType original_image_size);
 
+/* With ICET_BLOCK_TILED_IMAGES enabled, the single image strategies work on
+   images whose pixels are in block order rather than scanline order.  The
+   image is divided into ICET_IMAGE_BLOCK_SIZE square blocks (smaller at the
+   right and top edges) taken a row of blocks at a time, and the pixels of
+   each block are in scanline order.  Splitting and interlacing work on this
+   order unchanged, so the pieces are compact groups of blocks instead of
+   strips of scanlines, and empty blocks merge into single run lengths.
+   icetSparseImageTileBlocks copies a sparse image in scanline order to
+   out_image in block order.  icetImageUntileBlocks puts the pixels of a
+   (non-sparse) image in block order back in scanline order, using
+   scratch_state_buffer for a copy of the pixels. */
+#define ICET_IMAGE_BLOCK_SIZE   16
+
+ICET_EXPORT void icetSparseImageTileBlocks(const IceTSparseImage in_image,
+                                           IceTSparseImage out_image);
+ICET_EXPORT void icetImageUntileBlocks(IceTImage image,
+                                       IceTEnum scratch_state_buffer);
+
 ICET_EXPORT void icetClearImage(IceTImage image);
 ICET_EXPORT void icetClearSparseImage(IceTSparseImage image);
 
@@ -192,9 +250,49 @@ ICET_EXPORT void icetCompressedCompressedComposite(
                                              const IceTSparseImage back_buffer,
                                              IceTSparseImage dest_buffer);
 
+/* Composites num_images sparse images, with images[0] in front, into
+   dest_buffer in a single pass over all their run lengths, so the output is
+   written once rather than once per pair of images.  dest_buffer must not be
+   one of the images.  The result is the same as compositing the images in
+   pairs, except for rounding in the blend and additive modes. */
+ICET_EXPORT void icetCompressedCompressedCompositeImages(
+                                                const IceTSparseImage *images,
+                                                IceTInt num_images,
+                                                IceTSparseImage dest_buffer);
+
+/* Dense pixels packed with each pixel's color followed by its depth, padded
+   so that every pixel is aligned.  Without depth, packed pixels are laid
+   out like the color buffer.  They can be combined in any grouping with
+   icetImageReducePackedPixels, which only supports the order independent
+   ICET_COMPOSITE_MODE_ADD, ICET_COMPOSITE_MODE_MAX, and
+   ICET_COMPOSITE_MODE_MIN. */
+ICET_EXPORT IceTSizeType icetImagePackedPixelSize(IceTEnum color_format,
+                                                  IceTEnum depth_format);
+ICET_EXPORT void icetImagePackPixels(const IceTImage image,
+                                     IceTSizeType offset,
+                                     IceTSizeType num_pixels,
+                                     IceTVoid *buffer);
+ICET_EXPORT void icetImageUnpackPixels(const IceTVoid *buffer,
+                                       IceTImage image,
+                                       IceTSizeType offset,
+                                       IceTSizeType num_pixels);
+ICET_EXPORT void icetImageReducePackedPixels(IceTEnum composite_mode,
+                                             IceTEnum color_format,
+                                             IceTEnum depth_format,
+                                             const IceTVoid *src,
+                                             IceTVoid *dest,
+                                             IceTSizeType num_pixels);
+
 ICET_EXPORT void icetImageCorrectBackground(IceTImage image);
 ICET_EXPORT void icetClearImageTrueBackground(IceTImage image);
 
+/* Converts an image in one of the accumulation formats to color_format in
+   the ICET_ACCUMULATION_RESULT_BUF state buffer.  Inactive pixels are set to
+   the background color (the true background color if background correction
+   is needed). */
+ICET_EXPORT IceTImage icetImageFinishAccumulation(const IceTImage image,
+                                                  IceTEnum color_format);
+
 #define ICET_BLEND_UBYTE(front, back, dest)                             \
 {                                                                       \
     IceTUInt afactor = 255 - (front)[3];                                \
@@ -219,6 +317,30 @@ ICET_EXPORT void icetClearImageTrueBackground(IceTImage image);
 #define ICET_OVER_FLOAT(src, dest)  ICET_BLEND_FLOAT(src, dest, dest)
 #define ICET_UNDER_FLOAT(src, dest) ICET_BLEND_FLOAT(dest, src, dest)
 
+#define ICET_ADD_CLAMP_UBYTE(x) ((IceTUByte)((x) < 255 ? (x) : 255))
+
+/* Additive compositing.  Unlike blending, the operation is commutative, so
+   there is no distinction between front and back.  Byte values saturate. */
+#define ICET_ADD_UBYTE(src1, src2, dest)                                \
+{                                                                       \
+    IceTUInt sum0 = (IceTUInt)(src1)[0] + (IceTUInt)(src2)[0];          \
+    IceTUInt sum1 = (IceTUInt)(src1)[1] + (IceTUInt)(src2)[1];          \
+    IceTUInt sum2 = (IceTUInt)(src1)[2] + (IceTUInt)(src2)[2];          \
+    IceTUInt sum3 = (IceTUInt)(src1)[3] + (IceTUInt)(src2)[3];          \
+    (dest)[0] = ICET_ADD_CLAMP_UBYTE(sum0);                             \
+    (dest)[1] = ICET_ADD_CLAMP_UBYTE(sum1);                             \
+    (dest)[2] = ICET_ADD_CLAMP_UBYTE(sum2);                             \
+    (dest)[3] = ICET_ADD_CLAMP_UBYTE(sum3);                             \
+}
+
+#define ICET_ADD_FLOAT(src1, src2, dest)                                \
+{                                                                       \
+    (dest)[0] = (src1)[0] + (src2)[0];                                  \
+    (dest)[1] = (src1)[1] + (src2)[1];                                  \
+    (dest)[2] = (src1)[2] + (src2)[2];                                  \
+    (dest)[3] = (src1)[3] + (src2)[3];                                  \
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,10 +19,48 @@ extern "C" {
 }
 #endif
 
+/* Declares a variable with static storage that each thread keeps its own copy
+   of.  IceT keeps the current context and a few other globals this way so
+   that threads of one process can each act as an IceT process (see
+   IceTThreads.h).  Without thread support this is an ordinary static. */
+#ifdef ICET_USE_PTHREADS
+#ifdef _MSC_VER
+#define ICET_THREAD_LOCAL       static __declspec(thread)
+#else
+#define ICET_THREAD_LOCAL       static __thread
+#endif
+#else /*ICET_USE_PTHREADS*/
+#define ICET_THREAD_LOCAL       static
+#endif /*ICET_USE_PTHREADS*/
+
 /* Returns the size of the type given by the identifier (ICET_INT, ICET_FLOAT,
    etc.)  in bytes. */
 ICET_EXPORT IceTInt icetTypeWidth(IceTEnum type);
 
+/* Function called by icetParallelFor for each index. */
+typedef void (*IceTParallelForFunction)(IceTInt index, IceTVoid *data);
+
+/* Calls func(index, data) for every index in [0, count) using up to
+   num_threads threads (the calling thread being one of them) and returns once
+   all the calls finish.  If IceT was built without thread support, the calls
+   are simply made in order.  The other threads are workers kept by the
+   current context (see icetDestroyThreadPool), so only the first call that
+   needs a given number of them pays to start threads.  They share the current
+   context of the calling thread, but the function must not modify the IceT
+   state (including raising diagnostics or recording timing), which is not
+   thread safe. */
+ICET_EXPORT void icetParallelFor(IceTInt num_threads,
+                                 IceTInt count,
+                                 IceTParallelForFunction func,
+                                 IceTVoid *data);
+
+/* The worker threads of icetParallelFor for one context. */
+typedef struct IceTThreadPoolStruct *IceTThreadPool;
+
+/* Stops and joins the workers of the pool.  Called when the context that
+   owns it is destroyed.  Does nothing if pool is NULL. */
+ICET_EXPORT void icetDestroyThreadPool(IceTThreadPool pool);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,143 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2011 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTDevSIMD_h
+#define __IceTDevSIMD_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* Instruction set levels for the dense compositing kernels.  Each level
+   implies all those below it. */
+#define ICET_SIMD_LEVEL_SCALAR  0
+#define ICET_SIMD_LEVEL_SSE2    1
+#define ICET_SIMD_LEVEL_AVX2    2
+#define ICET_SIMD_LEVEL_AVX512  3
+
+/* Returns the instruction set level used by the kernels below.  Unless
+   changed with icetSIMDSetLevel, this is the highest level supported by the
+   processor (and the build). */
+ICET_EXPORT IceTInt icetSIMDGetLevel(void);
+
+/* Restricts the kernels to the given level or lower.  Levels above what the
+   processor supports are clamped.  Mostly useful for testing and timing.
+   The level is shared by all threads, so do not change it while any of them
+   is compositing. */
+ICET_EXPORT void icetSIMDSetLevel(IceTInt level);
+
+/* Z-buffer composite of num_pixels pixels.  Wherever the source depth is
+   less than the destination depth, the source color and depth replace the
+   destination. */
+ICET_EXPORT void icetSIMDZBufferUByte(const IceTUInt *src_color,
+                                      const IceTFloat *src_depth,
+                                      IceTUInt *dest_color,
+                                      IceTFloat *dest_depth,
+                                      IceTSizeType num_pixels);
+ICET_EXPORT void icetSIMDZBufferFloat(const IceTFloat *src_color,
+                                      const IceTFloat *src_depth,
+                                      IceTFloat *dest_color,
+                                      IceTFloat *dest_depth,
+                                      IceTSizeType num_pixels);
+ICET_EXPORT void icetSIMDZBufferDepth(const IceTFloat *src_depth,
+                                      IceTFloat *dest_depth,
+                                      IceTSizeType num_pixels);
+
+/* Applies ICET_BLEND_UBYTE/ICET_BLEND_FLOAT to num_pixels RGBA pixels.  The
+   results are bit for bit the same as the macros.  dest may be the same
+   buffer as front or back. */
+ICET_EXPORT void icetSIMDBlendUByte(const IceTUByte *front,
+                                    const IceTUByte *back,
+                                    IceTUByte *dest,
+                                    IceTSizeType num_pixels);
+ICET_EXPORT void icetSIMDBlendFloat(const IceTFloat *front,
+                                    const IceTFloat *back,
+                                    IceTFloat *dest,
+                                    IceTSizeType num_pixels);
+
+/* Conversion of count values between IEEE half precision (stored in an
+   IceTUShort) and float.  Halves are rounded to the nearest even value.  With
+   AVX2 (and F16C) these use the hardware conversions. */
+ICET_EXPORT void icetSIMDHalfToFloat(const IceTUShort *src,
+                                     IceTFloat *dest,
+                                     IceTSizeType count);
+ICET_EXPORT void icetSIMDFloatToHalf(const IceTFloat *src,
+                                     IceTUShort *dest,
+                                     IceTSizeType count);
+
+/* Applies ICET_BLEND_FLOAT/ICET_ADD_FLOAT to num_pixels RGBA half precision
+   pixels, converting to float and rounding the result back to half.  dest
+   may be the same buffer as either input. */
+ICET_EXPORT void icetSIMDBlendHalf(const IceTUShort *front,
+                                   const IceTUShort *back,
+                                   IceTUShort *dest,
+                                   IceTSizeType num_pixels);
+ICET_EXPORT void icetSIMDAddHalf(const IceTUShort *src1,
+                                 const IceTUShort *src2,
+                                 IceTUShort *dest,
+                                 IceTSizeType num_pixels);
+
+/* Scan for the end of a run of pixels for the image compressor.  Each
+   function returns how many of the first num_pixels pixels have the given
+   activity (ICET_TRUE for active, ICET_FALSE for inactive), stopping at the
+   first one that does not.  The tests are the same as the compressor uses:
+   depth less than 1, nonzero alpha, or (for additive compositing without
+   depth) any nonzero channel. */
+ICET_EXPORT IceTSizeType icetSIMDCountDepthRun(const IceTFloat *depth,
+                                               IceTSizeType num_pixels,
+                                               IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaUByteRun(const IceTUInt *color,
+                                                    IceTSizeType num_pixels,
+                                                    IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaFloatRun(const IceTFloat *color,
+                                                    IceTSizeType num_pixels,
+                                                    IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountColorUByteRun(const IceTUInt *color,
+                                                    IceTSizeType num_pixels,
+                                                    IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountColorFloatRun(const IceTFloat *color,
+                                                    IceTSizeType num_pixels,
+                                                    IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaHalfRun(const IceTUShort *color,
+                                                   IceTSizeType num_pixels,
+                                                   IceTBoolean active);
+ICET_EXPORT IceTSizeType icetSIMDCountColorHalfRun(const IceTUShort *color,
+                                                   IceTSizeType num_pixels,
+                                                   IceTBoolean active);
+
+/* Like icetSIMDCountAlpha*Run, but pixels are only active if their alpha is
+   at least min_alpha, which must be greater than zero.  These implement
+   ICET_BLEND_ALPHA_CUTOFF.  Unsigned byte alphas are compared as integers
+   from 0 to 255 (so min_alpha may be 256 to make every pixel inactive). */
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaCutoffUByteRun(
+                                                      const IceTUInt *color,
+                                                      IceTSizeType num_pixels,
+                                                      IceTBoolean active,
+                                                      IceTUInt min_alpha);
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaCutoffFloatRun(
+                                                      const IceTFloat *color,
+                                                      IceTSizeType num_pixels,
+                                                      IceTBoolean active,
+                                                      IceTFloat min_alpha);
+ICET_EXPORT IceTSizeType icetSIMDCountAlphaCutoffHalfRun(
+                                                      const IceTUShort *color,
+                                                      IceTSizeType num_pixels,
+                                                      IceTBoolean active,
+                                                      IceTFloat min_alpha);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IceTDevSIMD_h */
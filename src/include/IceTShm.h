@@ -0,0 +1,64 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2010 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTShm_h
+#define __IceTShm_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* The shared memory communicator passes messages between processes on the
+   same node through a POSIX shared memory segment (shm_open and mmap).  A
+   sender copies its data into the segment and hands the receiver the
+   offset of the data, which the receiver copies out.  This is the same two
+   copies that MPI makes between processes on a node, so it is no faster
+   per byte.  It skips the message passing library and works for processes
+   that are not MPI processes.
+
+   If a process dies, the processes waiting on it raise an error and give
+   up on their messages instead of waiting forever.  After that, nothing
+   more moves through the segment.
+
+   The name identifies the segment (for example "/icet_run42").  It must
+   start with a slash, contain no other slashes, and not be in use by any
+   other communicator.  The name is removed as soon as all the processes have
+   attached, so nothing is left behind once they exit. */
+
+/* Makes a communicator among size processes that all run on this node, such
+   as processes made with fork.  Every process calls this with its own rank.
+   The call returns once all the processes have attached to the segment. */
+ICET_SHM_EXPORT IceTCommunicator icetCreateShmCommunicator(const char *name,
+                                                           int size,
+                                                           int rank);
+
+/* Makes a communicator with the same ranks as world in which the processes
+   that give the same node_id share a segment.  Messages to processes with
+   other node ids go through (a duplicate of) world, so world is typically an
+   MPI communicator and node_id identifies the machine (for example, the
+   color given by MPI_Comm_split_type with MPI_COMM_TYPE_SHARED).  This is a
+   collective operation over world.  The segment for each node is named by
+   name followed by the smallest world rank on the node. */
+ICET_SHM_EXPORT IceTCommunicator icetCreateShmHybridCommunicator(
+                                                        IceTCommunicator world,
+                                                        int node_id,
+                                                        const char *name);
+
+ICET_SHM_EXPORT void icetDestroyShmCommunicator(IceTCommunicator comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*__IceTShm_h*/
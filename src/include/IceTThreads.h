@@ -0,0 +1,55 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2010 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTThreads_h
+#define __IceTThreads_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* The threads communicator runs each IceT process as a thread of a single
+   process.  Messages are handed directly from the buffer of the sender to
+   the buffer of the receiver, so all the cores of one machine can composite
+   with the usual strategies without MPI.
+
+   A world holds the threads that communicate with each other.  Each thread
+   creates the communicator for its own rank in the world and then uses it
+   like any other communicator (for example, with icetCreateContext).  The
+   current context is kept per thread, so each thread has its own.  Every
+   communicator has to be destroyed before the world is. */
+typedef struct IceTThreadsWorldStruct *IceTThreadsWorld;
+
+ICET_THREADS_EXPORT IceTThreadsWorld icetCreateThreadsWorld(int size);
+ICET_THREADS_EXPORT void icetDestroyThreadsWorld(IceTThreadsWorld world);
+
+ICET_THREADS_EXPORT IceTCommunicator icetCreateThreadsCommunicator(
+                                                        IceTThreadsWorld world,
+                                                        int rank);
+ICET_THREADS_EXPORT void icetDestroyThreadsCommunicator(IceTCommunicator comm);
+
+/* Convenience function that makes a world of size threads, calls func in
+   each with the communicator for its rank, and returns once they all
+   finish.  Returns ICET_FALSE (without calling func) if the threads could
+   not be started. */
+typedef void (*IceTThreadsFunction)(IceTCommunicator comm, IceTVoid *data);
+ICET_THREADS_EXPORT IceTBoolean icetThreadsRun(int size,
+                                               IceTThreadsFunction func,
+                                               IceTVoid *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*__IceTThreads_h*/
@@ -115,9 +115,11 @@ static void bswapCollectFinalImages(const IceTInt *compose_group,
 
             if (receive_from_src) {
                 requests[i] =
-                    icetCommIrecv(colorBuffer + pixel_size*offset,
-                                  pixel_size*pixel_count, ICET_BYTE,
-                                  compose_group[src], SWAP_IMAGE_DATA);
+                    icetCommPersistentIrecv(colorBuffer + pixel_size*offset,
+                                            pixel_size*pixel_count,
+                                            ICET_BYTE,
+                                            compose_group[src],
+                                            SWAP_IMAGE_DATA);
             } else {
                 requests[i] = ICET_COMM_REQUEST_NULL;
             }
@@ -147,9 +149,11 @@ static void bswapCollectFinalImages(const IceTInt *compose_group,
 
             if (receive_from_src) {
                 requests[i] =
-                    icetCommIrecv(depthBuffer + pixel_size*offset,
-                                  pixel_size*pixel_count, ICET_BYTE,
-                                  compose_group[src], SWAP_DEPTH_DATA);
+                    icetCommPersistentIrecv(depthBuffer + pixel_size*offset,
+                                            pixel_size*pixel_count,
+                                            ICET_BYTE,
+                                            compose_group[src],
+                                            SWAP_DEPTH_DATA);
             } else {
                 requests[i] = ICET_COMM_REQUEST_NULL;
             }
@@ -377,7 +381,7 @@ static void bswapComposePow2(const IceTInt *compose_group,
 
     for (bitmask = 0x0001; bitmask < group_size; bitmask <<= 1) {
         IceTSparseImage outgoing_images[2];
-        IceTInt outgoing_offsets[2];
+        IceTSizeType outgoing_offsets[2];
 
         IceTInt pair;
         IceTInt inOnTop;
@@ -12,6 +12,7 @@
 #include <IceT.h>
 #include <IceTDevCommunication.h>
 #include <IceTDevDiagnostics.h>
+#include <IceTDevPorting.h>
 #include <IceTDevState.h>
 #include <IceTDevStrategySelect.h>
 #include <IceTDevTiming.h>
@@ -23,9 +24,9 @@
 
 #define LARGE_MESSAGE 23
 
-static IceTImage rtfi_image;
-static IceTSparseImage rtfi_outSparseImage;
-static IceTBoolean rtfi_first;
+ICET_THREAD_LOCAL IceTImage rtfi_image;
+ICET_THREAD_LOCAL IceTSparseImage rtfi_outSparseImage;
+ICET_THREAD_LOCAL IceTBoolean rtfi_first;
 static IceTVoid *rtfi_generateDataFunc(IceTInt id, IceTInt dest,
                                        IceTSizeType *size) {
     IceTInt rank;
@@ -109,10 +110,10 @@ void icetRenderTransferFullImages(IceTImage image,
     free(imageDestinations);
 }
 
-static IceTSparseImage rtsi_workingImage;
-static IceTSparseImage rtsi_availableImage;
-static IceTSparseImage rtsi_outSparseImage;
-static IceTBoolean rtsi_first;
+ICET_THREAD_LOCAL IceTSparseImage rtsi_workingImage;
+ICET_THREAD_LOCAL IceTSparseImage rtsi_availableImage;
+ICET_THREAD_LOCAL IceTSparseImage rtsi_outSparseImage;
+ICET_THREAD_LOCAL IceTBoolean rtsi_first;
 static IceTVoid *rtsi_generateDataFunc(IceTInt id, IceTInt dest,
                                        IceTSizeType *size) {
     IceTInt rank;
@@ -554,7 +555,7 @@ static void icetDoSendRecvLarge(const IceTInt *sendIds,
                 if (messagesInOrder) {
                     src_rank = composite_order[recv_order_idx];
                 } else {
-                    src_rank = recv_iter_state;
+                    src_rank = recv_order_idx;
                 }
                 (*handleDataFunc)(incomingBuffer, src_rank);
             }
@@ -599,6 +600,17 @@ void icetSingleImageCompose(const IceTInt *compose_group,
 {
     IceTEnum strategy;
 
+    /* The pieces are only put back in scanline order when collected. */
+    if (   icetIsEnabled(ICET_BLOCK_TILED_IMAGES)
+        && icetIsEnabled(ICET_COLLECT_IMAGES) ) {
+        IceTSparseImage tiled_image = icetGetStateBufferSparseImage(
+                                         ICET_BLOCK_TILE_BUF,
+                                         icetSparseImageGetWidth(input_image),
+                                         icetSparseImageGetHeight(input_image));
+        icetSparseImageTileBlocks(input_image, tiled_image);
+        input_image = tiled_image;
+    }
+
     icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &strategy);
     icetInvokeSingleImageStrategy(strategy,
                                   compose_group,
@@ -629,8 +641,11 @@ void icetSingleImageCollect(const IceTSparseImage input_image,
     IceTSizeType color_size = 1;
     IceTSizeType depth_size = 1;
 
-#define DUMMY_BUFFER_SIZE       ((IceTSizeType)(16*sizeof(IceTInt)))
-    IceTByte dummy_buffer[DUMMY_BUFFER_SIZE];
+    /* Sized from the image header so it holds an image with no pixels, and
+       declared as IceTSizeType to keep the header entries aligned. */
+#define DUMMY_BUFFER_SIZE       ICET_IMAGE_HEADER_SIZE
+    IceTSizeType dummy_buffer[  (DUMMY_BUFFER_SIZE + sizeof(IceTSizeType) - 1)
+                              / sizeof(IceTSizeType)];
 
     rank = icetCommRank();
     numproc = icetCommSize();
@@ -681,7 +696,7 @@ void icetSingleImageCollect(const IceTSparseImage input_image,
            prevent making the calling function allocate an image buffer when it
            is neither sending or receiving data, just allocate a dummy buffer to
            satisfy the following code. */
-        if (DUMMY_BUFFER_SIZE < icetImageBufferSize(0, 0)) {
+        if ((IceTSizeType)sizeof(dummy_buffer) < icetImageBufferSize(0, 0)) {
             icetRaiseError("Oops.  My dummy buffer is not big enough.",
                            ICET_SANITY_CHECK_FAIL);
             return;
@@ -768,4 +783,8 @@ void icetSingleImageCollect(const IceTSparseImage input_image,
     }
 
     icetTimingCollectEnd();
+
+    if ((rank == dest) && icetIsEnabled(ICET_BLOCK_TILED_IMAGES)) {
+        icetImageUntileBlocks(result_image, ICET_BLOCK_UNTILE_BUF);
+    }
 }
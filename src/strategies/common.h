@@ -135,7 +135,10 @@ void icetSendRecvLargeMessages(IceTInt numMessagesSending,
    on, the images will be composited in the order determined by ranks in
    compose_group with the first process on top.  The resulting image is left
    partitioned amongst processes.  Use icetSingleImageCollect to combine the
-   images.
+   images.  If ICET_BLOCK_TILED_IMAGES and ICET_COLLECT_IMAGES are enabled,
+   the input is put in block order (see icetSparseImageTileBlocks) first, so
+   the pieces hold groups of blocks that icetSingleImageCollect puts back in
+   scanline order.
 
    compose_group - A mapping of processors from the MPI ranks to the "group"
         ranks.  The composed image ends up in the processor with rank
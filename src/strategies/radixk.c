@@ -46,6 +46,8 @@
 #define RADIXK_SPLIT_OFFSET_ARRAY_BUFFER        ICET_SI_STRATEGY_BUFFER_8
 #define RADIXK_SPLIT_IMAGE_ARRAY_BUFFER         ICET_SI_STRATEGY_BUFFER_9
 #define RADIXK_RANK_LIST_BUFFER                 ICET_SI_STRATEGY_BUFFER_10
+#define RADIXK_INCOMING_IMAGE_ARRAY_BUFFER      ICET_SI_STRATEGY_BUFFER_11
+#define RADIXK_ARRIVED_INDEX_BUFFER             ICET_SI_STRATEGY_BUFFER_12
 
 typedef struct radixkRoundInfoStruct {
     IceTInt k; /* k value for this round. */
@@ -66,7 +68,6 @@ typedef struct radixkPartnerInfoStruct {
     IceTVoid *receiveBuffer; /* A buffer for receiving data from partner. */
     IceTSparseImage sendImage; /* A buffer to hold data being sent to partner */
     IceTSparseImage receiveImage; /* Hold for received non-composited image. */
-    IceTInt compositeLevel; /* Level in compositing tree for round. */
 } radixkPartnerInfo;
 
 /* BEGIN_PIVOT_FOR(loop_var, low, pivot, high)...END_PIVOT_FOR() provides a
@@ -112,13 +113,6 @@ static IceTInt radixkFindFloorPow2(IceTInt x)
     return lg;
 }
 
-static void radixkSwapImages(IceTSparseImage *image1, IceTSparseImage *image2)
-{
-    IceTSparseImage old_image1 = *image1;
-    *image1 = *image2;
-    *image2 = old_image1;
-}
-
 /* radixkGetPartitionIndices
 
    my position in each round forms an num_rounds-dimensional vector
@@ -488,7 +482,6 @@ static radixkPartnerInfo *radixkGetPartners(const radixkRoundInfo *round_info,
 
         p->receiveImage = icetSparseImageNull();
 
-        p->compositeLevel = -1;
     }
 
     return partners;
@@ -529,12 +522,11 @@ static IceTCommRequest *radixkPostReceives(radixkPartnerInfo *partners,
     for (i = 0; i < round_info->k; i++) {
         radixkPartnerInfo *p = &partners[i];
         if (i != round_info->partition_index) {
-            receive_requests[i] = icetCommIrecv(p->receiveBuffer,
-                                                sparse_image_size,
-                                                ICET_BYTE,
-                                                p->rank,
-                                                tag);
-            p->compositeLevel = -1;
+            receive_requests[i] = icetCommPersistentIrecv(p->receiveBuffer,
+                                                          sparse_image_size,
+                                                          ICET_BYTE,
+                                                          p->rank,
+                                                          tag);
         } else {
             /* No need to send to myself. */
             receive_requests[i] = ICET_COMM_REQUEST_NULL;
@@ -554,7 +546,7 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
                                         const IceTSparseImage image)
 {
     IceTCommRequest *send_requests;
-    IceTInt *piece_offsets;
+    IceTSizeType *piece_offsets;
     IceTSparseImage *image_pieces;
     IceTInt tag;
     IceTInt i;
@@ -565,8 +557,9 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
         send_requests=icetGetStateBuffer(RADIXK_SEND_REQUEST_BUFFER,
                                          round_info->k*sizeof(IceTCommRequest));
 
-        piece_offsets = icetGetStateBuffer(RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
-                                           round_info->k * sizeof(IceTInt));
+        piece_offsets = icetGetStateBuffer(
+                                       RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
+                                       round_info->k * sizeof(IceTSizeType));
         image_pieces =icetGetStateBuffer(RADIXK_SPLIT_IMAGE_ARRAY_BUFFER,
                                          round_info->k*sizeof(IceTSparseImage));
         for (i = 0; i < round_info->k; i++) {
@@ -594,16 +587,15 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
                 icetSparseImagePackageForSend(image_pieces[i],
                                               &package_buffer, &package_size);
 
-                send_requests[i] = icetCommIsend(package_buffer,
-                                                 package_size,
-                                                 ICET_BYTE,
-                                                 p->rank,
-                                                 tag);
+                send_requests[i] = icetCommPersistentIsend(package_buffer,
+                                                           package_size,
+                                                           ICET_BYTE,
+                                                           p->rank,
+                                                           tag);
             } else {
                 /* Implicitly send to myself. */
                 send_requests[i] = ICET_COMM_REQUEST_NULL;
                 p->receiveImage = p->sendImage;
-                p->compositeLevel = 0;
             }
         } END_PIVOT_FOR();
     } else { /* !round_info->split */
@@ -614,7 +606,6 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
             send_requests[0] = ICET_COMM_REQUEST_NULL;
             p->receiveImage = p->sendImage = image;
             p->offset = start_offset;
-            p->compositeLevel = 0;
         } else {
             IceTVoid *package_buffer;
             IceTSizeType package_size;
@@ -622,11 +613,11 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
 
             icetSparseImagePackageForSend(image,&package_buffer,&package_size);
 
-            send_requests[0] = icetCommIsend(package_buffer,
-                                             package_size,
-                                             ICET_BYTE,
-                                             recv_rank,
-                                             tag);
+            send_requests[0] = icetCommPersistentIsend(package_buffer,
+                                                       package_size,
+                                                       ICET_BYTE,
+                                                       recv_rank,
+                                                       tag);
 
             p->offset = 0;
         }
@@ -635,76 +626,6 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
     return send_requests;
 }
 
-/* When compositing incoming images, we pair up the images and composite in
-   a tree.  This minimizes the amount of times non-overlapping pixels need
-   to be copied.  Returns true when all images are composited */
-static IceTBoolean radixkTryCompositeIncoming(radixkPartnerInfo *partners,
-                                              const radixkRoundInfo *round_info,
-                                              IceTInt incoming_index,
-                                              IceTSparseImage *spare_image_p,
-                                              IceTSparseImage final_image)
-{
-    const IceTInt current_k = round_info->k;
-    IceTSparseImage spare_image = *spare_image_p;
-    IceTInt to_composite_index = incoming_index;
-
-    while (ICET_TRUE) {
-        IceTInt level = partners[to_composite_index].compositeLevel;
-        IceTInt dist_to_sibling = (1 << level);
-        IceTInt subtree_size = (dist_to_sibling << 1);
-        IceTInt front_index;
-        IceTInt back_index;
-
-        if (to_composite_index%subtree_size == 0) {
-            front_index = to_composite_index;
-            back_index = to_composite_index + dist_to_sibling;
-
-            if (back_index >= current_k) {
-                /* This image has no partner at this level.  Just promote
-                   the level and continue. */
-                if (front_index == 0) {
-                    /* Special case.  When index 0 has no partner, we must
-                       be at the top of the tree and we are done. */
-                    break;
-                }
-                partners[to_composite_index].compositeLevel++;
-                continue;
-            }
-        } else {
-            back_index = to_composite_index;
-            front_index = to_composite_index - dist_to_sibling;
-        }
-
-        if (   partners[front_index].compositeLevel
-            != partners[back_index].compositeLevel ) {
-            /* Paired images are not on the same level.  Cannot composite
-               until more images come in.  We are done for now. */
-            break;
-        }
-
-        if ((front_index == 0) && (subtree_size >= current_k)) {
-            /* This will be the last image composited.  Composite to final
-               location. */
-            spare_image = final_image;
-        }
-        icetCompressedCompressedComposite(partners[front_index].receiveImage,
-                                          partners[back_index].receiveImage,
-                                          spare_image);
-        radixkSwapImages(&partners[front_index].receiveImage, &spare_image);
-        if (icetSparseImageEqual(spare_image, final_image)) {
-            /* Special case, front image was sharing buffer with final.
-               Use back image for next spare. */
-            spare_image = partners[back_index].receiveImage;
-            partners[back_index].receiveImage = icetSparseImageNull();
-        }
-        partners[front_index].compositeLevel++;
-        to_composite_index = front_index;
-    }
-
-    *spare_image_p = spare_image;
-    return ((1 << partners[0].compositeLevel) >= current_k);
-}
-
 static void radixkCompositeIncomingImages(radixkPartnerInfo *partners,
                                           IceTCommRequest *receive_requests,
                                           const radixkRoundInfo *round_info,
@@ -712,41 +633,29 @@ static void radixkCompositeIncomingImages(radixkPartnerInfo *partners,
 {
     radixkPartnerInfo *me = &partners[round_info->partition_index];
 
-    IceTSparseImage spare_image;
-    IceTInt total_composites;
+    IceTSparseImage *incoming_images;
+    int *arrived;
+    IceTInt num_received;
+    IceTInt i;
 
     IceTSizeType width;
     IceTSizeType height;
 
-    IceTBoolean composites_done;
-
     /* If not receiving an image, return right away. */
     if ((!round_info->split) && (!round_info->has_image)) {
         return;
     }
 
-    /* Regardless of order, there are k-1 composite operations to perform. */
-    total_composites = round_info->k - 1;
-
-    /* We will be reusing buffers like crazy, but we'll need at least one more
-       for the first composite, assuming we have at least two composites. */
     width = icetSparseImageGetWidth(me->receiveImage);
     height = icetSparseImageGetHeight(me->receiveImage);
-    if (total_composites >= 2) {
-        spare_image = icetGetStateBufferSparseImage(RADIXK_SPARE_BUFFER,
-                                                    width,
-                                                    height);
-    } else {
-        spare_image = icetSparseImageNull();
-    }
 
-    /* Grumble.  Stupid special case where there is only one composite and we
-       want the result to go in the same image as my receive image (which can
-       happen when not splitting). */
-    if (icetSparseImageEqual(me->receiveImage,image) && (total_composites < 2)){
-        spare_image = icetGetStateBufferSparseImage(RADIXK_SPARE_BUFFER,
-                                                    width,
-                                                    height);
+    /* The result is written to image, so it cannot also be one of the inputs
+       (which can happen when not splitting). */
+    if (icetSparseImageEqual(me->receiveImage, image)) {
+        IceTSparseImage spare_image
+            = icetGetStateBufferSparseImage(RADIXK_SPARE_BUFFER,
+                                            width,
+                                            height);
         icetSparseImageCopyPixels(me->receiveImage,
                                   0,
                                   width*height,
@@ -754,38 +663,47 @@ static void radixkCompositeIncomingImages(radixkPartnerInfo *partners,
         me->receiveImage = spare_image;
     }
 
-    /* Start by trying to composite the implicit receive from myself.  It won't
-       actually composite anything, but it may change the composite level.  It
-       will also defensively set composites_done correctly. */
-    composites_done = radixkTryCompositeIncoming(partners,
-                                                 round_info,
-                                                 round_info->partition_index,
-                                                 &spare_image,
-                                                 image);
-
-    while (!composites_done) {
-        IceTInt receive_idx;
-        radixkPartnerInfo *receiver;
-
-        /* Wait for an image to come in. */
-        receive_idx = icetCommWaitany(round_info->k, receive_requests);
-        receiver = &partners[receive_idx];
-        receiver->compositeLevel = 0;
-        receiver->receiveImage
-            = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
-        if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
-            || (icetSparseImageGetHeight(receiver->receiveImage) != height) ) {
-            icetRaiseError("Radix-k received image with wrong size.",
+    /* Wait for all the images to come in.  Rather than compositing pairs in
+       a tree, which rewrites the whole partition at every level, all k
+       images are merged in one pass once they have arrived.  Each wait
+       picks up every image that has arrived since the last one. */
+    arrived = icetGetStateBuffer(RADIXK_ARRIVED_INDEX_BUFFER,
+                                 sizeof(int)*round_info->k);
+    num_received = 1;
+    while (num_received < round_info->k) {
+        int num_arrived;
+
+        num_arrived = icetCommWaitsome(round_info->k,
+                                       receive_requests,
+                                       arrived);
+        if (num_arrived < 1) {
+            icetRaiseError("Radix-k lost track of incoming images.",
                            ICET_SANITY_CHECK_FAIL);
+            break;
         }
+        for (i = 0; i < num_arrived; i++) {
+            radixkPartnerInfo *receiver = &partners[arrived[i]];
+            receiver->receiveImage
+                = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
+            if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
+                || (icetSparseImageGetHeight(receiver->receiveImage)
+                    != height) ) {
+                icetRaiseError("Radix-k received image with wrong size.",
+                               ICET_SANITY_CHECK_FAIL);
+            }
+        }
+        num_received += num_arrived;
+    }
 
-        /* Try to composite that image. */
-        composites_done = radixkTryCompositeIncoming(partners,
-                                                     round_info,
-                                                     receive_idx,
-                                                     &spare_image,
-                                                     image);
+    incoming_images
+        = icetGetStateBuffer(RADIXK_INCOMING_IMAGE_ARRAY_BUFFER,
+                             sizeof(IceTSparseImage)*round_info->k);
+    for (i = 0; i < round_info->k; i++) {
+        incoming_images[i] = partners[i].receiveImage;
     }
+    icetCompressedCompressedCompositeImages(incoming_images,
+                                            round_info->k,
+                                            image);
 }
 
 static void icetRadixkBasicCompose(const radixkInfo *info,
@@ -1077,7 +995,7 @@ static void icetRadixkTelescopeComposeSend(const IceTInt *lower_group,
         IceTSizeType partition_num_pixels;
         IceTSizeType sparse_image_size;
         IceTVoid *send_buf_pool;
-        IceTInt *piece_offsets;
+        IceTSizeType *piece_offsets;
         IceTSparseImage *image_pieces;
         IceTInt receiver_idx;
         IceTInt num_local_partitions;
@@ -1121,8 +1039,9 @@ static void icetRadixkTelescopeComposeSend(const IceTInt *lower_group,
         send_buf_pool = icetGetStateBuffer(RADIXK_SEND_BUFFER,
                                            sparse_image_size * num_receivers);
 
-        piece_offsets = icetGetStateBuffer(RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
-                                           num_receivers * sizeof(IceTInt));
+        piece_offsets = icetGetStateBuffer(
+                                       RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
+                                       num_receivers * sizeof(IceTSizeType));
         image_pieces = icetGetStateBuffer(
                                        RADIXK_SPLIT_IMAGE_ARRAY_BUFFER,
                                        num_receivers * sizeof(IceTSparseImage));
@@ -45,6 +45,7 @@
 #define RADIXKR_FACTORS_ARRAY_BUFFER             ICET_SI_STRATEGY_BUFFER_7
 #define RADIXKR_SPLIT_OFFSET_ARRAY_BUFFER        ICET_SI_STRATEGY_BUFFER_8
 #define RADIXKR_SPLIT_IMAGE_ARRAY_BUFFER         ICET_SI_STRATEGY_BUFFER_9
+#define RADIXKR_ARRIVED_INDEX_BUFFER             ICET_SI_STRATEGY_BUFFER_10
 
 typedef struct radixkrRoundInfoStruct {
     IceTInt k; /* k value for this round. */
@@ -518,11 +519,11 @@ static IceTCommRequest *radixkrPostReceives(radixkrPartnerGroupInfo p_group,
     for (i = 0; i < p_group.num_partners; i++) {
         radixkrPartnerInfo *p = &p_group.partners[i];
         if (i != round_info->partition_index) {
-            receive_requests[i] = icetCommIrecv(p->receiveBuffer,
-                                                sparse_image_size,
-                                                ICET_BYTE,
-                                                p->rank,
-                                                tag);
+            receive_requests[i] = icetCommPersistentIrecv(p->receiveBuffer,
+                                                          sparse_image_size,
+                                                          ICET_BYTE,
+                                                          p->rank,
+                                                          tag);
             p->compositeLevel = -1;
         } else {
             /* No need to send to myself. */
@@ -543,7 +544,7 @@ static IceTCommRequest *radixkrPostSends(radixkrPartnerGroupInfo p_group,
                                          const IceTSparseImage image)
 {
     IceTCommRequest *send_requests;
-    IceTInt *piece_offsets;
+    IceTSizeType *piece_offsets;
     IceTSparseImage *image_pieces;
     IceTInt tag;
     IceTInt i;
@@ -557,7 +558,7 @@ static IceTCommRequest *radixkrPostSends(radixkrPartnerGroupInfo p_group,
 
         piece_offsets = icetGetStateBuffer(
                     RADIXKR_SPLIT_OFFSET_ARRAY_BUFFER,
-                    round_info->split_factor * sizeof(IceTInt));
+                    round_info->split_factor * sizeof(IceTSizeType));
         image_pieces = icetGetStateBuffer(
                     RADIXKR_SPLIT_IMAGE_ARRAY_BUFFER,
                     round_info->split_factor * sizeof(IceTSparseImage));
@@ -589,11 +590,11 @@ static IceTCommRequest *radixkrPostSends(radixkrPartnerGroupInfo p_group,
                 icetSparseImagePackageForSend(image_pieces[i],
                                               &package_buffer, &package_size);
 
-                send_requests[i] = icetCommIsend(package_buffer,
-                                                 package_size,
-                                                 ICET_BYTE,
-                                                 p->rank,
-                                                 tag);
+                send_requests[i] = icetCommPersistentIsend(package_buffer,
+                                                           package_size,
+                                                           ICET_BYTE,
+                                                           p->rank,
+                                                           tag);
             } else {
                 /* Implicitly send to myself. */
                 send_requests[i] = ICET_COMM_REQUEST_NULL;
@@ -617,11 +618,11 @@ static IceTCommRequest *radixkrPostSends(radixkrPartnerGroupInfo p_group,
 
             icetSparseImagePackageForSend(image,&package_buffer,&package_size);
 
-            send_requests[0] = icetCommIsend(package_buffer,
-                                             package_size,
-                                             ICET_BYTE,
-                                             recv_rank,
-                                             tag);
+            send_requests[0] = icetCommPersistentIsend(package_buffer,
+                                                       package_size,
+                                                       ICET_BYTE,
+                                                       recv_rank,
+                                                       tag);
 
             p->offset = 0;
         }
@@ -712,6 +713,7 @@ static void radixkrCompositeIncomingImages(radixkrPartnerGroupInfo p_group,
 
     IceTSparseImage spare_image;
     IceTInt total_composites;
+    int *arrived;
 
     IceTSizeType width;
     IceTSizeType height;
@@ -761,27 +763,38 @@ static void radixkrCompositeIncomingImages(radixkrPartnerGroupInfo p_group,
                                                   &spare_image,
                                                   image);
 
+    arrived = icetGetStateBuffer(RADIXKR_ARRIVED_INDEX_BUFFER,
+                                 sizeof(int)*num_partners);
     while (!composites_done) {
-        IceTInt receive_idx;
-        radixkrPartnerInfo *receiver;
-
-        /* Wait for an image to come in. */
-        receive_idx = icetCommWaitany(num_partners, receive_requests);
-        receiver = &partners[receive_idx];
-        receiver->compositeLevel = 0;
-        receiver->receiveImage
-            = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
-        if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
-            || (icetSparseImageGetHeight(receiver->receiveImage) != height) ) {
-            icetRaiseError("Radix-kr received image with wrong size.",
+        int num_arrived;
+        int i;
+
+        /* Wait for images to come in, taking all that already have. */
+        num_arrived = icetCommWaitsome(num_partners, receive_requests, arrived);
+        if (num_arrived < 1) {
+            icetRaiseError("Radix-kr lost track of incoming images.",
                            ICET_SANITY_CHECK_FAIL);
+            break;
         }
 
-        /* Try to composite that image. */
-        composites_done = radixkrTryCompositeIncoming(p_group,
-                                                      receive_idx,
-                                                      &spare_image,
-                                                      image);
+        for (i = 0; i < num_arrived; i++) {
+            radixkrPartnerInfo *receiver = &partners[arrived[i]];
+            receiver->compositeLevel = 0;
+            receiver->receiveImage
+                = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
+            if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
+                || (icetSparseImageGetHeight(receiver->receiveImage)
+                    != height) ) {
+                icetRaiseError("Radix-kr received image with wrong size.",
+                               ICET_SANITY_CHECK_FAIL);
+            }
+
+            /* Try to composite that image. */
+            composites_done = radixkrTryCompositeIncoming(p_group,
+                                                          arrived[i],
+                                                          &spare_image,
+                                                          image);
+        }
     }
 }
 
@@ -0,0 +1,171 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2010 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* The reduce-scatter single image strategy composites dense images with one
+ * reduce-scatter of the communicator.  Every process decompresses its image
+ * and the pixels are reduced with the composite operation, leaving each
+ * process with an equal contiguous piece of the result.  This only works
+ * for composite modes that can combine pixels in any order, so the others
+ * are left to the automatic single image strategy.  Because the images
+ * are not compressed, it is best suited to images with few empty pixels. */
+
+#include <IceT.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevContext.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+#include <IceTDevStrategySelect.h>
+#include <IceTDevTiming.h>
+
+#include <string.h>
+
+#define REDUCE_SCATTER_IMAGE_BUFFER             ICET_SI_STRATEGY_BUFFER_0
+#define REDUCE_SCATTER_SEND_BUFFER              ICET_SI_STRATEGY_BUFFER_1
+#define REDUCE_SCATTER_RECEIVE_BUFFER           ICET_SI_STRATEGY_BUFFER_2
+#define REDUCE_SCATTER_PIECE_IMAGE_BUFFER       ICET_SI_STRATEGY_BUFFER_3
+#define REDUCE_SCATTER_RESULT_IMAGE_BUFFER      ICET_SI_STRATEGY_BUFFER_4
+
+typedef struct reduceScatterFormatStruct {
+    IceTEnum composite_mode;
+    IceTEnum color_format;
+    IceTEnum depth_format;
+} reduceScatterFormat;
+
+static void reduceScatterReducePixels(const void *inbuf,
+                                      void *inoutbuf,
+                                      IceTSizeType count,
+                                      void *data)
+{
+    const reduceScatterFormat *format = (const reduceScatterFormat *)data;
+
+    icetTimingBlendBegin();
+    icetImageReducePackedPixels(format->composite_mode,
+                                format->color_format,
+                                format->depth_format,
+                                inbuf,
+                                inoutbuf,
+                                count);
+    icetTimingBlendEnd();
+}
+
+void icetReduceScatterCompose(const IceTInt *compose_group,
+                              IceTInt group_size,
+                              IceTInt image_dest,
+                              IceTSparseImage input_image,
+                              IceTSparseImage *result_image,
+                              IceTSizeType *piece_offset)
+{
+    reduceScatterFormat format;
+    IceTInt group_rank;
+    IceTSizeType num_pixels;
+    IceTSizeType block_pixels;
+    IceTSizeType piece_pixels;
+    IceTSizeType pixel_size;
+    IceTImage full_image;
+    IceTImage piece_image;
+    IceTVoid *send_buffer;
+    IceTVoid *receive_buffer;
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &format.composite_mode);
+    format.color_format = icetSparseImageGetColorFormat(input_image);
+    format.depth_format = icetSparseImageGetDepthFormat(input_image);
+
+    if (   (   (format.composite_mode != ICET_COMPOSITE_MODE_ADD)
+            && (format.composite_mode != ICET_COMPOSITE_MODE_MAX)
+            && (format.composite_mode != ICET_COMPOSITE_MODE_MIN) )
+        || (icetGetCommunicator()->ReduceScatterBlock == NULL) ) {
+        icetRaiseDebug("Cannot reduce-scatter, doing automatic compose");
+        icetInvokeSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_AUTOMATIC,
+                                      compose_group,
+                                      group_size,
+                                      image_dest,
+                                      input_image,
+                                      result_image,
+                                      piece_offset);
+        return;
+    }
+
+    if (group_size < 2) {
+        icetRaiseDebug("Shallow copy input.");
+        *result_image = input_image;
+        *piece_offset = 0;
+        return;
+    }
+
+    group_rank = icetFindMyRankInGroup(compose_group, group_size);
+    if (group_rank < 0) {
+        icetRaiseError("Local process not in compose_group?",
+                       ICET_SANITY_CHECK_FAIL);
+        *result_image = input_image;
+        *piece_offset = 0;
+        return;
+    }
+
+    /* MPI_Reduce_scatter_block and its like give every process the same
+       number of pixels, so the image is padded to a multiple of the group
+       size. */
+    num_pixels = icetSparseImageGetNumPixels(input_image);
+    block_pixels = (num_pixels + group_size - 1)/group_size;
+    pixel_size = icetImagePackedPixelSize(format.color_format,
+                                          format.depth_format);
+
+    full_image = icetGetStateBufferImage(REDUCE_SCATTER_IMAGE_BUFFER,
+                                         block_pixels*group_size,
+                                         1);
+    icetDecompressSubImage(input_image, 0, full_image);
+
+    piece_image = icetGetStateBufferImage(REDUCE_SCATTER_PIECE_IMAGE_BUFFER,
+                                          block_pixels,
+                                          1);
+
+    /* Without depth, packed pixels are the same as the color buffer, so
+       the reduce-scatter can work in the images directly. */
+    if (format.depth_format == ICET_IMAGE_DEPTH_NONE) {
+        send_buffer = icetImageGetColorVoid(full_image, NULL);
+        receive_buffer = icetImageGetColorVoid(piece_image, NULL);
+    } else {
+        send_buffer = icetGetStateBuffer(REDUCE_SCATTER_SEND_BUFFER,
+                                         block_pixels*group_size*pixel_size);
+        receive_buffer = icetGetStateBuffer(REDUCE_SCATTER_RECEIVE_BUFFER,
+                                            block_pixels*pixel_size);
+        icetImagePackPixels(full_image, 0, num_pixels, send_buffer);
+    }
+    /* Zeroed padding is inactive or adds nothing in every format. */
+    memset((IceTByte *)send_buffer + num_pixels*pixel_size,
+           0,
+           (block_pixels*group_size - num_pixels)*pixel_size);
+
+    icetRaiseDebug1("Reduce-scatter of %d pixels per process",
+                    (int)block_pixels);
+    icetCommReduceScatterBlock(group_size,
+                               compose_group,
+                               send_buffer,
+                               receive_buffer,
+                               block_pixels,
+                               pixel_size,
+                               reduceScatterReducePixels,
+                               &format);
+
+    if (format.depth_format != ICET_IMAGE_DEPTH_NONE) {
+        icetImageUnpackPixels(receive_buffer, piece_image, 0, block_pixels);
+    }
+
+    piece_pixels = num_pixels - group_rank*block_pixels;
+    if (piece_pixels > block_pixels) piece_pixels = block_pixels;
+    if (piece_pixels < 0) piece_pixels = 0;
+
+    *result_image
+        = icetGetStateBufferSparseImage(REDUCE_SCATTER_RESULT_IMAGE_BUFFER,
+                                        block_pixels,
+                                        1);
+    icetCompressSubImage(piece_image, 0, piece_pixels, *result_image);
+    *piece_offset = (piece_pixels > 0) ? group_rank*block_pixels : 0;
+}
@@ -58,6 +58,12 @@ extern void icetRadixkrCompose(const IceTInt *compose_group,
                                IceTSparseImage input_image,
                                IceTSparseImage *result_image,
                                IceTSizeType *piece_offset);
+extern void icetReduceScatterCompose(const IceTInt *compose_group,
+                                     IceTInt group_size,
+                                     IceTInt image_dest,
+                                     IceTSparseImage input_image,
+                                     IceTSparseImage *result_image,
+                                     IceTSizeType *piece_offset);
 
 /*==================================================================*/
 
@@ -146,6 +152,7 @@ IceTBoolean icetSingleImageStrategyValid(IceTEnum strategy)
       case ICET_SINGLE_IMAGE_STRATEGY_RADIXK:
       case ICET_SINGLE_IMAGE_STRATEGY_RADIXKR:
       case ICET_SINGLE_IMAGE_STRATEGY_BSWAP_FOLDING:
+      case ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER:
           return ICET_TRUE;
       default:
           return ICET_FALSE;
@@ -161,6 +168,7 @@ const char *icetSingleImageStrategyNameFromEnum(IceTEnum strategy)
       case ICET_SINGLE_IMAGE_STRATEGY_RADIXK:           return "Radix-k";
       case ICET_SINGLE_IMAGE_STRATEGY_RADIXKR:          return "Radix-kr";
       case ICET_SINGLE_IMAGE_STRATEGY_BSWAP_FOLDING:    return "Folded Binary Swap";
+      case ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER:   return "Reduce-Scatter";
       default:
           icetRaiseError("Invalid single image strategy.", ICET_INVALID_ENUM);
           return "<Invalid>";
@@ -227,6 +235,14 @@ void icetInvokeSingleImageStrategy(IceTEnum strategy,
                                 result_image,
                                 piece_offset);
         break;
+      case ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER:
+          icetReduceScatterCompose(compose_group,
+                                   group_size,
+                                   image_dest,
+                                   input_image,
+                                   result_image,
+                                   piece_offset);
+          break;
       default:
           icetRaiseError("Invalid single image strategy.", ICET_INVALID_ENUM);
           break;
@@ -25,6 +25,7 @@
 #define SPLIT_FULL_IMAGE_BUFFER         ICET_STRATEGY_BUFFER_4
 #define SPLIT_REQUEST_BUFFER            ICET_STRATEGY_BUFFER_5
 #define SPLIT_TILE_GROUPS_BUFFER        ICET_STRATEGY_BUFFER_6
+#define SPLIT_ARRIVED_INDEX_BUFFER      ICET_STRATEGY_BUFFER_7
 
 #define IMAGE_DATA        50
 #define COLOR_DATA        51
@@ -173,6 +174,7 @@ IceTImage icetSplitCompose(void)
 
     int num_requests;
     IceTCommRequest *requests;
+    int *arrived;
 
     int first_incoming;
 
@@ -358,20 +360,36 @@ IceTImage icetSplitCompose(void)
         }
     }
 
-  /* Wait for images to come in and Z compare them. */
+  /* Wait for images to come in and Z compare them, taking every image
+     that has arrived each time. */
+    arrived = icetGetStateBuffer(SPLIT_ARRIVED_INDEX_BUFFER,
+                                 sizeof(int)*tile_contribs[my_tile]);
     first_incoming = 1;
-    for (image = 0; image < tile_contribs[my_tile]; image++) {
-        int idx;
-        idx = icetCommWaitany(tile_contribs[my_tile], requests);
-        incoming = icetSparseImageUnpackageFromReceive(incomingBuffers[idx]);
-        if (first_incoming) {
-            icetRaiseDebug1("Got first image (%d).", idx);
-            icetDecompressImage(incoming, imageFragment);
-            first_incoming = 0;
-        } else {
-            icetRaiseDebug1("Got subsequent image (%d).", idx);
-            icetCompressedComposite(imageFragment, incoming, 1);
+    image = 0;
+    while (image < tile_contribs[my_tile]) {
+        int num_arrived;
+        int i;
+        num_arrived = icetCommWaitsome(tile_contribs[my_tile], requests,
+                                       arrived);
+        if (num_arrived < 1) {
+            icetRaiseError("Lost track of incoming images.",
+                           ICET_SANITY_CHECK_FAIL);
+            break;
+        }
+        for (i = 0; i < num_arrived; i++) {
+            int idx = arrived[i];
+            incoming
+                = icetSparseImageUnpackageFromReceive(incomingBuffers[idx]);
+            if (first_incoming) {
+                icetRaiseDebug1("Got first image (%d).", idx);
+                icetDecompressImage(incoming, imageFragment);
+                first_incoming = 0;
+            } else {
+                icetRaiseDebug1("Got subsequent image (%d).", idx);
+                icetCompressedComposite(imageFragment, incoming, 1);
+            }
         }
+        image += num_arrived;
     }
 
     if (icetIsEnabled(ICET_COLLECT_IMAGES)) {
@@ -0,0 +1,463 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This tests the ICET_COMPOSITE_MODE_ADD composite mode.  Every process draws
+** the same color into the left half of the image, so the composited image
+** should hold the sum of all contributions there and the background color
+** everywhere else.  This is tried both with a depth buffer and without one,
+** in which case active pixels are identified by their color.  Besides the RGBA
+** formats, this covers the single and dual channel float formats and the
+** integer count format.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+#include <IceTDevSIMD.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+static const IceTFloat g_foreground_colorf[4] = { 0.125f,0.25f,0.375f,0.5f };
+static const IceTUByte g_foreground_colorub[4] = { 10, 20, 30, 40 };
+/* Not exact as a float, so sums in float would be off. */
+static const IceTUInt g_foreground_count = 16777217;
+
+/* Number of channels of the single and dual channel float formats, which
+   hold the first channels of the colors used here. */
+static IceTSizeType AddCompositeNumChannels(const IceTImage image)
+{
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_R_FLOAT) {
+        return 1;
+    } else {
+        return 2;
+    }
+}
+
+static void AddCompositeDraw(const IceTDouble *projection_matrix,
+                             const IceTDouble *modelview_matrix,
+                             const IceTFloat *background_color,
+                             const IceTInt *readback_viewport,
+                             IceTImage result)
+{
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTFloat *depths = NULL;
+    IceTSizeType x, y;
+
+    /* Not using these. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)readback_viewport;
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    if (icetImageGetDepthFormat(result) == ICET_IMAGE_DEPTH_FLOAT) {
+        depths = icetImageGetDepthf(result);
+    }
+
+    if (icetImageGetColorFormat(result) == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUByte *colors = icetImageGetColorub(result);
+        IceTUByte background_colorub[4];
+        background_colorub[0] = (IceTUByte)(255*background_color[0]);
+        background_colorub[1] = (IceTUByte)(255*background_color[1]);
+        background_colorub[2] = (IceTUByte)(255*background_color[2]);
+        background_colorub[3] = (IceTUByte)(255*background_color[3]);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                IceTSizeType pixel = y*width + x;
+                if (x < width/2) {
+                    memcpy(colors + 4*pixel, g_foreground_colorub, 4);
+                    if (depths != NULL) {
+                        depths[pixel] = 0.5f;
+                    }
+                } else {
+                    memcpy(colors + 4*pixel, background_colorub, 4);
+                    if (depths != NULL) {
+                        depths[pixel] = 1.0f;
+                    }
+                }
+            }
+        }
+    } else if (icetImageGetColorFormat(result) == ICET_IMAGE_COLOR_RGBA_HALF) {
+        IceTUShort *colors = icetImageGetColorVoid(result, NULL);
+        IceTUShort foreground_colorh[4];
+        IceTUShort background_colorh[4];
+        icetSIMDFloatToHalf(g_foreground_colorf, foreground_colorh, 4);
+        icetSIMDFloatToHalf(background_color, background_colorh, 4);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                IceTSizeType pixel = y*width + x;
+                if (x < width/2) {
+                    memcpy(colors + 4*pixel,
+                           foreground_colorh,
+                           4*sizeof(IceTUShort));
+                    if (depths != NULL) {
+                        depths[pixel] = 0.5f;
+                    }
+                } else {
+                    memcpy(colors + 4*pixel,
+                           background_colorh,
+                           4*sizeof(IceTUShort));
+                    if (depths != NULL) {
+                        depths[pixel] = 1.0f;
+                    }
+                }
+            }
+        }
+    } else if (icetImageGetColorFormat(result) == ICET_IMAGE_COLOR_R_UINT) {
+        IceTUInt *colors = icetImageGetColorui(result);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                IceTSizeType pixel = y*width + x;
+                if (x < width/2) {
+                    colors[pixel] = g_foreground_count;
+                    if (depths != NULL) {
+                        depths[pixel] = 0.5f;
+                    }
+                } else {
+                    colors[pixel] = 0;
+                    if (depths != NULL) {
+                        depths[pixel] = 1.0f;
+                    }
+                }
+            }
+        }
+    } else if (   (icetImageGetColorFormat(result)
+                   == ICET_IMAGE_COLOR_R_FLOAT)
+               || (icetImageGetColorFormat(result)
+                   == ICET_IMAGE_COLOR_RG_FLOAT) ) {
+        IceTFloat *colors = icetImageGetColorf(result);
+        IceTSizeType num_channels = AddCompositeNumChannels(result);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                IceTSizeType pixel = y*width + x;
+                if (x < width/2) {
+                    memcpy(colors + num_channels*pixel,
+                           g_foreground_colorf,
+                           num_channels*sizeof(IceTFloat));
+                    if (depths != NULL) {
+                        depths[pixel] = 0.5f;
+                    }
+                } else {
+                    memcpy(colors + num_channels*pixel,
+                           background_color,
+                           num_channels*sizeof(IceTFloat));
+                    if (depths != NULL) {
+                        depths[pixel] = 1.0f;
+                    }
+                }
+            }
+        }
+    } else {
+        IceTFloat *colors = icetImageGetColorf(result);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                IceTSizeType pixel = y*width + x;
+                if (x < width/2) {
+                    memcpy(colors + 4*pixel,
+                           g_foreground_colorf,
+                           4*sizeof(IceTFloat));
+                    if (depths != NULL) {
+                        depths[pixel] = 0.5f;
+                    }
+                } else {
+                    memcpy(colors + 4*pixel,
+                           background_color,
+                           4*sizeof(IceTFloat));
+                    if (depths != NULL) {
+                        depths[pixel] = 1.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void AddCompositeSetupRender(IceTEnum color_format,
+                                    IceTEnum depth_format)
+{
+    icetCompositeMode(ICET_COMPOSITE_MODE_ADD);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+    icetEnable(ICET_CORRECT_COLORED_BACKGROUND);
+
+    icetDrawCallback(AddCompositeDraw);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+}
+
+static int AddCompositeCheckImage(const IceTImage image)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTFloat expected_color[4];
+    IceTSizeType x, y;
+    int channel;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) return TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        const IceTUByte *colors = icetImageGetColorcub(image);
+        IceTUByte expected_ub[4];
+        IceTUByte background_ub[4];
+        for (channel = 0; channel < 4; channel++) {
+            IceTInt sum = num_proc*g_foreground_colorub[channel];
+            expected_ub[channel] = (IceTUByte)((sum < 255) ? sum : 255);
+            background_ub[channel]
+                = (IceTUByte)(255*g_background_color[channel]);
+        }
+        for (y = 0; y < SCREEN_HEIGHT; y++) {
+            for (x = 0; x < SCREEN_WIDTH; x++) {
+                const IceTUByte *pixel = colors + 4*(y*SCREEN_WIDTH + x);
+                const IceTUByte *expected
+                    = (x < SCREEN_WIDTH/2) ? expected_ub : background_ub;
+                if (memcmp(pixel, expected, 4) != 0) {
+                    printrank("**** Found bad pixel!!!! ****\n");
+                    printrank("Location x = %d, y = %d\n", x, y);
+                    printrank("Got color %d %d %d %d\n",
+                              pixel[0], pixel[1], pixel[2], pixel[3]);
+                    printrank("Expected %d %d %d %d\n",
+                              expected[0], expected[1],
+                              expected[2], expected[3]);
+                    return TEST_FAILED;
+                }
+            }
+        }
+    } else if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_R_UINT) {
+        /* Counts have no background, so inactive pixels are 0. */
+        const IceTUInt *colors = icetImageGetColorcui(image);
+        IceTUInt expected_count = num_proc*g_foreground_count;
+        IceTFloat *converted_colors
+            = malloc(4*SCREEN_WIDTH*SCREEN_HEIGHT*sizeof(IceTFloat));
+        int result = TEST_PASSED;
+        icetImageCopyColorf(image,
+                            converted_colors,
+                            ICET_IMAGE_COLOR_RGBA_FLOAT);
+        for (y = 0; (y < SCREEN_HEIGHT) && (result == TEST_PASSED); y++) {
+            for (x = 0; x < SCREEN_WIDTH; x++) {
+                IceTSizeType pixel = y*SCREEN_WIDTH + x;
+                IceTUInt expected = (x < SCREEN_WIDTH/2) ? expected_count : 0;
+                if (   (colors[pixel] != expected)
+                    || (converted_colors[4*pixel] != (IceTFloat)expected)
+                    || (converted_colors[4*pixel + 3] != 1.0f) ) {
+                    printrank("**** Found bad pixel!!!! ****\n");
+                    printrank("Location x = %d, y = %d\n", x, y);
+                    printrank("Got count %u (%f as float)\n",
+                              colors[pixel], converted_colors[4*pixel]);
+                    printrank("Expected %u\n", expected);
+                    result = TEST_FAILED;
+                    break;
+                }
+            }
+        }
+        free(converted_colors);
+        if (result != TEST_PASSED) return result;
+    } else if (   (icetImageGetColorFormat(image)
+                   == ICET_IMAGE_COLOR_R_FLOAT)
+               || (icetImageGetColorFormat(image)
+                   == ICET_IMAGE_COLOR_RG_FLOAT) ) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTSizeType num_channels = AddCompositeNumChannels(image);
+        for (channel = 0; channel < num_channels; channel++) {
+            expected_color[channel] = num_proc*g_foreground_colorf[channel];
+        }
+        for (y = 0; y < SCREEN_HEIGHT; y++) {
+            for (x = 0; x < SCREEN_WIDTH; x++) {
+                const IceTFloat *pixel
+                    = colors + num_channels*(y*SCREEN_WIDTH + x);
+                const IceTFloat *expected
+                    = (x < SCREEN_WIDTH/2) ? expected_color:g_background_color;
+                for (channel = 0; channel < num_channels; channel++) {
+                    if (pixel[channel] != expected[channel]) {
+                        printrank("**** Found bad pixel!!!! ****\n");
+                        printrank("Location x = %d, y = %d, channel = %d\n",
+                                  x, y, channel);
+                        printrank("Got value %f\n", pixel[channel]);
+                        printrank("Expected %f\n", expected[channel]);
+                        return TEST_FAILED;
+                    }
+                }
+            }
+        }
+    } else {
+        /* Half colors are checked after conversion to float.  All the
+           expected values are exact in half precision. */
+        IceTFloat *converted_colors = NULL;
+        const IceTFloat *colors;
+        int result = TEST_PASSED;
+        if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_RGBA_HALF) {
+            converted_colors
+                = malloc(4*SCREEN_WIDTH*SCREEN_HEIGHT*sizeof(IceTFloat));
+            icetImageCopyColorf(image,
+                                converted_colors,
+                                ICET_IMAGE_COLOR_RGBA_FLOAT);
+            colors = converted_colors;
+        } else {
+            colors = icetImageGetColorcf(image);
+        }
+        for (channel = 0; channel < 4; channel++) {
+            expected_color[channel] = num_proc*g_foreground_colorf[channel];
+        }
+        for (y = 0; y < SCREEN_HEIGHT; y++) {
+            for (x = 0; x < SCREEN_WIDTH; x++) {
+                const IceTFloat *pixel = colors + 4*(y*SCREEN_WIDTH + x);
+                const IceTFloat *expected
+                    = (x < SCREEN_WIDTH/2) ? expected_color:g_background_color;
+                if (   (pixel[0] != expected[0])
+                    || (pixel[1] != expected[1])
+                    || (pixel[2] != expected[2])
+                    || (pixel[3] != expected[3]) ) {
+                    printrank("**** Found bad pixel!!!! ****\n");
+                    printrank("Location x = %d, y = %d\n", x, y);
+                    printrank("Got color %f %f %f %f\n",
+                              pixel[0], pixel[1], pixel[2], pixel[3]);
+                    printrank("Expected %f %f %f %f\n",
+                              expected[0], expected[1],
+                              expected[2], expected[3]);
+                    result = TEST_FAILED;
+                    break;
+                }
+            }
+            if (result != TEST_PASSED) break;
+        }
+        if (converted_colors != NULL) {
+            free(converted_colors);
+        }
+        if (result != TEST_PASSED) return result;
+    }
+
+    return TEST_PASSED;
+}
+
+static int AddCompositeTryRender(IceTEnum color_format,
+                                 IceTEnum depth_format)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+
+    AddCompositeSetupRender(color_format, depth_format);
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    return AddCompositeCheckImage(image);
+}
+
+static int AddCompositeTryStrategy(IceTEnum color_format,
+                                   IceTEnum depth_format)
+{
+    int result = TEST_PASSED;
+    int strategy_idx;
+
+    for (strategy_idx = 0; strategy_idx < STRATEGY_LIST_SIZE; strategy_idx++) {
+        IceTEnum strategy = strategy_list[strategy_idx];
+        int single_image_strategy_idx;
+        int num_single_image_strategies;
+
+        icetStrategy(strategy);
+        printstat("Trying strategy %s\n", icetGetStrategyName());
+
+        if (strategy_uses_single_image_strategy(strategy)) {
+            num_single_image_strategies = SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+        } else {
+            num_single_image_strategies = 1;
+        }
+
+        for (single_image_strategy_idx = 0;
+             single_image_strategy_idx < num_single_image_strategies;
+             single_image_strategy_idx++) {
+            icetSingleImageStrategy(
+                      single_image_strategy_list[single_image_strategy_idx]);
+            printstat("  Using single image strategy %s\n",
+                      icetGetSingleImageStrategyName());
+            result += AddCompositeTryRender(color_format, depth_format);
+        }
+    }
+
+    return result;
+}
+
+static int AddCompositeRun(void)
+{
+    int result = TEST_PASSED;
+
+    printstat("Testing RGBA unsigned byte colors with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_UBYTE,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing RGBA float colors with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing RGBA half float colors with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_HALF,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing single channel float colors with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_R_FLOAT,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing dual channel float colors with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RG_FLOAT,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing integer counts with depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_R_UINT,
+                                      ICET_IMAGE_DEPTH_FLOAT);
+
+    printstat("Testing RGBA unsigned byte colors without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_UBYTE,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    printstat("Testing RGBA float colors without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    printstat("Testing RGBA half float colors without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RGBA_HALF,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    printstat("Testing single channel float colors without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_R_FLOAT,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    printstat("Testing dual channel float colors without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_RG_FLOAT,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    printstat("Testing integer counts without depth\n");
+    result += AddCompositeTryStrategy(ICET_IMAGE_COLOR_R_UINT,
+                                      ICET_IMAGE_DEPTH_NONE);
+
+    return result;
+}
+
+int AddComposite(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(AddCompositeRun);
+}
@@ -0,0 +1,358 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This tests the ICET_IMAGE_DEPTH_HALF and ICET_IMAGE_DEPTH_UNORM24 depth
+** formats.  Each process draws a band starting at the left of the image that
+** gets wider with rank, and lower ranks are closer to the viewer.  With z
+** buffer compositing, each pixel should get the color and depth of the lowest
+** rank drawn there.  With additive compositing, each pixel should get the
+** sum of the colors drawn there and the nearest depth.  The right of the image
+** is left empty.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+/* Returns the first rank drawn at column x (or num_proc for none). */
+static IceTInt DepthFormatsNearestRank(IceTSizeType x,
+                                       IceTSizeType width,
+                                       IceTInt num_proc)
+{
+    IceTInt rank;
+    for (rank = 0; rank < num_proc; rank++) {
+        if (x < width*(rank+1)/(num_proc+1)) break;
+    }
+    return rank;
+}
+
+/* Raw depth written by a rank.  Both encodings order the same as the depths
+   they represent. */
+static IceTUInt DepthFormatsRankKey(IceTEnum depth_format, IceTInt rank)
+{
+    if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        /* (1 + rank/64)/128 */
+        return 0x2000 + 16*(IceTUInt)rank;
+    } else {
+        return 0x100000 + 0x1000*(IceTUInt)rank;
+    }
+}
+
+static IceTFloat DepthFormatsRankDepth(IceTEnum depth_format, IceTInt rank)
+{
+    if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        return (1.0f + rank/64.0f)/128.0f;
+    } else {
+        return DepthFormatsRankKey(depth_format, rank)/16777215.0f;
+    }
+}
+
+static void DepthFormatsSetKey(IceTEnum depth_format,
+                               IceTVoid *depths,
+                               IceTSizeType pixel,
+                               IceTUInt key)
+{
+    if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        ((IceTUShort *)depths)[pixel] = (IceTUShort)key;
+    } else {
+        IceTUByte *depth = (IceTUByte *)depths + 3*pixel;
+        depth[0] = (IceTUByte)(key & 0xFF);
+        depth[1] = (IceTUByte)((key >> 8) & 0xFF);
+        depth[2] = (IceTUByte)((key >> 16) & 0xFF);
+    }
+}
+
+static IceTUInt DepthFormatsGetKey(IceTEnum depth_format,
+                                   const IceTVoid *depths,
+                                   IceTSizeType pixel)
+{
+    if (depth_format == ICET_IMAGE_DEPTH_HALF) {
+        return ((const IceTUShort *)depths)[pixel];
+    } else {
+        const IceTUByte *depth = (const IceTUByte *)depths + 3*pixel;
+        return (  (IceTUInt)depth[0]
+                | ((IceTUInt)depth[1] << 8)
+                | ((IceTUInt)depth[2] << 16) );
+    }
+}
+
+static IceTUInt DepthFormatsFarKey(IceTEnum depth_format)
+{
+    return (depth_format == ICET_IMAGE_DEPTH_HALF) ? 0x3C00 : 0xFFFFFF;
+}
+
+static void DepthFormatsRankColor(IceTInt rank, IceTUByte color[4])
+{
+    color[0] = (IceTUByte)(rank + 1);
+    color[1] = 2;
+    color[2] = 3;
+    color[3] = 4;
+}
+
+static void DepthFormatsDraw(const IceTDouble *projection_matrix,
+                             const IceTDouble *modelview_matrix,
+                             const IceTFloat *background_color,
+                             const IceTInt *readback_viewport,
+                             IceTImage result)
+{
+    IceTEnum color_format = icetImageGetColorFormat(result);
+    IceTEnum depth_format = icetImageGetDepthFormat(result);
+    IceTSizeType width = icetImageGetWidth(result);
+    IceTSizeType height = icetImageGetHeight(result);
+    IceTVoid *depths = icetImageGetDepthVoid(result, NULL);
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTUByte color[4];
+    IceTSizeType x, y;
+
+    /* Not using these. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)readback_viewport;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    DepthFormatsRankColor(rank, color);
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTBoolean active = (x < width*(rank+1)/(num_proc+1));
+            int channel;
+            if (active) {
+                DepthFormatsSetKey(depth_format, depths, pixel,
+                                   DepthFormatsRankKey(depth_format, rank));
+            } else {
+                DepthFormatsSetKey(depth_format, depths, pixel,
+                                   DepthFormatsFarKey(depth_format));
+            }
+            for (channel = 0; channel < 4; channel++) {
+                if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                    icetImageGetColorub(result)[4*pixel + channel] = active
+                        ? color[channel]
+                        : (IceTUByte)(255*background_color[channel]);
+                } else {
+                    icetImageGetColorf(result)[4*pixel + channel] = active
+                        ? color[channel]/255.0f
+                        : background_color[channel];
+                }
+            }
+        }
+    }
+}
+
+static void DepthFormatsSetupRender(IceTEnum composite_mode,
+                                    IceTEnum color_format,
+                                    IceTEnum depth_format)
+{
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+    icetDisable(ICET_COMPOSITE_ONE_BUFFER);
+
+    icetDrawCallback(DepthFormatsDraw);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+}
+
+static int DepthFormatsCheckImage(const IceTImage image,
+                                  IceTEnum composite_mode)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    const IceTVoid *depths;
+    IceTFloat *float_depths;
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType x, y;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) return TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    depths = icetImageGetDepthConstVoid(image, NULL);
+    float_depths = malloc(SCREEN_WIDTH*SCREEN_HEIGHT*sizeof(IceTFloat));
+    icetImageCopyDepthf(image, float_depths, ICET_IMAGE_DEPTH_FLOAT);
+
+    for (y = 0; (y < SCREEN_HEIGHT) && (result == TEST_PASSED); y++) {
+        for (x = 0; x < SCREEN_WIDTH; x++) {
+            IceTSizeType pixel = y*SCREEN_WIDTH + x;
+            IceTInt nearest = DepthFormatsNearestRank(x, SCREEN_WIDTH,
+                                                      num_proc);
+            IceTUInt expected_key;
+            IceTFloat expected_depth;
+            IceTUByte expected_color[4];
+            IceTUByte color[4];
+            int channel;
+
+            if (nearest < num_proc) {
+                expected_key = DepthFormatsRankKey(depth_format, nearest);
+                expected_depth = DepthFormatsRankDepth(depth_format, nearest);
+                DepthFormatsRankColor(nearest, expected_color);
+                if (composite_mode == ICET_COMPOSITE_MODE_ADD) {
+                    IceTInt r;
+                    for (r = nearest + 1; r < num_proc; r++) {
+                        IceTUByte rank_color[4];
+                        DepthFormatsRankColor(r, rank_color);
+                        for (channel = 0; channel < 4; channel++) {
+                            expected_color[channel] = (IceTUByte)
+                                (expected_color[channel] + rank_color[channel]);
+                        }
+                    }
+                }
+            } else {
+                expected_key = DepthFormatsFarKey(depth_format);
+                expected_depth = 1.0f;
+                for (channel = 0; channel < 4; channel++) {
+                    expected_color[channel]
+                        = (IceTUByte)(255*g_background_color[channel]);
+                }
+            }
+
+            for (channel = 0; channel < 4; channel++) {
+                if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                    color[channel]
+                        = icetImageGetColorcub(image)[4*pixel + channel];
+                } else {
+                    color[channel] = (IceTUByte)
+                        (255*icetImageGetColorcf(image)[4*pixel + channel]
+                         + 0.5f);
+                }
+            }
+
+            if (   (memcmp(color, expected_color, 4) != 0)
+                || (   DepthFormatsGetKey(depth_format, depths, pixel)
+                    != expected_key)
+                || (float_depths[pixel] < expected_depth - 0.000001f)
+                || (float_depths[pixel] > expected_depth + 0.000001f) ) {
+                printrank("**** Found bad pixel!!!! ****\n");
+                printrank("Location x = %d, y = %d\n", x, y);
+                printrank("Got color %d %d %d %d, depth 0x%X (%f)\n",
+                          color[0], color[1], color[2], color[3],
+                          DepthFormatsGetKey(depth_format, depths, pixel),
+                          float_depths[pixel]);
+                printrank("Expected %d %d %d %d, depth 0x%X (%f)\n",
+                          expected_color[0], expected_color[1],
+                          expected_color[2], expected_color[3],
+                          expected_key, expected_depth);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    free(float_depths);
+    return result;
+}
+
+static int DepthFormatsTryRender(IceTEnum composite_mode,
+                                 IceTEnum color_format,
+                                 IceTEnum depth_format)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+
+    DepthFormatsSetupRender(composite_mode, color_format, depth_format);
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    return DepthFormatsCheckImage(image, composite_mode);
+}
+
+static int DepthFormatsTryStrategy(IceTEnum composite_mode,
+                                   IceTEnum color_format,
+                                   IceTEnum depth_format)
+{
+    int result = TEST_PASSED;
+    int strategy_idx;
+
+    for (strategy_idx = 0; strategy_idx < STRATEGY_LIST_SIZE; strategy_idx++) {
+        IceTEnum strategy = strategy_list[strategy_idx];
+        int single_image_strategy_idx;
+        int num_single_image_strategies;
+
+        icetStrategy(strategy);
+        printstat("Trying strategy %s\n", icetGetStrategyName());
+
+        if (strategy_uses_single_image_strategy(strategy)) {
+            num_single_image_strategies = SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+        } else {
+            num_single_image_strategies = 1;
+        }
+
+        for (single_image_strategy_idx = 0;
+             single_image_strategy_idx < num_single_image_strategies;
+             single_image_strategy_idx++) {
+            icetSingleImageStrategy(
+                      single_image_strategy_list[single_image_strategy_idx]);
+            printstat("  Using single image strategy %s\n",
+                      icetGetSingleImageStrategyName());
+            result += DepthFormatsTryRender(composite_mode,
+                                            color_format,
+                                            depth_format);
+        }
+    }
+
+    return result;
+}
+
+static int DepthFormatsRun(void)
+{
+    static const IceTEnum composite_modes[2] = {
+        ICET_COMPOSITE_MODE_Z_BUFFER, ICET_COMPOSITE_MODE_ADD };
+    static const IceTEnum color_formats[2] = {
+        ICET_IMAGE_COLOR_RGBA_UBYTE, ICET_IMAGE_COLOR_RGBA_FLOAT };
+    static const IceTEnum depth_formats[2] = {
+        ICET_IMAGE_DEPTH_HALF, ICET_IMAGE_DEPTH_UNORM24 };
+    int result = TEST_PASSED;
+    int mode_idx, color_idx, depth_idx;
+
+    for (mode_idx = 0; mode_idx < 2; mode_idx++) {
+        for (color_idx = 0; color_idx < 2; color_idx++) {
+            for (depth_idx = 0; depth_idx < 2; depth_idx++) {
+                printstat("Testing %s compositing, %s colors, %s depth\n",
+                          (mode_idx == 0) ? "z buffer" : "additive",
+                          (color_idx == 0) ? "unsigned byte" : "float",
+                          (depth_idx == 0) ? "half" : "24-bit");
+                result += DepthFormatsTryStrategy(composite_modes[mode_idx],
+                                                  color_formats[color_idx],
+                                                  depth_formats[depth_idx]);
+            }
+        }
+    }
+
+    return result;
+}
+
+int DepthFormats(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(DepthFormatsRun);
+}
@@ -7,7 +7,7 @@
 **
 ** This test check to make sure that when an image is interlaced, split,
 ** and then combined back together, all the pixels are reconstructed
-** correctly.
+** correctly.  It does the same for images put in block order.
 *****************************************************************************/
 
 #include "test_codes.h"
@@ -344,6 +344,91 @@ static int TestInterlaceSplit(const IceTImage image)
     return TEST_PASSED;
 }
 
+static int TestBlockTileSplit(const IceTImage image)
+{
+    IceTVoid *original_sparse_buffer;
+    IceTSparseImage original_sparse;
+    IceTVoid *tiled_sparse_buffer;
+    IceTSparseImage tiled_sparse;
+    IceTVoid *sparse_partition_buffer[NUM_PARTITIONS];
+    IceTSparseImage sparse_partition[NUM_PARTITIONS];
+    IceTSizeType offsets[NUM_PARTITIONS];
+    IceTVoid *reconstruction_buffer;
+    IceTImage reconstruction;
+
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType num_partition_pixels;
+
+    IceTInt partition;
+
+    width = icetImageGetWidth(image);
+    height = icetImageGetHeight(image);
+    num_partition_pixels
+        = icetSparseImageSplitPartitionNumPixels(width*height,
+                                                 NUM_PARTITIONS,
+                                                 NUM_PARTITIONS);
+
+    original_sparse_buffer = malloc(icetSparseImageBufferSize(width, height));
+    original_sparse = icetSparseImageAssignBuffer(original_sparse_buffer,
+                                                  width,
+                                                  height);
+
+    tiled_sparse_buffer = malloc(icetSparseImageBufferSize(width, height));
+    tiled_sparse = icetSparseImageAssignBuffer(tiled_sparse_buffer,
+                                               width,
+                                               height);
+
+    for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+        sparse_partition_buffer[partition]
+            = malloc(icetSparseImageBufferSize(num_partition_pixels, 1));
+        sparse_partition[partition]
+            = icetSparseImageAssignBuffer(sparse_partition_buffer[partition],
+                                          num_partition_pixels, 1);
+    }
+
+    reconstruction_buffer = malloc(icetImageBufferSize(width, height));
+    reconstruction = icetImageAssignBuffer(reconstruction_buffer,width,height);
+
+    icetCompressImage(image, original_sparse);
+
+    printstat("Tiling image in blocks\n");
+    icetSparseImageTileBlocks(original_sparse, tiled_sparse);
+    if (   icetSparseImageGetActiveCount(tiled_sparse)
+        != icetSparseImageGetActiveCount(original_sparse) ) {
+        printrank("ERROR: Tiling changed the number of active pixels.\n");
+        return TEST_FAILED;
+    }
+
+    printstat("Splitting image %d times\n", NUM_PARTITIONS);
+    icetSparseImageSplit(tiled_sparse,
+                         0,
+                         NUM_PARTITIONS,
+                         NUM_PARTITIONS,
+                         sparse_partition,
+                         offsets);
+
+    printstat("Reconstructing image.\n");
+    for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+        icetDecompressSubImage(sparse_partition[partition],
+                               offsets[partition],
+                               reconstruction);
+    }
+    icetImageUntileBlocks(reconstruction, ICET_SI_STRATEGY_BUFFER_0);
+
+    if (!CompareImageColors(image, reconstruction)) { return TEST_FAILED; }
+    if (!CompareImageDepths(image, reconstruction)) { return TEST_FAILED; }
+
+    free(original_sparse_buffer);
+    free(tiled_sparse_buffer);
+    for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+        free(sparse_partition_buffer[partition]);
+    }
+    free(reconstruction_buffer);
+
+    return TEST_PASSED;
+}
+
 static int InterlaceRunFormat()
 {
     IceTVoid *imagebuffer;
@@ -359,12 +444,18 @@ static int InterlaceRunFormat()
     result = TestInterlaceSplit(image);
     if (result != TEST_PASSED) { return result; }
 
+    result = TestBlockTileSplit(image);
+    if (result != TEST_PASSED) { return result; }
+
     printstat("\n********* Creating full image\n");
     FullImage(image);
 
     result = TestInterlaceSplit(image);
     if (result != TEST_PASSED) { return result; }
 
+    result = TestBlockTileSplit(image);
+    if (result != TEST_PASSED) { return result; }
+
     free(imagebuffer);
 
     return TEST_PASSED;
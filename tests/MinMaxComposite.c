@@ -0,0 +1,359 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This tests the ICET_COMPOSITE_MODE_MAX and ICET_COMPOSITE_MODE_MIN composite
+** modes.  Every process draws different values into a different subset of
+** the pixels in the left half of the image, so the composited image should
+** hold the largest or smallest value drawn by any process for each channel
+** and the background color where no process drew.  This is tried both with a
+** depth buffer and without one, in which case active pixels are identified by
+** their color.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+#include <IceTDevSIMD.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+
+/* Float values are drawn in units of 1/256, in which all the values used
+   here are exact in half precision. */
+#define MIN_MAX_FLOAT_SCALE 256.0f
+
+static IceTSizeType MinMaxNumChannels(IceTEnum color_format)
+{
+    if (   (color_format == ICET_IMAGE_COLOR_R_FLOAT)
+        || (color_format == ICET_IMAGE_COLOR_R_UINT) ) {
+        return 1;
+    } else {
+        return 4;
+    }
+}
+
+static IceTBoolean MinMaxActive(IceTInt rank, IceTSizeType x, IceTSizeType y)
+{
+    return (x < SCREEN_WIDTH/2) && ((x + y + rank)%3 != 0);
+}
+
+/* The value drawn by the given process, which is between 1 and 200. */
+static IceTInt MinMaxValue(IceTInt rank,
+                           IceTSizeType x,
+                           IceTSizeType y,
+                           IceTSizeType channel)
+{
+    return 1 + (IceTInt)((rank*37 + x*3 + y*5 + channel*11)%200);
+}
+
+/* The value of the background color in the units of the image. */
+static IceTDouble MinMaxBackgroundValue(IceTEnum color_format,
+                                        IceTSizeType channel)
+{
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        return (IceTUByte)(255*g_background_color[channel]);
+    } else if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+        /* Counts have no background. */
+        return 0.0;
+    } else {
+        return MIN_MAX_FLOAT_SCALE*g_background_color[channel];
+    }
+}
+
+static void MinMaxDraw(const IceTDouble *projection_matrix,
+                       const IceTDouble *modelview_matrix,
+                       const IceTFloat *background_color,
+                       const IceTInt *readback_viewport,
+                       IceTImage result)
+{
+    IceTInt rank;
+    IceTEnum color_format;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType num_channels;
+    IceTVoid *colors;
+    IceTFloat *depths = NULL;
+    IceTSizeType x, y, channel;
+
+    /* Not using these. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)readback_viewport;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    color_format = icetImageGetColorFormat(result);
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    num_channels = MinMaxNumChannels(color_format);
+    colors = icetImageGetColorVoid(result, NULL);
+    if (icetImageGetDepthFormat(result) == ICET_IMAGE_DEPTH_FLOAT) {
+        depths = icetImageGetDepthf(result);
+    }
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTBoolean active = MinMaxActive(rank, x, y);
+            for (channel = 0; channel < num_channels; channel++) {
+                IceTSizeType index = num_channels*pixel + channel;
+                IceTFloat value_f;
+                if (active) {
+                    value_f = MinMaxValue(rank, x, y, channel)
+                        /MIN_MAX_FLOAT_SCALE;
+                } else {
+                    value_f = background_color[channel];
+                }
+                switch (color_format) {
+                  case ICET_IMAGE_COLOR_RGBA_UBYTE:
+                      ((IceTUByte *)colors)[index] = (IceTUByte)(
+                          active
+                          ? MinMaxValue(rank, x, y, channel)
+                          : 255*background_color[channel]);
+                      break;
+                  case ICET_IMAGE_COLOR_R_UINT:
+                      ((IceTUInt *)colors)[index]
+                          = active ? MinMaxValue(rank, x, y, channel) : 0;
+                      break;
+                  case ICET_IMAGE_COLOR_RGBA_HALF:
+                      icetSIMDFloatToHalf(&value_f,
+                                          (IceTUShort *)colors + index,
+                                          1);
+                      break;
+                  default:
+                      ((IceTFloat *)colors)[index] = value_f;
+                      break;
+                }
+            }
+            if (depths != NULL) {
+                depths[pixel] = active ? 0.5f : 1.0f;
+            }
+        }
+    }
+}
+
+static void MinMaxSetupRender(IceTEnum composite_mode,
+                              IceTEnum color_format,
+                              IceTEnum depth_format)
+{
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+    icetEnable(ICET_CORRECT_COLORED_BACKGROUND);
+
+    icetDrawCallback(MinMaxDraw);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+}
+
+/* Converts the colors of the image to doubles in the units of MinMaxValue. */
+static IceTDouble *MinMaxGetValues(const IceTImage image)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTSizeType num_values
+        = MinMaxNumChannels(color_format)*icetImageGetNumPixels(image);
+    IceTDouble *values = malloc(num_values*sizeof(IceTDouble));
+    IceTFloat *converted = NULL;
+    const IceTFloat *colors_f = NULL;
+    IceTSizeType i;
+
+    if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        converted = malloc(num_values*sizeof(IceTFloat));
+        icetImageCopyColorf(image, converted, ICET_IMAGE_COLOR_RGBA_FLOAT);
+        colors_f = converted;
+    } else if (   (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+               || (color_format == ICET_IMAGE_COLOR_R_FLOAT) ) {
+        colors_f = icetImageGetColorcf(image);
+    }
+
+    for (i = 0; i < num_values; i++) {
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            values[i] = icetImageGetColorcub(image)[i];
+        } else if (color_format == ICET_IMAGE_COLOR_R_UINT) {
+            values[i] = icetImageGetColorcui(image)[i];
+        } else {
+            values[i] = MIN_MAX_FLOAT_SCALE*colors_f[i];
+        }
+    }
+
+    if (converted != NULL) {
+        free(converted);
+    }
+    return values;
+}
+
+static int MinMaxCheckImage(const IceTImage image, IceTEnum composite_mode)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTEnum color_format;
+    IceTSizeType num_channels;
+    IceTDouble *values;
+    IceTSizeType x, y, channel;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) return TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    color_format = icetImageGetColorFormat(image);
+    num_channels = MinMaxNumChannels(color_format);
+    values = MinMaxGetValues(image);
+
+    for (y = 0; (y < SCREEN_HEIGHT) && (result == TEST_PASSED); y++) {
+        for (x = 0; (x < SCREEN_WIDTH) && (result == TEST_PASSED); x++) {
+            for (channel = 0; channel < num_channels; channel++) {
+                IceTDouble value
+                    = values[num_channels*(y*SCREEN_WIDTH + x) + channel];
+                IceTDouble expected = -1.0;
+                IceTInt p;
+                for (p = 0; p < num_proc; p++) {
+                    IceTInt v;
+                    if (!MinMaxActive(p, x, y)) continue;
+                    v = MinMaxValue(p, x, y, channel);
+                    if (   (expected < 0.0)
+                        || (   (composite_mode == ICET_COMPOSITE_MODE_MAX)
+                            ? (v > expected) : (v < expected) ) ) {
+                        expected = v;
+                    }
+                }
+                if (expected < 0.0) {
+                    expected = MinMaxBackgroundValue(color_format, channel);
+                }
+                if (value != expected) {
+                    printrank("**** Found bad pixel!!!! ****\n");
+                    printrank("Location x = %d, y = %d, channel = %d\n",
+                              (int)x, (int)y, (int)channel);
+                    printrank("Got value %f\n", value);
+                    printrank("Expected %f\n", expected);
+                    result = TEST_FAILED;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(values);
+    return result;
+}
+
+static int MinMaxTryRender(IceTEnum composite_mode,
+                           IceTEnum color_format,
+                           IceTEnum depth_format)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+
+    MinMaxSetupRender(composite_mode, color_format, depth_format);
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    return MinMaxCheckImage(image, composite_mode);
+}
+
+static int MinMaxTryStrategy(IceTEnum composite_mode,
+                             IceTEnum color_format,
+                             IceTEnum depth_format)
+{
+    int result = TEST_PASSED;
+    int strategy_idx;
+
+    for (strategy_idx = 0; strategy_idx < STRATEGY_LIST_SIZE; strategy_idx++) {
+        IceTEnum strategy = strategy_list[strategy_idx];
+        int single_image_strategy_idx;
+        int num_single_image_strategies;
+
+        icetStrategy(strategy);
+        printstat("Trying strategy %s\n", icetGetStrategyName());
+
+        if (strategy_uses_single_image_strategy(strategy)) {
+            num_single_image_strategies = SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+        } else {
+            num_single_image_strategies = 1;
+        }
+
+        for (single_image_strategy_idx = 0;
+             single_image_strategy_idx < num_single_image_strategies;
+             single_image_strategy_idx++) {
+            icetSingleImageStrategy(
+                      single_image_strategy_list[single_image_strategy_idx]);
+            printstat("  Using single image strategy %s\n",
+                      icetGetSingleImageStrategyName());
+            result += MinMaxTryRender(composite_mode,
+                                      color_format,
+                                      depth_format);
+        }
+    }
+
+    return result;
+}
+
+static int MinMaxTryFormats(IceTEnum composite_mode)
+{
+    IceTEnum color_formats[5];
+    IceTEnum depth_formats[2];
+    int color_idx, depth_idx;
+    int result = TEST_PASSED;
+
+    color_formats[0] = ICET_IMAGE_COLOR_RGBA_UBYTE;
+    color_formats[1] = ICET_IMAGE_COLOR_RGBA_FLOAT;
+    color_formats[2] = ICET_IMAGE_COLOR_RGBA_HALF;
+    color_formats[3] = ICET_IMAGE_COLOR_R_FLOAT;
+    color_formats[4] = ICET_IMAGE_COLOR_R_UINT;
+    depth_formats[0] = ICET_IMAGE_DEPTH_FLOAT;
+    depth_formats[1] = ICET_IMAGE_DEPTH_NONE;
+
+    for (depth_idx = 0; depth_idx < 2; depth_idx++) {
+        for (color_idx = 0; color_idx < 5; color_idx++) {
+            printstat("Testing color format 0x%X, depth format 0x%X\n",
+                      color_formats[color_idx], depth_formats[depth_idx]);
+            result += MinMaxTryStrategy(composite_mode,
+                                        color_formats[color_idx],
+                                        depth_formats[depth_idx]);
+        }
+    }
+
+    return result;
+}
+
+static int MinMaxCompositeRun(void)
+{
+    int result = TEST_PASSED;
+
+    printstat("Testing maximum composite\n");
+    result += MinMaxTryFormats(ICET_COMPOSITE_MODE_MAX);
+
+    printstat("Testing minimum composite\n");
+    result += MinMaxTryFormats(ICET_COMPOSITE_MODE_MIN);
+
+    return result;
+}
+
+int MinMaxComposite(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(MinMaxCompositeRun);
+}
@@ -0,0 +1,358 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This tests the ICET_DOUBLE_ACCUMULATION and ICET_REPRODUCIBLE_ACCUMULATION
+** options of the ICET_COMPOSITE_MODE_ADD composite mode.  Every process draws
+** values of widely varying magnitude and sign into the left half of the image,
+** so summing them in float gives results that depend on the order of the
+** additions.  With either option the composited image should be close to
+** the sum computed in double precision.  With reproducible accumulation, the
+** image should also be bit for bit the same for every strategy and every
+** ICET_MAGIC_K, including when compositing in ICET_BLOCK_TILED_IMAGES order.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+/* Holds the first image composited with reproducible accumulation, against
+   which all the others are compared. */
+static IceTFloat *g_first_image = NULL;
+
+/* The value drawn by process rank for the given pixel and channel.  The
+   values are never zero and range over about 12 orders of magnitude. */
+static IceTFloat ReproducibleAddValue(IceTInt rank,
+                                      IceTSizeType pixel,
+                                      IceTSizeType channel)
+{
+    unsigned int seed;
+    double mantissa;
+    int exponent;
+
+    seed = (unsigned int)(rank*7919 + pixel*31 + channel*104729);
+    seed = seed*1103515245u + 12345u;
+    seed ^= seed >> 16;
+    seed = seed*1103515245u + 12345u;
+
+    mantissa = 0.5 + (double)((seed >> 8) & 0xFFFF)/65536.0;
+    exponent = (int)((seed >> 24) % 41) - 20;
+    if (seed & 0x80) mantissa = -mantissa;
+
+    return (IceTFloat)ldexp(mantissa, exponent);
+}
+
+static IceTSizeType ReproducibleAddNumChannels(IceTEnum color_format)
+{
+    if (color_format == ICET_IMAGE_COLOR_R_FLOAT) {
+        return 1;
+    } else {
+        return 4;
+    }
+}
+
+static void ReproducibleAddDraw(const IceTDouble *projection_matrix,
+                                const IceTDouble *modelview_matrix,
+                                const IceTFloat *background_color,
+                                const IceTInt *readback_viewport,
+                                IceTImage result)
+{
+    IceTInt rank;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType num_channels;
+    IceTFloat *colors;
+    IceTFloat *depths = NULL;
+    IceTSizeType x, y, channel;
+
+    /* Not using these. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)readback_viewport;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    num_channels
+        = ReproducibleAddNumChannels(icetImageGetColorFormat(result));
+    colors = icetImageGetColorf(result);
+    if (icetImageGetDepthFormat(result) == ICET_IMAGE_DEPTH_FLOAT) {
+        depths = icetImageGetDepthf(result);
+    }
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            IceTSizeType pixel = y*width + x;
+            for (channel = 0; channel < num_channels; channel++) {
+                if (x < width/2) {
+                    colors[num_channels*pixel + channel]
+                        = ReproducibleAddValue(rank, pixel, channel);
+                } else {
+                    colors[num_channels*pixel + channel]
+                        = background_color[channel];
+                }
+            }
+            if (depths != NULL) {
+                depths[pixel] = (x < width/2) ? 0.5f : 1.0f;
+            }
+        }
+    }
+}
+
+static void ReproducibleAddSetupRender(IceTEnum color_format,
+                                       IceTEnum depth_format)
+{
+    icetCompositeMode(ICET_COMPOSITE_MODE_ADD);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+
+    icetDrawCallback(ReproducibleAddDraw);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+}
+
+/* Compares the image against the sum computed in double.  The accumulated
+   sum is only exact up to about 2^-32 of the largest value added, and the
+   final result is rounded to float. */
+static int ReproducibleAddCheckSum(const IceTFloat *colors,
+                                   IceTSizeType num_channels)
+{
+    IceTInt num_proc;
+    IceTSizeType x, y, channel;
+    IceTInt rank;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    for (y = 0; y < SCREEN_HEIGHT; y++) {
+        for (x = 0; x < SCREEN_WIDTH; x++) {
+            IceTSizeType pixel = y*SCREEN_WIDTH + x;
+            for (channel = 0; channel < num_channels; channel++) {
+                IceTDouble sum = 0.0;
+                IceTDouble magnitude = 0.0;
+                IceTDouble value = colors[num_channels*pixel + channel];
+                if (x < SCREEN_WIDTH/2) {
+                    for (rank = 0; rank < num_proc; rank++) {
+                        IceTDouble v
+                            = ReproducibleAddValue(rank, pixel, channel);
+                        sum += v;
+                        magnitude += fabs(v);
+                    }
+                }
+                if (  fabs(value - sum)
+                    > 1.0e-6*fabs(sum) + 1.0e-9*magnitude) {
+                    printrank("**** Found bad pixel!!!! ****\n");
+                    printrank("Location x = %d, y = %d, channel = %d\n",
+                              (int)x, (int)y, (int)channel);
+                    printrank("Got value %g\n", value);
+                    printrank("Expected %g\n", sum);
+                    return TEST_FAILED;
+                }
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int ReproducibleAddCheckImage(const IceTImage image,
+                                     IceTBoolean reproducible)
+{
+    IceTInt rank;
+    IceTSizeType num_channels;
+    IceTSizeType image_size;
+    const IceTFloat *colors;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) return TEST_PASSED;
+
+    num_channels
+        = ReproducibleAddNumChannels(icetImageGetColorFormat(image));
+    image_size = num_channels*SCREEN_WIDTH*SCREEN_HEIGHT*sizeof(IceTFloat);
+    colors = icetImageGetColorcf(image);
+
+    if (ReproducibleAddCheckSum(colors, num_channels) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    if (reproducible) {
+        if (g_first_image == NULL) {
+            g_first_image = malloc(image_size);
+            memcpy(g_first_image, colors, image_size);
+        } else if (memcmp(g_first_image, colors, image_size) != 0) {
+            printrank("**** Image differs from first composite ****\n");
+            return TEST_FAILED;
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int ReproducibleAddTryRender(IceTEnum color_format,
+                                    IceTEnum depth_format,
+                                    IceTBoolean reproducible)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+
+    ReproducibleAddSetupRender(color_format, depth_format);
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    return ReproducibleAddCheckImage(image, reproducible);
+}
+
+static int ReproducibleAddTryMagicK(IceTEnum color_format,
+                                    IceTEnum depth_format,
+                                    IceTBoolean reproducible)
+{
+    IceTEnum single_image_strategy;
+    IceTInt num_proc;
+    IceTInt magic_k;
+    int result = TEST_PASSED;
+
+    icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &single_image_strategy);
+    if (   (single_image_strategy != ICET_SINGLE_IMAGE_STRATEGY_RADIXK)
+        && (single_image_strategy != ICET_SINGLE_IMAGE_STRATEGY_RADIXKR) ) {
+        return ReproducibleAddTryRender(color_format,
+                                        depth_format,
+                                        reproducible);
+    }
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    for (magic_k = 2; magic_k <= num_proc; magic_k *= 2) {
+        printstat("    Using magic k value %d\n", magic_k);
+        icetStateSetInteger(ICET_MAGIC_K, magic_k);
+        result += ReproducibleAddTryRender(color_format,
+                                           depth_format,
+                                           reproducible);
+    }
+    icetStateSetInteger(ICET_MAGIC_K, ICET_MAGIC_K_DEFAULT);
+
+    return result;
+}
+
+static int ReproducibleAddTryStrategy(IceTEnum color_format,
+                                      IceTEnum depth_format,
+                                      IceTBoolean reproducible)
+{
+    int result = TEST_PASSED;
+    int strategy_idx;
+
+    if (g_first_image != NULL) {
+        free(g_first_image);
+        g_first_image = NULL;
+    }
+
+    for (strategy_idx = 0; strategy_idx < STRATEGY_LIST_SIZE; strategy_idx++) {
+        IceTEnum strategy = strategy_list[strategy_idx];
+        int single_image_strategy_idx;
+        int num_single_image_strategies;
+
+        icetStrategy(strategy);
+        printstat("Trying strategy %s\n", icetGetStrategyName());
+
+        if (strategy_uses_single_image_strategy(strategy)) {
+            num_single_image_strategies = SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+        } else {
+            num_single_image_strategies = 1;
+        }
+
+        for (single_image_strategy_idx = 0;
+             single_image_strategy_idx < num_single_image_strategies;
+             single_image_strategy_idx++) {
+            icetSingleImageStrategy(
+                      single_image_strategy_list[single_image_strategy_idx]);
+            printstat("  Using single image strategy %s\n",
+                      icetGetSingleImageStrategyName());
+            result += ReproducibleAddTryMagicK(color_format,
+                                               depth_format,
+                                               reproducible);
+        }
+    }
+
+    return result;
+}
+
+static int ReproducibleAddRun(void)
+{
+    int result = TEST_PASSED;
+
+    icetEnable(ICET_REPRODUCIBLE_ACCUMULATION);
+
+    printstat("Testing reproducible RGBA float colors with depth\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                         ICET_IMAGE_DEPTH_FLOAT,
+                                         ICET_TRUE);
+
+    printstat("Testing reproducible RGBA float colors without depth\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                         ICET_IMAGE_DEPTH_NONE,
+                                         ICET_TRUE);
+
+    printstat("Testing reproducible single channel float colors\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_R_FLOAT,
+                                         ICET_IMAGE_DEPTH_NONE,
+                                         ICET_TRUE);
+
+    icetEnable(ICET_BLOCK_TILED_IMAGES);
+    printstat("Testing reproducible RGBA float colors in block order\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                         ICET_IMAGE_DEPTH_FLOAT,
+                                         ICET_TRUE);
+    icetDisable(ICET_BLOCK_TILED_IMAGES);
+
+    icetDisable(ICET_REPRODUCIBLE_ACCUMULATION);
+    icetEnable(ICET_DOUBLE_ACCUMULATION);
+
+    printstat("Testing double RGBA float colors with depth\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                         ICET_IMAGE_DEPTH_FLOAT,
+                                         ICET_FALSE);
+
+    printstat("Testing double single channel float colors\n");
+    result += ReproducibleAddTryStrategy(ICET_IMAGE_COLOR_R_FLOAT,
+                                         ICET_IMAGE_DEPTH_NONE,
+                                         ICET_FALSE);
+
+    icetDisable(ICET_DOUBLE_ACCUMULATION);
+
+    if (g_first_image != NULL) {
+        free(g_first_image);
+        g_first_image = NULL;
+    }
+
+    return result;
+}
+
+int ReproducibleAdd(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ReproducibleAddRun);
+}
@@ -0,0 +1,672 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that the vectorized kernels used by icetComposite and
+** the image compressor give exactly the same results as the scalar code for
+** every instruction set level the processor supports.  It also checks that
+** ICET_BLEND_ALPHA_CUTOFF drops exactly the pixels below the cutoff.
+*****************************************************************************/
+
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevSIMD.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Deliberately not a multiple of any vector width. */
+#define SIMD_IMAGE_WIDTH        67
+#define SIMD_IMAGE_HEIGHT       13
+
+static const char *SIMDLevelName(IceTInt level)
+{
+    switch (level) {
+      case ICET_SIMD_LEVEL_SCALAR:      return "scalar";
+      case ICET_SIMD_LEVEL_SSE2:        return "SSE2";
+      case ICET_SIMD_LEVEL_AVX2:        return "AVX2";
+      case ICET_SIMD_LEVEL_AVX512:      return "AVX-512";
+      default:                          return "unknown";
+    }
+}
+
+static void InitRandomImage(IceTImage image)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTSizeType i;
+
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUByte *color = icetImageGetColorub(image);
+        for (i = 0; i < num_pixels; i++) {
+            IceTUByte alpha = (IceTUByte)(rand()%256);
+            /* Mostly premultiplied, but include some colors brighter than
+               alpha so that the byte arithmetic overflows. */
+            IceTInt limit = (rand()%8 == 0) ? 255 : alpha;
+            color[4*i+0] = (IceTUByte)(rand()%(limit+1));
+            color[4*i+1] = (IceTUByte)(rand()%(limit+1));
+            color[4*i+2] = (IceTUByte)(rand()%(limit+1));
+            color[4*i+3] = alpha;
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        IceTFloat *color = icetImageGetColorf(image);
+        for (i = 0; i < num_pixels; i++) {
+            IceTFloat alpha = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            color[4*i+0] = alpha*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            color[4*i+1] = alpha*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            color[4*i+2] = alpha*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            color[4*i+3] = alpha;
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        IceTUShort *color = icetImageGetColorVoid(image, NULL);
+        for (i = 0; i < num_pixels; i++) {
+            IceTFloat pixel[4];
+            pixel[3] = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            pixel[0] = pixel[3]*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            pixel[1] = pixel[3]*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            pixel[2] = pixel[3]*(IceTFloat)rand()/(IceTFloat)RAND_MAX;
+            icetSIMDFloatToHalf(pixel, color + 4*i, 4);
+        }
+    }
+
+    if (icetImageGetDepthFormat(image) == ICET_IMAGE_DEPTH_FLOAT) {
+        IceTFloat *depth = icetImageGetDepthf(image);
+        for (i = 0; i < num_pixels; i++) {
+            /* Coarse values so that some depths tie. */
+            depth[i] = (IceTFloat)(rand()%17)/16.0f;
+        }
+    }
+}
+
+static int CompareImages(const IceTImage reference, const IceTImage image)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(reference);
+    IceTSizeType pixel_size;
+    const IceTVoid *reference_data;
+    const IceTVoid *image_data;
+
+    reference_data = icetImageGetColorConstVoid(reference, &pixel_size);
+    image_data = icetImageGetColorConstVoid(image, &pixel_size);
+    if (   (pixel_size > 0)
+        && (memcmp(reference_data, image_data, num_pixels*pixel_size) != 0)) {
+        printrank("*** Colors differ from scalar result ***\n");
+        return TEST_FAILED;
+    }
+
+    reference_data = icetImageGetDepthConstVoid(reference, &pixel_size);
+    image_data = icetImageGetDepthConstVoid(image, &pixel_size);
+    if (   (pixel_size > 0)
+        && (memcmp(reference_data, image_data, num_pixels*pixel_size) != 0)) {
+        printrank("*** Depths differ from scalar result ***\n");
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+static int TryComposite(IceTEnum composite_mode,
+                        IceTEnum color_format,
+                        IceTEnum depth_format,
+                        int src_on_top)
+{
+    IceTVoid *buffers[4];
+    IceTImage src_image, dest_image, reference_image, test_image;
+    IceTSizeType buffer_size;
+    IceTInt supported_level;
+    IceTInt level;
+    int result = TEST_PASSED;
+
+    printstat("Mode 0x%X, color 0x%X, depth 0x%X, %s\n",
+              composite_mode, color_format, depth_format,
+              src_on_top ? "source on top" : "destination on top");
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+
+    buffer_size = icetImageBufferSize(SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+    for (level = 0; level < 4; level++) {
+        buffers[level] = malloc(buffer_size);
+    }
+    src_image = icetImageAssignBuffer(buffers[0],
+                                      SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+    dest_image = icetImageAssignBuffer(buffers[1],
+                                       SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+    reference_image = icetImageAssignBuffer(buffers[2],
+                                            SIMD_IMAGE_WIDTH,
+                                            SIMD_IMAGE_HEIGHT);
+    test_image = icetImageAssignBuffer(buffers[3],
+                                       SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+
+    InitRandomImage(src_image);
+    InitRandomImage(dest_image);
+
+    icetSIMDSetLevel(ICET_SIMD_LEVEL_SCALAR);
+    icetImageCopyPixels(dest_image, 0, reference_image, 0,
+                        icetImageGetNumPixels(dest_image));
+    icetComposite(reference_image, src_image, src_on_top);
+
+    icetSIMDSetLevel(ICET_SIMD_LEVEL_AVX512);
+    supported_level = icetSIMDGetLevel();
+    for (level = ICET_SIMD_LEVEL_SSE2; level <= supported_level; level++) {
+        printstat("  Checking %s\n", SIMDLevelName(level));
+        icetSIMDSetLevel(level);
+        icetImageCopyPixels(dest_image, 0, test_image, 0,
+                            icetImageGetNumPixels(dest_image));
+        icetComposite(test_image, src_image, src_on_top);
+        if (CompareImages(reference_image, test_image) != TEST_PASSED) {
+            printrank("*** Failed with %s ***\n", SIMDLevelName(level));
+            result = TEST_FAILED;
+            break;
+        }
+    }
+
+    /* Restore the default. */
+    icetSIMDSetLevel(-1);
+
+    for (level = 0; level < 4; level++) {
+        free(buffers[level]);
+    }
+
+    return result;
+}
+
+/* Fills the image with alternating runs of active and inactive pixels of
+   random length.  Inactive pixels are whatever the current composite mode
+   considers background, with some junk in the channels that do not count. */
+static void InitRunImage(IceTImage image)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTEnum composite_mode;
+    IceTUByte *color_ub = NULL;
+    IceTFloat *color_f = NULL;
+    IceTUShort *color_h = NULL;
+    IceTFloat *depth = NULL;
+    IceTSizeType i = 0;
+    IceTBoolean active = (rand()%2 == 0);
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        color_ub = icetImageGetColorub(image);
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        color_f = icetImageGetColorf(image);
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_HALF) {
+        color_h = icetImageGetColorVoid(image, NULL);
+    }
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        depth = icetImageGetDepthf(image);
+    }
+
+    while (i < num_pixels) {
+        IceTSizeType run_end = i + 1 + rand()%40;
+        if (run_end > num_pixels) run_end = num_pixels;
+        for ( ; i < run_end; i++) {
+            int channel;
+            for (channel = 0; channel < 4; channel++) {
+                if (color_ub != NULL) {
+                    color_ub[4*i+channel] = (IceTUByte)(1 + rand()%255);
+                }
+                if (color_f != NULL) {
+                    color_f[4*i+channel] = (IceTFloat)(1 + rand()%255)/255.0f;
+                }
+                if (color_h != NULL) {
+                    /* Positive normal halves. */
+                    color_h[4*i+channel]
+                        = (IceTUShort)(0x0400 + rand()%0x7800);
+                }
+            }
+            if (depth != NULL) {
+                depth[i] = (IceTFloat)(rand()%16)/16.0f;
+            }
+            if (active) continue;
+
+            if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+                depth[i] = 1.0f;
+            } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+                if (color_ub != NULL) color_ub[4*i+3] = 0;
+                if (color_f != NULL) {
+                    color_f[4*i+3] = (rand()%2 == 0) ? 0.0f : -0.0f;
+                }
+                if (color_h != NULL) {
+                    color_h[4*i+3] = (rand()%2 == 0) ? 0x0000 : 0x8000;
+                }
+            } else {
+                for (channel = 0; channel < 4; channel++) {
+                    if (color_ub != NULL) color_ub[4*i+channel] = 0;
+                    if (color_f != NULL) {
+                        color_f[4*i+channel]
+                            = (rand()%2 == 0) ? 0.0f : -0.0f;
+                    }
+                    if (color_h != NULL) {
+                        color_h[4*i+channel]
+                            = (rand()%2 == 0) ? 0x0000 : 0x8000;
+                    }
+                }
+            }
+        }
+        active = !active;
+    }
+}
+
+static int CompareSparseImages(const IceTSparseImage reference,
+                               const IceTSparseImage image)
+{
+    IceTSizeType size = icetSparseImageGetCompressedBufferSize(reference);
+    if (size != icetSparseImageGetCompressedBufferSize(image)) {
+        printrank("*** Compressed sizes differ: %d vs %d ***\n",
+                  (int)size, (int)icetSparseImageGetCompressedBufferSize(image));
+        return TEST_FAILED;
+    }
+    if (memcmp(reference.opaque_internals, image.opaque_internals, size)
+        != 0) {
+        printrank("*** Compressed data differs from scalar result ***\n");
+        return TEST_FAILED;
+    }
+    return TEST_PASSED;
+}
+
+static int TryCompress(IceTEnum composite_mode,
+                       IceTEnum color_format,
+                       IceTEnum depth_format)
+{
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffers[2];
+    IceTImage image;
+    IceTSparseImage reference_image, test_image;
+    IceTSizeType num_pixels = SIMD_IMAGE_WIDTH*SIMD_IMAGE_HEIGHT;
+    IceTSizeType offset, sub_pixels;
+    IceTInt supported_level;
+    IceTInt level;
+    int result = TEST_PASSED;
+
+    printstat("Compress mode 0x%X, color 0x%X, depth 0x%X\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+
+    image_buffer
+        = malloc(icetImageBufferSize(SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer,
+                                  SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+    sparse_buffers[0] = malloc(icetSparseImageBufferSize(SIMD_IMAGE_WIDTH,
+                                                         SIMD_IMAGE_HEIGHT));
+    sparse_buffers[1] = malloc(icetSparseImageBufferSize(SIMD_IMAGE_WIDTH,
+                                                         SIMD_IMAGE_HEIGHT));
+
+    InitRunImage(image);
+
+    /* Also try a piece that does not start on a vector boundary. */
+    offset = 1 + rand()%17;
+    sub_pixels = num_pixels - offset - rand()%17;
+
+    icetSIMDSetLevel(ICET_SIMD_LEVEL_AVX512);
+    supported_level = icetSIMDGetLevel();
+    for (level = ICET_SIMD_LEVEL_SSE2; level <= supported_level; level++) {
+        printstat("  Checking %s\n", SIMDLevelName(level));
+
+        reference_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                                      SIMD_IMAGE_WIDTH,
+                                                      SIMD_IMAGE_HEIGHT);
+        test_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                                 SIMD_IMAGE_WIDTH,
+                                                 SIMD_IMAGE_HEIGHT);
+        icetSIMDSetLevel(ICET_SIMD_LEVEL_SCALAR);
+        icetCompressImage(image, reference_image);
+        icetSIMDSetLevel(level);
+        icetCompressImage(image, test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) break;
+
+        reference_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                                      sub_pixels, 1);
+        test_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                                 sub_pixels, 1);
+        icetSIMDSetLevel(ICET_SIMD_LEVEL_SCALAR);
+        icetCompressSubImage(image, offset, sub_pixels, reference_image);
+        icetSIMDSetLevel(level);
+        icetCompressSubImage(image, offset, sub_pixels, test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) break;
+    }
+    if (result != TEST_PASSED) {
+        printrank("*** Failed with %s ***\n", SIMDLevelName(level));
+    }
+
+    /* Restore the default. */
+    icetSIMDSetLevel(-1);
+
+    free(image_buffer);
+    free(sparse_buffers[0]);
+    free(sparse_buffers[1]);
+
+    return result;
+}
+
+/* Compresses blended images with ICET_BLEND_ALPHA_CUTOFF, checking every
+   level against the scalar code and that decompressing the result clears
+   exactly the pixels with alpha below the cutoff. */
+#define ALPHA_CUTOFF            0.5f
+static int TryAlphaCutoff(IceTEnum color_format)
+{
+    static const IceTFloat zero_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    IceTVoid *image_buffers[2];
+    IceTVoid *sparse_buffer;
+    IceTImage image, decompressed_image;
+    IceTSparseImage sparse_image;
+    IceTSizeType num_pixels = SIMD_IMAGE_WIDTH*SIMD_IMAGE_HEIGHT;
+    IceTSizeType pixel_size;
+    const IceTByte *colors;
+    const IceTByte *decompressed_colors;
+    IceTSizeType i;
+    int result;
+
+    icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, ALPHA_CUTOFF);
+    result = TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                         color_format,
+                         ICET_IMAGE_DEPTH_NONE);
+    if (result != TEST_PASSED) {
+        icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, 0.0f);
+        return result;
+    }
+
+    printstat("Alpha cutoff %g, color 0x%X\n", ALPHA_CUTOFF, color_format);
+
+    icetStateSetFloatv(ICET_BACKGROUND_COLOR, 4, zero_color);
+    icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, 0);
+
+    image_buffers[0]
+        = malloc(icetImageBufferSize(SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT));
+    image_buffers[1]
+        = malloc(icetImageBufferSize(SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT));
+    sparse_buffer = malloc(icetSparseImageBufferSize(SIMD_IMAGE_WIDTH,
+                                                     SIMD_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffers[0],
+                                  SIMD_IMAGE_WIDTH, SIMD_IMAGE_HEIGHT);
+    decompressed_image = icetImageAssignBuffer(image_buffers[1],
+                                               SIMD_IMAGE_WIDTH,
+                                               SIMD_IMAGE_HEIGHT);
+    sparse_image = icetSparseImageAssignBuffer(sparse_buffer,
+                                               SIMD_IMAGE_WIDTH,
+                                               SIMD_IMAGE_HEIGHT);
+
+    InitRunImage(image);
+    icetCompressImage(image, sparse_image);
+    icetDecompressImage(sparse_image, decompressed_image);
+
+    colors = icetImageGetColorConstVoid(image, &pixel_size);
+    decompressed_colors
+        = icetImageGetColorConstVoid(decompressed_image, NULL);
+    for (i = 0; i < num_pixels; i++) {
+        const IceTByte *pixel = colors + i*pixel_size;
+        const IceTByte *decompressed_pixel = decompressed_colors + i*pixel_size;
+        IceTFloat alpha;
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            alpha = (IceTFloat)((const IceTUByte *)pixel)[3]/255.0f;
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            alpha = ((const IceTFloat *)pixel)[3];
+        } else {
+            icetSIMDHalfToFloat((const IceTUShort *)pixel + 3, &alpha, 1);
+        }
+
+        if (alpha >= ALPHA_CUTOFF) {
+            if (memcmp(pixel, decompressed_pixel, pixel_size) != 0) {
+                printrank("*** Pixel %d with alpha %g was changed ***\n",
+                          (int)i, alpha);
+                result = TEST_FAILED;
+                break;
+            }
+        } else {
+            IceTSizeType byte;
+            for (byte = 0; byte < pixel_size; byte++) {
+                if (decompressed_pixel[byte] != 0) break;
+            }
+            if (byte < pixel_size) {
+                printrank("*** Pixel %d with alpha %g was kept ***\n",
+                          (int)i, alpha);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    icetStateSetFloat(ICET_BLEND_ALPHA_CUTOFF, 0.0f);
+
+    free(image_buffers[0]);
+    free(image_buffers[1]);
+    free(sparse_buffer);
+
+    return result;
+}
+#undef ALPHA_CUTOFF
+
+/* Converts every half value to float and back, and a spread of float values
+   (including ones that round, overflow, and underflow) to half, checking that
+   every level matches the scalar conversion and that halves survive the round
+   trip. */
+#define HALF_FLOAT_COUNT        4096
+static int TryHalfConversion(void)
+{
+    IceTUShort *halves;
+    IceTUShort *reference_halves;
+    IceTUShort *test_halves;
+    IceTFloat *floats;
+    IceTFloat *reference_floats;
+    IceTFloat *test_floats;
+    IceTInt supported_level;
+    IceTInt level;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    printstat("Half precision conversion\n");
+
+    halves = malloc(65536*sizeof(IceTUShort));
+    reference_halves = malloc(65536*sizeof(IceTUShort));
+    test_halves = malloc(65536*sizeof(IceTUShort));
+    floats = malloc(65536*sizeof(IceTFloat));
+    reference_floats = malloc(65536*sizeof(IceTFloat));
+    test_floats = malloc(65536*sizeof(IceTFloat));
+
+    for (i = 0; i < 65536; i++) {
+        halves[i] = (IceTUShort)i;
+    }
+    for (i = 0; i < HALF_FLOAT_COUNT; i++) {
+        /* Random mantissa bits over a range of exponents well past what
+           half precision can represent. */
+        IceTFloat value = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+        IceTInt exponent = rand()%60 - 36;
+        while (exponent > 0) { value *= 2.0f; exponent--; }
+        while (exponent < 0) { value *= 0.5f; exponent++; }
+        floats[i] = (rand()%2 == 0) ? value : -value;
+    }
+
+    icetSIMDSetLevel(ICET_SIMD_LEVEL_SCALAR);
+    icetSIMDHalfToFloat(halves, reference_floats, 65536);
+    icetSIMDFloatToHalf(reference_floats, reference_halves, 65536);
+    for (i = 0; i < 65536; i++) {
+        IceTBoolean is_nan = (   ((halves[i] & 0x7C00) == 0x7C00)
+                              && ((halves[i] & 0x03FF) != 0) );
+        if (!is_nan && (reference_halves[i] != halves[i])) {
+            printrank("*** Half 0x%04X became 0x%04X ***\n",
+                      halves[i], reference_halves[i]);
+            result = TEST_FAILED;
+            break;
+        }
+    }
+    icetSIMDFloatToHalf(floats, reference_halves, HALF_FLOAT_COUNT);
+
+    icetSIMDSetLevel(ICET_SIMD_LEVEL_AVX512);
+    supported_level = icetSIMDGetLevel();
+    for (level = ICET_SIMD_LEVEL_SSE2;
+         (level <= supported_level) && (result == TEST_PASSED);
+         level++) {
+        printstat("  Checking %s\n", SIMDLevelName(level));
+        icetSIMDSetLevel(level);
+        icetSIMDHalfToFloat(halves, test_floats, 65536);
+        if (memcmp(reference_floats, test_floats, 65536*sizeof(IceTFloat))
+            != 0) {
+            printrank("*** Half to float differs with %s ***\n",
+                      SIMDLevelName(level));
+            result = TEST_FAILED;
+        }
+        icetSIMDFloatToHalf(floats, test_halves, HALF_FLOAT_COUNT);
+        if (memcmp(reference_halves, test_halves,
+                   HALF_FLOAT_COUNT*sizeof(IceTUShort)) != 0) {
+            printrank("*** Float to half differs with %s ***\n",
+                      SIMDLevelName(level));
+            result = TEST_FAILED;
+        }
+    }
+
+    /* Restore the default. */
+    icetSIMDSetLevel(-1);
+
+    free(halves);
+    free(reference_halves);
+    free(test_halves);
+    free(floats);
+    free(reference_floats);
+    free(test_floats);
+
+    return result;
+}
+#undef HALF_FLOAT_COUNT
+
+static int SIMDCompositeRun(void)
+{
+    unsigned int seed;
+    int src_on_top;
+
+    seed = (unsigned int)time(NULL);
+    printstat("Using seed %u\n", seed);
+    srand(seed);
+
+    printstat("Processor supports %s\n", SIMDLevelName(icetSIMDGetLevel()));
+
+    if (TryHalfConversion() != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    for (src_on_top = 0; src_on_top < 2; src_on_top++) {
+        if (TryComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                         ICET_IMAGE_COLOR_RGBA_UBYTE,
+                         ICET_IMAGE_DEPTH_FLOAT,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                         ICET_IMAGE_COLOR_RGBA_FLOAT,
+                         ICET_IMAGE_DEPTH_FLOAT,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                         ICET_IMAGE_COLOR_NONE,
+                         ICET_IMAGE_DEPTH_FLOAT,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_BLEND,
+                         ICET_IMAGE_COLOR_RGBA_UBYTE,
+                         ICET_IMAGE_DEPTH_NONE,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_BLEND,
+                         ICET_IMAGE_COLOR_RGBA_FLOAT,
+                         ICET_IMAGE_DEPTH_NONE,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_BLEND,
+                         ICET_IMAGE_COLOR_RGBA_HALF,
+                         ICET_IMAGE_DEPTH_NONE,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+        if (TryComposite(ICET_COMPOSITE_MODE_ADD,
+                         ICET_IMAGE_COLOR_RGBA_HALF,
+                         ICET_IMAGE_DEPTH_NONE,
+                         src_on_top) != TEST_PASSED) {
+            return TEST_FAILED;
+        }
+    }
+
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_NONE,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                    ICET_IMAGE_COLOR_RGBA_HALF,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryAlphaCutoff(ICET_IMAGE_COLOR_RGBA_UBYTE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryAlphaCutoff(ICET_IMAGE_COLOR_RGBA_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryAlphaCutoff(ICET_IMAGE_COLOR_RGBA_HALF) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_ADD,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_ADD,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_ADD,
+                    ICET_IMAGE_COLOR_RGBA_HALF,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+int SIMDComposite(int argc, char *argv[])
+{
+    /* To remove warning */
+    (void)argc;
+    (void)argv;
+
+    return run_test(SIMDCompositeRun);
+}
@@ -0,0 +1,539 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test forks processes that communicate through the shared memory
+** communicator.  It checks messages big enough to be split into fragments,
+** collective operations, and subsets, and then composites an image with
+** every strategy.  The checks are run once with all the processes sharing
+** one segment and once with a hybrid communicator that pretends the
+** processes are on two nodes, so that half the messages go through the
+** fallback communicator.  Last, a process exits while another waits for it,
+** which has to raise an error rather than hang.  Only the first MPI process
+** runs the test.
+*****************************************************************************/
+
+/* For fork and waitpid. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevCommunication.h>
+
+#ifdef ICET_USE_SHM
+#include <IceTShm.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SHM_NUM_PROCS           6
+#define SHM_PROCS_PER_NODE      3
+
+#define SHM_IMAGE_WIDTH         67
+#define SHM_IMAGE_HEIGHT        41
+
+/* Bigger than the segment, so every message is sent in fragments. */
+#define SHM_LARGE_COUNT         (4*1024*1024)
+
+#define SHM_MESSAGE_TAG         7
+
+#ifdef ICET_USE_SHM
+
+static IceTBoolean ShmPixelActive(IceTInt rank, IceTInt x, IceTInt y)
+{
+    return ((x + 3*y + rank)%4 != 0);
+}
+
+/* The depths of the processes at any one pixel are all different. */
+static IceTFloat ShmPixelDepth(IceTInt rank, IceTInt x)
+{
+    return (IceTFloat)((x + 5*rank)%SHM_NUM_PROCS + 1)
+        /(IceTFloat)(SHM_NUM_PROCS + 2);
+}
+
+static int ShmCheckMessages(void)
+{
+    IceTInt rank = icetCommRank();
+    IceTInt size = icetCommSize();
+    IceTInt send_values[SHM_NUM_PROCS];
+    IceTInt recv_values[SHM_NUM_PROCS];
+    IceTCommRequest requests[2*SHM_NUM_PROCS];
+    int indices[2*SHM_NUM_PROCS];
+    int num_left;
+    IceTInt *large_send;
+    IceTInt *large_recv;
+    IceTInt proc;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    if ((size != SHM_NUM_PROCS) || (rank < 0) || (rank >= size)) {
+        printrank("Communicator has size %d and rank %d\n", size, rank);
+        return TEST_FAILED;
+    }
+
+    for (proc = 0; proc < size; proc++) {
+        send_values[proc] = 1000*rank + proc;
+        recv_values[proc] = -1;
+        requests[proc] = icetCommIrecv(&recv_values[proc], 1, ICET_INT,
+                                       proc, SHM_MESSAGE_TAG);
+        requests[size+proc] = icetCommIsend(&send_values[proc], 1, ICET_INT,
+                                            proc, SHM_MESSAGE_TAG);
+    }
+    for (i = 0; i < 2*size; i++) {
+        IceTInt idx = icetCommWaitany(2*size, requests);
+        if ((idx < 0) || (idx >= 2*size)) {
+            printrank("Waitany returned bad index %d\n", idx);
+            return TEST_FAILED;
+        }
+        if ((idx < size) && (recv_values[idx] != 1000*idx + rank)) {
+            printrank("Got %d from %d\n", recv_values[idx], idx);
+            result = TEST_FAILED;
+        }
+    }
+
+    /* The same exchange finished with Test, Testsome and Waitsome. */
+    for (proc = 0; proc < size; proc++) {
+        recv_values[proc] = -1;
+        requests[proc] = icetCommIrecv(&recv_values[proc], 1, ICET_INT,
+                                       proc, SHM_MESSAGE_TAG);
+        requests[size+proc] = icetCommIsend(&send_values[proc], 1, ICET_INT,
+                                            proc, SHM_MESSAGE_TAG);
+    }
+    while (!icetCommTest(&requests[2*size-1])) { }
+    num_left = 2*size - 1;
+    while (num_left > 0) {
+        int num_done = icetCommTestsome(2*size, requests, indices);
+        if (num_done == 0) {
+            num_done = icetCommWaitsome(2*size, requests, indices);
+        }
+        if ((num_done < 1) || (num_done > num_left)) {
+            printrank("Waitsome finished %d of %d requests\n",
+                      num_done, num_left);
+            return TEST_FAILED;
+        }
+        for (i = 0; i < num_done; i++) {
+            int idx = indices[i];
+            if (   (idx < 0) || (idx >= 2*size)
+                || (requests[idx] != ICET_COMM_REQUEST_NULL) ) {
+                printrank("Waitsome returned bad index %d\n", idx);
+                return TEST_FAILED;
+            }
+            if ((idx < size) && (recv_values[idx] != 1000*idx + rank)) {
+                printrank("Got %d from %d\n", recv_values[idx], idx);
+                result = TEST_FAILED;
+            }
+        }
+        num_left -= num_done;
+    }
+    if (icetCommWaitsome(2*size, requests, indices) != 0) {
+        printrank("Waitsome finished requests that were done\n");
+        result = TEST_FAILED;
+    }
+
+    large_send = malloc(SHM_LARGE_COUNT*sizeof(IceTInt));
+    large_recv = malloc(SHM_LARGE_COUNT*sizeof(IceTInt));
+    for (i = 0; i < SHM_LARGE_COUNT; i++) {
+        large_send[i] = rank + i;
+    }
+    icetCommSendrecv(large_send, SHM_LARGE_COUNT, ICET_INT,
+                     (rank+1)%size, SHM_MESSAGE_TAG,
+                     large_recv, SHM_LARGE_COUNT, ICET_INT,
+                     (rank+size-1)%size, SHM_MESSAGE_TAG);
+    for (i = 0; i < SHM_LARGE_COUNT; i++) {
+        if (large_recv[i] != (rank+size-1)%size + i) {
+            printrank("Bad value in large message at %d\n", i);
+            result = TEST_FAILED;
+            break;
+        }
+    }
+
+    /* A large message that is not received yet must not keep a small one
+       from another process from getting through. */
+    if (rank == 0) {
+        icetCommSend(large_send, SHM_LARGE_COUNT, ICET_INT,
+                     1, SHM_MESSAGE_TAG);
+    } else if (rank == 2) {
+        icetCommSend(&rank, 1, ICET_INT, 1, SHM_MESSAGE_TAG);
+    } else if (rank == 1) {
+        icetCommRecv(&proc, 1, ICET_INT, 2, SHM_MESSAGE_TAG);
+        icetCommRecv(large_recv, SHM_LARGE_COUNT, ICET_INT,
+                     0, SHM_MESSAGE_TAG);
+        if (   (proc != 2)
+            || (large_recv[SHM_LARGE_COUNT-1] != SHM_LARGE_COUNT-1) ) {
+            printrank("Bad values behind an unmatched message\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    free(large_send);
+    free(large_recv);
+
+    return result;
+}
+
+static int ShmCheckCollectives(void)
+{
+    IceTInt rank = icetCommRank();
+    IceTInt size = icetCommSize();
+    IceTInt blocks[SHM_NUM_PROCS];
+    IceTInt32 group[SHM_NUM_PROCS];
+    IceTInt group_size;
+    IceTCommunicator subset;
+    IceTInt proc;
+    int result = TEST_PASSED;
+
+    for (proc = 0; proc < size; proc++) blocks[proc] = -1;
+    blocks[rank] = 3*rank;
+    icetCommAllgather(ICET_IN_PLACE_COLLECT, 1, ICET_INT, blocks);
+    for (proc = 0; proc < size; proc++) {
+        if (blocks[proc] != 3*proc) {
+            printrank("Bad allgather value from %d\n", proc);
+            result = TEST_FAILED;
+        }
+    }
+
+    icetCommBarrier();
+
+    /* Subset of the odd ranks in reverse order. */
+    group_size = size/2;
+    for (proc = 0; proc < group_size; proc++) {
+        group[proc] = size - 1 - 2*proc;
+    }
+    subset = icetCommSubset(group_size, group);
+    if (rank%2 == 0) {
+        if (subset != ICET_COMM_NULL) {
+            printrank("Got a subset communicator outside of the subset\n");
+            subset->Destroy(subset);
+            result = TEST_FAILED;
+        }
+    } else if (subset == ICET_COMM_NULL) {
+        printrank("Did not get a subset communicator\n");
+        result = TEST_FAILED;
+    } else {
+        subset->Allgather(subset, &rank, 1, ICET_INT, blocks);
+        if (group[subset->Comm_rank(subset)] != rank) {
+            printrank("Bad rank in subset\n");
+            result = TEST_FAILED;
+        }
+        for (proc = 0; proc < group_size; proc++) {
+            if (blocks[proc] != group[proc]) {
+                printrank("Bad allgather value in subset\n");
+                result = TEST_FAILED;
+            }
+        }
+        subset->Destroy(subset);
+    }
+
+    return result;
+}
+
+static int ShmCheckImage(const IceTImage image)
+{
+    const IceTUByte *colors = icetImageGetColorcub(image);
+    IceTInt x, y;
+
+    for (y = 0; y < SHM_IMAGE_HEIGHT; y++) {
+        for (x = 0; x < SHM_IMAGE_WIDTH; x++) {
+            const IceTUByte *pixel = colors + 4*(y*SHM_IMAGE_WIDTH + x);
+            IceTUByte expected[4] = { 255, 255, 255, 255 };
+            IceTFloat front_depth = 1.0f;
+            IceTInt proc;
+            for (proc = 0; proc < SHM_NUM_PROCS; proc++) {
+                if (   ShmPixelActive(proc, x, y)
+                    && (ShmPixelDepth(proc, x) < front_depth) ) {
+                    front_depth = ShmPixelDepth(proc, x);
+                    expected[0] = (IceTUByte)(proc + 1);
+                    expected[1] = (IceTUByte)(40*proc);
+                    expected[2] = 0;
+                    expected[3] = 255;
+                }
+            }
+            if (memcmp(pixel, expected, 4) != 0) {
+                printrank("Bad pixel at %d, %d: got %d %d %d %d,"
+                          " expected %d %d %d %d\n", x, y,
+                          pixel[0], pixel[1], pixel[2], pixel[3],
+                          expected[0], expected[1], expected[2], expected[3]);
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int ShmCheckComposite(void)
+{
+    IceTFloat background_color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    IceTInt viewport[4] = { 0, 0, SHM_IMAGE_WIDTH, SHM_IMAGE_HEIGHT };
+    IceTInt rank = icetCommRank();
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTInt x, y;
+    int strategy_index;
+    int si_index;
+    int result = TEST_PASSED;
+
+    colors = malloc(4*SHM_IMAGE_WIDTH*SHM_IMAGE_HEIGHT);
+    depths = malloc(SHM_IMAGE_WIDTH*SHM_IMAGE_HEIGHT*sizeof(IceTFloat));
+    for (y = 0; y < SHM_IMAGE_HEIGHT; y++) {
+        for (x = 0; x < SHM_IMAGE_WIDTH; x++) {
+            IceTSizeType pixel = y*SHM_IMAGE_WIDTH + x;
+            colors[4*pixel + 0] = (IceTUByte)(rank + 1);
+            colors[4*pixel + 1] = (IceTUByte)(40*rank);
+            colors[4*pixel + 2] = 0;
+            colors[4*pixel + 3] = 255;
+            depths[pixel] = (  ShmPixelActive(rank, x, y)
+                             ? ShmPixelDepth(rank, x) : 1.0f );
+        }
+    }
+
+    icetResetTiles();
+    icetAddTile(0, 0, SHM_IMAGE_WIDTH, SHM_IMAGE_HEIGHT, 0);
+    icetPhysicalRenderSize(SHM_IMAGE_WIDTH, SHM_IMAGE_HEIGHT);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        for (si_index = 0;
+             si_index < SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+             si_index++) {
+            IceTImage image;
+
+            icetSingleImageStrategy(single_image_strategy_list[si_index]);
+            printstat("    Compositing with %s and %s\n",
+                      icetGetStrategyName(),
+                      icetGetSingleImageStrategyName());
+
+            image = icetCompositeImage(colors, depths, viewport,
+                                       NULL, NULL, background_color);
+            if ((rank == 0) && (ShmCheckImage(image) != TEST_PASSED)) {
+                printrank("Failed with %s and %s\n",
+                          icetGetStrategyName(),
+                          icetGetSingleImageStrategyName());
+                result = TEST_FAILED;
+            }
+        }
+    }
+
+    free(colors);
+    free(depths);
+
+    return result;
+}
+
+/* Every process runs every check so that a failure in one does not leave
+   the others waiting in a collective operation. */
+static int ShmCheckCommunicator(IceTCommunicator comm, const char *label)
+{
+    IceTContext original_context = icetGetContext();
+    IceTContext context;
+    int result = TEST_PASSED;
+
+    context = icetCreateContext(comm);
+
+    printstat("%s\n", label);
+    printstat("  Checking messages\n");
+    if (ShmCheckMessages() != TEST_PASSED) result = TEST_FAILED;
+    printstat("  Checking collective operations\n");
+    if (ShmCheckCollectives() != TEST_PASSED) result = TEST_FAILED;
+    printstat("  Checking compositing\n");
+    if (ShmCheckComposite() != TEST_PASSED) result = TEST_FAILED;
+    if (icetGetError() != ICET_NO_ERROR) {
+        printrank("IceT raised an error\n");
+        result = TEST_FAILED;
+    }
+
+    icetDestroyContext(context);
+    icetSetContext(original_context);
+
+    return result;
+}
+
+static int ShmProcess(const char *name, int rank)
+{
+    IceTCommunicator comm;
+    IceTCommunicator hybrid;
+    char hybrid_name[64];
+    int result = TEST_PASSED;
+
+    comm = icetCreateShmCommunicator(name, SHM_NUM_PROCS, rank);
+    if (comm == ICET_COMM_NULL) {
+        printrank("Could not create shared memory communicator\n");
+        return TEST_FAILED;
+    }
+
+    if (ShmCheckCommunicator(comm, "One node") != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    sprintf(hybrid_name, "%s_hybrid", name);
+    hybrid = icetCreateShmHybridCommunicator(comm,
+                                             rank/SHM_PROCS_PER_NODE,
+                                             hybrid_name);
+    if (hybrid == ICET_COMM_NULL) {
+        printrank("Could not create hybrid communicator\n");
+        result = TEST_FAILED;
+    } else {
+        if (ShmCheckCommunicator(hybrid, "Two nodes") != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        icetDestroyShmCommunicator(hybrid);
+    }
+
+    icetDestroyShmCommunicator(comm);
+
+    return result;
+}
+
+/* A child attaches to a segment and exits right away.  The receive from it
+   has to end with an error. */
+static int ShmCheckDeadPeer(const char *name)
+{
+    IceTContext original_context = icetGetContext();
+    IceTCommunicator comm;
+    IceTContext context;
+    IceTInt value;
+    IceTEnum error;
+    pid_t child;
+    int status;
+    int result = TEST_PASSED;
+
+    printstat("Peer that exits\n");
+
+    fflush(stdout);
+    fflush(stderr);
+    child = fork();
+    if (child < 0) {
+        printrank("Could not fork process\n");
+        return TEST_NOT_RUN;
+    }
+    if (child == 0) {
+        comm = icetCreateShmCommunicator(name, 2, 1);
+        _exit((comm != ICET_COMM_NULL) ? 0 : 1);
+    }
+
+    comm = icetCreateShmCommunicator(name, 2, 0);
+    if (comm == ICET_COMM_NULL) {
+        printrank("Could not create shared memory communicator\n");
+        waitpid(child, NULL, 0);
+        return TEST_FAILED;
+    }
+    context = icetCreateContext(comm);
+    /* The error is expected, so do not print it. */
+    icetDiagnostics(ICET_DIAG_OFF);
+
+    icetCommRecv(&value, 1, ICET_INT, 1, SHM_MESSAGE_TAG);
+    error = icetGetError();
+    if (error != ICET_INVALID_OPERATION) {
+        printrank("Receive from a dead process gave error 0x%x\n",
+                  (int)error);
+        result = TEST_FAILED;
+    }
+
+    icetDestroyContext(context);
+    icetSetContext(original_context);
+    icetDestroyShmCommunicator(comm);
+
+    if (   (waitpid(child, &status, 0) != child)
+        || !WIFEXITED(status)
+        || (WEXITSTATUS(status) != 0) ) {
+        printrank("Process that exits failed to attach\n");
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int ShmCommunicatorRun(void)
+{
+    pid_t children[SHM_NUM_PROCS];
+    char name[64];
+    IceTInt mpi_rank;
+    int num_children;
+    int result;
+    int i;
+
+    icetGetIntegerv(ICET_RANK, &mpi_rank);
+    if (mpi_rank != 0) return TEST_PASSED;
+
+    sprintf(name, "/icet_test_%ld", (long)getpid());
+
+    /* Do not let the children print what is buffered. */
+    fflush(stdout);
+    fflush(stderr);
+
+    for (num_children = 0; num_children < SHM_NUM_PROCS-1; num_children++) {
+        children[num_children] = fork();
+        if (children[num_children] < 0) {
+            break;
+        }
+        if (children[num_children] == 0) {
+            result = ShmProcess(name, num_children + 1);
+            fflush(stdout);
+            _exit((result == TEST_PASSED) ? 0 : 1);
+        }
+    }
+    if (num_children < SHM_NUM_PROCS-1) {
+        /* The children that did start give up when the segment is never
+           made. */
+        printrank("Could not fork processes\n");
+        for (i = 0; i < num_children; i++) {
+            waitpid(children[i], NULL, 0);
+        }
+        return TEST_NOT_RUN;
+    }
+
+    result = ShmProcess(name, 0);
+
+    for (i = 0; i < num_children; i++) {
+        int status;
+        if (   (waitpid(children[i], &status, 0) != children[i])
+            || !WIFEXITED(status)
+            || (WEXITSTATUS(status) != 0) ) {
+            printrank("Process %d failed\n", i + 1);
+            result = TEST_FAILED;
+        }
+    }
+
+    strcat(name, "_dead");
+    if (ShmCheckDeadPeer(name) == TEST_FAILED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+#else /*ICET_USE_SHM*/
+
+static int ShmCommunicatorRun(void)
+{
+    printstat("IceT was built without shared memory support.\n");
+    return TEST_NOT_RUN;
+}
+
+#endif /*ICET_USE_SHM*/
+
+int ShmCommunicator(int argc, char *argv[])
+{
+    /* To remove warning */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ShmCommunicatorRun);
+}
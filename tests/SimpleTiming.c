@@ -145,6 +145,7 @@ static void usage(char *argv[])
     printstat("  -bswapfold    Use the binary-swap with folding single-image strategy.\n");
     printstat("  -radixk       Use the radix-k single-image strategy.\n");
     printstat("  -radixkr      Use the radix-kr single-image strategy.\n");
+    printstat("  -reduce-scatter Use the reduce-scatter single-image strategy.\n");
     printstat("  -tree         Use the tree single-image strategy.\n");
     printstat("  -magic-k-study <num> Use the radix-k single-image strategy and repeat for\n"
            "                   multiple values of k, up to <num>, doubling each time.\n");
@@ -239,6 +240,9 @@ static void parse_arguments(int argc, char *argv[])
             g_single_image_strategy = ICET_SINGLE_IMAGE_STRATEGY_RADIXK;
         } else if (strcmp(argv[arg], "-radixkr") == 0) {
             g_single_image_strategy = ICET_SINGLE_IMAGE_STRATEGY_RADIXKR;
+        } else if (strcmp(argv[arg], "-reduce-scatter") == 0) {
+            g_single_image_strategy
+                = ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER;
         } else if (strcmp(argv[arg], "-tree") == 0) {
             g_single_image_strategy = ICET_SINGLE_IMAGE_STRATEGY_TREE;
         } else if (strcmp(argv[arg], "-magic-k-study") == 0) {
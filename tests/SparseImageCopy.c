@@ -6,7 +6,8 @@
 ** This source code is released under the New BSD License.
 **
 ** This test checks the behavior of various ways to copy blocks of pixels
-** in sparse images.
+** in sparse images.  It also checks the active pixel bounds recorded in
+** sparse images and compositing images whose active pixels do not overlap.
 *****************************************************************************/
 
 #include "test_codes.h"
@@ -16,6 +17,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 /* Encode image position in color. */
 #define ACTIVE_COLOR(x, y) \
@@ -297,6 +299,193 @@ static int TestSparseImageSplit(const IceTImage image)
 #undef NUM_PARTITIONS
 }
 
+/* Checks the active count and viewport of a sparse image against those of
+   the pixels of the given region of image. */
+static int CheckActiveBounds(const IceTImage image,
+                             IceTSizeType offset,
+                             const IceTSparseImage sparse)
+{
+    const IceTUInt *data = icetImageGetColorcui(image) + offset;
+    IceTSizeType width = icetSparseImageGetWidth(sparse);
+    IceTSizeType height = icetSparseImageGetHeight(sparse);
+    IceTSizeType active_count = 0;
+    IceTInt x_min = (IceTInt)width, y_min = (IceTInt)height;
+    IceTInt x_max = -1, y_max = -1;
+    IceTInt expected[4];
+    IceTInt viewport[4];
+    IceTInt x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            if (data[y*width + x] != 0) {
+                active_count++;
+                if (x < x_min) x_min = x;
+                if (x > x_max) x_max = x;
+                if (y < y_min) y_min = y;
+                if (y > y_max) y_max = y;
+            }
+        }
+    }
+    if (active_count > 0) {
+        expected[0] = x_min;
+        expected[1] = y_min;
+        expected[2] = x_max - x_min + 1;
+        expected[3] = y_max - y_min + 1;
+    } else {
+        expected[0] = expected[1] = expected[2] = expected[3] = 0;
+    }
+
+    if (icetSparseImageGetActiveCount(sparse) != active_count) {
+        printrank("Active count is %d, expected %d\n",
+                  (int)icetSparseImageGetActiveCount(sparse),
+                  (int)active_count);
+        return TEST_FAILED;
+    }
+    icetSparseImageGetActiveViewport(sparse, viewport);
+    if (memcmp(viewport, expected, sizeof(viewport)) != 0) {
+        printrank("Active viewport is %d %d %d %d, expected %d %d %d %d\n",
+                  viewport[0], viewport[1], viewport[2], viewport[3],
+                  expected[0], expected[1], expected[2], expected[3]);
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+static int TestSparseImageActiveBounds(const IceTImage image)
+{
+#define NUM_PARTITIONS 7
+    IceTVoid *full_sparse_buffer;
+    IceTSparseImage full_sparse;
+    IceTVoid *sparse_partition_buffer[NUM_PARTITIONS];
+    IceTSparseImage sparse_partition[NUM_PARTITIONS];
+    IceTSizeType offsets[NUM_PARTITIONS];
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTSizeType num_partition_pixels;
+    IceTInt partition;
+    int result;
+
+    num_partition_pixels
+        = icetSparseImageSplitPartitionNumPixels(width*height,
+                                                 NUM_PARTITIONS,
+                                                 NUM_PARTITIONS);
+
+    full_sparse_buffer = malloc(icetSparseImageBufferSize(width, height));
+    full_sparse = icetSparseImageAssignBuffer(full_sparse_buffer,width,height);
+    for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+        sparse_partition_buffer[partition]
+            = malloc(icetSparseImageBufferSize(num_partition_pixels, 1));
+        sparse_partition[partition]
+            = icetSparseImageAssignBuffer(sparse_partition_buffer[partition],
+                                          num_partition_pixels, 1);
+    }
+
+    printstat("Checking active bounds of compressed image\n");
+    icetCompressImage(image, full_sparse);
+    result = CheckActiveBounds(image, 0, full_sparse);
+
+    if (result == TEST_PASSED) {
+        printstat("Checking active bounds of split image\n");
+        icetSparseImageSplit(full_sparse,
+                             0,
+                             NUM_PARTITIONS,
+                             NUM_PARTITIONS,
+                             sparse_partition,
+                             offsets);
+        for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+            result = CheckActiveBounds(image,
+                                       offsets[partition],
+                                       sparse_partition[partition]);
+            if (result != TEST_PASSED) break;
+        }
+    }
+
+    free(full_sparse_buffer);
+    for (partition = 0; partition < NUM_PARTITIONS; partition++) {
+        free(sparse_partition_buffer[partition]);
+    }
+
+    return result;
+#undef NUM_PARTITIONS
+}
+
+/* Splits the image into its bottom and top halves and checks that
+   compositing them (with their active pixels not overlapping) or compositing
+   either with an empty image gives the same as compressing the whole. */
+static int TestDisjointComposite(const IceTImage image)
+{
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTSizeType half_pixels = width*(height/2);
+    IceTVoid *half_buffers[2];
+    IceTImage halves[2];
+    IceTVoid *sparse_buffers[4];
+    IceTSparseImage sparse_halves[2];
+    IceTSparseImage expected;
+    IceTSparseImage composited;
+    IceTInt front;
+    int result = TEST_PASSED;
+
+    half_buffers[0] = malloc(icetImageBufferSize(width, height));
+    half_buffers[1] = malloc(icetImageBufferSize(width, height));
+    halves[0] = icetImageAssignBuffer(half_buffers[0], width, height);
+    halves[1] = icetImageAssignBuffer(half_buffers[1], width, height);
+    icetImageCopyPixels(image, 0, halves[0], 0, width*height);
+    icetImageCopyPixels(image, 0, halves[1], 0, width*height);
+    memset(icetImageGetColorui(halves[0]) + half_pixels,
+           0,
+           (width*height - half_pixels)*sizeof(IceTUInt));
+    memset(icetImageGetColorui(halves[1]), 0, half_pixels*sizeof(IceTUInt));
+
+    sparse_buffers[0] = malloc(icetSparseImageBufferSize(width, height));
+    sparse_buffers[1] = malloc(icetSparseImageBufferSize(width, height));
+    sparse_buffers[2] = malloc(icetSparseImageBufferSize(width, height));
+    sparse_buffers[3] = malloc(icetSparseImageBufferSize(width, height));
+    sparse_halves[0]
+        = icetSparseImageAssignBuffer(sparse_buffers[0], width, height);
+    sparse_halves[1]
+        = icetSparseImageAssignBuffer(sparse_buffers[1], width, height);
+    expected = icetSparseImageAssignBuffer(sparse_buffers[2], width, height);
+    composited = icetSparseImageAssignBuffer(sparse_buffers[3], width, height);
+
+    icetCompressImage(halves[0], sparse_halves[0]);
+    icetCompressImage(halves[1], sparse_halves[1]);
+    icetCompressImage(image, expected);
+
+    for (front = 0; (front < 2) && (result == TEST_PASSED); front++) {
+        printstat("Compositing disjoint halves, half %d in front\n", front);
+        icetCompressedCompressedComposite(sparse_halves[front],
+                                          sparse_halves[1-front],
+                                          composited);
+        result = CompareSparseImages(expected, composited);
+        if (result == TEST_PASSED) {
+            result = CheckActiveBounds(image, 0, composited);
+        }
+    }
+
+    if (result == TEST_PASSED) {
+        printstat("Compositing with an empty image\n");
+        icetClearSparseImage(sparse_halves[1]);
+        icetCompressedCompressedComposite(sparse_halves[1],
+                                          sparse_halves[0],
+                                          composited);
+        result = CompareSparseImages(sparse_halves[0], composited);
+        if (result == TEST_PASSED) {
+            result = CheckActiveBounds(halves[0], 0, composited);
+        }
+    }
+
+    free(half_buffers[0]);
+    free(half_buffers[1]);
+    free(sparse_buffers[0]);
+    free(sparse_buffers[1]);
+    free(sparse_buffers[2]);
+    free(sparse_buffers[3]);
+
+    return result;
+}
+
 static int SparseImageCopyRun()
 {
     IceTVoid *imagebuffer;
@@ -318,6 +507,12 @@ static int SparseImageCopyRun()
     if (TestSparseImageSplit(image) != TEST_PASSED) {
         return TEST_FAILED;
     }
+    if (TestSparseImageActiveBounds(image) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TestDisjointComposite(image) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
 
     printstat("\n********* Creating upper triangle image\n");
     UpperTriangleImage(image);
@@ -328,6 +523,12 @@ static int SparseImageCopyRun()
     if (TestSparseImageSplit(image) != TEST_PASSED) {
         return TEST_FAILED;
     }
+    if (TestSparseImageActiveBounds(image) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TestDisjointComposite(image) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
 
     free(imagebuffer);
 
@@ -0,0 +1,694 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that compressing an image with multiple threads
+** (ICET_COMPRESS_THREADS) and compositing two compressed images with multiple
+** threads (ICET_COMPOSITE_THREADS) give exactly the same sparse images as
+** doing the same with one thread.  It also checks splitting a compressed
+** image with multiple threads, which seeks to the partitions with the seek
+** table built during compression, and that a sent image (which loses its
+** seek table) splits the same way.  Finally, it checks that compositing
+** several compressed images in one pass gives the same sparse image as
+** compositing them in pairs from back to front.
+*****************************************************************************/
+
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Big enough to be split into several bands, but not evenly. */
+#define THREADS_IMAGE_WIDTH     331
+#define THREADS_IMAGE_HEIGHT    211
+
+#define THREADS_MAX_THREADS     4
+
+#define THREADS_NUM_PARTITIONS  5
+
+#define THREADS_MERGE_IMAGES    4
+
+static IceTDouble IdentityMatrix[16] = {
+    1.0, 0.0, 0.0, 0.0,
+    0.0, 1.0, 0.0, 0.0,
+    0.0, 0.0, 1.0, 0.0,
+    0.0, 0.0, 0.0, 1.0
+};
+static IceTFloat Black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+static unsigned int g_draw_seed;
+
+/* Fills the image with runs of active and inactive pixels of random length
+   so that the band boundaries land both inside and between runs. */
+static void InitRunImage(IceTImage image)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTEnum composite_mode;
+    IceTUByte *color_ub = NULL;
+    IceTFloat *color_f = NULL;
+    IceTFloat *depth = NULL;
+    IceTSizeType i = 0;
+    IceTBoolean active = (rand()%2 == 0);
+
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        color_ub = icetImageGetColorub(image);
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        color_f = icetImageGetColorf(image);
+    }
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        depth = icetImageGetDepthf(image);
+    }
+
+    while (i < num_pixels) {
+        IceTSizeType run_end = i + 1 + rand()%500;
+        if (run_end > num_pixels) run_end = num_pixels;
+        for ( ; i < run_end; i++) {
+            int channel;
+            for (channel = 0; channel < 4; channel++) {
+                if (color_ub != NULL) {
+                    color_ub[4*i+channel] = (IceTUByte)(1 + rand()%255);
+                }
+                if (color_f != NULL) {
+                    color_f[4*i+channel] = (IceTFloat)(1 + rand()%255)/255.0f;
+                }
+            }
+            if (depth != NULL) {
+                depth[i] = (IceTFloat)(rand()%16)/16.0f;
+            }
+            if (active) continue;
+
+            if (depth != NULL) {
+                depth[i] = 1.0f;
+            } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+                if (color_ub != NULL) color_ub[4*i+3] = 0;
+                if (color_f != NULL) color_f[4*i+3] = 0.0f;
+            } else {
+                for (channel = 0; channel < 4; channel++) {
+                    if (color_ub != NULL) color_ub[4*i+channel] = 0;
+                    if (color_f != NULL) color_f[4*i+channel] = 0.0f;
+                }
+            }
+        }
+        active = !active;
+    }
+}
+
+static void drawCallback(const IceTDouble *projection_matrix,
+                         const IceTDouble *modelview_matrix,
+                         const IceTFloat *background_color,
+                         const IceTInt *readback_viewport,
+                         IceTImage result)
+{
+  /* Don't care about this information. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+    (void)readback_viewport;
+
+  /* Draw the same image every time. */
+    srand(g_draw_seed);
+    InitRunImage(result);
+}
+
+static int CompareSparseImages(const IceTSparseImage reference,
+                               const IceTSparseImage image)
+{
+    IceTSizeType size = icetSparseImageGetCompressedBufferSize(reference);
+    if (size != icetSparseImageGetCompressedBufferSize(image)) {
+        printrank("*** Compressed sizes differ: %d vs %d ***\n",
+                  (int)size, (int)icetSparseImageGetCompressedBufferSize(image));
+        return TEST_FAILED;
+    }
+    if (memcmp(reference.opaque_internals, image.opaque_internals, size)
+        != 0) {
+        printrank("*** Compressed data differs from serial result ***\n");
+        return TEST_FAILED;
+    }
+    return TEST_PASSED;
+}
+
+static int TryCompress(IceTEnum composite_mode,
+                       IceTEnum color_format,
+                       IceTEnum depth_format)
+{
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffers[2];
+    IceTImage image;
+    IceTSparseImage reference_image, test_image;
+    IceTSizeType num_pixels = THREADS_IMAGE_WIDTH*THREADS_IMAGE_HEIGHT;
+    IceTSizeType offset, sub_pixels;
+    IceTSizeType max_width, max_height;
+    IceTInt viewport[4];
+    IceTInt num_threads;
+    int result = TEST_PASSED;
+
+    printstat("Compress mode 0x%X, color 0x%X, depth 0x%X\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+
+    max_width = (SCREEN_WIDTH > THREADS_IMAGE_WIDTH)
+        ? SCREEN_WIDTH : THREADS_IMAGE_WIDTH;
+    max_height = (SCREEN_HEIGHT > THREADS_IMAGE_HEIGHT)
+        ? SCREEN_HEIGHT : THREADS_IMAGE_HEIGHT;
+
+    image_buffer = malloc(icetImageBufferSize(THREADS_IMAGE_WIDTH,
+                                              THREADS_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer,
+                                  THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT);
+    sparse_buffers[0] = malloc(icetSparseImageBufferSize(max_width,
+                                                         max_height));
+    sparse_buffers[1] = malloc(icetSparseImageBufferSize(max_width,
+                                                         max_height));
+
+    InitRunImage(image);
+
+    /* Also try a piece that does not start at the beginning. */
+    offset = 1 + rand()%1000;
+    sub_pixels = num_pixels - offset - rand()%1000;
+
+    /* Set up for icetGetCompressedTileImage as in the CompressionSize test.
+       Use a contained viewport smaller than the tile so that the compressed
+       image has padding on all sides. */
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetDrawCallback(drawCallback);
+    icetDrawFrame(IdentityMatrix, IdentityMatrix, Black);
+    viewport[0] = (IceTInt)(SCREEN_WIDTH/10);
+    viewport[1] = (IceTInt)(SCREEN_HEIGHT/7);
+    viewport[2] = (IceTInt)(SCREEN_WIDTH/2);
+    viewport[3] = (IceTInt)(SCREEN_HEIGHT/2);
+    icetStateSetIntegerv(ICET_CONTAINED_VIEWPORT, 4, viewport);
+
+    for (num_threads = 2; num_threads <= THREADS_MAX_THREADS; num_threads++) {
+        printstat("  Checking %d threads\n", num_threads);
+
+        reference_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                                      THREADS_IMAGE_WIDTH,
+                                                      THREADS_IMAGE_HEIGHT);
+        test_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                                 THREADS_IMAGE_WIDTH,
+                                                 THREADS_IMAGE_HEIGHT);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+        icetCompressImage(image, reference_image);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, num_threads);
+        icetCompressImage(image, test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) break;
+
+        reference_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                                      sub_pixels, 1);
+        test_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                                 sub_pixels, 1);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+        icetCompressSubImage(image, offset, sub_pixels, reference_image);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, num_threads);
+        icetCompressSubImage(image, offset, sub_pixels, test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) break;
+
+        reference_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                                      SCREEN_WIDTH,
+                                                      SCREEN_HEIGHT);
+        test_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                                 SCREEN_WIDTH,
+                                                 SCREEN_HEIGHT);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+        icetGetCompressedTileImage(0, reference_image);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, num_threads);
+        icetGetCompressedTileImage(0, test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) break;
+    }
+    if (result != TEST_PASSED) {
+        printrank("*** Failed with %d threads ***\n", num_threads);
+    }
+
+    icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+
+    free(image_buffer);
+    free(sparse_buffers[0]);
+    free(sparse_buffers[1]);
+
+    return result;
+}
+
+static int TryCCComposite(IceTEnum composite_mode,
+                          IceTEnum color_format,
+                          IceTEnum depth_format)
+{
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffers[4];
+    IceTImage image;
+    IceTSparseImage front_image, back_image, reference_image, test_image;
+    IceTSizeType sparse_size;
+    IceTInt num_threads;
+    int result = TEST_PASSED;
+    int i;
+
+    printstat("Composite mode 0x%X, color 0x%X, depth 0x%X\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+
+    image_buffer = malloc(icetImageBufferSize(THREADS_IMAGE_WIDTH,
+                                              THREADS_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer,
+                                  THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT);
+    sparse_size = icetSparseImageBufferSize(THREADS_IMAGE_WIDTH,
+                                            THREADS_IMAGE_HEIGHT);
+    for (i = 0; i < 4; i++) {
+        sparse_buffers[i] = malloc(sparse_size);
+    }
+    front_image = icetSparseImageAssignBuffer(sparse_buffers[0],
+                                              THREADS_IMAGE_WIDTH,
+                                              THREADS_IMAGE_HEIGHT);
+    back_image = icetSparseImageAssignBuffer(sparse_buffers[1],
+                                             THREADS_IMAGE_WIDTH,
+                                             THREADS_IMAGE_HEIGHT);
+    reference_image = icetSparseImageAssignBuffer(sparse_buffers[2],
+                                                  THREADS_IMAGE_WIDTH,
+                                                  THREADS_IMAGE_HEIGHT);
+    test_image = icetSparseImageAssignBuffer(sparse_buffers[3],
+                                             THREADS_IMAGE_WIDTH,
+                                             THREADS_IMAGE_HEIGHT);
+
+    InitRunImage(image);
+    icetCompressImage(image, front_image);
+    InitRunImage(image);
+    icetCompressImage(image, back_image);
+
+    for (num_threads = 2; num_threads <= THREADS_MAX_THREADS; num_threads++) {
+        printstat("  Checking %d threads\n", num_threads);
+
+        icetStateSetInteger(ICET_COMPOSITE_THREADS, 1);
+        icetCompressedCompressedComposite(front_image,
+                                          back_image,
+                                          reference_image);
+        icetStateSetInteger(ICET_COMPOSITE_THREADS, num_threads);
+        icetCompressedCompressedComposite(front_image,
+                                          back_image,
+                                          test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) {
+            printrank("*** Failed with %d threads ***\n", num_threads);
+            break;
+        }
+    }
+
+    icetStateSetInteger(ICET_COMPOSITE_THREADS, 1);
+
+    free(image_buffer);
+    for (i = 0; i < 4; i++) {
+        free(sparse_buffers[i]);
+    }
+
+    return result;
+}
+
+/* Composites THREADS_MERGE_IMAGES compressed images at once and checks the
+   result against compositing pairs from back to front with one thread. */
+static int TryMergeComposite(IceTEnum composite_mode,
+                             IceTEnum color_format,
+                             IceTEnum depth_format)
+{
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffers[THREADS_MERGE_IMAGES + 3];
+    IceTImage image;
+    IceTSparseImage images[THREADS_MERGE_IMAGES];
+    IceTSparseImage reference_image, spare_image, test_image;
+    IceTSizeType sparse_size;
+    IceTInt num_threads;
+    int result = TEST_PASSED;
+    int i;
+
+    printstat("Merge mode 0x%X, color 0x%X, depth 0x%X\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+    icetStateSetInteger(ICET_COMPOSITE_THREADS, 1);
+
+    image_buffer = malloc(icetImageBufferSize(THREADS_IMAGE_WIDTH,
+                                              THREADS_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer,
+                                  THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT);
+    sparse_size = icetSparseImageBufferSize(THREADS_IMAGE_WIDTH,
+                                            THREADS_IMAGE_HEIGHT);
+    for (i = 0; i < THREADS_MERGE_IMAGES + 3; i++) {
+        sparse_buffers[i] = malloc(sparse_size);
+    }
+    for (i = 0; i < THREADS_MERGE_IMAGES; i++) {
+        images[i] = icetSparseImageAssignBuffer(sparse_buffers[i],
+                                                THREADS_IMAGE_WIDTH,
+                                                THREADS_IMAGE_HEIGHT);
+        InitRunImage(image);
+        icetCompressImage(image, images[i]);
+    }
+    reference_image
+        = icetSparseImageAssignBuffer(sparse_buffers[THREADS_MERGE_IMAGES],
+                                      THREADS_IMAGE_WIDTH,
+                                      THREADS_IMAGE_HEIGHT);
+    spare_image
+        = icetSparseImageAssignBuffer(sparse_buffers[THREADS_MERGE_IMAGES+1],
+                                      THREADS_IMAGE_WIDTH,
+                                      THREADS_IMAGE_HEIGHT);
+    test_image
+        = icetSparseImageAssignBuffer(sparse_buffers[THREADS_MERGE_IMAGES+2],
+                                      THREADS_IMAGE_WIDTH,
+                                      THREADS_IMAGE_HEIGHT);
+
+    /* Composite pairs from back to front, accumulating in the reference. */
+    icetSparseImageCopyPixels(images[THREADS_MERGE_IMAGES-1],
+                              0,
+                              THREADS_IMAGE_WIDTH*THREADS_IMAGE_HEIGHT,
+                              reference_image);
+    for (i = THREADS_MERGE_IMAGES - 2; i >= 0; i--) {
+        IceTSparseImage swap;
+        icetCompressedCompressedComposite(images[i],
+                                          reference_image,
+                                          spare_image);
+        swap = reference_image;
+        reference_image = spare_image;
+        spare_image = swap;
+    }
+
+    for (num_threads = 1; num_threads <= THREADS_MAX_THREADS; num_threads++) {
+        printstat("  Checking %d threads\n", num_threads);
+
+        icetStateSetInteger(ICET_COMPOSITE_THREADS, num_threads);
+        icetCompressedCompressedCompositeImages(images,
+                                                THREADS_MERGE_IMAGES,
+                                                test_image);
+        result = CompareSparseImages(reference_image, test_image);
+        if (result != TEST_PASSED) {
+            printrank("*** Failed with %d threads ***\n", num_threads);
+            break;
+        }
+    }
+
+    icetStateSetInteger(ICET_COMPOSITE_THREADS, 1);
+
+    free(image_buffer);
+    for (i = 0; i < THREADS_MERGE_IMAGES + 3; i++) {
+        free(sparse_buffers[i]);
+    }
+
+    return result;
+}
+
+static int CompareSplits(const IceTSparseImage *reference_images,
+                         const IceTSizeType *reference_offsets,
+                         const IceTSparseImage *images,
+                         const IceTSizeType *offsets)
+{
+    int partition;
+    for (partition = 0; partition < THREADS_NUM_PARTITIONS; partition++) {
+        if (reference_offsets[partition] != offsets[partition]) {
+            printrank("*** Partition %d offsets differ: %d vs %d ***\n",
+                      partition,
+                      (int)reference_offsets[partition],
+                      (int)offsets[partition]);
+            return TEST_FAILED;
+        }
+        if (   CompareSparseImages(reference_images[partition],
+                                   images[partition])
+            != TEST_PASSED ) {
+            printrank("*** Partition %d differs ***\n", partition);
+            return TEST_FAILED;
+        }
+    }
+    return TEST_PASSED;
+}
+
+static int TrySplit(IceTEnum composite_mode,
+                    IceTEnum color_format,
+                    IceTEnum depth_format)
+{
+    IceTVoid *image_buffer;
+    IceTVoid *full_buffer;
+    IceTVoid *received_buffer;
+    IceTVoid *partition_buffers[2*THREADS_NUM_PARTITIONS];
+    IceTImage image;
+    IceTSparseImage full_image, received_image;
+    IceTSparseImage reference_images[THREADS_NUM_PARTITIONS];
+    IceTSparseImage test_images[THREADS_NUM_PARTITIONS];
+    IceTSizeType reference_offsets[THREADS_NUM_PARTITIONS];
+    IceTSizeType test_offsets[THREADS_NUM_PARTITIONS];
+    IceTSizeType sparse_size;
+    IceTSizeType image_offset;
+    IceTVoid *package_buffer;
+    IceTSizeType package_size;
+    IceTInt num_threads;
+    int result = TEST_PASSED;
+    int i;
+
+    printstat("Split mode 0x%X, color 0x%X, depth 0x%X\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+
+    image_buffer = malloc(icetImageBufferSize(THREADS_IMAGE_WIDTH,
+                                              THREADS_IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer,
+                                  THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT);
+    sparse_size = icetSparseImageBufferSize(THREADS_IMAGE_WIDTH,
+                                            THREADS_IMAGE_HEIGHT);
+    full_buffer = malloc(sparse_size);
+    full_image = icetSparseImageAssignBuffer(full_buffer,
+                                             THREADS_IMAGE_WIDTH,
+                                             THREADS_IMAGE_HEIGHT);
+    received_buffer = malloc(sparse_size);
+    for (i = 0; i < 2*THREADS_NUM_PARTITIONS; i++) {
+        partition_buffers[i] = malloc(sparse_size);
+    }
+    for (i = 0; i < THREADS_NUM_PARTITIONS; i++) {
+        reference_images[i]
+            = icetSparseImageAssignBuffer(partition_buffers[i],
+                                          THREADS_IMAGE_WIDTH,
+                                          THREADS_IMAGE_HEIGHT);
+        test_images[i]
+            = icetSparseImageAssignBuffer(
+                                  partition_buffers[THREADS_NUM_PARTITIONS+i],
+                                  THREADS_IMAGE_WIDTH,
+                                  THREADS_IMAGE_HEIGHT);
+    }
+
+    InitRunImage(image);
+    icetCompressImage(image, full_image);
+    image_offset = rand()%1000;
+
+    icetSparseImageSplit(full_image,
+                         image_offset,
+                         THREADS_NUM_PARTITIONS,
+                         2*THREADS_NUM_PARTITIONS,
+                         reference_images,
+                         reference_offsets);
+
+    for (num_threads = 2; num_threads <= THREADS_MAX_THREADS; num_threads++) {
+        printstat("  Checking %d threads\n", num_threads);
+        icetStateSetInteger(ICET_COMPRESS_THREADS, num_threads);
+
+        icetSparseImageSplit(full_image,
+                             image_offset,
+                             THREADS_NUM_PARTITIONS,
+                             2*THREADS_NUM_PARTITIONS,
+                             test_images,
+                             test_offsets);
+        result = CompareSplits(reference_images, reference_offsets,
+                               test_images, test_offsets);
+        if (result != TEST_PASSED) {
+            printrank("*** Failed with %d threads ***\n", num_threads);
+            break;
+        }
+
+        /* Splitting with the first partition in place. */
+        icetSparseImageCopyPixels(full_image,
+                                  0,
+                                  icetSparseImageGetNumPixels(full_image),
+                                  test_images[0]);
+        icetSparseImageSplit(test_images[0],
+                             image_offset,
+                             THREADS_NUM_PARTITIONS,
+                             2*THREADS_NUM_PARTITIONS,
+                             test_images,
+                             test_offsets);
+        result = CompareSplits(reference_images, reference_offsets,
+                               test_images, test_offsets);
+        if (result != TEST_PASSED) {
+            printrank("*** In place failed with %d threads ***\n",
+                      num_threads);
+            break;
+        }
+    }
+
+    if (result == TEST_PASSED) {
+        printstat("  Checking sent image\n");
+        icetSparseImagePackageForSend(full_image,
+                                      &package_buffer, &package_size);
+        /* Fill what follows the sent data with garbage so that using a seek
+           table that did not come along would be noticed. */
+        memset(received_buffer, 0xA5, sparse_size);
+        memcpy(received_buffer, package_buffer, package_size);
+        received_image = icetSparseImageUnpackageFromReceive(received_buffer);
+        icetSparseImageSplit(received_image,
+                             image_offset,
+                             THREADS_NUM_PARTITIONS,
+                             2*THREADS_NUM_PARTITIONS,
+                             test_images,
+                             test_offsets);
+        result = CompareSplits(reference_images, reference_offsets,
+                               test_images, test_offsets);
+    }
+
+    icetStateSetInteger(ICET_COMPRESS_THREADS, 1);
+
+    free(image_buffer);
+    free(full_buffer);
+    free(received_buffer);
+    for (i = 0; i < 2*THREADS_NUM_PARTITIONS; i++) {
+        free(partition_buffers[i]);
+    }
+
+    return result;
+}
+
+static int SparseThreadsRun(void)
+{
+    unsigned int seed;
+
+    seed = (unsigned int)time(NULL);
+    printstat("Using seed %u\n", seed);
+    srand(seed);
+    g_draw_seed = seed;
+
+    icetStrategy(ICET_STRATEGY_REDUCE);
+
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_Z_BUFFER,
+                    ICET_IMAGE_COLOR_NONE,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_BLEND,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_ADD,
+                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCompress(ICET_COMPOSITE_MODE_ADD,
+                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    if (TryCCComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                       ICET_IMAGE_COLOR_RGBA_UBYTE,
+                       ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCCComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                       ICET_IMAGE_COLOR_NONE,
+                       ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCCComposite(ICET_COMPOSITE_MODE_BLEND,
+                       ICET_IMAGE_COLOR_RGBA_FLOAT,
+                       ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCCComposite(ICET_COMPOSITE_MODE_ADD,
+                       ICET_IMAGE_COLOR_RGBA_UBYTE,
+                       ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryCCComposite(ICET_COMPOSITE_MODE_ADD,
+                       ICET_IMAGE_COLOR_RGBA_FLOAT,
+                       ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    if (TryMergeComposite(ICET_COMPOSITE_MODE_Z_BUFFER,
+                          ICET_IMAGE_COLOR_RGBA_UBYTE,
+                          ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryMergeComposite(ICET_COMPOSITE_MODE_BLEND,
+                          ICET_IMAGE_COLOR_RGBA_FLOAT,
+                          ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryMergeComposite(ICET_COMPOSITE_MODE_BLEND,
+                          ICET_IMAGE_COLOR_RGBA_UBYTE,
+                          ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TryMergeComposite(ICET_COMPOSITE_MODE_ADD,
+                          ICET_IMAGE_COLOR_RGBA_FLOAT,
+                          ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    if (TrySplit(ICET_COMPOSITE_MODE_Z_BUFFER,
+                 ICET_IMAGE_COLOR_RGBA_UBYTE,
+                 ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+    if (TrySplit(ICET_COMPOSITE_MODE_BLEND,
+                 ICET_IMAGE_COLOR_RGBA_FLOAT,
+                 ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+int SparseThreads(int argc, char *argv[])
+{
+    /* To remove warning */
+    (void)argc;
+    (void)argv;
+
+    return run_test(SparseThreadsRun);
+}
@@ -0,0 +1,540 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2011 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test runs IceT processes as threads with the threads communicator.
+** Each thread checks the point-to-point and collective operations of the
+** communicator, including subsets, and then composites an image with every
+** strategy.  Only the first MPI process runs the threads.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevCommunication.h>
+#include <IceTDevContext.h>
+
+#ifdef ICET_USE_PTHREADS
+#include <IceTThreads.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Not a power of two, so the strategies have to handle leftover ranks. */
+#define THREADS_NUM_RANKS       13
+
+#define THREADS_IMAGE_WIDTH     97
+#define THREADS_IMAGE_HEIGHT    61
+
+/* Bigger than messages that are sent eagerly. */
+#define THREADS_LARGE_COUNT     100000
+
+#define THREADS_MESSAGE_TAG     7
+
+#ifdef ICET_USE_PTHREADS
+
+static int g_results[THREADS_NUM_RANKS];
+
+static IceTBoolean ThreadsPixelActive(IceTInt rank, IceTInt x, IceTInt y)
+{
+    return ((x + 2*y + rank)%5 != 0);
+}
+
+/* The depths of the ranks at any one pixel are all different. */
+static IceTFloat ThreadsPixelDepth(IceTInt rank, IceTInt x)
+{
+    return (IceTFloat)((x + 7*rank)%THREADS_NUM_RANKS + 1)
+        /(IceTFloat)(THREADS_NUM_RANKS + 2);
+}
+
+static int ThreadsCheckPointToPoint(void)
+{
+    IceTInt rank = icetCommRank();
+    IceTInt size = icetCommSize();
+    IceTInt send_values[THREADS_NUM_RANKS];
+    IceTInt recv_values[THREADS_NUM_RANKS];
+    IceTCommRequest requests[2*THREADS_NUM_RANKS];
+    int indices[2*THREADS_NUM_RANKS];
+    int num_left;
+    IceTInt *large_send;
+    IceTInt *large_recv;
+    IceTInt proc;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    if ((size != THREADS_NUM_RANKS) || (rank < 0) || (rank >= size)) {
+        printrank("Communicator has size %d and rank %d\n", size, rank);
+        return TEST_FAILED;
+    }
+
+    for (proc = 0; proc < size; proc++) {
+        send_values[proc] = 1000*rank + proc;
+        recv_values[proc] = -1;
+        requests[proc] = ICET_COMM_REQUEST_NULL;
+        requests[size+proc] = ICET_COMM_REQUEST_NULL;
+        if (proc == rank) continue;
+        requests[proc] = icetCommIrecv(&recv_values[proc], 1, ICET_INT,
+                                       proc, THREADS_MESSAGE_TAG);
+        requests[size+proc] = icetCommIsend(&send_values[proc], 1, ICET_INT,
+                                            proc, THREADS_MESSAGE_TAG);
+    }
+    for (i = 0; i < 2*(size-1); i++) {
+        IceTInt idx = icetCommWaitany(2*size, requests);
+        if ((idx < 0) || (idx >= 2*size) || (idx%size == rank)) {
+            printrank("Waitany returned bad index %d\n", idx);
+            return TEST_FAILED;
+        }
+        if ((idx < size) && (recv_values[idx] != 1000*idx + rank)) {
+            printrank("Got %d from %d\n", recv_values[idx], idx);
+            result = TEST_FAILED;
+        }
+    }
+
+    /* The same exchange finished with Test, Testsome and Waitsome. */
+    for (proc = 0; proc < size; proc++) {
+        recv_values[proc] = -1;
+        if (proc == rank) continue;
+        requests[proc] = icetCommIrecv(&recv_values[proc], 1, ICET_INT,
+                                       proc, THREADS_MESSAGE_TAG);
+        requests[size+proc] = icetCommIsend(&send_values[proc], 1, ICET_INT,
+                                            proc, THREADS_MESSAGE_TAG);
+    }
+    num_left = 2*(size-1);
+    if (requests[2*size-1] != ICET_COMM_REQUEST_NULL) {
+        while (!icetCommTest(&requests[2*size-1])) { }
+        num_left--;
+    }
+    while (num_left > 0) {
+        int num_done = icetCommTestsome(2*size, requests, indices);
+        if (num_done == 0) {
+            num_done = icetCommWaitsome(2*size, requests, indices);
+        }
+        if ((num_done < 1) || (num_done > num_left)) {
+            printrank("Waitsome finished %d of %d requests\n",
+                      num_done, num_left);
+            return TEST_FAILED;
+        }
+        for (i = 0; i < num_done; i++) {
+            int idx = indices[i];
+            if (   (idx < 0) || (idx >= 2*size)
+                || (requests[idx] != ICET_COMM_REQUEST_NULL) ) {
+                printrank("Waitsome returned bad index %d\n", idx);
+                return TEST_FAILED;
+            }
+            if ((idx < size) && (recv_values[idx] != 1000*idx + rank)) {
+                printrank("Got %d from %d\n", recv_values[idx], idx);
+                result = TEST_FAILED;
+            }
+        }
+        num_left -= num_done;
+    }
+    if (icetCommWaitsome(2*size, requests, indices) != 0) {
+        printrank("Waitsome finished requests that were done\n");
+        result = TEST_FAILED;
+    }
+
+    /* Communicators may leave out Testsome and Test.  Without Testsome the
+       requests are tested one at a time, and without Test nothing is ever
+       reported finished, but neither may block. */
+    {
+        IceTCommunicator comm = icetGetCommunicator();
+        struct IceTCommunicatorStruct saved_comm = *comm;
+        IceTInt recv_value = -1;
+        int num_done;
+
+        comm->Testsome = NULL;
+        requests[0] = icetCommIrecv(&recv_value, 1, ICET_INT,
+                                    (rank+size-1)%size, THREADS_MESSAGE_TAG);
+        requests[1] = icetCommIsend(&rank, 1, ICET_INT,
+                                    (rank+1)%size, THREADS_MESSAGE_TAG);
+        num_left = 2;
+        while (num_left > 0) {
+            num_done = icetCommTestsome(2, requests, indices);
+            for (i = 0; i < num_done; i++) {
+                if (   (indices[i] < 0) || (indices[i] > 1)
+                    || (requests[indices[i]] != ICET_COMM_REQUEST_NULL) ) {
+                    printrank("Testsome without Testsome returned bad index"
+                              " %d\n", indices[i]);
+                    return TEST_FAILED;
+                }
+            }
+            num_left -= num_done;
+        }
+        if (recv_value != (rank+size-1)%size) {
+            printrank("Got %d from Testsome without Testsome\n",
+                      recv_value);
+            result = TEST_FAILED;
+        }
+
+        comm->Test = NULL;
+        requests[0] = icetCommIrecv(&recv_value, 1, ICET_INT,
+                                    (rank+size-1)%size, THREADS_MESSAGE_TAG);
+        requests[1] = icetCommIsend(&rank, 1, ICET_INT,
+                                    (rank+1)%size, THREADS_MESSAGE_TAG);
+        if (   (icetCommTestsome(2, requests, indices) != 0)
+            || icetCommTest(&requests[0]) ) {
+            printrank("Testing without Test reported a finished request\n");
+            result = TEST_FAILED;
+        }
+        icetCommWaitall(2, requests);
+        comm->Testsome = saved_comm.Testsome;
+        comm->Test = saved_comm.Test;
+    }
+
+    large_send = malloc(THREADS_LARGE_COUNT*sizeof(IceTInt));
+    large_recv = malloc(THREADS_LARGE_COUNT*sizeof(IceTInt));
+    for (i = 0; i < THREADS_LARGE_COUNT; i++) {
+        large_send[i] = rank + i;
+    }
+    icetCommSendrecv(large_send, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+1)%size, THREADS_MESSAGE_TAG,
+                     large_recv, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+size-1)%size, THREADS_MESSAGE_TAG);
+    for (i = 0; i < THREADS_LARGE_COUNT; i++) {
+        if (large_recv[i] != (rank+size-1)%size + i) {
+            printrank("Bad value in large message at %d\n", i);
+            result = TEST_FAILED;
+            break;
+        }
+    }
+
+    /* Blocking sends and receives in a ring, small and large. */
+    if (rank%2 == 0) {
+        icetCommSend(&rank, 1, ICET_INT, (rank+1)%size, THREADS_MESSAGE_TAG);
+        icetCommSend(large_send, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+1)%size, THREADS_MESSAGE_TAG);
+        icetCommRecv(&proc, 1, ICET_INT,
+                     (rank+size-1)%size, THREADS_MESSAGE_TAG);
+        icetCommRecv(large_recv, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+size-1)%size, THREADS_MESSAGE_TAG);
+    } else {
+        icetCommRecv(&proc, 1, ICET_INT,
+                     (rank+size-1)%size, THREADS_MESSAGE_TAG);
+        icetCommRecv(large_recv, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+size-1)%size, THREADS_MESSAGE_TAG);
+        icetCommSend(&rank, 1, ICET_INT, (rank+1)%size, THREADS_MESSAGE_TAG);
+        icetCommSend(large_send, THREADS_LARGE_COUNT, ICET_INT,
+                     (rank+1)%size, THREADS_MESSAGE_TAG);
+    }
+    if (   (proc != (rank+size-1)%size)
+        || (large_recv[THREADS_LARGE_COUNT-1]
+            != (rank+size-1)%size + THREADS_LARGE_COUNT-1) ) {
+        printrank("Bad values from blocking ring\n");
+        result = TEST_FAILED;
+    }
+
+    free(large_send);
+    free(large_recv);
+
+    return result;
+}
+
+static void ThreadsSumInts(const void *inbuf,
+                           void *inoutbuf,
+                           IceTSizeType count,
+                           void *data)
+{
+    const IceTInt *in = (const IceTInt *)inbuf;
+    IceTInt *inout = (IceTInt *)inoutbuf;
+    IceTSizeType i;
+    (void)data;
+    for (i = 0; i < count; i++) {
+        inout[i] += in[i];
+    }
+}
+
+static int ThreadsCheckCollectives(void)
+{
+    IceTInt rank = icetCommRank();
+    IceTInt size = icetCommSize();
+    IceTInt values[THREADS_NUM_RANKS*(THREADS_NUM_RANKS+1)/2];
+    IceTInt blocks[THREADS_NUM_RANKS];
+    IceTSizeType counts[THREADS_NUM_RANKS];
+    IceTSizeType offsets[THREADS_NUM_RANKS];
+    IceTInt32 group[THREADS_NUM_RANKS];
+    IceTInt group_size;
+    IceTCommunicator subset;
+    IceTInt proc;
+    IceTInt i;
+
+    /* Gatherv of rank+1 copies of each rank, in place on the root. */
+    for (proc = 0; proc < size; proc++) {
+        counts[proc] = proc + 1;
+        offsets[proc] = proc*(proc + 1)/2;
+    }
+    for (i = 0; i < size*(size+1)/2; i++) values[i] = -1;
+    for (i = 0; i <= rank; i++) values[offsets[rank] + i] = rank;
+    if (rank == 0) {
+        icetCommGatherv(ICET_IN_PLACE_COLLECT, counts[rank], ICET_INT,
+                        values, counts, offsets, 0);
+        for (proc = 0; proc < size; proc++) {
+            for (i = 0; i <= proc; i++) {
+                if (values[offsets[proc] + i] != proc) {
+                    printrank("Bad gatherv value from %d\n", proc);
+                    return TEST_FAILED;
+                }
+            }
+        }
+    } else {
+        icetCommGatherv(values + offsets[rank], counts[rank], ICET_INT,
+                        NULL, counts, offsets, 0);
+    }
+
+    for (proc = 0; proc < size; proc++) blocks[proc] = -1;
+    blocks[rank] = 3*rank;
+    icetCommAllgather(ICET_IN_PLACE_COLLECT, 1, ICET_INT, blocks);
+    for (proc = 0; proc < size; proc++) {
+        if (blocks[proc] != 3*proc) {
+            printrank("Bad allgather value from %d\n", proc);
+            return TEST_FAILED;
+        }
+    }
+
+    for (proc = 0; proc < size; proc++) values[proc] = 100*rank + proc;
+    icetCommAlltoall(values, 1, ICET_INT, blocks);
+    for (proc = 0; proc < size; proc++) {
+        if (blocks[proc] != 100*proc + rank) {
+            printrank("Bad alltoall value from %d\n", proc);
+            return TEST_FAILED;
+        }
+    }
+
+    icetCommBarrier();
+
+    /* Reduce-scatter over the even ranks, which sums 2 values per rank. */
+    group_size = (size + 1)/2;
+    for (i = 0; i < group_size; i++) group[i] = 2*i;
+    if (rank%2 == 0) {
+        for (i = 0; i < 2*group_size; i++) values[i] = rank + i;
+        icetCommReduceScatterBlock(group_size, group, values, blocks, 2,
+                                   sizeof(IceTInt), ThreadsSumInts, NULL);
+        for (i = 0; i < 2; i++) {
+            /* Sum over the group of (2*g + rank) for element rank + i. */
+            IceTInt expected
+                = group_size*(group_size - 1) + group_size*(rank + i);
+            if (blocks[i] != expected) {
+                printrank("Bad reduce-scatter value %d, expected %d\n",
+                          blocks[i], expected);
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    /* Subset of the odd ranks in reverse order. */
+    group_size = size/2;
+    for (i = 0; i < group_size; i++) group[i] = size - 2 - 2*i;
+    subset = icetCommSubset(group_size, group);
+    if (rank%2 == 0) {
+        if (subset != ICET_COMM_NULL) {
+            printrank("Got a subset communicator outside of the subset\n");
+            return TEST_FAILED;
+        }
+    } else {
+        IceTInt subset_rank;
+        if (subset == ICET_COMM_NULL) {
+            printrank("Did not get a subset communicator\n");
+            return TEST_FAILED;
+        }
+        subset_rank = subset->Comm_rank(subset);
+        if (   (subset->Comm_size(subset) != group_size)
+            || (group[subset_rank] != rank) ) {
+            printrank("Subset has size %d and rank %d\n",
+                      subset->Comm_size(subset), subset_rank);
+            return TEST_FAILED;
+        }
+        subset->Allgather(subset, &rank, 1, ICET_INT, blocks);
+        subset->Barrier(subset);
+        subset->Destroy(subset);
+        for (i = 0; i < group_size; i++) {
+            if (blocks[i] != group[i]) {
+                printrank("Bad allgather value in subset\n");
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int ThreadsCheckImage(const IceTImage image)
+{
+    const IceTUByte *colors = icetImageGetColorcub(image);
+    IceTInt x, y;
+
+    for (y = 0; y < THREADS_IMAGE_HEIGHT; y++) {
+        for (x = 0; x < THREADS_IMAGE_WIDTH; x++) {
+            const IceTUByte *pixel = colors + 4*(y*THREADS_IMAGE_WIDTH + x);
+            IceTUByte expected[4] = { 255, 255, 255, 255 };
+            IceTFloat front_depth = 1.0f;
+            IceTInt proc;
+            for (proc = 0; proc < THREADS_NUM_RANKS; proc++) {
+                if (   ThreadsPixelActive(proc, x, y)
+                    && (ThreadsPixelDepth(proc, x) < front_depth) ) {
+                    front_depth = ThreadsPixelDepth(proc, x);
+                    expected[0] = (IceTUByte)(proc + 1);
+                    expected[1] = (IceTUByte)(2*proc);
+                    expected[2] = 0;
+                    expected[3] = 255;
+                }
+            }
+            if (memcmp(pixel, expected, 4) != 0) {
+                printrank("Bad pixel at %d, %d: got %d %d %d %d,"
+                          " expected %d %d %d %d\n", x, y,
+                          pixel[0], pixel[1], pixel[2], pixel[3],
+                          expected[0], expected[1], expected[2], expected[3]);
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int ThreadsCheckComposite(void)
+{
+    IceTFloat background_color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    IceTInt viewport[4] = { 0, 0, THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT };
+    IceTInt rank = icetCommRank();
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTInt x, y;
+    int strategy_index;
+    int si_index;
+    int result = TEST_PASSED;
+
+    colors = malloc(4*THREADS_IMAGE_WIDTH*THREADS_IMAGE_HEIGHT);
+    depths = malloc(THREADS_IMAGE_WIDTH*THREADS_IMAGE_HEIGHT
+                    *sizeof(IceTFloat));
+    for (y = 0; y < THREADS_IMAGE_HEIGHT; y++) {
+        for (x = 0; x < THREADS_IMAGE_WIDTH; x++) {
+            IceTSizeType pixel = y*THREADS_IMAGE_WIDTH + x;
+            colors[4*pixel + 0] = (IceTUByte)(rank + 1);
+            colors[4*pixel + 1] = (IceTUByte)(2*rank);
+            colors[4*pixel + 2] = 0;
+            colors[4*pixel + 3] = 255;
+            depths[pixel] = (  ThreadsPixelActive(rank, x, y)
+                             ? ThreadsPixelDepth(rank, x) : 1.0f );
+        }
+    }
+
+    icetResetTiles();
+    icetAddTile(0, 0, THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT, 0);
+    icetPhysicalRenderSize(THREADS_IMAGE_WIDTH, THREADS_IMAGE_HEIGHT);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        for (si_index = 0;
+             si_index < SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+             si_index++) {
+            IceTImage image;
+
+            icetSingleImageStrategy(single_image_strategy_list[si_index]);
+            printstat("  Compositing with %s and %s\n",
+                      icetGetStrategyName(),
+                      icetGetSingleImageStrategyName());
+
+            image = icetCompositeImage(colors, depths, viewport,
+                                       NULL, NULL, background_color);
+            if ((rank == 0) && (ThreadsCheckImage(image) != TEST_PASSED)) {
+                printrank("Failed with %s and %s\n",
+                          icetGetStrategyName(),
+                          icetGetSingleImageStrategyName());
+                result = TEST_FAILED;
+            }
+        }
+    }
+
+    free(colors);
+    free(depths);
+
+    return result;
+}
+
+static void ThreadsMain(IceTCommunicator comm, IceTVoid *data)
+{
+    IceTContext context;
+    IceTInt rank;
+    int result;
+
+    (void)data;
+
+    context = icetCreateContext(comm);
+    rank = icetCommRank();
+
+    /* Every rank runs every check so that a failure on one rank does not
+       leave the others waiting in a collective operation. */
+    result = TEST_PASSED;
+    printstat("Checking point-to-point messages\n");
+    if (ThreadsCheckPointToPoint() != TEST_PASSED) result = TEST_FAILED;
+    printstat("Checking collective operations\n");
+    if (ThreadsCheckCollectives() != TEST_PASSED) result = TEST_FAILED;
+    printstat("Checking compositing\n");
+    if (ThreadsCheckComposite() != TEST_PASSED) result = TEST_FAILED;
+    if (icetGetError() != ICET_NO_ERROR) {
+        printrank("IceT raised an error\n");
+        result = TEST_FAILED;
+    }
+
+    g_results[rank] = result;
+
+    icetDestroyContext(context);
+}
+
+static int ThreadsCommunicatorRun(void)
+{
+    IceTInt rank;
+    IceTInt thread_rank;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) return TEST_PASSED;
+
+    for (thread_rank = 0; thread_rank < THREADS_NUM_RANKS; thread_rank++) {
+        g_results[thread_rank] = TEST_NOT_PASSED;
+    }
+
+    printstat("Running %d threads\n", THREADS_NUM_RANKS);
+    if (!icetThreadsRun(THREADS_NUM_RANKS, ThreadsMain, NULL)) {
+        printrank("Could not start threads\n");
+        return TEST_NOT_PASSED;
+    }
+
+    for (thread_rank = 0; thread_rank < THREADS_NUM_RANKS; thread_rank++) {
+        if (g_results[thread_rank] != TEST_PASSED) {
+            printrank("Thread %d failed\n", thread_rank);
+            return TEST_FAILED;
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+#else /*ICET_USE_PTHREADS*/
+
+static int ThreadsCommunicatorRun(void)
+{
+    printstat("IceT was built without thread support.\n");
+    return TEST_NOT_RUN;
+}
+
+#endif /*ICET_USE_PTHREADS*/
+
+int ThreadsCommunicator(int argc, char *argv[])
+{
+    /* To remove warning */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ThreadsCommunicatorRun);
+}
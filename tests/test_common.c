@@ -37,8 +37,8 @@ IceTEnum strategy_list[5];
 int STRATEGY_LIST_SIZE = 5;
 /* int STRATEGY_LIST_SIZE = 1; */
 
-IceTEnum single_image_strategy_list[6];
-int SINGLE_IMAGE_STRATEGY_LIST_SIZE = 6;
+IceTEnum single_image_strategy_list[7];
+int SINGLE_IMAGE_STRATEGY_LIST_SIZE = 7;
 /* int SINGLE_IMAGE_STRATEGY_LIST_SIZE = 1; */
 
 IceTSizeType SCREEN_WIDTH;
@@ -241,6 +241,7 @@ void initialize_test(int *argcp, char ***argvp, IceTCommunicator comm)
     single_image_strategy_list[3] = ICET_SINGLE_IMAGE_STRATEGY_RADIXKR;
     single_image_strategy_list[4] = ICET_SINGLE_IMAGE_STRATEGY_TREE;
     single_image_strategy_list[5] = ICET_SINGLE_IMAGE_STRATEGY_BSWAP_FOLDING;
+    single_image_strategy_list[6] = ICET_SINGLE_IMAGE_STRATEGY_REDUCE_SCATTER;
 }
 
 IceTBoolean strategy_uses_single_image_strategy(IceTEnum strategy)